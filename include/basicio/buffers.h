@@ -6,37 +6,54 @@
 #include <string.h>
 #include <stdlib.h>
 
+#include "utils/arena.h"
+
 #define MIN_BUFFER_SIZE 512
 
+/**
+ * @brief Largest capacity buffer_grow accepts, so that a bad size cannot exhaust memory.
+ */
+#define MAX_BUFFER_SIZE ((size_t)1 << 30)
+
 /** Buffer Struct */
 
 typedef struct buffer_t
 {
-    int write_pos; // pos of next byte to load
-    int read_pos;  // pos of next byte to read 
-    int capacity;  // buffer size
+    size_t write_pos; // pos of next byte to load
+    size_t read_pos;  // pos of next byte to read 
+    size_t capacity;  // buffer size
+    bool owns_data; // false if data is borrowed memory such as a pooled slab
     char *data;
 } Buffer;
 
 /** Buffer Funcs. */
 
-void buffer_init(Buffer *buf, int capacity);
+void buffer_init(Buffer *buf, size_t capacity);
+
+/**
+ * @brief Wraps borrowed memory without copying it. The buffer never frees that memory, and growing it moves the content to owned heap memory instead.
+ * 
+ * @param buf
+ * @param data
+ * @param capacity
+ */
+void buffer_init_borrowed(Buffer *buf, char *data, size_t capacity);
 void buffer_destroy(Buffer *buf);
-bool buffer_grow(Buffer *buf, int new_capacity);
+bool buffer_grow(Buffer *buf, size_t new_capacity);
 void buffer_clear(Buffer *buf);
 char *buffer_pop(Buffer *buf);
 bool buffer_is_full(const Buffer *buf);
 bool buffer_is_drained(const Buffer *buf);
 
-int buffer_get_wpos(const Buffer *buf);
-bool buffer_set_wpos(Buffer *buf, int wpos);
-int buffer_get_rpos(const Buffer *buf);
-bool buffer_set_rpos(Buffer *buf, int rpos);
+size_t buffer_get_wpos(const Buffer *buf);
+bool buffer_set_wpos(Buffer *buf, size_t wpos);
+size_t buffer_get_rpos(const Buffer *buf);
+bool buffer_set_rpos(Buffer *buf, size_t rpos);
 
 bool buffer_put(Buffer *buf, char byte);
-bool buffer_put_span(Buffer *buf, int count, const char *bytes);
+bool buffer_put_span(Buffer *buf, size_t count, const char *bytes);
 char buffer_get(Buffer *buf);
-char *buffer_get_span(Buffer *buf, int count);
-char *buffer_read_delim(Buffer *buf, char delim);
+char *buffer_get_span(Buffer *buf, size_t count, Arena *arena);
+char *buffer_read_delim(Buffer *buf, char delim, Arena *arena);
 
 #endif
@@ -0,0 +1,110 @@
+#ifndef OUTQUEUE_H
+#define OUTQUEUE_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <linux/errqueue.h>
+
+#include "basicio/transport.h"
+
+/* Macros */
+
+#define OUTQUEUE_IOV_COUNT 16  // most segments handed to one sendmsg call
+
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY)
+#define OUTQUEUE_HAS_ZEROCOPY 1
+#else
+#define OUTQUEUE_HAS_ZEROCOPY 0
+#endif
+
+/* OutQueue Structs */
+
+typedef struct out_segment_t
+{
+    struct out_segment_t *next;
+    const char *base;  // first byte, either in data or in shared memory
+    size_t len;        // bytes from base
+    size_t sent;       // bytes already taken by the socket
+    bool owned;        // base points to data
+    char data[];       // private copy, since the writer reuses its buffers right after queueing
+} OutSegment;
+
+/**
+ * @brief A FIFO of reply bytes a non-blocking socket could not take yet. It moves with its connection, so a slow reader drains without holding a worker.
+ */
+typedef struct out_queue_t
+{
+    OutSegment *head;
+    OutSegment *tail;
+    size_t pending;   // unsent bytes over all segments
+    size_t buffered;  // unsent bytes of copied segments, which is what a slow client costs in memory
+    size_t zerocopy_min;        // shared segments this long are sent with MSG_ZEROCOPY, or 0 to always copy
+    uint32_t zerocopy_inflight; // zero-copy sends the kernel has yet to report done
+    bool zerocopy_on;           // SO_ZEROCOPY is set on the socket
+} OutQueue;
+
+/* OutQueue Funcs. */
+
+void outqueue_init(OutQueue *outq);
+void outqueue_clear(OutQueue *outq);
+
+/**
+ * @brief Moves every segment of src to the empty dst, leaving src empty.
+ */
+void outqueue_move(OutQueue *dst, OutQueue *src);
+bool outqueue_is_empty(const OutQueue *outq);
+
+/**
+ * @brief Appends a copy of the bytes.
+ *
+ * @param outq
+ * @param data
+ * @param len
+ * @returns false if out of memory.
+ */
+bool outqueue_put(OutQueue *outq, const char *data, size_t len);
+
+/**
+ * @brief Appends bytes by reference without copying them. They must stay valid until the queue is flushed or cleared, as static resources do.
+ *
+ * @param outq
+ * @param data
+ * @param len
+ * @returns false if out of memory.
+ */
+bool outqueue_put_shared(OutQueue *outq, const char *data, size_t len);
+
+/**
+ * @brief Sends queued bytes without blocking until the queue empties or the transport is full.
+ *
+ * @param outq
+ * @param transport
+ * @returns Bytes sent, or -1 if the transport failed. A full transport is not a failure.
+ */
+ssize_t outqueue_flush(OutQueue *outq, Transport *transport);
+
+/**
+ * @brief Opts into MSG_ZEROCOPY for shared segments of at least min_len bytes. The kernel then sends straight from their pages, so they must stay unchanged until their completions are reaped, as static resources do for the server's whole run.
+ * @note Copied segments never go zero-copy, since they are freed as soon as the socket takes them.
+ *
+ * @param outq
+ * @param min_len Smallest segment worth the page pinning and completion handling, or 0 for off.
+ */
+void outqueue_set_zerocopy(OutQueue *outq, size_t min_len);
+
+/**
+ * @brief Reads zero-copy completions from the socket's error queue without blocking. They must be read, since they make the socket poll as failed and count against its buffer limit.
+ * @note If the kernel reports having copied the data anyway, as over loopback, zero-copy is turned off for the queue.
+ *
+ * @param outq
+ * @param fd
+ * @returns Completed sends, or -1 if the error queue held a real socket error.
+ */
+int outqueue_reap_zerocopy(OutQueue *outq, int fd);
+
+#endif
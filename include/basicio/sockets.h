@@ -1,42 +1,210 @@
 #ifndef SOCKETS_H
 #define SOCKETS_H
 
+#include <errno.h>
+#include <stddef.h>
 #include <unistd.h>
+#include <poll.h>
 #include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <fcntl.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <netdb.h>
 #include <arpa/inet.h>
 
 #include "basicio/buffers.h"
+#include "basicio/outqueue.h"
+#include "basicio/transport.h"
+#include "utils/timing.h"
+
+/** Macros */
+
+#define SERVERSOCKET_UNIX_PREFIX "unix:"
+#define SERVERSOCKET_ABSTRACT_MARK '@'  // leads Unix socket names in the abstract namespace
+#define SERVERSOCKET_PATH_SIZE sizeof(((struct sockaddr_un *)0)->sun_path)
+#define SERVERSOCKET_HOST_SIZE 256
+#define CLIENTSOCKET_NO_DEADLINE 0
+#define CLIENTSOCKET_DEFAULT_MAX_PENDING (256 * 1024)
 
 /** ServerSocket */
 
+/**
+ * @brief TCP tuning of a listener's accept path. Unix domain listeners ignore it.
+ */
+typedef struct svr_socket_opts_t
+{
+    int defer_accept_secs; // TCP_DEFER_ACCEPT: hold connections in the kernel until their first bytes arrive, or 0 for off
+    int fastopen_qlen;     // TCP_FASTOPEN: pending requests that may ride on SYNs of returning clients, or 0 for off
+    bool nodelay;          // TCP_NODELAY for accepted connections, which inherit it from the listener
+} ServerSocketOpts;
+
 typedef struct svr_socket_t
 {
     int fd;
     int backlog;
+    int family;       // AF_INET, AF_INET6 or AF_UNIX
     bool ready;
     bool closed;
+    ServerSocketOpts opts;
+    char unix_path[SERVERSOCKET_PATH_SIZE]; // filesystem socket to remove on close, or empty
 } ServerSocket;
 
+/**
+ * @brief Prepares a TCP listener. IPv6 hosts such as "::" also accept IPv4 clients as mapped addresses.
+ */
 void serversocket_init(ServerSocket *svr_sock, const char *host, const char *port, int backlog);
+
+/**
+ * @brief Prepares a Unix domain listener, which spares local clients such as a sidecar proxy the TCP stack. A stale socket file left by an earlier run is replaced, but setup fails if a server still accepts on it.
+ * 
+ * @param svr_sock
+ * @param path Filesystem path, or a name after '@' for the abstract namespace, which needs no file.
+ * @param backlog
+ */
+void serversocket_init_unix(ServerSocket *svr_sock, const char *path, int backlog);
+
+/**
+ * @brief Prepares a listener from an address string: "unix:/path/to.sock", "unix:@name", "host:port" or "[ipv6-host]:port".
+ * 
+ * @param svr_sock
+ * @param address
+ * @param backlog
+ * @returns false if the address is malformed or the socket could not be bound.
+ */
+bool serversocket_init_address(ServerSocket *svr_sock, const char *address, int backlog);
+
+/**
+ * @brief Sets the TCP options applied by serversocket_open. Call this before opening.
+ */
+void serversocket_set_options(ServerSocket *svr_sock, const ServerSocketOpts *opts);
+
+/**
+ * @brief Starts listening with the socket's backlog and options. Options the system lacks are skipped, since they only tune performance.
+ */
 bool serversocket_open(ServerSocket *svr_sock);
 void serversocket_close(ServerSocket *svr_sock);
+
+/**
+ * @brief Stops accepting without closing the fd, which wakes any thread polling the listener. Close it once that thread is done.
+ */
+void serversocket_shutdown(ServerSocket *svr_sock);
+
+/**
+ * @brief Accepts one pending connection without blocking. The new socket is non-blocking and close-on-exec from the start.
+ * 
+ * @param svr_sock
+ * @returns The connection's fd, or -1 with errno EAGAIN once the backlog is empty.
+ */
 int serversocket_accept(ServerSocket *svr_sock);
 
 /** ClientSocket */
 
 typedef struct cli_socket_t
 {
-    int fd;
+    Transport transport;   // byte stream under the socket, which is the fd's own unless replaced for tests and benchmarks
     bool closed;
+    uint64_t deadline_ms;  // monotonic time when blocked reads give up, or CLIENTSOCKET_NO_DEADLINE
+    uint32_t extend_ms;    // if not 0, each read or send that moves data pushes the deadline this far past now
+    OutQueue outq;         // written bytes the socket could not take yet
+    size_t max_pending;    // writes wait under the deadline while more than this is copied into the queue
+    uint64_t bytes_in;     // received since init, for the owner to collect
+    uint64_t bytes_out;    // sent since init, not counting what is still queued
+    bool read_failed;      // a read hit end of stream or an I/O error, as opposed to a malformed request
+    bool timed_out;        // a read or send gave up because the deadline passed
 } ClientSocket;
 
 void clientsocket_init(ClientSocket *cli_sock, int fd);
+
+/**
+ * @brief Prepares a client over another transport, such as memory pipes that feed the scanner at memory speed or a script of fragmented reads and short writes. The socket takes a copy of the transport, which stays open until clientsocket_close.
+ * @note Zero-copy sends and detaching into a parking set need a socket transport.
+ */
+void clientsocket_init_transport(ClientSocket *cli_sock, const Transport *transport);
 void clientsocket_close(ClientSocket *cli_sock);
+
+/**
+ * @brief Bounds every later read. Data already received is read without waiting, and a read that would block only polls until the deadline, then fails with ETIMEDOUT.
+ * 
+ * @param cli_sock
+ * @param deadline_ms Monotonic time from timing_now_ms(), or CLIENTSOCKET_NO_DEADLINE.
+ * @param extend_ms Turns the deadline into an inactivity timeout if not 0, as for slow but steady bodies.
+ */
+void clientsocket_set_deadline(ClientSocket *cli_sock, uint64_t deadline_ms, uint32_t extend_ms);
+
+/**
+ * @brief Caps the bytes queued for sending, so a slow reader costs at most this much memory before writers wait for it.
+ */
+void clientsocket_set_max_pending(ClientSocket *cli_sock, size_t max_pending);
+
+/**
+ * @brief Sends shared payloads of at least min_len bytes with MSG_ZEROCOPY, which saves copying large static bodies into the kernel on every reply. Pays off from a few hundred KB, and turns itself off where the kernel would copy anyway.
+ * 
+ * @param cli_sock
+ * @param min_len Or 0 to always copy.
+ */
+void clientsocket_set_zerocopy(ClientSocket *cli_sock, size_t min_len);
 bool clientsocket_read_line(ClientSocket *cli_sock, char delim, Buffer *dst_buf);
-bool clientsocket_read_blob(ClientSocket *cli_sock, int count, Buffer *dst_buf);
-bool clientsocket_write_blob(ClientSocket *cli_sock, int count, const Buffer *src_buf);
+
+/**
+ * @brief Checks without waiting whether the client already sent more data or hung up, as with pipelined requests.
+ * 
+ * @param cli_sock
+ * @returns true if a read would not block.
+ */
+bool clientsocket_has_input(ClientSocket *cli_sock);
+bool clientsocket_read_blob(ClientSocket *cli_sock, size_t count, Buffer *dst_buf);
+
+/**
+ * @brief Reads whatever is available up to count bytes into raw memory with one receive call.
+ * 
+ * @param cli_sock
+ * @param dst
+ * @param count
+ * @returns Bytes read, 0 if the peer closed, or -1 on error.
+ */
+ssize_t clientsocket_read_some(ClientSocket *cli_sock, char *dst, size_t count);
+/**
+ * @brief Sends without blocking, and queues a copy of whatever the socket cannot take yet. Only waits under the deadline while the queue holds more than max_pending copied bytes.
+ * 
+ * @param cli_sock
+ * @param count
+ * @param src_buf
+ * @returns false if the client is gone, too slow for the deadline, or memory ran out.
+ */
+bool clientsocket_write_blob(ClientSocket *cli_sock, size_t count, const Buffer *src_buf);
+
+/**
+ * @brief Sends scattered segments with one system call per pass, so payloads need no copy into a reply buffer. Leftovers are queued as in clientsocket_write_blob.
+ * @note The iovec array is modified to track partial sends.
+ */
+bool clientsocket_write_iov(ClientSocket *cli_sock, struct iovec *iov, int iov_count);
+
+/**
+ * @brief Like clientsocket_write_iov, but the segments flagged in shared_mask are queued by reference instead of copied, and so never count toward max_pending.
+ * 
+ * @param cli_sock
+ * @param iov
+ * @param iov_count At most 32 segments.
+ * @param shared_mask Bit i marks iov[i] as memory that outlives the connection.
+ */
+bool clientsocket_write_iov_shared(ClientSocket *cli_sock, struct iovec *iov, int iov_count, uint32_t shared_mask);
+
+/**
+ * @brief Gets the count of written bytes still waiting to be sent.
+ */
+size_t clientsocket_pending(const ClientSocket *cli_sock);
+
+/**
+ * @brief Hands the socket's fd and queued output over to a new owner, such as a parking set that finishes sending. The socket is left closed without closing its fd.
+ * 
+ * @param cli_sock
+ * @param dst_outq Empty queue to take the pending output.
+ * @returns The detached fd.
+ */
+int clientsocket_detach(ClientSocket *cli_sock, OutQueue *dst_outq);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,137 @@
+#ifndef TRANSPORT_H
+#define TRANSPORT_H
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/* Macros */
+
+#define TRANSPORT_NO_FD -1
+#define MEMPIPE_DEFAULT_CAPACITY 4096
+
+/* Transport Structs */
+
+struct transport_t;
+
+/**
+ * @brief Byte stream operations behind a ClientSocket. None of them may block.
+ */
+typedef struct transport_ops_t
+{
+    ssize_t (*recv)(struct transport_t *transport, char *dst, size_t count);               // like recv with MSG_DONTWAIT
+    ssize_t (*sendmsg)(struct transport_t *transport, const struct msghdr *msg, int flags); // like sendmsg, where MSG_DONTWAIT is implied
+    int (*poll)(struct transport_t *transport, short events, int timeout_ms);              // revents of one poll, 0 on timeout, or -1
+    void (*close)(struct transport_t *transport);
+} TransportOps;
+
+/**
+ * @brief A byte stream: a real socket, or a stand-in that lets the scanner and writer run without a network.
+ */
+typedef struct transport_t
+{
+    const TransportOps *ops;
+    void *ctx;  // state of stand-in transports
+    int fd;     // socket fd, or TRANSPORT_NO_FD
+} Transport;
+
+/**
+ * @brief A one-way, growable byte FIFO in memory.
+ */
+typedef struct mem_pipe_t
+{
+    char *data;
+    size_t capacity;
+    size_t read_pos;
+    size_t write_pos;
+    bool closed;  // the writing end is done, so reads past the data see end of stream
+} MemPipe;
+
+/**
+ * @brief Both directions of an in-memory connection as the server sees them.
+ */
+typedef struct mem_transport_t
+{
+    MemPipe *in_ref;   // what the client sent
+    MemPipe *out_ref;  // what the server replied
+} MemTransport;
+
+/**
+ * @brief Replays fixed sizes for each receive and send of another transport, to force fragmented requests and short writes. A size of 0 makes that call fail with EAGAIN once. Sizes repeat from the start when the script runs out.
+ */
+typedef struct scripted_transport_t
+{
+    Transport *inner_ref;
+    const size_t *read_sizes;
+    int read_count;
+    int read_step;
+    const size_t *write_sizes;
+    int write_count;
+    int write_step;
+} ScriptedTransport;
+
+/**
+ * @brief Gets every chunk a tap transport received, such as to capture requests.
+ */
+typedef void (*TransportTapFunc)(void *tap_ref, int fd, const char *data, size_t len);
+
+/**
+ * @brief Passes every call on to another transport, showing received bytes to a callback first.
+ */
+typedef struct tap_transport_t
+{
+    Transport inner;  // held by value, since the tap usually replaces a ClientSocket's own transport
+    TransportTapFunc on_recv;
+    void *tap_ref;    // passed to on_recv
+} TapTransport;
+
+/* Transport Funcs. */
+
+void transport_init_socket(Transport *transport, int fd);
+
+/**
+ * @brief Runs over a pair of memory pipes. Polls that find nothing ready fail at once with ETIMEDOUT, since nothing else can fill the pipes while the caller waits.
+ */
+void transport_init_memory(Transport *transport, MemTransport *mem);
+
+/**
+ * @brief Wraps another transport, passing each call on with its size cut to the script's next step.
+ *
+ * @param transport
+ * @param scripted Script and wrapped transport. A NULL size list leaves that direction alone.
+ */
+void transport_init_scripted(Transport *transport, ScriptedTransport *scripted);
+/**
+ * @brief Wraps another transport, which must be set in tap->inner first. The tap keeps the inner fd, so fd users such as parking see the same socket.
+ */
+void transport_init_tap(Transport *transport, TapTransport *tap);
+
+/**
+ * @brief Checks whether calls end at a kernel socket, through any taps, so its fd may be used for socket options and MSG_ZEROCOPY.
+ */
+bool transport_is_socket(const Transport *transport);
+
+ssize_t transport_recv(Transport *transport, char *dst, size_t count);
+ssize_t transport_sendmsg(Transport *transport, const struct msghdr *msg, int flags);
+int transport_poll(Transport *transport, short events, int timeout_ms);
+void transport_close(Transport *transport);
+
+/* MemPipe Funcs. */
+
+bool mempipe_init(MemPipe *pipe, size_t capacity);
+void mempipe_dispose(MemPipe *pipe);
+bool mempipe_write(MemPipe *pipe, const char *data, size_t len);
+size_t mempipe_read(MemPipe *pipe, char *dst, size_t count);
+size_t mempipe_available(const MemPipe *pipe);
+
+/**
+ * @brief Empties the pipe and reopens it for writing.
+ */
+void mempipe_clear(MemPipe *pipe);
+
+#endif
@@ -12,20 +12,21 @@
 
 #define BQUEUE_MIN_SIZE 4
 #define BQUEUE_DEFAULT_SIZE 16
-#define BQUEUE_MAX_SIZE 32
+#define BQUEUE_MAX_SIZE 4096  // parked connections may wake up together in large bursts
 
 /* BlockedQueue Structs */
 
 typedef struct qnode_t
 {
-    int data;  // client-initiated connection fd
+    int data;    // client-initiated connection fd
+    int served;  // requests already served on the connection, if it comes back from parking
     struct qnode_t *next;
 } QueueNode;
 
 typedef struct bqueue_t
 {
-    int8_t count;
-    int8_t capacity;
+    int count;
+    int capacity;
     pthread_mutex_t lock;    // prevents race conditions of queue data
     pthread_cond_t signaler; // semaphore to wake any consumer threads
     QueueNode *head;         // first node
@@ -38,7 +39,7 @@ QueueNode *qnode_create(int data_fd);
 
 /* BlockingQueue Funcs. */
 
-bool bqueue_init(BlockedQueue *bqueue, int8_t capacity);
+bool bqueue_init(BlockedQueue *bqueue, int capacity);
 
 void bqueue_destroy(BlockedQueue *bqueue);
 
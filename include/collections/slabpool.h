@@ -0,0 +1,52 @@
+#ifndef SLABPOOL_H
+#define SLABPOOL_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Magic Macros */
+
+#define SLABPOOL_MIN_COUNT 4
+#define SLABPOOL_MAX_COUNT 4096
+#define SLABPOOL_NIL_ID 0  // slab ids are 1-based so 0 can end the freelist
+
+/* SlabPool Struct */
+
+/**
+ * @brief A lock-free freelist of fixed-size memory slabs shared by all workers. Connections borrow a slab for their I/O buffers instead of allocating new ones.
+ * @note The head packs an ABA tag in its upper 32 bits and a slab id in its lower 32 bits, so a pop racing with a pop and push of the same slab fails its CAS.
+ */
+typedef struct slabpool_t
+{
+    size_t slab_size;              // bytes per slab
+    uint32_t slab_count;           // total preallocated slabs
+    char *slabs;                   // one contiguous block of all slabs
+    _Atomic uint32_t *next_ids;    // freelist links by slab id
+    _Atomic uint64_t head;         // tagged id of the first free slab
+} SlabPool;
+
+/* SlabPool Funcs. */
+
+bool slabpool_init(SlabPool *pool, uint32_t slab_count, size_t slab_size);
+
+void slabpool_dispose(SlabPool *pool);
+
+/**
+ * @brief Pops a free slab without locking.
+ * 
+ * @param pool
+ * @returns char* or NULL if every slab is in use, so callers should fall back to normal allocation.
+ */
+char *slabpool_acquire(SlabPool *pool);
+
+/**
+ * @brief Pushes a slab back onto the freelist without locking. Pointers from outside the pool are ignored.
+ * 
+ * @param pool
+ * @param slab
+ */
+void slabpool_release(SlabPool *pool, char *slab);
+
+#endif
@@ -0,0 +1,100 @@
+#ifndef TIMERWHEEL_H
+#define TIMERWHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/* Magic Macros */
+
+#define TIMERWHEEL_LEVELS 4
+#define TIMERWHEEL_SLOT_BITS 6
+#define TIMERWHEEL_SLOTS (1 << TIMERWHEEL_SLOT_BITS)
+#define TIMERWHEEL_SLOT_MASK (TIMERWHEEL_SLOTS - 1)
+#define TIMERWHEEL_MAX_TICKS ((uint64_t)1 << (TIMERWHEEL_LEVELS * TIMERWHEEL_SLOT_BITS)) // farther timers are clamped to this range
+#define TIMERWHEEL_NO_EXPIRY UINT64_MAX
+
+/* Structs */
+
+struct timer_node_t;
+
+/**
+ * @brief An alias for logic run when a timer expires. The node is already unlinked, so the callback may schedule it again.
+ */
+typedef void (*TimerFunc)(struct timer_node_t *node);
+
+/**
+ * @brief An intrusive timer embedded in its owner, like a connection record, so scheduling never allocates.
+ */
+typedef struct timer_node_t
+{
+    struct timer_node_t *prev;
+    struct timer_node_t *next;  // NULL while the timer is not scheduled
+    uint64_t expiry_tick;
+    TimerFunc on_expire;
+    void *owner_ref;            // object that the callback acts on
+} TimerNode;
+
+/**
+ * @brief A hierarchical hashed timer wheel. Level 0 has one slot per tick, and each higher level has slots 64 times as coarse whose timers cascade down as their time nears.
+ * @note Scheduling and cancelling are O(1). Advancing costs one slot visit per elapsed tick plus each timer's few cascades, and an empty wheel just jumps ahead.
+ */
+typedef struct timerwheel_t
+{
+    uint32_t tick_ms;       // milliseconds per level 0 slot
+    uint64_t current_tick;  // last tick that has been processed
+    size_t count;           // scheduled timers
+    TimerNode slots[TIMERWHEEL_LEVELS][TIMERWHEEL_SLOTS]; // circular list sentinels
+} TimerWheel;
+
+/* TimerNode Funcs. */
+
+void timernode_init(TimerNode *node, TimerFunc on_expire, void *owner);
+bool timernode_is_scheduled(const TimerNode *node);
+
+/* TimerWheel Funcs. */
+
+/**
+ * @brief Prepares an empty wheel starting at the given time.
+ * 
+ * @param wheel
+ * @param now_ms Monotonic time like timing_now_ms().
+ * @param tick_ms Timer resolution, where timers may fire up to one tick late but never early.
+ */
+void timerwheel_init(TimerWheel *wheel, uint64_t now_ms, uint32_t tick_ms);
+
+/**
+ * @brief Schedules or reschedules a timer to expire at an absolute time. Past times expire on the next advance.
+ * 
+ * @param wheel
+ * @param node
+ * @param expiry_ms
+ */
+void timerwheel_schedule(TimerWheel *wheel, TimerNode *node, uint64_t expiry_ms);
+
+/**
+ * @brief Unschedules a timer if it is scheduled.
+ * 
+ * @param wheel
+ * @param node
+ */
+void timerwheel_cancel(TimerWheel *wheel, TimerNode *node);
+
+/**
+ * @brief Processes every tick up to the given time and runs the callbacks of expired timers.
+ * 
+ * @param wheel
+ * @param now_ms
+ * @returns Count of expired timers.
+ */
+int timerwheel_advance(TimerWheel *wheel, uint64_t now_ms);
+
+/**
+ * @brief Gets a time by which advancing is due. It is exact for timers within 64 ticks, but for farther ones it is the next cascade, which is never late.
+ * 
+ * @param wheel
+ * @returns Absolute milliseconds, or TIMERWHEEL_NO_EXPIRY for an empty wheel.
+ */
+uint64_t timerwheel_next_expiry(const TimerWheel *wheel);
+
+#endif
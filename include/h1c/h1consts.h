@@ -29,8 +29,27 @@
 #define HTTP_HEADER_CONNECTION "Connection:"
 #define HTTP_HVALUE_CONN_ALIVE "keep-alive"
 #define HTTP_HVALUE_CONN_CLOSE "close"
+#define HTTP_HEADER_KEEP_ALIVE "Keep-Alive:"
 #define HTTP_HEADER_CTYPE "Content-Type:"
 #define HTTP_HEADER_CLEN "Content-Length:"
+#define HTTP_HEADER_ACCEPT_ENCODING "Accept-Encoding:"
+#define HTTP_HEADER_CENCODING "Content-Encoding:"
+#define HTTP_HEADER_VARY "Vary:"
+#define HTTP_HVALUE_VARY_ENCODING "Accept-Encoding"
+#define HTTP_HEADER_ETAG "ETag:"
+#define HTTP_HEADER_LAST_MODIFIED "Last-Modified:"
+#define HTTP_HEADER_IF_NONE_MATCH "If-None-Match:"
+#define HTTP_HEADER_IF_MODIFIED_SINCE "If-Modified-Since:"
+#define HTTP_HEADER_RANGE "Range:"
+#define HTTP_HEADER_IF_RANGE "If-Range:"
+#define HTTP_HEADER_ACCEPT_RANGES "Accept-Ranges:"
+#define HTTP_HEADER_CONTENT_RANGE "Content-Range:"
+#define HTTP_HVALUE_RANGES_BYTES "bytes"
+#define HTTP_HEADER_EXPECT "Expect:"
+#define HTTP_HVALUE_EXPECT_CONTINUE "100-continue"
+#define HTTP_HEADER_TRANSFER_ENCODING "Transfer-Encoding:"
+#define HTTP_HVALUE_CHUNKED "chunked"
+#define HTTP_RANGE_UNIT_PREFIX "bytes="
 
 /** Content_Type MIMEs */
 
@@ -39,23 +58,43 @@
 #define MIME_TXT_HTML "text/html"
 #define MIME_TXT_CSS "text/css"
 #define MIME_TXT_JS "text/javascript"
+#define MIME_APP_OCTET "application/octet-stream"
+#define MIME_MULTI_BYTERANGES "multipart/byteranges"
+#define MIME_BYTERANGES_BOUNDARY "H1C-byteranges-5f0c2e9b"
+
+/** Content-Encoding Tokens */
+
+#define ENCODING_TOKEN_IDENTITY "identity"
+#define ENCODING_TOKEN_GZIP "gzip"
+#define ENCODING_TOKEN_BR "br"
+#define ENCODING_TOKEN_ANY "*"
 
 /** Statuses */
 
 #define HTTP_STATUS_OK "200"
+#define HTTP_STATUS_PARTIAL "206"
+#define HTTP_STATUS_NOT_MODIFIED "304"
 #define HTTP_STATUS_BAD_REQUEST "400"
 #define HTTP_STATUS_UNFOUND "404"
 #define HTTP_STATUS_NO_ACCEPT "406"
+#define HTTP_STATUS_TOO_LARGE "413"
+#define HTTP_STATUS_BAD_RANGE "416"
 #define HTTP_STATUS_SERVER_ERR "500"
 #define HTTP_STATUS_NO_IMPL "501"
 
 #define HTTP_MSG_OK "OK"
+#define HTTP_MSG_PARTIAL "Partial Content"
+#define HTTP_MSG_NOT_MODIFIED "Not Modified"
 #define HTTP_MSG_BAD_REQUEST "Bad Request"
 #define HTTP_MSG_UNFOUND "Not Found"
 #define HTTP_MSG_NO_ACCEPT "Not Acceptable"
+#define HTTP_MSG_TOO_LARGE "Content Too Large"
+#define HTTP_MSG_BAD_RANGE "Range Not Satisfiable"
 #define HTTP_MSG_SERVER_ERR "Internal Server Error"
 #define HTTP_MSG_NO_IMPL "Not Implemented"
 
+#define HTTP_INTERIM_CONTINUE "HTTP/1.1 100 Continue\r\n\r\n"
+
 /** Enums */
 
 typedef enum http_method_e
@@ -81,7 +120,21 @@ typedef enum mime_type_e
     TXT_HTML,
     TXT_CSS,
     TXT_JS,
+    APP_OCTET,
     MIME_UNKNOWN
 } MimeType;
 
+/**
+ * @brief Codes of supported Content-Encoding values. The order is also the index order of static resource variants.
+ */
+typedef enum content_encoding_e
+{
+    ENCODING_IDENTITY,
+    ENCODING_GZIP,
+    ENCODING_BR,
+    ENCODING_COUNT
+} ContentEncoding;
+
+#define ENCODING_FLAG(enc) (1 << (enc))
+
 #endif
\ No newline at end of file
@@ -7,6 +7,29 @@
 #include "h1c/reqinfo.h"
 #include "basicio/buffers.h"
 #include "basicio/sockets.h"
+#include "utils/probes.h"
+
+/** Macros */
+
+/**
+ * @brief Bytes of borrowed memory the scanner splits into its header and body buffers.
+ */
+#define H1SCANNER_BUFFER_MEM_SIZE (2 * MIN_BUFFER_SIZE)
+
+/**
+ * @brief Largest body buffered whole for handlers that do not stream it. Bigger ones get 413.
+ */
+#define H1SCANNER_MAX_BUFFERED_BODY (64 * 1024)
+
+/**
+ * @brief Largest unread body that is drained to keep the connection usable. Bigger leftovers close the connection.
+ */
+#define H1SCANNER_MAX_SKIP_SIZE (64 * 1024)
+
+/**
+ * @brief Most trailer fields kept after a chunked body. More of them fail the request.
+ */
+#define H1SCANNER_MAX_TRAILERS 8
 
 /** Enums */
 
@@ -20,11 +43,21 @@ typedef enum http_scanner_state_e
     EAT_URL,     // process URL string
     EAT_SCHEMA,  // process HTTP schema
     EAT_HEADER,   // skip or process header
-    EAT_BLOB,    // skip or process body
+    EAT_BLOB,    // headers are done, but the body is still unread
     STOP,        // finish the current request scan
     ERROR        // signals 400 Bad Request error to server!
 } HttpScannerState;
 
+/**
+ * @brief Defines how the end of a request body is found.
+ */
+typedef enum http_body_framing_e
+{
+    BODY_NONE,    // no body
+    BODY_LENGTH,  // Content-Length bytes follow the headers
+    BODY_CHUNKED  // "Transfer-Encoding: chunked" chunks with optional trailers follow the headers
+} HttpBodyFraming;
+
 /**
  * @brief Models a very crude finite state machine to read and parse HTTP/1.x requests.
  */
@@ -32,14 +65,32 @@ typedef struct h1scanner_t
 {
     HttpScannerState state;      // operation current scanning
     ClientSocket *cli_sock_ref;  // reference to readable client stream
+    int worker_id;               // worker that owns the connection, for the request__parsed probe
+    Arena *arena_ref;            // per-request memory for scanned strings and bodies
     bool buffers_ok;             // whether I/O buffers are allocated or not
+    HttpBodyFraming framing;     // how the current body ends
+    size_t body_left;            // body bytes still unread from the socket, or from the current chunk if chunked
+    bool chunk_crlf_pending;     // if the CRLF ending the last chunk's data is still unread
+    bool continue_pending;       // if the client awaits "100 Continue" before sending the body
+    bool body_too_large;         // if buffering stopped because of H1SCANNER_MAX_BUFFERED_BODY
+    int trailer_count;
+    HttpField trailers[H1SCANNER_MAX_TRAILERS]; // trailer fields of a chunked body, valid once it is read
     Buffer header_buf;
     Buffer body_buf;
 } HttpScanner;
 
 /** Helper Funcs. */
 
-void h1scanner_init(HttpScanner *scanner, ClientSocket *cli_sock);
+/**
+ * @brief Prepares a scanner for a new connection.
+ * 
+ * @param scanner
+ * @param cli_sock
+ * @param worker_id Worker that owns the connection, or 0 outside of a worker.
+ * @param arena
+ * @param buffer_mem Optional borrowed memory of H1SCANNER_BUFFER_MEM_SIZE bytes, such as part of a pooled slab. If NULL, the buffers are allocated.
+ */
+void h1scanner_init(HttpScanner *scanner, ClientSocket *cli_sock, int worker_id, Arena *arena, char *buffer_mem);
 void h1scanner_dispose(HttpScanner *scanner);
 void h1scanner_reset(HttpScanner *scanner);
 bool h1scanner_is_ready(const HttpScanner *scanner);
@@ -47,7 +98,54 @@ HttpScannerState h1scanner_method(HttpScanner *scanner, BaseRequest *req_ref);
 HttpScannerState h1scanner_url(HttpScanner *scanner, BaseRequest *req_ref);
 HttpScannerState h1scanner_schema(HttpScanner *scanner, BaseRequest *req_ref);
 HttpScannerState h1scanner_header(HttpScanner *scanner, BaseRequest *req_ref);
+
+/**
+ * @brief Reads the rest of the body into the request arena. Bodies over H1SCANNER_MAX_BUFFERED_BODY fail with body_too_large set.
+ * 
+ * @param scanner
+ * @param req_ref Receives the NUL-terminated body_blob. A chunked body's decoded length is put into content_len.
+ * @returns STOP or ERROR
+ */
 HttpScannerState h1scanner_eat_blob(HttpScanner *scanner, BaseRequest *req_ref);
+
+/**
+ * @brief Checks if the scanned request still has body bytes waiting in the socket.
+ */
+bool h1scanner_has_body(const HttpScanner *scanner);
+
+/**
+ * @brief Reads the next piece of the body as it arrives. Each piece is at most one body buffer long, so memory stays bounded for any body size.
+ * 
+ * @param scanner
+ * @param chunk_ref Receives a view of the piece, valid until the next call.
+ * @returns Bytes in the piece, 0 once the body is done, or -1 on error.
+ */
+ssize_t h1scanner_read_body(HttpScanner *scanner, const char **chunk_ref);
+
+/**
+ * @brief Finds a trailer field of a chunked body by its case-insensitive name without the colon.
+ * 
+ * @param scanner
+ * @param name
+ * @returns The value or NULL if the body had no such trailer or is not fully read yet.
+ */
+const char *h1scanner_get_trailer(const HttpScanner *scanner, const char *name);
+
+/**
+ * @brief Discards body bytes a handler left unread, so the next request on the connection starts in the right place.
+ * 
+ * @param scanner
+ * @returns false if the connection must close, as the leftover is over H1SCANNER_MAX_SKIP_SIZE or reading failed.
+ */
+bool h1scanner_skip_body(HttpScanner *scanner);
+
+/**
+ * @brief Scans the request line and headers. The body is left in the socket, so the state is EAT_BLOB instead of STOP if there is one.
+ * 
+ * @param scanner
+ * @param req_ref
+ * @returns false on a malformed request or read error.
+ */
 bool h1scanner_read_reqinfo(HttpScanner *scanner, BaseRequest *req_ref);
 
 #endif
\ No newline at end of file
@@ -5,11 +5,17 @@
 #include "basicio/buffers.h"
 #include "basicio/sockets.h"
 #include "h1c/resinfo.h"
+#include "utils/probes.h"
 
 /** Macros */
 
 #define DEFAULT_REPLY_BUFSIZE 3096
 
+/**
+ * @brief Enough segments for the headers, every multipart part header and payload slice, and the closing boundary.
+ */
+#define H1WRITER_IOV_COUNT (2 + 2 * BYTE_RANGES_MAX_COUNT)
+
 /** Structs */
 
 /**
@@ -18,12 +24,26 @@
 typedef struct h1writer_t
 {
     ClientSocket *cli_sock_ref;
+    int worker_id;       // worker that owns the connection, for the response__written probe
     Buffer reply_buf;
+    bool streaming;      // a streaming reply is open, and its head may still wait in reply_buf
+    bool stream_chunked; // chunks are framed, otherwise the body ends when the connection closes
+    bool stream_discard; // chunks are dropped, as for HEAD requests
+    int stream_status;   // status code of the open streaming reply, for its response__written probe
+    size_t stream_bytes; // bytes of the open streaming reply handed to the socket so far
 } ReplyWriter;
 
 /** ReplyWriter Funcs */
 
-void h1writer_init(ReplyWriter *writer, ClientSocket *cli_sock_ref);
+/**
+ * @brief Prepares a writer for a new connection.
+ * 
+ * @param writer
+ * @param cli_sock_ref
+ * @param worker_id Worker that owns the connection, or 0 outside of a worker.
+ * @param buffer_mem Optional borrowed memory of DEFAULT_REPLY_BUFSIZE bytes, such as part of a pooled slab. If NULL, the buffer is allocated.
+ */
+void h1writer_init(ReplyWriter *writer, ClientSocket *cli_sock_ref, int worker_id, char *buffer_mem);
 void h1writer_dispose(ReplyWriter *writer);
 void h1writer_reset(ReplyWriter *writer);
 
@@ -31,12 +51,64 @@ bool h1writer_put_status_line(ReplyWriter *writer, const ResponseObj *resinfo);
 bool h1writer_put_header_server(ReplyWriter *writer, const ResponseObj *resinfo);
 bool h1writer_put_header_date(ReplyWriter *writer, const ResponseObj *resinfo);
 bool h1writer_put_header_keepconn(ReplyWriter *writer, const ResponseObj *resinfo);
+bool h1writer_put_header_keepalive(ReplyWriter *writer, const ResponseObj *resinfo);
 bool h1writer_put_header_contype(ReplyWriter *writer, const ResponseObj *resinfo);
 bool h1writer_put_header_contlen(ReplyWriter *writer, const ResponseObj *resinfo);
+bool h1writer_put_header_encoding(ReplyWriter *writer, const ResponseObj *resinfo);
+bool h1writer_put_header_vary(ReplyWriter *writer, const ResponseObj *resinfo);
+bool h1writer_put_header_etag(ReplyWriter *writer, const ResponseObj *resinfo);
+bool h1writer_put_header_lastmod(ReplyWriter *writer, const ResponseObj *resinfo);
+bool h1writer_put_header_acceptranges(ReplyWriter *writer, const ResponseObj *resinfo);
+bool h1writer_put_header_conrange(ReplyWriter *writer, const ResponseObj *resinfo);
+bool h1writer_put_header_transenc(ReplyWriter *writer, const ResponseObj *resinfo);
 bool h1writer_put_header_blank(ReplyWriter *writer);
 bool h1writer_write_body_blob(ReplyWriter *writer, const ResponseObj *resinfo);
 bool h1writer_write_out(ReplyWriter *writer);
 
+/**
+ * @brief Sends the buffered headers and then the payload, or just its requested ranges, without copying the payload into the reply buffer.
+ * 
+ * @param writer
+ * @param resinfo
+ * @returns true if everything was sent.
+ */
+bool h1writer_write_reply_iov(ReplyWriter *writer, const ResponseObj *resinfo);
+
+/**
+ * @brief Puts the status line and every header of the reply into the reply buffer without sending anything.
+ */
+bool h1writer_put_reply_head(ReplyWriter *writer, const ResponseObj *resinfo);
+
 bool h1writer_put_reply(ReplyWriter *writer, const ResponseObj *resinfo);
 
+/** ReplyWriter Streaming Funcs */
+
+/**
+ * @brief Begins a streamed reply. HTTP/1.1 replies use chunked encoding, but HTTP/1.0 ones end by closing the connection. The head is held back to share a send with the first chunk.
+ * 
+ * @param writer
+ * @param resinfo Filled reply whose status line picks the framing. Its content length and payload are ignored.
+ * @param discard_body Sends only the head, as for HEAD requests.
+ * @returns false if the head does not fit.
+ */
+bool h1writer_stream_open(ReplyWriter *writer, ResponseObj *resinfo, bool discard_body);
+
+/**
+ * @brief Sends one chunk of a streamed reply right away. Unsent bytes are queued, but the call waits while the queue is over its cap, so a slow client throttles the handler instead of piling up memory.
+ * 
+ * @param writer
+ * @param data
+ * @param len Empty chunks are skipped since they would end the body.
+ * @returns false if the client is gone.
+ */
+bool h1writer_stream_write(ReplyWriter *writer, const char *data, size_t len);
+
+/**
+ * @brief Ends a streamed reply with the last chunk, or just flushes a held back head.
+ * 
+ * @param writer
+ * @returns false if the client is gone.
+ */
+bool h1writer_stream_finish(ReplyWriter *writer);
+
 #endif
\ No newline at end of file
@@ -4,10 +4,35 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
 #include "h1c/h1consts.h"
 
+/** Macros */
+
+#define BYTE_RANGES_MAX_COUNT 8
+#define BYTE_RANGES_INVALID -1  // Range header must be ignored, so the full payload is sent
+#define BYTE_RANGES_UNSATISFIABLE 0
+
 /** Structs */
 
+/**
+ * @brief An inclusive byte span of a payload, like "first-last" in a Range header.
+ */
+typedef struct byte_range_t
+{
+    int first;
+    int last;
+} ByteRange;
+
+/**
+ * @brief A name and value pair of a header section, such as a chunked body's trailers.
+ */
+typedef struct http_field_t
+{
+    char *name;
+    char *value;
+} HttpField;
+
 typedef struct basic_reqinfo
 {
     HttpSchema schema_id; // int code for HTTP/1.x schema name
@@ -15,9 +40,14 @@ typedef struct basic_reqinfo
     char *path_str;       // raw URL string... relative for now
 
     char *host_hstr;      // Host header value
-    bool keep_connection; // Connection header flag.
+    bool keep_connection; // Persistence by the schema default and Connection header
     MimeType mime_type;   // Content-Type header value
-    int content_len;      // Content-Length header value
+    size_t content_len;   // Content-Length header value
+    int accept_encodings; // Accept-Encoding header value as ENCODING_FLAG bits
+    char *if_none_match_hstr; // If-None-Match header value
+    time_t if_modified_since; // If-Modified-Since header value, or 0 if absent
+    char *range_hstr;     // Range header value
+    char *if_range_hstr;  // If-Range header value
     char *body_blob;      // Main message payload in bytes
 } BaseRequest;
 
@@ -25,6 +55,65 @@ typedef struct basic_reqinfo
 
 MimeType mime_id_to_code(const char *mime_str);
 
+/**
+ * @brief Gets a method's name as sent on the request line, or "OTHER" for UNKNOWN.
+ */
+const char *method_code_to_name(HttpMethod method);
+
+/**
+ * @brief Converts an Accept-Encoding header value into ENCODING_FLAG bits. Codings with a zero q-value are left out, but identity is always acceptable. A "*" only adds codings not named elsewhere in the list.
+ */
+int accept_encoding_to_flags(const char *hvalue_str);
+
+/**
+ * @brief Checks a comma-separated header value like Connection's for a case-insensitive token.
+ * 
+ * @param hvalue_str
+ * @param token
+ * @returns true if any list item equals the token.
+ */
+bool header_list_has_token(const char *hvalue_str, const char *token);
+
+/**
+ * @brief Parses a Content-Length header value, which must be only decimal digits.
+ * 
+ * @param hvalue_str
+ * @param len_ref Receives the length on success.
+ * @returns true if the value is valid and fits in size_t.
+ */
+bool content_length_parse(const char *hvalue_str, size_t *len_ref);
+
+/**
+ * @brief Parses the hex size at the start of a chunk-size line. Chunk extensions after ';' are ignored.
+ * 
+ * @param line_str
+ * @param size_ref Receives the chunk size on success.
+ * @returns true if the size is valid and fits in size_t.
+ */
+bool chunk_size_parse(const char *line_str, size_t *size_ref);
+
+/**
+ * @brief Parses an IMF-fixdate header value like "Sun, 06 Nov 1994 08:49:37 GMT".
+ * @returns The UTC time or 0 if the date is malformed.
+ */
+time_t http_date_to_time(const char *date_str);
+
+/**
+ * @brief Checks an If-None-Match list against an entity tag by weak comparison, so a "W/" prefix is ignored. The "*" value matches any tag.
+ */
+bool etag_list_has_match(const char *etag_list_str, const char *etag);
+
+/**
+ * @brief Parses a "bytes=..." Range header value against a payload length. Each satisfiable range is clamped to the payload, and unsatisfiable ones are dropped.
+ * 
+ * @param range_str
+ * @param full_len Payload length in bytes.
+ * @param ranges Array of at least max_count items.
+ * @param max_count
+ * @returns The count of satisfiable ranges, BYTE_RANGES_UNSATISFIABLE if none are, or BYTE_RANGES_INVALID for bad syntax or too many ranges.
+ */
+int byte_ranges_parse(const char *range_str, int full_len, ByteRange *ranges, int max_count);
+
 void basic_reqinfo_init(BaseRequest *base_req);
 
 void basic_reqinfo_clear(BaseRequest *base_req);
@@ -6,6 +6,7 @@
 #include <stdio.h>
 #include <time.h>
 #include "h1c/h1consts.h"
+#include "h1c/reqinfo.h"
 
 /** Macros */
 
@@ -27,14 +28,29 @@ typedef enum resinfo_reset_mode_e
  */
 typedef struct resinfo_t
 {
+    int status_code;        // numeric status of the status line, or 0 if unset
     int status_line_len;
     char status_line[STATUS_LINE_BUFSIZE];  // Stores HTTP/1.x status line as "schema SP status SP msg"
     const char *server_name_ref;  // Unbinds later, but stores a ptr. to server name
     time_t date;            // Date: <GMT> header value
     bool keep_connection;   // Connection header flag
+    int keepalive_timeout;  // Keep-Alive header's idle timeout in seconds, or 0 to leave the header out
+    int keepalive_max;      // Keep-Alive header's count of requests left on the connection
     MimeType mime_type;     // Content-Type header value
     int content_len;        // Content-Length header value
+    ContentEncoding encoding;  // Content-Encoding header value
+    bool vary_encoding;     // Vary: Accept-Encoding flag for negotiated payloads
+    bool header_only;       // Skips the payload and its headers, as for 304 replies
+    const char *etag_ref;   // ETag header value, bound to a static resource
+    time_t last_modified;   // Last-Modified header value, or 0 if unknown
+    bool accept_ranges;     // Accept-Ranges: bytes flag for range-capable payloads
+    bool range_unsatisfied; // Marks a 416 reply, which needs "Content-Range: bytes */length"
+    int range_count;        // Count of byte ranges to send as 206 parts, or 0 for the whole payload
+    ByteRange ranges[BYTE_RANGES_MAX_COUNT];
+    bool streamed;          // Marks a reply already sent by a streaming handler instead of from body_blob
+    bool chunked;           // Transfer-Encoding: chunked flag, which replaces Content-Length
     char *body_blob;        // Main message payload in bytes
+    bool body_shared;       // Marks a payload that outlives every connection, such as a static resource, so slow clients get it sent without a copy
 } ResponseObj;
 
 void resinfo_init(ResponseObj *response, const char *server_name);
@@ -42,8 +58,28 @@ void resinfo_reset(ResponseObj *response, ResponseRstMode mode);
 
 void resinfo_fill_status_line(ResponseObj *response, const char *schema, const char *code, const char *msg);
 void resinfo_set_keep_connection(ResponseObj *response, bool is_persistent);
+void resinfo_set_keep_alive(ResponseObj *response, int timeout, int max_requests);
 void resinfo_set_mime_type(ResponseObj *response, MimeType mime_type);
 void resinfo_set_content_length(ResponseObj *response, int content_length);
+void resinfo_set_encoding(ResponseObj *response, ContentEncoding encoding, bool is_negotiated);
+void resinfo_set_validators(ResponseObj *response, const char *etag, time_t last_modified);
+void resinfo_set_header_only(ResponseObj *response, bool is_header_only);
+void resinfo_set_accept_ranges(ResponseObj *response, bool is_range_capable);
+void resinfo_set_ranges(ResponseObj *response, const ByteRange *ranges, int range_count);
+void resinfo_set_range_unsatisfied(ResponseObj *response);
+
+/**
+ * @brief Marks the reply as streamed. Without chunked framing, the body ends by closing the connection.
+ * 
+ * @param response
+ * @param is_chunked
+ */
+void resinfo_set_streamed(ResponseObj *response, bool is_chunked);
 void resinfo_set_body_payload(ResponseObj *response, char *blob);
 
+/**
+ * @brief Sets a payload that stays valid until the server stops, such as a static resource's bytes. Unlike other payloads, it is not copied when a slow client makes its reply wait.
+ */
+void resinfo_set_shared_payload(ResponseObj *response, char *blob);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+#ifndef ACCESSLOG_H
+#define ACCESSLOG_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "h1c/reqinfo.h"
+#include "utils/timing.h"
+
+/* Macros */
+
+#define ACCESSLOG_CACHE_LINE 64
+#define ACCESSLOG_RING_SIZE (1 << 21)    // bytes of formatted records each worker may have waiting, a power of two
+#define ACCESSLOG_LINE_MAX 1024          // longest record, with long paths cut short to fit
+#define ACCESSLOG_FLUSH_MS 50            // how often the flusher writes out the rings
+#define ACCESSLOG_CHECK_MS 1000          // how often the flusher looks for a rotated file
+#define ACCESSLOG_PATH_SIZE 256
+
+/* Structs */
+
+/**
+ * @brief A single-producer, single-consumer byte ring of formatted records. The worker appends whole lines and the flusher takes them, and neither ever waits on the other.
+ * @note Positions only grow, and wrap into the buffer by masking. Each side's position sits on its own cache line.
+ */
+typedef struct log_ring_t
+{
+    _Alignas(ACCESSLOG_CACHE_LINE) _Atomic size_t write_pos; // written by the worker
+    _Atomic uint64_t dropped;   // records lost to a full ring, written by the worker
+    char *data;
+    size_t capacity;
+    _Alignas(ACCESSLOG_CACHE_LINE) _Atomic size_t read_pos;  // written by the flusher
+} LogRing;
+
+/**
+ * @brief One served exchange, as a worker hands it to the log.
+ */
+typedef struct access_record_t
+{
+    int worker_id;
+    HttpMethod method;
+    const char *path;     // or NULL if the request line was not read
+    int status_code;      // or 0 if there was no reply
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t duration_ns; // from the start of reading the request to the end of sending the reply
+    const char *error;    // why the exchange failed, or NULL
+} AccessRecord;
+
+/**
+ * @brief An access log file fed by per-worker rings. A background thread batches every ring's records into one large write, and reopens the file after rotation.
+ */
+typedef struct access_log_t
+{
+    char path[ACCESSLOG_PATH_SIZE];
+    int fd;
+    ino_t inode;                // of the open file, to notice when rotation moved it away
+    LogRing *rings;
+    int ring_count;
+    bool running;
+    _Atomic bool reopen_requested;
+    pthread_t flusher;
+    pthread_mutex_t lock;       // only guards the flusher's sleep, never a worker
+    pthread_cond_t wakeup;
+} AccessLog;
+
+/* LogRing Funcs. */
+
+/**
+ * @brief Formats a record as one JSON line and appends it without blocking. If the ring is full, the record is dropped and counted instead.
+ *
+ * @param ring The calling worker's own ring.
+ * @param record
+ * @returns false if the record was dropped.
+ */
+bool logring_put_record(LogRing *ring, const AccessRecord *record);
+
+/* AccessLog Funcs. */
+
+/**
+ * @brief Opens the log file for appending and makes a ring for each worker.
+ *
+ * @param log
+ * @param path
+ * @param ring_count
+ * @returns false if the file cannot be opened or memory ran out.
+ */
+bool accesslog_init(AccessLog *log, const char *path, int ring_count);
+LogRing *accesslog_get_ring(AccessLog *log, int ring_index);
+
+/**
+ * @brief Starts the flusher thread.
+ */
+bool accesslog_start(AccessLog *log);
+
+/**
+ * @brief Asks the flusher to reopen the file, as after a rotation by rename. Only sets a flag, so it may be called from a signal handler.
+ */
+void accesslog_request_reopen(AccessLog *log);
+
+/**
+ * @brief Stops the flusher after a final flush, then closes the file and frees the rings. Only call this once workers stopped logging.
+ */
+void accesslog_dispose(AccessLog *log);
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "utils/timing.h"
+
+/* Macros */
+
+#define CAPTURE_FILE_MAGIC "H1CCAPTR"
+#define CAPTURE_FILE_VERSION 1
+#define CAPTURE_BUFSIZE (1024 * 1024)  // stdio buffer of the capture file, so most records cost a copy instead of a write
+
+/* Enums */
+
+typedef enum capture_record_kind_e
+{
+    CAPTURE_DATA = 0,  // bytes a worker received, which follow the record
+    CAPTURE_REPLY,     // a reply of length bytes went out, whether sent or queued
+    CAPTURE_CLOSE      // the server closed the connection, so its fd may name another one next
+} CaptureRecordKind;
+
+/* Structs */
+
+/**
+ * @brief Capture layout: this header, then records in the order they were put, each followed by its data if any.
+ */
+typedef struct capture_file_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t started_unix_ms;  // wall clock time of the first record's offset 0
+} CaptureFileHeader;
+
+typedef struct capture_record_t
+{
+    uint64_t offset_ns;  // since the capture started
+    int32_t fd;          // names the connection until its CAPTURE_CLOSE
+    uint32_t length;     // data bytes following a CAPTURE_DATA, reply bytes of a CAPTURE_REPLY, or 0
+    uint16_t kind;
+    uint16_t worker_id;  // 0 for the listener thread, which closes parked connections
+    uint32_t reserved;
+} CaptureRecord;
+
+/**
+ * @brief A file of every byte clients sent, with when they arrived and where replies and closes fell, as tools/h1creplay plays back.
+ * @note Records from every thread go through one lock, so they are in time order and none are lost. This costs each read a lock and a copy, so capturing is opt-in.
+ */
+typedef struct request_capture_t
+{
+    FILE *out;
+    pthread_mutex_t lock;
+    uint64_t started_ns;  // timing_now_ns() at offset 0
+    uint64_t records;
+    bool write_failed;    // set once, after which records are ignored
+} RequestCapture;
+
+/* RequestCapture Funcs. */
+
+/**
+ * @brief Creates or replaces the capture file and writes its header.
+ *
+ * @param capture
+ * @param path
+ * @returns false if the file cannot be written.
+ */
+bool capture_init(RequestCapture *capture, const char *path);
+
+/**
+ * @brief Appends a record from any thread.
+ *
+ * @param capture
+ * @param kind
+ * @param worker_id
+ * @param fd
+ * @param data Bytes of a CAPTURE_DATA record, or NULL.
+ * @param length As in CaptureRecord.
+ */
+void capture_put(RequestCapture *capture, CaptureRecordKind kind, int worker_id, int fd, const char *data, uint32_t length);
+
+/**
+ * @brief Flushes and closes the file.
+ */
+void capture_dispose(RequestCapture *capture);
+
+#endif
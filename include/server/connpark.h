@@ -0,0 +1,146 @@
+#ifndef CONNPARK_H
+#define CONNPARK_H
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+
+#include "basicio/sockets.h"
+#include "server/capture.h"
+#include "collections/bqueue.h"
+#include "collections/timerwheel.h"
+#include "utils/metrics.h"
+#include "utils/probes.h"
+#include "utils/tracering.h"
+
+/* Macros */
+
+#define CONNPARK_MAX_EVENTS 64
+#define CONNPARK_TIMER_TICK_MS 100
+#define CONNPARK_MAX_LISTENERS 8
+
+/* Enums */
+
+typedef enum park_reason_e
+{
+    PARK_DRAINING, // the client has yet to take all of its reply
+    PARK_IDLE      // a persistent connection waits for its next request
+} ParkReason;
+
+/* Structs */
+
+/**
+ * @brief State of one parked connection, kept instead of a whole worker and buffer slab while its client is slow or quiet. Idle records cost about a hundred bytes each.
+ */
+typedef struct conn_record_t
+{
+    struct conn_record_t *prev; // links of every parked record, for disposal
+    struct conn_record_t *next;
+    struct conn_parking_t *park_ref;
+    TimerNode timer;            // closes the connection once the client goes quiet for too long
+    OutQueue outq;              // reply bytes the client has yet to take
+    uint32_t timeout_ms;        // inactivity limit of the current reason
+    uint32_t idle_timeout_ms;   // keep-alive limit once drained, or 0 to close then
+    int fd;
+    int served;                 // requests served on the connection so far
+    ParkReason reason;
+} ConnRecord;
+
+/**
+ * @brief A shared epoll set of connections that wait on their clients, polled by the listener thread along with its listening sockets. Any worker picks up a parked connection once it is ready for its next request.
+ * @note Workers park connections from their own threads, so the timer wheel and record list are locked. Events and timers are only processed by the polling thread.
+ */
+typedef struct conn_parking_t
+{
+    int epoll_fd;
+    int count;                  // parked connections
+    pthread_mutex_t lock;
+    TimerWheel timers;
+    ConnRecord records;         // sentinel of the record list
+    BlockedQueue *bqueue_ref;   // where ready persistent connections go back to
+    ThreadMetrics *metrics_ref; // counters of the polling thread
+    TraceRing *trace_ref;       // trace ring of the polling thread
+    RequestCapture *capture_ref; // where closes are noted while capturing, or NULL
+    ServerSocket *listeners[CONNPARK_MAX_LISTENERS]; // listening sockets in the set, told apart from records by address
+    int listener_count;
+} ConnParking;
+
+/* ConnParking Funcs. */
+
+/**
+ * @brief Prepares an empty parking set.
+ * 
+ * @param park
+ * @param bqueue_ref
+ * @param metrics_ref Counters of the thread that will poll the set, which counts the bytes it sends and the connections it closes.
+ * @param trace_ref Trace ring of the same thread, which records the closes.
+ */
+bool connpark_init(ConnParking *park, BlockedQueue *bqueue_ref, ThreadMetrics *metrics_ref, TraceRing *trace_ref);
+
+/**
+ * @brief Notes each connection the set closes in a request capture, so replays know its fd names another connection next. Call it before the polling thread starts.
+ * 
+ * @param park
+ * @param capture_ref Or NULL to stop.
+ */
+void connpark_set_capture(ConnParking *park, RequestCapture *capture_ref);
+
+/**
+ * @brief Closes every parked connection and the epoll set. Only call this after the polling thread ends.
+ */
+void connpark_dispose(ConnParking *park);
+
+/**
+ * @brief Adds an opened listening socket to the epoll set. Its readiness is reported by connpark_poll instead of handled.
+ * 
+ * @param park
+ * @param svr_sock
+ * @returns false if CONNPARK_MAX_LISTENERS are already watched or epoll refused.
+ */
+bool connpark_watch_listener(ConnParking *park, ServerSocket *svr_sock);
+
+/**
+ * @brief Stops or resumes reporting a watched listener, so a listener that cannot accept for now, as when out of fds, does not wake the poll over and over.
+ * 
+ * @param park
+ * @param svr_sock
+ * @param paused
+ * @returns false if epoll refused.
+ */
+bool connpark_pause_listener(ConnParking *park, ServerSocket *svr_sock, bool paused);
+
+/**
+ * @brief Takes over a connection whose client has not read its whole reply yet. The rest is sent as the socket becomes writable, and then the connection idles as if by connpark_put_idle, or closes if it does not persist.
+ *
+ * @param park
+ * @param cli_sock Socket to detach, along with its queued output.
+ * @param served Requests served on the connection so far.
+ * @param timeout_ms Longest time the client may take no bytes.
+ * @param idle_timeout_ms Keep-alive timeout after the reply, or 0 to close the connection once drained.
+ * @returns false if the connection had to be closed instead.
+ */
+bool connpark_put_draining(ConnParking *park, ClientSocket *cli_sock, int served, uint32_t timeout_ms, uint32_t idle_timeout_ms);
+
+/**
+ * @brief Takes over a persistent connection between requests, so no worker blocks on it. It goes back to the task queue once readable, or closes after the keep-alive timeout.
+ *
+ * @param park
+ * @param cli_sock Socket to detach.
+ * @param served Requests served on the connection so far.
+ * @param idle_timeout_ms
+ * @returns false if the connection had to be closed instead.
+ */
+bool connpark_put_idle(ConnParking *park, ClientSocket *cli_sock, int served, uint32_t idle_timeout_ms);
+
+/**
+ * @brief Waits for parked connections or listening sockets, handles every ready connection, then closes the expired ones.
+ *
+ * @param park
+ * @param max_wait_ms Longest wait, or -1 to wait until a timer is due.
+ * @param ready_listeners Gets every listening socket with connections to accept. Needs room for CONNPARK_MAX_LISTENERS.
+ * @param ready_count Gets the count of ready listening sockets.
+ * @returns Count of ready events, or -1 if polling failed.
+ */
+int connpark_poll(ConnParking *park, int max_wait_ms, ServerSocket **ready_listeners, int *ready_count);
+
+#endif
@@ -3,38 +3,236 @@
 
 #include "server/lstworker.h"
 #include "server/srvworker.h"
+#include "utils/statseg.h"
 
 /* Magic Macros */
 
 #define H1C_VERSION_STRING "H1C/0.3.0"
 #define H1C_DEFAULT_HOSTNAME "127.0.0.1"
 #define H1C_DEFAULT_PORT "8000"
-#define H1C_DEFAULT_BACKLOG 4
+#define H1C_DEFAULT_BACKLOG 511     // bursts of connects wait in the kernel instead of retrying SYNs; capped by net.core.somaxconn
+#define H1C_DEFER_ACCEPT 10         // seconds a connection may wait in the kernel for its first request bytes
+#define H1C_TCP_FASTOPEN 0
+#define H1C_TCP_NODELAY false
+#define H1C_TASK_QUEUE_SIZE BQUEUE_MAX_SIZE  // room for parked connections waking up besides new ones
 #define H1C_WORKER_COUNT 4
+#define H1C_MAX_LISTENERS CONNPARK_MAX_LISTENERS
+#define H1C_SLAB_COUNT 64
+#define H1C_KEEPALIVE_TIMEOUT 5
+#define H1C_KEEPALIVE_MAX 100
+#define H1C_HEADER_TIMEOUT 10
+#define H1C_BODY_TIMEOUT 30
+#define H1C_SEND_TIMEOUT 30
+#define H1C_MAX_PENDING_OUTPUT (256 * 1024)
+#define H1C_ZEROCOPY_MIN 0  // MSG_ZEROCOPY is opt-in, since it only pays off for large bodies over real NICs
 #define H1C_TOTAL_THREADS (H1C_WORKER_COUNT + 1)
 
 typedef struct h1c_core_t
 {
     /* Service Utils */
 
-    ServerSocket entry_socket;
+    ServerSocket entry_sockets[H1C_MAX_LISTENERS]; // TCP and Unix domain listeners feeding the same workers
+    int listener_count;
+    int listen_backlog;             // overrides every listener's backlog if not 0
+    ServerSocketOpts listen_opts;   // TCP tuning of every listener
     HandlerContext ctx;
     RouteMap router;
+    ConnectionPolicy conn_policy;
 
     /* Concurrency State */
 
     pthread_t thread_ids[H1C_TOTAL_THREADS]; // thread pool
+    bool producer_started;   // whether thread_ids[0] must be joined
     BlockedQueue task_queue; // synchronized queue
+    SlabPool buffer_pool;    // lock-free pool of connection buffer slabs
+    ConnParking parking;     // slow clients polled by the producer
     ListenWorker producer_obj; // first pthread state
     ServerWorker workers[H1C_WORKER_COUNT]; // other pthreads' states
+
+    /* Metrics */
+
+    ThreadMetrics thread_metrics[H1C_TOTAL_THREADS]; // the producer's, then each worker's
+    MetricsBoard metrics;
+    TraceRing trace_rings[H1C_TOTAL_THREADS];        // likewise, always recording
+    TraceBoard trace;
+    AccessLog access_log;    // written by workers and flushed by its own thread
+    bool access_log_on;
+    StatsPublisher stats;    // live counters in shared memory, as h1ctop reads
+    bool stats_on;
+    RequestCapture capture;  // raw requests for replays, written by workers and the parking set
+    bool capture_on;
 } ServerDriver;
 
 bool server_core_init(ServerDriver *server, const char *host_name, const char *port, int backlog);
+
+/**
+ * @brief Adds another listener, such as a Unix domain socket for a local proxy. Call this before server_core_run.
+ * 
+ * @param server
+ * @param address As for serversocket_init_address: "unix:/path/to.sock", "unix:@name", "host:port" or "[ipv6-host]:port".
+ * @param backlog
+ * @returns false if the address is malformed, cannot be bound, or there are already H1C_MAX_LISTENERS.
+ */
+bool server_core_add_listener(ServerDriver *server, const char *address, int backlog);
+/**
+ * @brief Tunes the accept path of every TCP listener. Call this before server_core_run.
+ * 
+ * @param server
+ * @param backlog Pending connections each listener queues, or 0 to keep the ones given when adding listeners.
+ * @param defer_accept_secs Seconds TCP_DEFER_ACCEPT holds a connection until its request arrives, or 0 to hand over connections right away.
+ * @param fastopen_qlen TCP Fast Open queue length, or 0 for off.
+ * @param nodelay Whether to turn off Nagle's algorithm for accepted connections.
+ * @returns false if any count is negative.
+ */
+bool server_core_set_listen_options(ServerDriver *server, int backlog, int defer_accept_secs, int fastopen_qlen, bool nodelay);
+
+/**
+ * @brief Sets the keep-alive limits of every connection. Call this before server_core_run.
+ * 
+ * @param server
+ * @param timeout Idle seconds before a persistent connection is closed.
+ * @param max_requests Most requests served per connection.
+ * @returns false if either limit is not positive.
+ */
+bool server_core_set_keepalive(ServerDriver *server, int timeout, int max_requests);
+
+/**
+ * @brief Sets the I/O timeouts of every connection. Call this before server_core_run.
+ * 
+ * @param server
+ * @param header_timeout Seconds to receive a whole request line and headers.
+ * @param body_timeout Seconds a request body may go without new data.
+ * @param send_timeout Seconds a reply may go without the client taking any of it.
+ * @returns false if any timeout is not positive.
+ */
+bool server_core_set_timeouts(ServerDriver *server, int header_timeout, int body_timeout, int send_timeout);
+
+/**
+ * @brief Sets how many reply bytes may be queued for a slow client before its writer waits. Call this before server_core_run.
+ * 
+ * @param server
+ * @param max_pending
+ * @returns false if the limit is 0.
+ */
+bool server_core_set_max_pending(ServerDriver *server, size_t max_pending);
+
+/**
+ * @brief Opts into MSG_ZEROCOPY sends of static resource bodies of at least min_len bytes. Call this before server_core_run.
+ * @note Resources stay loaded until server_core_cleanup, so their pages outlive any send still in flight.
+ * 
+ * @param server
+ * @param min_len Smallest body sent zero-copy, such as 256 KB, or 0 to turn it off.
+ * @returns false if the system lacks MSG_ZEROCOPY.
+ */
+bool server_core_set_zerocopy(ServerDriver *server, size_t min_len);
+/**
+ * @brief Writes a JSON line per exchange to an access log file. Each worker formats its records into its own ring, and a background thread writes every ring out together, so workers never wait on the disk. Call this before server_core_run.
+ * 
+ * @param server
+ * @param path File to append to, which is created if missing and reopened once rotation moves it.
+ * @returns false if the file cannot be opened.
+ */
+bool server_core_set_access_log(ServerDriver *server, const char *path);
+
+/**
+ * @brief Captures every byte clients send, with when it arrived and where replies and closes fell, to a binary file that tools/h1creplay plays back. Received bytes are copied and written out through a shared lock at each reply and close, so this is for recording traffic to benchmark with rather than for production. Call this before server_core_run.
+ * 
+ * @param server
+ * @param path File to create or replace.
+ * @returns false if the file cannot be written.
+ */
+bool server_core_set_capture(ServerDriver *server, const char *path);
+
+/**
+ * @brief Asks the access log to reopen its file, as after rotation. Only sets a flag, so a SIGHUP handler may call it.
+ */
+void server_core_reopen_logs(ServerDriver *server);
 bool server_core_setup_hdctx(ServerDriver *server, const char *file_names[], uint16_t file_count);
 bool server_core_put_handler(ServerDriver *server, const char *path, HttpMethod method, MimeType mime, HandlerFunc callback);
-void server_core_setup_thrd_states(ServerDriver *server);
+
+/**
+ * @brief Registers a handler that reads its request body in chunks with handlerctx_read_body instead of getting it buffered whole.
+ */
+bool server_core_put_streaming_handler(ServerDriver *server, const char *path, HttpMethod method, MimeType mime, HandlerFunc callback);
+
+/**
+ * @brief Registers a GET route that reports the server's counters in the Prometheus text format: requests by method, replies by status, bytes in and out, accepts, queue-full rejections, parse errors and active connections. Serving it only reads the counters, so workers are never held up.
+ * 
+ * @param server
+ * @param path Such as "/metrics".
+ */
+bool server_core_put_metrics_handler(ServerDriver *server, const char *path);
+
+/**
+ * @brief Registers a GET route that replies with a binary dump of every thread's recent connection events, as tools/h1ctrace decodes. Workers keep recording while it is copied.
+ * 
+ * @param server
+ * @param path Such as "/debug/trace".
+ */
+bool server_core_put_trace_handler(ServerDriver *server, const char *path);
+
+/**
+ * @brief Writes a binary dump of every thread's recent connection events to a file, as tools/h1ctrace decodes. Safe to call from a signal handler.
+ * 
+ * @param server
+ * @param path
+ * @returns false if the file could not be written.
+ */
+bool server_core_dump_trace(const ServerDriver *server, const char *path);
+
+/**
+ * @brief Sets up the producer and worker states before their threads start. Called by server_core_run.
+ * 
+ * @param server
+ * @returns false if a worker could not allocate its request arena.
+ */
+bool server_core_setup_thrd_states(ServerDriver *server);
+
+/**
+ * @brief Publishes live counters to the shared memory segment "/h1c.<pid>" every STATSEG_PUBLISH_MS, as tools/h1ctop reads. Its own thread only reads counters workers already keep, so serving is never slowed. Called by server_core_run.
+ * 
+ * @param server
+ * @returns false if shared memory is unavailable, which the server runs without.
+ */
+bool server_core_start_stats(ServerDriver *server);
+
+/**
+ * @brief Sums every worker's histogram of a stage into dst, in timing_cycles() ticks. Workers are never locked or slowed, so this is safe while serving.
+ * 
+ * @param server
+ * @param stage
+ * @param dst A histogram private to the caller, which is reset first.
+ */
+void server_core_merge_latency(const ServerDriver *server, ServerWorkerStage stage, LatencyHistogram *dst);
+
+/**
+ * @brief Prints a table of every stage's count, mean and tail latencies in microseconds, such as at shutdown. Call it once the workers are joined, and never from a signal handler, since it calibrates the timer and formats with stdio.
+ */
+void server_core_report_latency(const ServerDriver *server, FILE *out);
+
+/**
+ * @brief Starts the producer and worker threads, plus the access log and stats threads if they are on. Block the signals the caller handles first, since threads inherit the mask.
+ * 
+ * @param server
+ * @returns How many workers started, which is 0 if the server cannot serve.
+ */
 int server_core_run(ServerDriver *server);
 void server_core_join(ServerDriver *server, int wthrd_count);
+
+/**
+ * @brief Stops accepting, then stops and joins the producer and every started worker. An idle worker ends at once, and a busy one after its current step, which connection timeouts bound. Call it from a normal thread, never a signal handler.
+ * 
+ * @param server
+ * @param wthrd_count As returned by server_core_run.
+ */
+void server_core_stop(ServerDriver *server, int wthrd_count);
+
+/**
+ * @brief Flushes the access log, capture and stats, then disposes everything the threads shared. Call it after server_core_stop, so no thread still uses what it frees.
+ * 
+ * @param server
+ * @param wthrd_count As returned by server_core_run.
+ */
 void server_core_cleanup(ServerDriver *server, int wthrd_count);
 
 #endif
\ No newline at end of file
@@ -4,20 +4,37 @@
 #include <stdio.h>
 #include "basicio/sockets.h"
 #include "collections/bqueue.h"
+#include "server/connpark.h"
 
 /* Macros and Enums */
 
+#define LSTWORKER_POLL_TIMEOUT_MS 2500    // longest wait before rechecking whether to stop
+#define LSTWORKER_ACCEPT_BACKOFF_MS 100    // pause of listeners after running out of fds or memory
+#define LSTWORKER_LOG_INTERVAL_MS 5000     // least time between logs of repeating accept failures
+
 typedef struct listen_worker_t
 {
-    bool is_listening;          // flag for running
-    ServerSocket *srvsock_ref;  // listening socket
+    _Atomic bool is_listening;  // flag for running, cleared by other threads to stop it
+    ServerSocket *srvsocks_ref; // listening sockets, which all feed the same task queue
+    int srvsock_count;
     BlockedQueue *bqueue_ref;   // task queue
+    ConnParking *park_ref;      // parked connections, polled along with the listening sockets
+    ThreadMetrics *metrics_ref; // counters of this thread
+    TraceRing *trace_ref;       // lifecycle events of this thread
+    uint64_t resume_ms;         // when paused listeners are polled again, or 0 if none are paused
+    uint64_t last_log_ms;       // when an accept failure was last logged
+    int failure_count;          // failures since then
 } ListenWorker;
 
-void lstworker_init(ListenWorker *lstworker, ServerSocket *srvsock_ref, BlockedQueue *bqueue_ref);
+void lstworker_init(ListenWorker *lstworker, ServerSocket *srvsocks_ref, int srvsock_count, BlockedQueue *bqueue_ref, ConnParking *park_ref, ThreadMetrics *metrics_ref, TraceRing *trace_ref);
 
 void lstworker_end(ListenWorker *lstworker);
 
+/**
+ * @brief Asks a running producer to return from lstworker_work soon, from another thread. Its listeners are shut down to wake its poll, but only closed by lstworker_end once it is joined.
+ */
+void lstworker_stop(ListenWorker *lstworker);
+
 void lstworker_work(ListenWorker *lstworker);
 
 void *lstworker_run(void *lstworker_ref);
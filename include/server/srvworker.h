@@ -2,10 +2,52 @@
 #define SRVWORKER_H
 
 #include "collections/bqueue.h"
+#include "collections/slabpool.h"
+#include "collections/timerwheel.h"
+#include "server/accesslog.h"
+#include "server/connpark.h"
 #include "h1c/h1scanner.h"
 #include "h1c/h1writer.h"
+#include "utils/histogram.h"
 #include "utils/routemap.h"
 
+/* Macros */
+
+#define SRVWORKER_ARENA_BLOCK_SIZE 8192
+#define SRVWORKER_TIMER_TICK_MS 100
+#define SRVWORKER_CAPTURE_COALESCE 4096  // received bytes held back while capturing, so header reads of one byte do not each become a record
+
+/**
+ * @brief Size of the pooled slab holding one connection's scanner and writer buffers.
+ */
+#define SRVWORKER_SLAB_SIZE (H1SCANNER_BUFFER_MEM_SIZE + DEFAULT_REPLY_BUFSIZE)
+
+/* Structs */
+
+/**
+ * @brief Limits for how long and how much a persistent connection is served.
+ */
+typedef struct conn_policy_t
+{
+    int keepalive_timeout; // idle seconds a persistent connection may wait for its next request
+    int keepalive_max;     // most requests served on one connection
+    int header_timeout;    // seconds to receive a whole request line and headers
+    int body_timeout;      // seconds a request body may go without any new data
+    int send_timeout;      // seconds a reply may go without the client taking any of it
+    size_t max_pending;    // most reply bytes queued for a slow client before writes wait
+    size_t zerocopy_min;   // static bodies this large are sent with MSG_ZEROCOPY, or 0 for off
+} ConnectionPolicy;
+
+/**
+ * @brief Defines which deadline a connection's timer tracks. Idle deadlines between requests belong to the parking set.
+ */
+typedef enum conn_timer_kind_e
+{
+    CONN_TIMER_HEADER, // while the request line and headers arrive
+    CONN_TIMER_BODY,   // while the request body arrives
+    CONN_TIMER_SEND    // while the reply is made and sent
+} ConnTimerKind;
+
 /* Enums */
 
 typedef enum srvworker_state_e
@@ -19,13 +61,29 @@ typedef enum srvworker_state_e
     SWORKER_END
 } ServerWorkerState;
 
+/**
+ * @brief Timed steps of a worker. Each state of the FSM gets one, and processing is also split into its route lookup and handler call.
+ */
+typedef enum srvworker_stage_e
+{
+    SWORKER_STAGE_CONSUME = 0, // waiting for and taking up a connection
+    SWORKER_STAGE_RECV,
+    SWORKER_STAGE_PROCESS,
+    SWORKER_STAGE_ROUTE,       // part of process
+    SWORKER_STAGE_HANDLER,     // part of process, including any body it reads or reply it streams
+    SWORKER_STAGE_SEND,
+    SWORKER_STAGE_RESET,
+    SWORKER_STAGE_COUNT
+} ServerWorkerStage;
+
 /* ServerWorker */
 
 typedef struct srvworker_t
 {
     int wid;
     ServerWorkerState state;  // controlling FSM status for worker actions 
-    bool must_abort; // special flag to indicate an early stop 
+    _Atomic int shown_state;  // copy of state for outside readers, such as the stats segment
+    _Atomic bool must_abort; // special flag to indicate an early stop, set by srvworker_stop 
 
     BaseRequest request;
     ResponseObj response;
@@ -33,15 +91,65 @@ typedef struct srvworker_t
     HttpScanner scanner;
     ReplyWriter writer;
     ClientSocket clisock;     // reusable client fd wrapper
+    Arena arena;              // per-request allocations, reset in bulk after each reply
+    HandlerContext ctx_view;  // worker view of the shared context with this worker's arena
 
     RouteMap *router_ref;     // route to handler tree
     HandlerContext *ctx_ref;  // shared reference to resource table
     BlockedQueue *bqueue_ref; // shared reference to synchronized task queue
+    SlabPool *slabpool_ref;   // shared reference to the connection buffer pool
+    ConnParking *park_ref;    // shared reference to where slow readers finish their replies
+    ThreadMetrics *metrics_ref; // counters of this worker, which only it writes
+    TraceRing *trace_ref;     // lifecycle events of this worker, which only it records
+    char *slab_ref;           // borrowed slab of the current connection, or NULL if the pool ran dry
+
+    ConnectionPolicy policy;  // keep-alive limits copied from the server
+    int conn_requests;        // requests read on the current connection so far
+    TimerWheel timers;        // deadlines of every connection this worker owns
+    TimerNode conn_timer;     // deadline of the current connection
+    ConnTimerKind conn_timer_kind;
+    bool conn_timed_out;      // set once the current connection's deadline expires
+
+    LatencyHistogram latency[SWORKER_STAGE_COUNT]; // timing_cycles() ticks spent per stage, written only by this worker
+
+    LogRing *log_ring_ref;    // this worker's access log ring, or NULL if logging is off
+    uint64_t exchange_started_ns; // when the current request began to be read
+    const char *exchange_error;   // why the current exchange failed, or NULL
+
+    RequestCapture *capture_ref;  // where received bytes, replies and closes are noted, or NULL if capturing is off
+    TapTransport capture_tap;     // wraps the current connection's transport while capturing
+    uint32_t capture_held;        // bytes of capture_data not yet in the capture
+    char capture_data[SRVWORKER_CAPTURE_COALESCE];
 } ServerWorker;
 
 /* ServerWorker Funcs. */
 
-void srvworker_init(ServerWorker *srvworker, int worker_id, RouteMap *router_ref, HandlerContext *ctx_ref, BlockedQueue *bqueue_ref, const char *server_name);
+/**
+ * @brief Sets up a worker before its thread starts.
+ * @returns false if its request arena cannot be allocated, since handlers could not allocate anything.
+ */
+bool srvworker_init(ServerWorker *srvworker, int worker_id, RouteMap *router_ref, HandlerContext *ctx_ref, BlockedQueue *bqueue_ref, SlabPool *slabpool_ref, ConnParking *park_ref, ThreadMetrics *metrics_ref, TraceRing *trace_ref, const ConnectionPolicy *policy, const char *server_name);
+
+/**
+ * @brief Gives the worker an access log ring to write a record of each exchange to. Call it before the worker starts.
+ * 
+ * @param srvworker
+ * @param log_ring_ref The worker's own ring, or NULL to turn logging off.
+ */
+void srvworker_set_access_log(ServerWorker *srvworker, LogRing *log_ring_ref);
+
+/**
+ * @brief Gives the worker a request capture to note every received byte, reply and close in. Call it before the worker starts.
+ * 
+ * @param srvworker
+ * @param capture_ref Or NULL to turn capturing off.
+ */
+void srvworker_set_capture(ServerWorker *srvworker, RequestCapture *capture_ref);
+
+/**
+ * @brief Asks a running worker to end, from another thread. An idle worker wakes and ends at once, and a busy one ends after its current step, which its connection timeouts bound.
+ */
+void srvworker_stop(ServerWorker *srvworker);
 
 /**
  * @brief Special cleanup function for ServerWorker data... Only meant to be used in final server cleanup AFTER the worker thread ends.
@@ -50,12 +158,79 @@ void srvworker_init(ServerWorker *srvworker, int worker_id, RouteMap *router_ref
  */
 void srvworker_dispose(ServerWorker *srvworker);
 
+/**
+ * @brief Arms the current connection's timer with the policy's timeout for a phase. Its socket I/O is bounded by the same deadline, and body and send deadlines move forward as data moves.
+ * 
+ * @param srvworker
+ * @param kind
+ */
+void srvworker_arm_timer(ServerWorker *srvworker, ConnTimerKind kind);
+
+/**
+ * @brief Runs the worker's timer wheel up to now, so expired connections get marked for closing.
+ * 
+ * @param srvworker
+ * @returns Count of expired connections.
+ */
+int srvworker_check_timers(ServerWorker *srvworker);
+
+/**
+ * @brief Gets a state's name as used in reports, such as "recv".
+ */
+const char *srvworker_state_name(ServerWorkerState state);
+
+/**
+ * @brief Gets a worker's current state, as seen from another thread.
+ */
+ServerWorkerState srvworker_get_shown_state(const ServerWorker *srvworker);
+
+/**
+ * @brief Gets a stage's name as used in reports, such as "recv".
+ */
+const char *srvworker_stage_name(ServerWorkerStage stage);
+
+/**
+ * @brief Adds a worker's ticks spent in a stage to dst. Safe while the worker runs, since it never waits on the worker.
+ * 
+ * @param srvworker
+ * @param stage
+ * @param dst A histogram private to the caller.
+ */
+void srvworker_merge_latency(const ServerWorker *srvworker, ServerWorkerStage stage, LatencyHistogram *dst);
+
 ServerWorkerState srvworker_consume(ServerWorker *srvworker);
 
 ServerWorkerState srvworker_recv(ServerWorker *srvworker);
 
 ServerWorkerState srvworker_process_ok(ServerWorker *srvworker, const BaseRequest *req_ref);
 
+/**
+ * @brief Turns a successful GET / HEAD reply into a header-only 304 when the request's If-None-Match or If-Modified-Since validators still hold.
+ * 
+ * @param srvworker
+ * @param req_ref
+ * @returns SWORKER_SEND
+ */
+ServerWorkerState srvworker_process_conditional(ServerWorker *srvworker, const BaseRequest *req_ref);
+
+/**
+ * @brief Narrows a range-capable 200 reply into a 206 or 416 reply by its Range header. A failed If-Range check keeps the full payload.
+ * 
+ * @param srvworker
+ * @param req_ref
+ * @returns SWORKER_SEND
+ */
+ServerWorkerState srvworker_process_range(ServerWorker *srvworker, const BaseRequest *req_ref);
+
+/**
+ * @brief Ends a response a handler streamed by itself. The connection closes if the stream failed or had no chunked framing.
+ * 
+ * @param srvworker
+ * @param handler_status
+ * @returns SWORKER_RESET since there is nothing left to send.
+ */
+ServerWorkerState srvworker_end_stream(ServerWorker *srvworker, HandlerStatus handler_status);
+
 ServerWorkerState srvworker_process_bad(ServerWorker *srvworker, const char *status_str, const char *msg_str, const BaseRequest *req_ref);
 
 ServerWorkerState srvworker_process_all(ServerWorker *srvworker);
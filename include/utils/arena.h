@@ -0,0 +1,61 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Magic Macros */
+
+#define ARENA_DEFAULT_BLOCK_SIZE 4096
+#define ARENA_ALIGNMENT (_Alignof(max_align_t))
+
+/* Arena Structs */
+
+typedef struct arena_block_t
+{
+    struct arena_block_t *next;
+    size_t capacity;  // usable bytes after this header
+    size_t used;      // bump offset of the next allocation
+    char data[];
+} ArenaBlock;
+
+/**
+ * @brief A bump-pointer allocator for per-request memory. Allocations are never freed one by one, but all of them are dropped by one reset.
+ * @note Not thread-safe, so each ServerWorker owns one.
+ */
+typedef struct arena_t
+{
+    size_t block_size;    // capacity of regular blocks
+    ArenaBlock *head;     // first block, kept across resets
+    ArenaBlock *current;  // block currently bumped
+} Arena;
+
+/* Arena Funcs. */
+
+bool arena_init(Arena *arena, size_t block_size);
+void arena_dispose(Arena *arena);
+
+/**
+ * @brief Rewinds every allocation at once. Regular blocks are kept for reuse, but oversized ones are freed so one huge request does not pin memory.
+ * 
+ * @param arena
+ */
+void arena_reset(Arena *arena);
+
+/**
+ * @brief Gets uninitialized memory aligned for any type.
+ * 
+ * @param arena
+ * @param size
+ * @returns void* or NULL on allocation failure.
+ */
+void *arena_alloc(Arena *arena, size_t size);
+
+/**
+ * @brief Copies count bytes into a new NUL-terminated c-string.
+ */
+char *arena_strndup(Arena *arena, const char *bytes, size_t count);
+
+#endif
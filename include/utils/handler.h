@@ -34,6 +34,7 @@ typedef struct h1chandler_t
 {
     HttpMethod method;     // code of accepted method
     MimeType content_type; // allowed MIME type
+    bool streams_body;     // if the callback pulls the request body in chunks instead of getting body_blob
     HandlerFunc callback;  // function with normal logic
 } H1CHandler;
 
@@ -49,6 +50,14 @@ typedef struct h1chandler_t
  */
 void h1chandler_init(H1CHandler *handler, HttpMethod method, MimeType mime, HandlerFunc callback);
 
+/**
+ * @brief Marks if the handler streams request bodies. Streaming callbacks read the body with handlerctx_read_body, so even huge uploads use bounded memory.
+ * 
+ * @param handler
+ * @param streams_body
+ */
+void h1chandler_set_streams_body(H1CHandler *handler, bool streams_body);
+
 /**
  * @brief Verifies if a request can be served by its qualities. The basic algorithm does these checks in order: method then MIME type.
  * 
@@ -69,4 +78,17 @@ HandlerStatus h1chandler_check_req(const H1CHandler *handler, const BaseRequest
  */
 HandlerStatus h1chandler_handle(const H1CHandler *handler, const HandlerContext *ctx, const BaseRequest *req, ResponseObj *res);
 
+/** Handler Helper Funcs */
+
+/**
+ * @brief Fills a response with a cached static resource. The payload is the best precompressed variant allowed by the request's Accept-Encoding.
+ * 
+ * @param ctx
+ * @param fname Resource key, which is its file path.
+ * @param req
+ * @param res
+ * @returns HANDLE_OK if the resource exists, HANDLE_GENERAL_ERR otherwise.
+ */
+HandlerStatus h1chandler_serve_static(const HandlerContext *ctx, const char *fname, const BaseRequest *req, ResponseObj *res);
+
 #endif
\ No newline at end of file
@@ -2,7 +2,12 @@
 #define HANDLERCTX_H
 
 #include "utils/misc.h"
+#include "utils/arena.h"
+#include "utils/metrics.h"
+#include "utils/tracering.h"
 #include "utils/resrctable.h"
+#include "h1c/h1scanner.h"
+#include "h1c/h1writer.h"
 
 /* HandlerContext */
 
@@ -10,12 +15,93 @@ typedef struct handlerctx_t
 {
     bool ready;               // if initialization had no errors
     ResourceTable resources;  // static resource hashtable for now
+    Arena *arena_ref;         // per-worker request arena, only set in worker views
+    HttpScanner *scanner_ref; // per-worker request body source, only set in worker views
+    ReplyWriter *writer_ref;  // per-worker reply sink for streamed responses, only set in worker views
+    const MetricsBoard *metrics_ref; // server counters for reporting handlers, or NULL
+    const TraceBoard *trace_ref;     // server trace rings for dumping handlers, or NULL
 } HandlerContext;
 
 /* HandlerContext Funcs. */
 
 bool handlerctx_init(HandlerContext *handlerctx, uint16_t fcount, const char *fnames[]);
 void handlerctx_dispose(HandlerContext *handlerctx);
+
+/**
+ * @brief Gives handlers read access to the server's counters. Call this before making worker views, since they copy it.
+ */
+void handlerctx_set_metrics(HandlerContext *handlerctx, const MetricsBoard *metrics);
+
+/**
+ * @brief Gives handlers read access to the server's trace rings. Call this before making worker views, since they copy it.
+ */
+void handlerctx_set_trace(HandlerContext *handlerctx, const TraceBoard *trace);
+
+/**
+ * @brief Makes a worker's view of the shared context. The view borrows the shared resource table, so it must never be disposed.
+ * 
+ * @param view
+ * @param shared
+ * @param arena The worker's request arena for handler allocations.
+ * @param scanner The worker's scanner for streamed request bodies.
+ * @param writer The worker's writer for streamed responses.
+ */
+void handlerctx_init_view(HandlerContext *view, const HandlerContext *shared, Arena *arena, HttpScanner *scanner, ReplyWriter *writer);
+
+/**
+ * @brief Allocates handler memory like dynamic response bodies from the request arena. The memory is valid until the reply is sent.
+ * 
+ * @param handlerctx
+ * @param size
+ * @returns void* or NULL if the context has no arena or allocation fails.
+ */
+void *handlerctx_alloc(const HandlerContext *handlerctx, size_t size);
+
+/**
+ * @brief Reads the next chunk of the current request body for handlers set to stream bodies.
+ * 
+ * @param handlerctx
+ * @param chunk_ref Receives a view of the chunk, valid until the next call.
+ * @returns Bytes in the chunk, 0 once the body is done, or -1 on error.
+ */
+ssize_t handlerctx_read_body(const HandlerContext *handlerctx, const char **chunk_ref);
+
+/**
+ * @brief Gets a trailer field sent after a chunked request body, once the body is fully read.
+ * 
+ * @param handlerctx
+ * @param name Case-insensitive field name without the colon.
+ * @returns The value or NULL if absent.
+ */
+const char *handlerctx_get_trailer(const HandlerContext *handlerctx, const char *name);
+
+/**
+ * @brief Starts streaming the response instead of filling body_blob. Set the MIME type and other headers before this call, since the head is final once opened.
+ * 
+ * @param handlerctx
+ * @param req Decides if the body is sent at all, as HEAD requests only get the head.
+ * @param res
+ * @returns false if the stream could not start.
+ */
+bool handlerctx_stream_open(const HandlerContext *handlerctx, const BaseRequest *req, ResponseObj *res);
+
+/**
+ * @brief Sends the next piece of a streamed response. It blocks while the client is slow to read, which throttles the handler.
+ * 
+ * @param handlerctx
+ * @param data
+ * @param len
+ * @returns false if the client is gone, so the handler should stop and return an error.
+ */
+bool handlerctx_stream_write(const HandlerContext *handlerctx, const char *data, size_t len);
+
+/**
+ * @brief Ends a streamed response. The worker does this itself if an OK handler forgets to.
+ * 
+ * @param handlerctx
+ * @returns false if the client is gone.
+ */
+bool handlerctx_stream_finish(const HandlerContext *handlerctx);
 inline bool handlerctx_ready(const HandlerContext *handlerctx);
 const StaticResource *handlerctx_get_resrc(const HandlerContext *handlerctx, const char *fname);
 
@@ -0,0 +1,57 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Magic Macros */
+
+#define HISTOGRAM_SUB_BITS 3                         // 8 sub-buckets per power of two, so bucket bounds are within 12.5% of a value
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKET_COUNT ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+/* LatencyHistogram Struct */
+
+/**
+ * @brief A log-linear histogram in the style of HdrHistogram, over any unit such as timestamp ticks. Values under HISTOGRAM_SUB_COUNT get exact buckets, and larger ones share buckets of bounded relative width.
+ * @note Each histogram has one writer, which records without atomic read-modify-writes. Other threads may merge it at any time and see every count either before or after an update, never torn.
+ */
+typedef struct latency_histogram_t
+{
+    _Atomic uint64_t counts[HISTOGRAM_BUCKET_COUNT];
+    _Atomic uint64_t sum;  // of recorded values, for the mean
+    _Atomic uint64_t max;
+} LatencyHistogram;
+
+/* LatencyHistogram Funcs. */
+
+void histogram_init(LatencyHistogram *hist);
+
+/**
+ * @brief Counts one value. Only the histogram's owner thread may call this.
+ */
+void histogram_record(LatencyHistogram *hist, uint64_t value);
+
+/**
+ * @brief Adds src's counts into dst without locking, so readers never stall the writer of src.
+ *
+ * @param dst A histogram private to the caller.
+ * @param src
+ */
+void histogram_merge(LatencyHistogram *dst, const LatencyHistogram *src);
+uint64_t histogram_count(const LatencyHistogram *hist);
+double histogram_mean(const LatencyHistogram *hist);
+
+/**
+ * @brief Gets the value below which a percentage of the recorded values fall.
+ *
+ * @param hist
+ * @param percent From 0 to 100, such as 99.9.
+ * @returns The highest value of the matching bucket, or 0 if the histogram is empty.
+ */
+uint64_t histogram_percentile(const LatencyHistogram *hist, double percent);
+uint64_t histogram_max(const LatencyHistogram *hist);
+
+#endif
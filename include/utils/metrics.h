@@ -0,0 +1,94 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "h1c/reqinfo.h"
+
+/* Magic Macros */
+
+#define METRICS_CACHE_LINE 64
+#define METRICS_METHOD_COUNT (UNKNOWN + 1)  // slots by HttpMethod
+#define METRICS_STATUS_MIN 100
+#define METRICS_STATUS_COUNT 500            // slots for status codes 100 to 599
+#define METRICS_TEXT_BUFSIZE 16384
+
+/* Metrics Structs */
+
+/**
+ * @brief Counters of one server thread. Only the owner thread writes them, so counting costs a plain load and store instead of a locked add, and the alignment keeps each thread's counters off the cache lines of the others.
+ */
+typedef struct thread_metrics_t
+{
+    _Alignas(METRICS_CACHE_LINE) _Atomic uint64_t requests[METRICS_METHOD_COUNT]; // requests read, by method
+    _Atomic uint64_t responses[METRICS_STATUS_COUNT];  // replies, by status code
+    _Atomic uint64_t bytes_in;
+    _Atomic uint64_t bytes_out;
+    _Atomic uint64_t accepts;
+    _Atomic uint64_t queue_full;    // accepted connections shed since the task queue was full
+    _Atomic uint64_t parse_errors;  // malformed request lines or headers
+    _Atomic uint64_t closes;        // connections closed, so accepts minus closes are active
+    _Atomic uint64_t slab_acquires; // connection buffers taken from the pool
+    _Atomic uint64_t slab_misses;   // times the pool ran dry, so buffers were allocated instead
+    _Atomic uint64_t conditional_requests; // GET and HEAD requests with validators, which 304 replies answer
+} ThreadMetrics;
+
+/**
+ * @brief Every thread's counters, for readers that sum them.
+ */
+typedef struct metrics_board_t
+{
+    ThreadMetrics *threads;
+    int thread_count;
+} MetricsBoard;
+
+/* ThreadMetrics Funcs. */
+
+void metrics_init(ThreadMetrics *metrics);
+
+/**
+ * @brief Adds to a counter of the calling thread's own metrics.
+ */
+static inline void metrics_add(_Atomic uint64_t *counter, uint64_t delta)
+{
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + delta, memory_order_relaxed);
+}
+
+/**
+ * @brief Reads a counter of any thread. The value may be a few updates behind its owner's.
+ */
+static inline uint64_t metrics_load(const _Atomic uint64_t *counter)
+{
+    return atomic_load_explicit(counter, memory_order_relaxed);
+}
+
+void metrics_count_request(ThreadMetrics *metrics, HttpMethod method);
+
+/**
+ * @brief Counts a reply by its status code. Codes out of the 100 to 599 range are ignored.
+ */
+void metrics_count_response(ThreadMetrics *metrics, int status_code);
+
+/* MetricsBoard Funcs. */
+
+void metrics_board_init(MetricsBoard *board, ThreadMetrics *threads, int thread_count);
+
+/**
+ * @brief Sums every thread's counters into dst. Readers never lock or wait on the threads, so totals may be a few updates behind.
+ */
+void metrics_board_sum(const MetricsBoard *board, ThreadMetrics *dst);
+
+/**
+ * @brief Writes the summed counters in the Prometheus text exposition format.
+ *
+ * @param board
+ * @param dst
+ * @param capacity
+ * @returns Length of the text, or -1 if it did not fit.
+ */
+int metrics_board_render(const MetricsBoard *board, char *dst, size_t capacity);
+
+#endif
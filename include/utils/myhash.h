@@ -6,7 +6,10 @@
 
 #define MY_HASH_PRIME 3
 #define MY_HASH_LIMIT 10
+#define FNV1A_64_OFFSET 0xcbf29ce484222325ULL
+#define FNV1A_64_PRIME 0x100000001b3ULL
 
 size_t hash_cstr(const char *str);
+uint64_t hash_bytes_fnv1a(const char *bytes, size_t count);
 
 #endif
\ No newline at end of file
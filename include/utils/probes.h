@@ -0,0 +1,35 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/* Magic Macros */
+
+/**
+ * USDT probes of provider "h1c", for tracing a running server with bpftrace or perf without rebuilding it:
+ *
+ *   request__parsed(worker_id, fd, method, bytes_in, ok)       h1scanner.c, once a request line and headers are read
+ *   route__matched(worker_id, fd, method, matched, path)       srvworker.c, after the route lookup
+ *   handler__returned(worker_id, fd, handler_status, status)   srvworker.c, after the handler runs
+ *   response__written(worker_id, fd, status, bytes, ok)        h1writer.c, once a whole reply is handed to the socket
+ *   connection__closed(worker_id, fd, requests_served)         srvworker.c, or connpark.c and lstworker.c as worker 0, the listener thread
+ *
+ * With <sys/sdt.h>, each probe is a single NOP plus an ELF note until a tracer attaches, so they stay in release builds. Without it, or with H1C_NO_PROBES defined, they compile to nothing: arguments only appear under sizeof, so they are never evaluated but still count as used.
+ */
+
+#if !defined(H1C_NO_PROBES) && defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define H1C_PROBES_ENABLED 1
+#endif
+#endif
+
+#ifdef H1C_PROBES_ENABLED
+#define H1C_PROBE3(name, a1, a2, a3) DTRACE_PROBE3(h1c, name, a1, a2, a3)
+#define H1C_PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(h1c, name, a1, a2, a3, a4)
+#define H1C_PROBE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(h1c, name, a1, a2, a3, a4, a5)
+#else
+#define H1C_PROBE3(name, a1, a2, a3) do { (void)sizeof(a1); (void)sizeof(a2); (void)sizeof(a3); } while (0)
+#define H1C_PROBE4(name, a1, a2, a3, a4) do { H1C_PROBE3(name, a1, a2, a3); (void)sizeof(a4); } while (0)
+#define H1C_PROBE5(name, a1, a2, a3, a4, a5) do { H1C_PROBE4(name, a1, a2, a3, a4); (void)sizeof(a5); } while (0)
+#endif
+
+#endif
@@ -6,6 +6,9 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "utils/myhash.h"
 
 /* Magic Macros */
 
@@ -13,24 +16,51 @@
 #define FILE_EXT_HTML ".html"
 #define FILE_EXT_CSS ".css"
 #define FILE_EXT_JS ".js"
+#define FILE_EXT_GZIP ".gz"
+#define FILE_EXT_BR ".br"
+
+/**
+ * @brief Files smaller than this are not gzipped at load time since the gzip framing would eat most of the savings.
+ */
+#define STATSRC_GZIP_MIN_SIZE 128
+
+/**
+ * @brief Fits a quoted 64-bit hex hash, a coding suffix, and the NUL.
+ */
+#define STATSRC_ETAG_BUFSIZE 32
 
 /* Helper Funcs. */
 
 MimeType filename_get_mime(const char *fname);
 char *file_read_all(const char *fname, size_t *read_count_ref);
+char *file_map_all(const char *fname, size_t *map_count_ref);
+char *data_gzip_all(const char *data, size_t data_len, size_t *gzip_count_ref);
 
 /* StaticResource */
 
+/**
+ * @brief Stores one encoded form of a static file's content.
+ */
+typedef struct static_variant_t
+{
+    size_t clen;
+    char *data;
+    bool mapped;  // if data is a read-only file mapping instead of heap memory
+    char etag[STATSRC_ETAG_BUFSIZE];  // strong validator from a content hash of this variant
+} StaticVariant;
+
 /**
  * @brief Encapusulates data of any static file resource.
  * @note The data is managed and freed within resource functions, but the file name c-string is not managed. Thus, freeing the file name is dangerous.
+ * @note Each variant is indexed by its ContentEncoding code. Encoded variants come from ".gz" / ".br" sidecar files or are gzipped once on load.
+ * @note File contents are mapped read-only, so replies and byte ranges are sent from the page cache without extra copies.
  */
 typedef struct static_resource_t
 {
     const char *fname;
     MimeType type;
-    size_t clen;
-    char *data;
+    time_t mtime;  // file modification time for Last-Modified
+    StaticVariant variants[ENCODING_COUNT];
 } StaticResource;
 
 /* StaticResource Funcs. */
@@ -40,5 +70,16 @@ void statsrc_dispose(StaticResource *statsrc);
 MimeType statsrc_get_type(const StaticResource *statsrc);
 int statsrc_get_length(const StaticResource *statsrc);
 const char *statsrc_view_data(const StaticResource *statsrc);
+bool statsrc_has_encodings(const StaticResource *statsrc);
+
+/**
+ * @brief Picks the smallest variant whose coding is in the accepted ENCODING_FLAG bits. The identity variant is the fallback.
+ * 
+ * @param statsrc
+ * @param accept_flags
+ * @param encoding_ref Receives the chosen variant's coding.
+ * @returns const StaticVariant* 
+ */
+const StaticVariant *statsrc_pick_variant(const StaticResource *statsrc, int accept_flags, ContentEncoding *encoding_ref);
 
-#endif
\ No newline at end of file
+#endif
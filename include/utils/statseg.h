@@ -0,0 +1,153 @@
+#ifndef STATSEG_H
+#define STATSEG_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "utils/timing.h"
+
+/* Macros */
+
+#define STATSEG_MAGIC 0x53433148u     // "H1CS" in memory order
+#define STATSEG_VERSION 1
+#define STATSEG_NAME_FMT "/h1c.%d"    // shm name by server pid
+#define STATSEG_NAME_SIZE 64
+#define STATSEG_MAX_WORKERS 64
+#define STATSEG_STATE_SIZE 12
+#define STATSEG_STATUS_CLASSES 5      // 1xx to 5xx
+#define STATSEG_PUBLISH_MS 500        // how often the publisher refreshes the segment
+#define STATSEG_READ_TRIES 100        // reads retried while the publisher keeps writing
+
+/* Structs */
+
+typedef struct stats_worker_t
+{
+    char state[STATSEG_STATE_SIZE];  // FSM state name, such as "recv"
+    uint32_t worker_id;
+    uint64_t requests;
+    uint64_t bytes_out;
+} StatsWorker;
+
+/**
+ * @brief Server-wide numbers at one moment, as published to readers such as h1ctop.
+ */
+typedef struct stats_snapshot_t
+{
+    uint64_t published_ms;  // wall clock time of publishing, so readers can tell a stale segment
+    uint64_t uptime_ms;
+    uint32_t pid;
+    uint32_t worker_count;
+    uint64_t requests;
+    double rps;             // over the last publishing interval
+    uint64_t responses[STATSEG_STATUS_CLASSES];
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t accepts;
+    uint64_t active_connections;
+    uint64_t parked_connections;
+    uint64_t queue_depth;
+    uint64_t queue_capacity;
+    uint64_t queue_full;
+    uint64_t parse_errors;
+    uint64_t slab_acquires;        // connection buffers taken from the pool
+    uint64_t slab_misses;          // times the pool ran dry
+    uint64_t conditional_requests; // GET and HEAD requests with validators
+    uint64_t not_modified;         // of which the client's cached copy was still good
+    StatsWorker workers[STATSEG_MAX_WORKERS];
+} StatsSnapshot;
+
+/**
+ * @brief Layout of the shared memory segment. The snapshot is guarded by a seqlock: its sequence is odd while the publisher writes, and readers retry if it changed during their copy, so the publisher never waits on readers.
+ */
+typedef struct stats_segment_t
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;           // of this struct, so mismatched readers refuse it
+    _Atomic uint32_t seq;
+    StatsSnapshot snapshot;
+} StatsSegment;
+
+/**
+ * @brief Fills a snapshot from the server's live state. Called on the publisher thread.
+ */
+typedef void (*StatsGatherFunc)(void *source_ref, StatsSnapshot *dst);
+
+/**
+ * @brief Owns a named segment and the thread refreshing it.
+ */
+typedef struct stats_publisher_t
+{
+    char name[STATSEG_NAME_SIZE];
+    StatsSegment *segment;
+    StatsGatherFunc gather;
+    void *source_ref;
+    uint64_t started_ms;
+    uint64_t last_requests;  // of the previous snapshot, for rps
+    uint64_t last_ms;
+    bool running;
+    pthread_t thread;
+    pthread_mutex_t lock;    // only guards the publisher's sleep
+    pthread_cond_t wakeup;
+} StatsPublisher;
+
+/* StatsSegment Funcs. */
+
+/**
+ * @brief Replaces the segment's snapshot as the only writer.
+ */
+void statseg_write(StatsSegment *segment, const StatsSnapshot *snapshot);
+
+/**
+ * @brief Copies a consistent snapshot out of the segment.
+ *
+ * @param segment
+ * @param dst
+ * @returns false if the publisher kept writing through every try.
+ */
+bool statseg_read(const StatsSegment *segment, StatsSnapshot *dst);
+
+/**
+ * @brief Maps a server's segment read-only, as for h1ctop.
+ *
+ * @param name Such as "/h1c.1234".
+ * @returns The segment, or NULL if it is missing or of another layout.
+ */
+const StatsSegment *statseg_open(const char *name);
+void statseg_close(const StatsSegment *segment);
+
+/* StatsPublisher Funcs. */
+
+/**
+ * @brief Creates the named segment, replacing a stale one of the same name.
+ *
+ * @param publisher
+ * @param name
+ * @param gather
+ * @param source_ref Passed to gather.
+ * @returns false if shared memory is unavailable.
+ */
+bool statspub_init(StatsPublisher *publisher, const char *name, StatsGatherFunc gather, void *source_ref);
+
+/**
+ * @brief Starts refreshing the segment every STATSEG_PUBLISH_MS.
+ */
+bool statspub_start(StatsPublisher *publisher);
+
+/**
+ * @brief Stops refreshing, then unmaps and removes the segment.
+ */
+void statspub_dispose(StatsPublisher *publisher);
+
+#endif
@@ -0,0 +1,58 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Macros */
+
+#define TIMING_CALIBRATE_NS 20000000  // sleep of timing_ticks_per_ns, long enough to dwarf the clock calls around it
+
+/* Timing Funcs. */
+
+/**
+ * @brief Gets milliseconds on the monotonic clock, which never jumps with wall clock changes. Only differences between readings are meaningful.
+ * 
+ * @returns uint64_t
+ */
+uint64_t timing_now_ms(void);
+
+/**
+ * @brief Gets nanoseconds on the monotonic clock, for measuring latencies.
+ * 
+ * @returns uint64_t
+ */
+uint64_t timing_now_ns(void);
+
+/**
+ * @brief Reads the CPU's timestamp counter, which costs a few nanoseconds instead of a clock call. Ticks run at a fixed rate per machine, not at the core's current clock. Falls back to nanoseconds where there is no such counter.
+ * 
+ * @returns uint64_t
+ */
+static inline uint64_t timing_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+
+    return ticks;
+#else
+    return timing_now_ns();
+#endif
+}
+
+/**
+ * @brief Measures how many timing_cycles() ticks pass per nanosecond by sleeping briefly, so tick counts can be reported as times. Call it off the hot path, as for reports.
+ * 
+ * @returns double
+ */
+double timing_ticks_per_ns(void);
+
+#endif
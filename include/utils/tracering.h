@@ -0,0 +1,163 @@
+#ifndef TRACERING_H
+#define TRACERING_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "utils/timing.h"
+
+/* Macros */
+
+#define TRACE_CACHE_LINE 64
+#define TRACE_RING_CAPACITY 4096   // newest events kept per thread, a power of two
+#define TRACE_FILE_MAGIC "H1CTRACE"
+#define TRACE_FILE_VERSION 1
+
+/* Enums */
+
+typedef enum trace_event_kind_e
+{
+    TRACE_ACCEPT = 0,
+    TRACE_PARSE_START,  // a worker starts reading a request
+    TRACE_ROUTE,        // code is 1 if a route matched
+    TRACE_HANDLER_DONE, // code is the HandlerStatus
+    TRACE_SEND_DONE,    // code is the status code and bytes what went out
+    TRACE_CLOSE,
+    TRACE_KIND_COUNT
+} TraceEventKind;
+
+/* Structs */
+
+/**
+ * @brief One connection lifecycle event, as stored in rings and dump files.
+ */
+typedef struct trace_event_t
+{
+    uint64_t ticks;  // timing_cycles() when it happened
+    int32_t fd;
+    uint16_t kind;
+    uint16_t thread_id;
+    uint32_t code;
+    uint32_t bytes;
+} TraceEvent;
+
+/**
+ * @brief The events a thread recorded last. The newest overwrite the oldest, so memory stays fixed however long the server runs.
+ * @note Only the owner thread records. Readers copy events out and discard those the owner may have overwritten meanwhile, so neither side ever waits.
+ */
+typedef struct trace_ring_t
+{
+    _Alignas(TRACE_CACHE_LINE) _Atomic uint64_t head; // events ever recorded, so the newest is at head - 1
+    uint16_t thread_id;
+    TraceEvent events[TRACE_RING_CAPACITY];
+} TraceRing;
+
+/**
+ * @brief Every thread's ring, for dumps.
+ */
+typedef struct trace_board_t
+{
+    TraceRing *rings;
+    int ring_count;
+    double ticks_per_ns;  // measured once, so dumps need not
+} TraceBoard;
+
+/**
+ * @brief Dump layout: this header, then a TraceRingHeader and its events for each ring, oldest first.
+ */
+typedef struct trace_file_header_t
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t ring_count;
+    double ticks_per_ns;
+} TraceFileHeader;
+
+typedef struct trace_ring_header_t
+{
+    uint32_t thread_id;
+    uint32_t event_count;
+} TraceRingHeader;
+
+/* TraceRing Funcs. */
+
+void tracering_init(TraceRing *ring, uint16_t thread_id);
+
+/**
+ * @brief Records an event of the calling thread's own ring. It costs a timestamp read and a few stores, so it stays on in production.
+ *
+ * @param ring The thread's ring, or NULL to record nothing.
+ * @param kind
+ * @param fd
+ * @param code Meaning depends on kind.
+ * @param bytes Meaning depends on kind.
+ */
+static inline void tracering_record(TraceRing *ring, TraceEventKind kind, int fd, uint32_t code, uint32_t bytes)
+{
+    if (!ring)
+        return;
+
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    TraceEvent *event = &ring->events[head & (TRACE_RING_CAPACITY - 1)];
+
+    event->ticks = timing_cycles();
+    event->fd = fd;
+    event->kind = (uint16_t)kind;
+    event->thread_id = ring->thread_id;
+    event->code = code;
+    event->bytes = bytes;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+/**
+ * @brief Copies the ring's events out, oldest first, while its owner keeps recording.
+ *
+ * @param ring
+ * @param dst Room for TRACE_RING_CAPACITY events.
+ * @returns Count of events copied whole.
+ */
+uint32_t tracering_snapshot(const TraceRing *ring, TraceEvent *dst);
+
+/**
+ * @brief Gets an event kind's name as used in decoded traces, such as "accept".
+ */
+const char *tracering_kind_name(TraceEventKind kind);
+
+/* TraceBoard Funcs. */
+
+/**
+ * @brief Sets up every thread's ring, where thread i gets thread_id i. Also measures the timestamp rate, which takes a few milliseconds.
+ */
+void trace_board_init(TraceBoard *board, TraceRing *rings, int ring_count);
+
+/**
+ * @brief Gets the most bytes a dump may take.
+ */
+size_t trace_board_dump_size(const TraceBoard *board);
+
+/**
+ * @brief Writes a dump of every ring into memory, as for an admin route.
+ *
+ * @param board
+ * @param dst
+ * @param capacity At least trace_board_dump_size bytes.
+ * @returns Length of the dump, or -1 if it did not fit.
+ */
+long trace_board_dump(const TraceBoard *board, char *dst, size_t capacity);
+
+/**
+ * @brief Writes a dump of every ring to a file, replacing it. Only uses async-signal-safe calls, so a signal handler may call it.
+ *
+ * @param board
+ * @param path
+ * @returns false if the file could not be written or another dump to file is running.
+ */
+bool trace_board_dump_file(const TraceBoard *board, const char *path);
+
+#endif
@@ -0,0 +1,450 @@
+/**
+ * @file accesslog.c
+ * @author Derek Tan
+ * @brief Implements the access log, with per-worker record rings and a batching flusher thread.
+ * @date 2023-12-22
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "server/accesslog.h"
+
+/* Macros */
+
+#define ACCESSLOG_TAIL_ROOM 192  // room kept after the path for the fixed fields that follow it
+
+/* Helper Structs */
+
+/**
+ * @brief A record line being formatted. Only the path varies much in length, so the rest is written without bounds checks.
+ */
+typedef struct log_line_t
+{
+    char *data;
+    size_t length;
+} LogLine;
+
+/* Helper Funcs. */
+
+static void logline_put_str(LogLine *line, const char *text)
+{
+    size_t text_len = strlen(text);
+
+    memcpy(line->data + line->length, text, text_len);
+    line->length += text_len;
+}
+
+/**
+ * @brief Writes a number in decimal, which snprintf would take several times longer to do.
+ */
+static void logline_put_u64(LogLine *line, uint64_t value)
+{
+    char digits[20];
+    int digit_count = 0;
+
+    do
+    {
+        digits[digit_count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    while (digit_count > 0)
+        line->data[line->length++] = digits[--digit_count];
+}
+
+static uint64_t accesslog_wall_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Copies a client-supplied string as JSON string content, escaping quotes, backslashes and control bytes.
+ * @returns Bytes written, which stop short of room.
+ */
+static size_t logring_escape(char *dst, size_t room, const char *src)
+{
+    static const char hex_digits[] = "0123456789abcdef";
+    size_t length = 0;
+
+    for (; *src != '\0'; src++)
+    {
+        unsigned char c = (unsigned char)*src;
+
+        if (c == '"' || c == '\\')
+        {
+            if (length + 2 > room)
+                break;
+
+            dst[length++] = '\\';
+            dst[length++] = (char)c;
+        }
+        else if (c < 0x20 || c == 0x7f)
+        {
+            if (length + 6 > room)
+                break;
+
+            memcpy(dst + length, "\\u00", 4);
+            dst[length + 4] = hex_digits[c >> 4];
+            dst[length + 5] = hex_digits[c & 0xf];
+            length += 6;
+        }
+        else
+        {
+            if (length + 1 > room)
+                break;
+
+            dst[length++] = (char)c;
+        }
+    }
+
+    return length;
+}
+
+/**
+ * @brief Appends bytes if they all fit, so the flusher never sees part of a line.
+ */
+static bool logring_append(LogRing *ring, const char *data, size_t len)
+{
+    size_t write_pos = atomic_load_explicit(&ring->write_pos, memory_order_relaxed);
+    size_t read_pos = atomic_load_explicit(&ring->read_pos, memory_order_acquire);
+
+    if (ring->capacity - (write_pos - read_pos) < len)
+        return false;
+
+    size_t offset = write_pos & (ring->capacity - 1);
+    size_t first_len = (len < ring->capacity - offset) ? len : ring->capacity - offset;
+
+    memcpy(ring->data + offset, data, first_len);
+    memcpy(ring->data, data + first_len, len - first_len);
+    atomic_store_explicit(&ring->write_pos, write_pos + len, memory_order_release);
+
+    return true;
+}
+
+/**
+ * @brief Writes out everything the rings hold in one writev call, or a few if the file takes less at once.
+ * @returns Bytes written.
+ */
+static size_t accesslog_flush(AccessLog *log)
+{
+    struct iovec flush_iov[2 * log->ring_count];
+    size_t pending[log->ring_count];
+    size_t total_wc = 0;
+    int iov_count = 0;
+
+    // Only whole lines are ever published, so everything up to each write position is ready.
+    for (int i = 0; i < log->ring_count; i++)
+    {
+        LogRing *ring = &log->rings[i];
+        size_t read_pos = atomic_load_explicit(&ring->read_pos, memory_order_relaxed);
+        size_t offset = read_pos & (ring->capacity - 1);
+
+        pending[i] = atomic_load_explicit(&ring->write_pos, memory_order_acquire) - read_pos;
+
+        if (pending[i] == 0)
+            continue;
+
+        size_t first_len = (pending[i] < ring->capacity - offset) ? pending[i] : ring->capacity - offset;
+
+        flush_iov[iov_count].iov_base = ring->data + offset;
+        flush_iov[iov_count].iov_len = first_len;
+        iov_count++;
+
+        if (first_len < pending[i])
+        {
+            flush_iov[iov_count].iov_base = ring->data;
+            flush_iov[iov_count].iov_len = pending[i] - first_len;
+            iov_count++;
+        }
+    }
+
+    if (iov_count == 0)
+        return 0;
+
+    int iov_pos = 0;
+
+    while (iov_pos < iov_count)
+    {
+        ssize_t temp_wc = writev(log->fd, flush_iov + iov_pos, iov_count - iov_pos);
+
+        if (temp_wc < 0 && errno == EINTR)
+            continue;
+
+        // The file is unwritable, as when the disk is full: keep the records for the next attempt.
+        if (temp_wc <= 0)
+            break;
+
+        total_wc += temp_wc;
+
+        while (iov_pos < iov_count && (size_t)temp_wc >= flush_iov[iov_pos].iov_len)
+        {
+            temp_wc -= flush_iov[iov_pos].iov_len;
+            iov_pos++;
+        }
+
+        if (iov_pos < iov_count)
+        {
+            flush_iov[iov_pos].iov_base = (char *)flush_iov[iov_pos].iov_base + temp_wc;
+            flush_iov[iov_pos].iov_len -= temp_wc;
+        }
+    }
+
+    // Release what went out from the rings in order, stopping at the first one left partly unwritten.
+    size_t release_left = total_wc;
+
+    for (int i = 0; i < log->ring_count && release_left > 0; i++)
+    {
+        size_t released = (pending[i] < release_left) ? pending[i] : release_left;
+        size_t read_pos = atomic_load_explicit(&log->rings[i].read_pos, memory_order_relaxed);
+
+        atomic_store_explicit(&log->rings[i].read_pos, read_pos + released, memory_order_release);
+        release_left -= released;
+    }
+
+    return total_wc;
+}
+
+static int accesslog_open_file(const char *path, ino_t *inode_ref)
+{
+    struct stat file_info;
+    int fd = open(path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+
+    if (fd != -1 && fstat(fd, &file_info) == 0)
+        *inode_ref = file_info.st_ino;
+
+    return fd;
+}
+
+/**
+ * @brief Checks whether the path now names another file than the open one, as after logrotate renamed it.
+ */
+static bool accesslog_is_rotated(const AccessLog *log)
+{
+    struct stat path_info;
+
+    return stat(log->path, &path_info) != 0 || path_info.st_ino != log->inode;
+}
+
+static void accesslog_reopen(AccessLog *log)
+{
+    ino_t new_inode = 0;
+    int new_fd = accesslog_open_file(log->path, &new_inode);
+
+    // Keep logging to the old file rather than nowhere.
+    if (new_fd == -1)
+        return;
+
+    close(log->fd);
+    log->fd = new_fd;
+    log->inode = new_inode;
+}
+
+/**
+ * @brief Notes records lost to full rings in the log itself, so gaps are visible.
+ */
+static void accesslog_note_drops(AccessLog *log, uint64_t *reported_ref)
+{
+    char line[ACCESSLOG_LINE_MAX];
+    uint64_t dropped = 0;
+
+    for (int i = 0; i < log->ring_count; i++)
+        dropped += atomic_load_explicit(&log->rings[i].dropped, memory_order_relaxed);
+
+    if (dropped == *reported_ref)
+        return;
+
+    int line_len = snprintf(line, sizeof(line), "{\"ts\":%llu,\"dropped_records\":%llu}\n",
+        (unsigned long long)accesslog_wall_ms(), (unsigned long long)(dropped - *reported_ref));
+
+    if (write(log->fd, line, line_len) == line_len)
+        *reported_ref = dropped;
+}
+
+static void *accesslog_run(void *log_ref)
+{
+    AccessLog *log = (AccessLog *)log_ref;
+    uint64_t next_check_ms = timing_now_ms() + ACCESSLOG_CHECK_MS;
+    uint64_t reported_drops = 0;
+
+    pthread_mutex_lock(&log->lock);
+
+    while (log->running)
+    {
+        struct timespec until;
+
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += (long)ACCESSLOG_FLUSH_MS * 1000000;
+        until.tv_sec += until.tv_nsec / 1000000000;
+        until.tv_nsec %= 1000000000;
+        pthread_cond_timedwait(&log->wakeup, &log->lock, &until);
+        pthread_mutex_unlock(&log->lock);
+
+        accesslog_flush(log);
+        accesslog_note_drops(log, &reported_drops);
+
+        // Records written so far belong in the old file, so reopening comes after the flush.
+        uint64_t now_ms = timing_now_ms();
+        bool check_due = now_ms >= next_check_ms;
+
+        if (check_due)
+            next_check_ms = now_ms + ACCESSLOG_CHECK_MS;
+
+        if (atomic_exchange(&log->reopen_requested, false) || (check_due && accesslog_is_rotated(log)))
+            accesslog_reopen(log);
+
+        pthread_mutex_lock(&log->lock);
+    }
+
+    pthread_mutex_unlock(&log->lock);
+
+    accesslog_flush(log);
+    accesslog_note_drops(log, &reported_drops);
+
+    return NULL;
+}
+
+/* LogRing Funcs. */
+
+bool logring_put_record(LogRing *ring, const AccessRecord *record)
+{
+    char line[ACCESSLOG_LINE_MAX];
+    LogLine cursor = {.data = line, .length = 0};
+
+    logline_put_str(&cursor, "{\"ts\":");
+    logline_put_u64(&cursor, accesslog_wall_ms());
+    logline_put_str(&cursor, ",\"worker\":");
+    logline_put_u64(&cursor, (uint64_t)record->worker_id);
+    logline_put_str(&cursor, ",\"method\":\"");
+    logline_put_str(&cursor, method_code_to_name(record->method));
+    logline_put_str(&cursor, "\",\"path\":\"");
+
+    if (record->path != NULL)
+        cursor.length += logring_escape(line + cursor.length, ACCESSLOG_LINE_MAX - cursor.length - ACCESSLOG_TAIL_ROOM, record->path);
+
+    logline_put_str(&cursor, "\",\"status\":");
+    logline_put_u64(&cursor, (uint64_t)record->status_code);
+    logline_put_str(&cursor, ",\"bytes_in\":");
+    logline_put_u64(&cursor, record->bytes_in);
+    logline_put_str(&cursor, ",\"bytes_out\":");
+    logline_put_u64(&cursor, record->bytes_out);
+    logline_put_str(&cursor, ",\"dur_us\":");
+    logline_put_u64(&cursor, record->duration_ns / 1000);
+    line[cursor.length++] = '.';
+    line[cursor.length++] = (char)('0' + record->duration_ns / 100 % 10);
+
+    if (record->error != NULL)
+    {
+        logline_put_str(&cursor, ",\"error\":\"");
+        logline_put_str(&cursor, record->error);
+        logline_put_str(&cursor, "\"");
+    }
+
+    logline_put_str(&cursor, "}\n");
+
+    if (!logring_append(ring, line, cursor.length))
+    {
+        atomic_store_explicit(&ring->dropped, atomic_load_explicit(&ring->dropped, memory_order_relaxed) + 1, memory_order_relaxed);
+        return false;
+    }
+
+    return true;
+}
+
+/* AccessLog Funcs. */
+
+bool accesslog_init(AccessLog *log, const char *path, int ring_count)
+{
+    log->fd = -1;
+    log->rings = NULL;
+    log->ring_count = 0;
+    log->running = false;
+    atomic_init(&log->reopen_requested, false);
+
+    if (strlen(path) >= ACCESSLOG_PATH_SIZE)
+        return false;
+
+    strcpy(log->path, path);
+    log->fd = accesslog_open_file(path, &log->inode);
+    log->rings = aligned_alloc(ACCESSLOG_CACHE_LINE, sizeof(LogRing) * ring_count);
+
+    if (log->fd == -1 || !log->rings)
+    {
+        accesslog_dispose(log);
+        return false;
+    }
+
+    for (int i = 0; i < ring_count; i++)
+    {
+        LogRing *ring = &log->rings[i];
+
+        atomic_init(&ring->write_pos, 0);
+        atomic_init(&ring->read_pos, 0);
+        atomic_init(&ring->dropped, 0);
+        ring->capacity = ACCESSLOG_RING_SIZE;
+        ring->data = malloc(ACCESSLOG_RING_SIZE);
+        log->ring_count++;
+
+        if (!ring->data)
+        {
+            accesslog_dispose(log);
+            return false;
+        }
+    }
+
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->wakeup, NULL);
+
+    return true;
+}
+
+LogRing *accesslog_get_ring(AccessLog *log, int ring_index)
+{
+    return (ring_index >= 0 && ring_index < log->ring_count) ? &log->rings[ring_index] : NULL;
+}
+
+bool accesslog_start(AccessLog *log)
+{
+    log->running = true;
+
+    if (pthread_create(&log->flusher, NULL, accesslog_run, log) != 0)
+    {
+        log->running = false;
+        return false;
+    }
+
+    return true;
+}
+
+void accesslog_request_reopen(AccessLog *log)
+{
+    atomic_store(&log->reopen_requested, true);
+}
+
+void accesslog_dispose(AccessLog *log)
+{
+    if (log->running)
+    {
+        pthread_mutex_lock(&log->lock);
+        log->running = false;
+        pthread_cond_signal(&log->wakeup);
+        pthread_mutex_unlock(&log->lock);
+        pthread_join(log->flusher, NULL);
+    }
+
+    for (int i = 0; i < log->ring_count; i++)
+        free(log->rings[i].data);
+
+    free(log->rings);
+    log->rings = NULL;
+    log->ring_count = 0;
+
+    if (log->fd != -1)
+        close(log->fd);
+
+    log->fd = -1;
+}
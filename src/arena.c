@@ -0,0 +1,133 @@
+/**
+ * @file arena.c
+ * @author Derek Tan
+ * @brief Implements the per-worker request arena.
+ * @date 2023-12-10
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include "utils/arena.h"
+
+/* Helper Funcs. */
+
+static size_t arena_align_size(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+}
+
+static ArenaBlock *arena_block_create(size_t capacity)
+{
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+
+    if (block != NULL)
+    {
+        block->next = NULL;
+        block->capacity = capacity;
+        block->used = 0;
+    }
+
+    return block;
+}
+
+/* Arena Funcs. */
+
+bool arena_init(Arena *arena, size_t block_size)
+{
+    arena->block_size = (block_size > 0) ? arena_align_size(block_size) : ARENA_DEFAULT_BLOCK_SIZE;
+    arena->head = arena_block_create(arena->block_size);
+    arena->current = arena->head;
+
+    return arena->head != NULL;
+}
+
+void arena_dispose(Arena *arena)
+{
+    ArenaBlock *block_ptr = arena->head;
+    ArenaBlock *next_ptr = NULL;
+
+    while (block_ptr != NULL)
+    {
+        next_ptr = block_ptr->next;
+        free(block_ptr);
+        block_ptr = next_ptr;
+    }
+
+    arena->head = NULL;
+    arena->current = NULL;
+}
+
+void arena_reset(Arena *arena)
+{
+    ArenaBlock *prev_ptr = NULL;
+    ArenaBlock *block_ptr = arena->head;
+
+    while (block_ptr != NULL)
+    {
+        ArenaBlock *next_ptr = block_ptr->next;
+
+        // Oversized blocks only served one big allocation, so give them back instead of keeping them around.
+        if (block_ptr->capacity > arena->block_size && prev_ptr != NULL)
+        {
+            prev_ptr->next = next_ptr;
+            free(block_ptr);
+        }
+        else
+        {
+            block_ptr->used = 0;
+            prev_ptr = block_ptr;
+        }
+
+        block_ptr = next_ptr;
+    }
+
+    arena->current = arena->head;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    size_t aligned_size = arena_align_size((size > 0) ? size : 1);
+    ArenaBlock *block_ptr = arena->current;
+
+    if (!block_ptr)
+        return NULL;
+
+    // 1. Move through any kept blocks from earlier requests until one has room.
+    while (block_ptr->used + aligned_size > block_ptr->capacity && block_ptr->next != NULL && aligned_size <= arena->block_size)
+        block_ptr = block_ptr->next;
+
+    // 2. Append a new block if none fit. Big allocations get a block of their exact size.
+    if (block_ptr->used + aligned_size > block_ptr->capacity)
+    {
+        size_t new_capacity = (aligned_size > arena->block_size) ? aligned_size : arena->block_size;
+        ArenaBlock *new_block = arena_block_create(new_capacity);
+
+        if (!new_block)
+            return NULL;
+
+        new_block->next = block_ptr->next;
+        block_ptr->next = new_block;
+        block_ptr = new_block;
+    }
+
+    void *memory = block_ptr->data + block_ptr->used;
+
+    block_ptr->used += aligned_size;
+    arena->current = block_ptr;
+
+    return memory;
+}
+
+char *arena_strndup(Arena *arena, const char *bytes, size_t count)
+{
+    char *str = arena_alloc(arena, count + 1);
+
+    if (!str)
+        return NULL;
+
+    memcpy(str, bytes, count);
+    str[count] = '\0';
+
+    return str;
+}
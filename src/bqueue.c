@@ -19,6 +19,7 @@ QueueNode *qnode_create(int data_fd)
     if (node != NULL)
     {
         node->data = data_fd;
+        node->served = 0;
         node->next = NULL;
     }
 
@@ -27,14 +28,14 @@ QueueNode *qnode_create(int data_fd)
 
 /* BlockingQueue Funcs. */
 
-bool bqueue_init(BlockedQueue *bqueue, int8_t capacity)
+bool bqueue_init(BlockedQueue *bqueue, int capacity)
 {
-    int8_t safe_capacity = (capacity >= BQUEUE_MIN_SIZE && capacity <= BQUEUE_MAX_SIZE)
+    int safe_capacity = (capacity >= BQUEUE_MIN_SIZE && capacity <= BQUEUE_MAX_SIZE)
         ? capacity
         : BQUEUE_MIN_SIZE;
     
     bool lock_ok = pthread_mutex_init(&bqueue->lock, NULL) == 0;
-    bool signaler_ok = pthread_cond_init(&bqueue->signaler, NULL);
+    bool signaler_ok = pthread_cond_init(&bqueue->signaler, NULL) == 0;
     bqueue->head = NULL;
     bqueue->tip = NULL;
     bqueue->capacity = safe_capacity;
@@ -45,22 +46,20 @@ bool bqueue_init(BlockedQueue *bqueue, int8_t capacity)
 
 void bqueue_destroy(BlockedQueue *bqueue)
 {
-    if (bqueue_is_empty(bqueue))
-        return;
-
-    QueueNode *next_ptr = bqueue->head;
+    QueueNode *node = bqueue->head;
 
-    while (bqueue->head != NULL)
+    while (node != NULL)
     {
-        next_ptr = next_ptr->next;
+        QueueNode *next_ptr = node->next;
 
         // close still pending connection fd's!
-        close(next_ptr->data);
-        free(bqueue->head);
+        close(node->data);
+        free(node);
 
-        bqueue->head = next_ptr;
+        node = next_ptr;
     }
-    
+
+    bqueue->head = NULL;
     bqueue->tip = NULL;
     bqueue->count = 0;
 
@@ -91,6 +90,7 @@ QueueNode *bqueue_dequeue(BlockedQueue *bqueue)
 
     bqueue->head = node->next;
     node->next = NULL;
+    bqueue->count--;
 
     if (!bqueue->head)
         bqueue->tip = NULL;
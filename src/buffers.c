@@ -10,42 +10,69 @@
 
 #include "basicio/buffers.h"
 
-void buffer_init(Buffer *buf, int capacity)
+void buffer_init(Buffer *buf, size_t capacity)
 {
     buf->write_pos = 0;
     buf->read_pos = 0;
     buf->capacity = (capacity > 0) ? capacity : MIN_BUFFER_SIZE;
+    buf->owns_data = true;
     buf->data = calloc(buf->capacity, sizeof(int8_t));
 
     if (!buf->data)
         buf->capacity = 0;
 }
 
+void buffer_init_borrowed(Buffer *buf, char *data, size_t capacity)
+{
+    buf->write_pos = 0;
+    buf->read_pos = 0;
+    buf->capacity = (data != NULL) ? capacity : 0;
+    buf->owns_data = false;
+    buf->data = data;
+}
+
 void buffer_destroy(Buffer *buf)
 {
     if (!buf->data)
         return;
     
-    free(buf->data);
+    if (buf->owns_data)
+        free(buf->data);
+
     buf->data = NULL;
     buf->capacity = 0;
     buf->read_pos = 0;
     buf->write_pos = 0;
 }
 
-bool buffer_grow(Buffer *buf, int new_capacity)
+bool buffer_grow(Buffer *buf, size_t new_capacity)
 {
-    int old_capacity = buf->capacity;
-    int clamped_capacity = (new_capacity > old_capacity && new_capacity < INT16_MAX) ? new_capacity : 0;
+    size_t old_capacity = buf->capacity;
+    size_t clamped_capacity = (new_capacity > old_capacity && new_capacity <= MAX_BUFFER_SIZE) ? new_capacity : 0;
 
     if (clamped_capacity == 0 || clamped_capacity <= old_capacity)
         return false;
 
-    char *new_buffer = realloc(buf->data, sizeof(int8_t) * clamped_capacity);
+    char *new_buffer = NULL;
+
+    // Borrowed memory cannot be realloc'd, so its content moves to a new heap block once.
+    if (buf->owns_data)
+    {
+        new_buffer = realloc(buf->data, sizeof(int8_t) * clamped_capacity);
+    }
+    else
+    {
+        new_buffer = malloc(sizeof(int8_t) * clamped_capacity);
+
+        if (new_buffer != NULL && buf->data != NULL)
+            memcpy(new_buffer, buf->data, old_capacity);
+    }
 
     if (!new_buffer)
         return false;
 
+    buf->owns_data = true;
+
     memset(new_buffer + old_capacity, '\0', clamped_capacity - old_capacity);
     buf->data = new_buffer;
     buf->capacity = clamped_capacity;
@@ -55,7 +82,7 @@ bool buffer_grow(Buffer *buf, int new_capacity)
 
 void buffer_clear(Buffer *buf)
 {
-    memset(buf->data, '\0', buf->capacity);
+    // Only rewind positions since readers stop at write_pos and writers NUL-terminate what they put.
     buf->read_pos = 0;
     buf->write_pos = 0;
 }
@@ -82,14 +109,14 @@ bool buffer_is_drained(const Buffer *buf)
     return buf->read_pos > buf->write_pos;
 }
 
-int buffer_get_wpos(const Buffer *buf)
+size_t buffer_get_wpos(const Buffer *buf)
 {
     return buf->write_pos;
 }
 
-bool buffer_set_wpos(Buffer *buf, int wpos)
+bool buffer_set_wpos(Buffer *buf, size_t wpos)
 {
-    bool wpos_valid = wpos >= 0 && wpos < buf->capacity;
+    bool wpos_valid = wpos < buf->capacity;
     
     if (wpos_valid)
         buf->write_pos = wpos;
@@ -97,14 +124,14 @@ bool buffer_set_wpos(Buffer *buf, int wpos)
     return wpos_valid;
 }
 
-int buffer_get_rpos(const Buffer *buf)
+size_t buffer_get_rpos(const Buffer *buf)
 {
     return buf->read_pos;
 }
 
-bool buffer_set_rpos(Buffer *buf, int rpos)
+bool buffer_set_rpos(Buffer *buf, size_t rpos)
 {
-    bool rpos_valid = rpos >= 0 && rpos <= buf->write_pos;
+    bool rpos_valid = rpos <= buf->write_pos;
 
     if (rpos_valid)
         buf->read_pos = rpos;
@@ -123,25 +150,17 @@ bool buffer_put(Buffer *buf, char byte)
     return true;
 }
 
-bool buffer_put_span(Buffer *buf, int count, const char *bytes)
+bool buffer_put_span(Buffer *buf, size_t count, const char *bytes)
 {
-    int space_left = buf->capacity - buf->write_pos;
+    size_t space_left = buf->capacity - buf->write_pos;
     
     if (count > space_left)
         return false;
-    
-    int pending_bytes = count;
-    const char *cursor = bytes;
 
-    while (pending_bytes > 0 && !buffer_is_full(buf))
-    {
-        buf->data[buf->write_pos] = *cursor;
-        cursor++;
-        buf->write_pos++;
-        pending_bytes--;
-    }
+    memcpy(buf->data + buf->write_pos, bytes, count);
+    buf->write_pos += count;
 
-    return pending_bytes == 0;
+    return true;
 }
 
 char buffer_get(Buffer *buf)
@@ -155,42 +174,32 @@ char buffer_get(Buffer *buf)
     return byte;
 }
 
-char *buffer_get_span(Buffer *buf, int count)
+char *buffer_get_span(Buffer *buf, size_t count, Arena *arena)
 {
-    if (buffer_is_drained(buf) || count < 0 || count > (buf->write_pos - buf->read_pos))
+    if (buffer_is_drained(buf) || count > (buf->write_pos - buf->read_pos))
         return NULL;
     
-    int span_size = count + 1;
-    char *bytes = calloc(span_size, sizeof(int8_t));
-
-    if (bytes != NULL)
-    {
-        for (int i = 0; i < span_size; i++)
-            bytes[i] = buffer_get(buf);
-        
-        bytes[span_size - 1] = '\0';
-    }
+    // The span lives in the request arena, so it is released in bulk when the worker resets.
+    char *bytes = arena_strndup(arena, buf->data + buf->read_pos, count);
 
     buf->read_pos += count;
 
     return bytes;
 }
 
-char *buffer_read_delim(Buffer *buf, char delim)
+char *buffer_read_delim(Buffer *buf, char delim, Arena *arena)
 {
     if (buffer_is_drained(buf))
         return NULL;
     
-    int count = 0;
-    int span_size = 0;
-    int space_left = buf->capacity - buf->read_pos;
+    size_t count = 0;
+    size_t space_left = buf->write_pos - buf->read_pos;
     const char *data_cursor = buf->data + buf->read_pos;
-    char *bytes = NULL;
 
     // 1. Peek ahead until delimiter or end is found...
     uint8_t byte;
 
-    do
+    while (space_left > 0)
     {
         byte = *data_cursor;
         
@@ -201,20 +210,10 @@ char *buffer_read_delim(Buffer *buf, char delim)
         count++;
         space_left--;
     }
-    while (space_left > 0);
     
-    // 2. Allocate and fill the delimited buffer.
-    span_size = count + 1;
+    // 2. Copy the delimited span into the request arena.
     data_cursor -= count;
     buf->read_pos += count + 1; // Put +1 to skip delimiter.
 
-    bytes = calloc(span_size, sizeof(int8_t));
-
-    if (!bytes)
-        return NULL;
-
-    memcpy(bytes, data_cursor, count);
-    bytes[span_size - 1] = '\0';
-
-    return bytes;
+    return arena_strndup(arena, data_cursor, count);
 }
@@ -0,0 +1,87 @@
+/**
+ * @file capture.c
+ * @author Derek Tan
+ * @brief Implements the request capture file, as replayed by tools/h1creplay.
+ * @date 2023-12-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "server/capture.h"
+
+/* RequestCapture Funcs. */
+
+bool capture_init(RequestCapture *capture, const char *path)
+{
+    CaptureFileHeader header;
+    struct timespec now;
+
+    capture->records = 0;
+    capture->write_failed = false;
+    capture->out = fopen(path, "wb");
+
+    if (!capture->out)
+        return false;
+
+    setvbuf(capture->out, NULL, _IOFBF, CAPTURE_BUFSIZE);
+    pthread_mutex_init(&capture->lock, NULL);
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    capture->started_ns = timing_now_ns();
+
+    memset(&header, 0, sizeof(CaptureFileHeader));
+    memcpy(header.magic, CAPTURE_FILE_MAGIC, sizeof(header.magic));
+    header.version = CAPTURE_FILE_VERSION;
+    header.started_unix_ms = (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+
+    if (fwrite(&header, sizeof(CaptureFileHeader), 1, capture->out) != 1)
+    {
+        capture_dispose(capture);
+        return false;
+    }
+
+    return true;
+}
+
+void capture_put(RequestCapture *capture, CaptureRecordKind kind, int worker_id, int fd, const char *data, uint32_t length)
+{
+    CaptureRecord record = {
+        .offset_ns = 0,
+        .fd = fd,
+        .length = length,
+        .kind = (uint16_t)kind,
+        .worker_id = (uint16_t)worker_id,
+        .reserved = 0
+    };
+
+    pthread_mutex_lock(&capture->lock);
+
+    // Stamped under the lock, so offsets never go backwards in the file.
+    record.offset_ns = timing_now_ns() - capture->started_ns;
+
+    if (!capture->write_failed)
+    {
+        bool write_ok = fwrite(&record, sizeof(CaptureRecord), 1, capture->out) == 1;
+
+        if (write_ok && kind == CAPTURE_DATA && length > 0)
+            write_ok = fwrite(data, length, 1, capture->out) == 1;
+
+        capture->write_failed = !write_ok;
+        capture->records += write_ok;
+    }
+
+    pthread_mutex_unlock(&capture->lock);
+}
+
+void capture_dispose(RequestCapture *capture)
+{
+    if (!capture->out)
+        return;
+
+    pthread_mutex_lock(&capture->lock);
+    fclose(capture->out);
+    capture->out = NULL;
+    capture->write_failed = true;
+    pthread_mutex_unlock(&capture->lock);
+}
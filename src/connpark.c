@@ -0,0 +1,398 @@
+/**
+ * @file connpark.c
+ * @author Derek Tan
+ * @brief Implements the parking set for connections that wait on slow or idle clients.
+ * @date 2023-12-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "server/connpark.h"
+
+/* Helper Funcs. */
+
+/**
+ * @brief Removes a record from the list and the wheel. The lock must be held.
+ */
+static void connpark_unlink(ConnParking *park, ConnRecord *record)
+{
+    timerwheel_cancel(&park->timers, &record->timer);
+    record->prev->next = record->next;
+    record->next->prev = record->prev;
+    record->prev = NULL;
+    record->next = NULL;
+    park->count--;
+}
+
+static void connpark_free(ConnRecord *record, bool close_fd)
+{
+    if (close_fd)
+        close(record->fd); // NOTE: closing also drops the fd from the epoll set.
+
+    outqueue_clear(&record->outq);
+    free(record);
+}
+
+/**
+ * @brief Notes a close in the request capture, if any. It must come before the fd is closed, since another connection may get the fd right after.
+ */
+static void connpark_note_close(ConnParking *park, int fd)
+{
+    RequestCapture *capture = park->capture_ref; // read once, as the server may drop it while shutting down
+
+    if (capture != NULL)
+        capture_put(capture, CAPTURE_CLOSE, 0, fd, NULL, 0);
+}
+
+/**
+ * @brief Timer callback run by connpark_poll with the lock held.
+ */
+static void connpark_on_expired(TimerNode *node)
+{
+    ConnRecord *record = (ConnRecord *)node->owner_ref;
+    ConnParking *park = record->park_ref;
+
+    connpark_unlink(park, record);
+    tracering_record(park->trace_ref, TRACE_CLOSE, record->fd, 0, 0);
+    H1C_PROBE3(connection__closed, 0, record->fd, record->served);
+    connpark_note_close(park, record->fd);
+    connpark_free(record, true);
+    metrics_add(&park->metrics_ref->closes, 1);
+}
+
+/**
+ * @brief Gives a connection back to the workers for its next request.
+ */
+static bool connpark_handoff(ConnParking *park, int fd, int served)
+{
+    QueueNode *task = qnode_create(fd);
+
+    if (!task)
+        return false;
+
+    task->served = served;
+
+    if (!bqueue_enqueue(park->bqueue_ref, task))
+    {
+        free(task);
+        return false;
+    }
+
+    pthread_cond_signal(&park->bqueue_ref->signaler);
+
+    return true;
+}
+
+/**
+ * @brief Registers or re-arms a record for the one event its reason waits on.
+ */
+static bool connpark_arm(ConnParking *park, ConnRecord *record, int op)
+{
+    struct epoll_event park_event = {.events = EPOLLONESHOT, .data.ptr = record};
+
+    if (record->reason == PARK_DRAINING)
+        park_event.events |= EPOLLOUT;
+    else
+        park_event.events |= EPOLLIN | EPOLLRDHUP;
+
+    return epoll_ctl(park->epoll_fd, op, record->fd, &park_event) == 0;
+}
+
+/**
+ * @brief Removes a record that leaves the set, and hands its connection back to the workers or closes it.
+ */
+static void connpark_release(ConnParking *park, ConnRecord *record, bool hand_back)
+{
+    pthread_mutex_lock(&park->lock);
+    connpark_unlink(park, record);
+    pthread_mutex_unlock(&park->lock);
+
+    if (hand_back)
+    {
+        epoll_ctl(park->epoll_fd, EPOLL_CTL_DEL, record->fd, NULL);
+
+        if (connpark_handoff(park, record->fd, record->served))
+        {
+            connpark_free(record, false);
+            return;
+        }
+    }
+
+    tracering_record(park->trace_ref, TRACE_CLOSE, record->fd, 0, 0);
+    H1C_PROBE3(connection__closed, 0, record->fd, record->served);
+    connpark_note_close(park, record->fd);
+    connpark_free(record, true);
+    metrics_add(&park->metrics_ref->closes, 1);
+}
+
+/**
+ * @brief Sends more of a draining record's output. Once drained, a persistent connection starts idling in place.
+ */
+static void connpark_on_writable(ConnParking *park, ConnRecord *record)
+{
+    Transport socket_transport;
+
+    transport_init_socket(&socket_transport, record->fd);
+
+    ssize_t temp_wc = outqueue_flush(&record->outq, &socket_transport);
+    bool drained = temp_wc >= 0 && outqueue_is_empty(&record->outq);
+
+    if (temp_wc > 0)
+        metrics_add(&park->metrics_ref->bytes_out, temp_wc);
+
+    if (temp_wc < 0 || (drained && record->idle_timeout_ms == 0))
+    {
+        connpark_release(park, record, false);
+        return;
+    }
+
+    if (drained)
+    {
+        record->reason = PARK_IDLE;
+        record->timeout_ms = record->idle_timeout_ms;
+    }
+
+    // Only progress earns the client more time.
+    if (temp_wc > 0)
+    {
+        pthread_mutex_lock(&park->lock);
+        timerwheel_schedule(&park->timers, &record->timer, timing_now_ms() + record->timeout_ms);
+        pthread_mutex_unlock(&park->lock);
+    }
+
+    if (!connpark_arm(park, record, EPOLL_CTL_MOD))
+        connpark_release(park, record, false);
+}
+
+static void connpark_on_ready(ConnParking *park, ConnRecord *record, uint32_t events)
+{
+    // Zero-copy completions also poll as errors, but only need reaping.
+    if ((events & (EPOLLERR | EPOLLHUP)) == EPOLLERR && outqueue_reap_zerocopy(&record->outq, record->fd) > 0)
+    {
+        events &= ~EPOLLERR;
+
+        if ((events & (EPOLLIN | EPOLLOUT | EPOLLRDHUP)) == 0)
+        {
+            if (!connpark_arm(park, record, EPOLL_CTL_MOD))
+                connpark_release(park, record, false);
+
+            return;
+        }
+    }
+
+    if (record->reason == PARK_DRAINING)
+    {
+        connpark_on_writable(park, record);
+        return;
+    }
+
+    // A hang up without data needs no worker, but a request sent just before a half close still gets served.
+    connpark_release(park, record, (events & (EPOLLERR | EPOLLHUP)) == 0);
+}
+
+/**
+ * @brief Lists, times and registers a new record under the lock, so the polling thread cannot see it half made.
+ */
+static bool connpark_put(ConnParking *park, ConnRecord *record)
+{
+    pthread_mutex_lock(&park->lock);
+
+    record->next = &park->records;
+    record->prev = park->records.prev;
+    park->records.prev->next = record;
+    park->records.prev = record;
+    park->count++;
+    timerwheel_schedule(&park->timers, &record->timer, timing_now_ms() + record->timeout_ms);
+
+    bool add_ok = connpark_arm(park, record, EPOLL_CTL_ADD);
+
+    if (!add_ok)
+        connpark_unlink(park, record);
+
+    pthread_mutex_unlock(&park->lock);
+
+    if (!add_ok)
+    {
+        connpark_note_close(park, record->fd);
+        connpark_free(record, true);
+    }
+
+    return add_ok;
+}
+
+static ConnRecord *connpark_record_create(ConnParking *park, ClientSocket *cli_sock, int served, ParkReason reason)
+{
+    ConnRecord *record = ALLOC_STRUCT(ConnRecord);
+
+    if (!record)
+    {
+        connpark_note_close(park, cli_sock->transport.fd);
+        clientsocket_close(cli_sock);
+        return NULL;
+    }
+
+    record->park_ref = park;
+    timernode_init(&record->timer, connpark_on_expired, record);
+    outqueue_init(&record->outq);
+    record->fd = clientsocket_detach(cli_sock, &record->outq);
+    record->served = served;
+    record->reason = reason;
+
+    return record;
+}
+
+static bool connpark_is_listener(const ConnParking *park, const void *event_ptr)
+{
+    for (int i = 0; i < park->listener_count; i++)
+    {
+        if (park->listeners[i] == event_ptr)
+            return true;
+    }
+
+    return false;
+}
+
+/* ConnParking Funcs. */
+
+bool connpark_init(ConnParking *park, BlockedQueue *bqueue_ref, ThreadMetrics *metrics_ref, TraceRing *trace_ref)
+{
+    park->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    park->count = 0;
+    park->records.prev = &park->records;
+    park->records.next = &park->records;
+    park->bqueue_ref = bqueue_ref;
+    park->metrics_ref = metrics_ref;
+    park->trace_ref = trace_ref;
+    park->capture_ref = NULL;
+    park->listener_count = 0;
+    timerwheel_init(&park->timers, timing_now_ms(), CONNPARK_TIMER_TICK_MS);
+
+    bool lock_ok = pthread_mutex_init(&park->lock, NULL) == 0;
+
+    return park->epoll_fd != -1 && lock_ok;
+}
+
+void connpark_set_capture(ConnParking *park, RequestCapture *capture_ref)
+{
+    park->capture_ref = capture_ref;
+}
+
+void connpark_dispose(ConnParking *park)
+{
+    pthread_mutex_lock(&park->lock);
+
+    while (park->records.next != &park->records)
+    {
+        ConnRecord *record = park->records.next;
+
+        connpark_unlink(park, record);
+        connpark_free(record, true);
+    }
+
+    pthread_mutex_unlock(&park->lock);
+    pthread_mutex_destroy(&park->lock);
+
+    if (park->epoll_fd != -1)
+        close(park->epoll_fd);
+
+    park->epoll_fd = -1;
+}
+
+bool connpark_watch_listener(ConnParking *park, ServerSocket *svr_sock)
+{
+    struct epoll_event listen_event = {.events = EPOLLIN, .data.ptr = svr_sock};
+
+    if (park->listener_count >= CONNPARK_MAX_LISTENERS)
+        return false;
+
+    if (epoll_ctl(park->epoll_fd, EPOLL_CTL_ADD, svr_sock->fd, &listen_event) != 0)
+        return false;
+
+    park->listeners[park->listener_count] = svr_sock;
+    park->listener_count++;
+
+    return true;
+}
+
+bool connpark_pause_listener(ConnParking *park, ServerSocket *svr_sock, bool paused)
+{
+    struct epoll_event listen_event = {.events = paused ? 0 : EPOLLIN, .data.ptr = svr_sock};
+
+    return epoll_ctl(park->epoll_fd, EPOLL_CTL_MOD, svr_sock->fd, &listen_event) == 0;
+}
+
+bool connpark_put_draining(ConnParking *park, ClientSocket *cli_sock, int served, uint32_t timeout_ms, uint32_t idle_timeout_ms)
+{
+    ConnRecord *record = connpark_record_create(park, cli_sock, served, PARK_DRAINING);
+
+    if (!record)
+        return false;
+
+    record->timeout_ms = timeout_ms;
+    record->idle_timeout_ms = idle_timeout_ms;
+
+    return connpark_put(park, record);
+}
+
+bool connpark_put_idle(ConnParking *park, ClientSocket *cli_sock, int served, uint32_t idle_timeout_ms)
+{
+    ConnRecord *record = connpark_record_create(park, cli_sock, served, PARK_IDLE);
+
+    if (!record)
+        return false;
+
+    record->timeout_ms = idle_timeout_ms;
+    record->idle_timeout_ms = idle_timeout_ms;
+
+    return connpark_put(park, record);
+}
+
+int connpark_poll(ConnParking *park, int max_wait_ms, ServerSocket **ready_listeners, int *ready_count)
+{
+    struct epoll_event events[CONNPARK_MAX_EVENTS];
+    int wait_ms = max_wait_ms;
+
+    *ready_count = 0;
+
+    // Wake up in time for the next timer, which may be sooner than the caller's limit.
+    pthread_mutex_lock(&park->lock);
+    uint64_t next_expiry_ms = timerwheel_next_expiry(&park->timers);
+    pthread_mutex_unlock(&park->lock);
+
+    if (next_expiry_ms != TIMERWHEEL_NO_EXPIRY)
+    {
+        uint64_t now_ms = timing_now_ms();
+        int timer_wait_ms = (next_expiry_ms > now_ms) ? (int)(next_expiry_ms - now_ms) : 0;
+
+        if (wait_ms < 0 || timer_wait_ms < wait_ms)
+            wait_ms = timer_wait_ms;
+    }
+
+    int event_count = epoll_wait(park->epoll_fd, events, CONNPARK_MAX_EVENTS, wait_ms);
+
+    if (event_count < 0)
+    {
+        if (errno != EINTR)
+            return -1;
+
+        event_count = 0;
+    }
+
+    for (int i = 0; i < event_count; i++)
+    {
+        if (connpark_is_listener(park, events[i].data.ptr))
+        {
+            ready_listeners[*ready_count] = (ServerSocket *)events[i].data.ptr;
+            (*ready_count)++;
+        }
+        else
+            connpark_on_ready(park, (ConnRecord *)events[i].data.ptr, events[i].events);
+    }
+
+    pthread_mutex_lock(&park->lock);
+    timerwheel_advance(&park->timers, timing_now_ms());
+    pthread_mutex_unlock(&park->lock);
+
+    return event_count;
+}
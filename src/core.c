@@ -10,22 +10,268 @@
 
 #include "server/core.h"
 
+/* Helper Funcs. */
+
+/**
+ * @brief Built-in handler reporting the summed counters of every thread.
+ */
+static HandlerStatus server_core_handle_metrics(const HandlerContext *ctx, const BaseRequest *req, ResponseObj *res)
+{
+    (void)req;
+
+    char *metrics_text = handlerctx_alloc(ctx, METRICS_TEXT_BUFSIZE);
+
+    if (!metrics_text || !ctx->metrics_ref)
+        return HANDLE_GENERAL_ERR;
+
+    int text_len = metrics_board_render(ctx->metrics_ref, metrics_text, METRICS_TEXT_BUFSIZE);
+
+    if (text_len < 0)
+        return HANDLE_GENERAL_ERR;
+
+    resinfo_set_mime_type(res, TXT_PLAIN);
+    resinfo_set_content_length(res, text_len);
+    resinfo_set_body_payload(res, metrics_text);
+
+    return HANDLE_OK;
+}
+
+/**
+ * @brief Built-in handler replying with a dump of every thread's trace ring.
+ */
+static HandlerStatus server_core_handle_trace(const HandlerContext *ctx, const BaseRequest *req, ResponseObj *res)
+{
+    (void)req;
+
+    if (!ctx->trace_ref)
+        return HANDLE_GENERAL_ERR;
+
+    size_t dump_capacity = trace_board_dump_size(ctx->trace_ref);
+    char *dump_data = handlerctx_alloc(ctx, dump_capacity);
+
+    if (!dump_data)
+        return HANDLE_GENERAL_ERR;
+
+    long dump_len = trace_board_dump(ctx->trace_ref, dump_data, dump_capacity);
+
+    if (dump_len < 0)
+        return HANDLE_GENERAL_ERR;
+
+    resinfo_set_mime_type(res, APP_OCTET);
+    resinfo_set_content_length(res, (int)dump_len);
+    resinfo_set_body_payload(res, dump_data);
+
+    return HANDLE_OK;
+}
+
+/**
+ * @brief Fills the stats segment's snapshot on the publisher thread. Counters are read without locks, and the queue and parking locks are only held to copy a count.
+ */
+static void server_core_gather_stats(void *server_ref, StatsSnapshot *dst)
+{
+    ServerDriver *server = (ServerDriver *)server_ref;
+    ThreadMetrics total;
+
+    metrics_board_sum(&server->metrics, &total);
+
+    for (int i = 0; i < METRICS_METHOD_COUNT; i++)
+        dst->requests += metrics_load(&total.requests[i]);
+
+    for (int i = 0; i < METRICS_STATUS_COUNT; i++)
+        dst->responses[i / 100] += metrics_load(&total.responses[i]);
+
+    uint64_t accepts = metrics_load(&total.accepts);
+    uint64_t closes = metrics_load(&total.closes);
+
+    dst->bytes_in = metrics_load(&total.bytes_in);
+    dst->bytes_out = metrics_load(&total.bytes_out);
+    dst->accepts = accepts;
+    dst->active_connections = (accepts > closes) ? accepts - closes : 0;
+    dst->queue_full = metrics_load(&total.queue_full);
+    dst->parse_errors = metrics_load(&total.parse_errors);
+    dst->slab_acquires = metrics_load(&total.slab_acquires);
+    dst->slab_misses = metrics_load(&total.slab_misses);
+    dst->conditional_requests = metrics_load(&total.conditional_requests);
+    dst->not_modified = metrics_load(&total.responses[304 - METRICS_STATUS_MIN]);
+
+    pthread_mutex_lock(&server->task_queue.lock);
+    dst->queue_depth = server->task_queue.count;
+    dst->queue_capacity = server->task_queue.capacity;
+    pthread_mutex_unlock(&server->task_queue.lock);
+
+    pthread_mutex_lock(&server->parking.lock);
+    dst->parked_connections = server->parking.count;
+    pthread_mutex_unlock(&server->parking.lock);
+
+    dst->worker_count = (H1C_WORKER_COUNT < STATSEG_MAX_WORKERS) ? H1C_WORKER_COUNT : STATSEG_MAX_WORKERS;
+
+    for (uint32_t worker_i = 0; worker_i < dst->worker_count; worker_i++)
+    {
+        const ServerWorker *worker = &server->workers[worker_i];
+        StatsWorker *worker_stats = &dst->workers[worker_i];
+
+        strncpy(worker_stats->state, srvworker_state_name(srvworker_get_shown_state(worker)), STATSEG_STATE_SIZE - 1);
+        worker_stats->worker_id = (uint32_t)worker->wid;
+        worker_stats->bytes_out = metrics_load(&worker->metrics_ref->bytes_out);
+
+        for (int i = 0; i < METRICS_METHOD_COUNT; i++)
+            worker_stats->requests += metrics_load(&worker->metrics_ref->requests[i]);
+    }
+}
+
+/* ServerDriver Funcs. */
+
 bool server_core_init(ServerDriver *server, const char *host_name, const char *port, int backlog)
 {
     bool bqueue_is_ok = true;
+    bool pool_is_ok = true;
+    bool park_is_ok = true;
 
     // setup listening socket
-    serversocket_init(&server->entry_socket, host_name, port, backlog);
+    serversocket_init(&server->entry_sockets[0], host_name, port, backlog);
+    server->listener_count = 1;
+    server->listen_backlog = 0;
+    server->listen_opts.defer_accept_secs = H1C_DEFER_ACCEPT;
+    server->listen_opts.fastopen_qlen = H1C_TCP_FASTOPEN;
+    server->listen_opts.nodelay = H1C_TCP_NODELAY;
 
     // setup synchronized queue
-    bqueue_is_ok = bqueue_init(&server->task_queue, H1C_DEFAULT_BACKLOG);
+    bqueue_is_ok = bqueue_init(&server->task_queue, H1C_TASK_QUEUE_SIZE);
+
+    // setup reusable connection buffers
+    pool_is_ok = slabpool_init(&server->buffer_pool, H1C_SLAB_COUNT, SRVWORKER_SLAB_SIZE);
+
+    // setup counters, where the producer's come first
+    metrics_board_init(&server->metrics, server->thread_metrics, H1C_TOTAL_THREADS);
+
+    // setup trace rings in the same order
+    trace_board_init(&server->trace, server->trace_rings, H1C_TOTAL_THREADS);
+
+    // setup parking set for slow clients, which the producer polls
+    park_is_ok = connpark_init(&server->parking, &server->task_queue, &server->thread_metrics[0], &server->trace_rings[0]);
 
     // setup blank route-handler map
     rtemap_init(&server->router);
+
+    // setup default keep-alive limits
+    server->conn_policy.keepalive_timeout = H1C_KEEPALIVE_TIMEOUT;
+    server->conn_policy.keepalive_max = H1C_KEEPALIVE_MAX;
+    server->conn_policy.header_timeout = H1C_HEADER_TIMEOUT;
+    server->conn_policy.body_timeout = H1C_BODY_TIMEOUT;
+    server->conn_policy.send_timeout = H1C_SEND_TIMEOUT;
+    server->conn_policy.max_pending = H1C_MAX_PENDING_OUTPUT;
+    server->conn_policy.zerocopy_min = H1C_ZEROCOPY_MIN;
+
+    // access logging is opt-in
+    server->access_log_on = false;
+
+    // the stats segment is published once running
+    server->stats_on = false;
+
+    // capturing requests is opt-in
+    server->capture_on = false;
+
+    // no threads run until server_core_run
+    server->producer_started = false;
     
     /// @note HandlerContext and concurrency utilities may be setup afterward with other helper functions.
 
-    return bqueue_is_ok;
+    return bqueue_is_ok && pool_is_ok && park_is_ok;
+}
+
+bool server_core_add_listener(ServerDriver *server, const char *address, int backlog)
+{
+    if (server->listener_count >= H1C_MAX_LISTENERS)
+        return false;
+
+    if (!serversocket_init_address(&server->entry_sockets[server->listener_count], address, backlog))
+        return false;
+
+    server->listener_count++;
+
+    return true;
+}
+
+bool server_core_set_listen_options(ServerDriver *server, int backlog, int defer_accept_secs, int fastopen_qlen, bool nodelay)
+{
+    if (backlog < 0 || defer_accept_secs < 0 || fastopen_qlen < 0)
+        return false;
+
+    server->listen_backlog = backlog;
+    server->listen_opts.defer_accept_secs = defer_accept_secs;
+    server->listen_opts.fastopen_qlen = fastopen_qlen;
+    server->listen_opts.nodelay = nodelay;
+
+    return true;
+}
+
+bool server_core_set_keepalive(ServerDriver *server, int timeout, int max_requests)
+{
+    if (timeout <= 0 || max_requests <= 0)
+        return false;
+
+    server->conn_policy.keepalive_timeout = timeout;
+    server->conn_policy.keepalive_max = max_requests;
+
+    return true;
+}
+
+bool server_core_set_timeouts(ServerDriver *server, int header_timeout, int body_timeout, int send_timeout)
+{
+    if (header_timeout <= 0 || body_timeout <= 0 || send_timeout <= 0)
+        return false;
+
+    server->conn_policy.header_timeout = header_timeout;
+    server->conn_policy.body_timeout = body_timeout;
+    server->conn_policy.send_timeout = send_timeout;
+
+    return true;
+}
+
+bool server_core_set_max_pending(ServerDriver *server, size_t max_pending)
+{
+    if (max_pending == 0)
+        return false;
+
+    server->conn_policy.max_pending = max_pending;
+
+    return true;
+}
+
+bool server_core_set_zerocopy(ServerDriver *server, size_t min_len)
+{
+    if (min_len > 0 && !OUTQUEUE_HAS_ZEROCOPY)
+        return false;
+
+    server->conn_policy.zerocopy_min = min_len;
+
+    return true;
+}
+
+bool server_core_set_access_log(ServerDriver *server, const char *path)
+{
+    if (server->access_log_on)
+        return false;
+
+    server->access_log_on = accesslog_init(&server->access_log, path, H1C_WORKER_COUNT);
+
+    return server->access_log_on;
+}
+
+bool server_core_set_capture(ServerDriver *server, const char *path)
+{
+    if (server->capture_on)
+        return false;
+
+    server->capture_on = capture_init(&server->capture, path);
+
+    return server->capture_on;
+}
+
+void server_core_reopen_logs(ServerDriver *server)
+{
+    if (server->access_log_on)
+        accesslog_request_reopen(&server->access_log);
 }
 
 bool server_core_setup_hdctx(ServerDriver *server, const char *file_names[], uint16_t file_count)
@@ -43,27 +289,110 @@ bool server_core_put_handler(ServerDriver *server, const char *path, HttpMethod
     return rtemap_put(&server->router, handler_node);
 }
 
-void server_core_setup_thrd_states(ServerDriver *server)
+bool server_core_put_streaming_handler(ServerDriver *server, const char *path, HttpMethod method, MimeType mime, HandlerFunc callback)
+{
+    RoutedNode *handler_node = rtdnode_create(path, method, mime, callback);
+
+    if (!handler_node)
+        return false;
+
+    h1chandler_set_streams_body(&handler_node->handler, true);
+
+    return rtemap_put(&server->router, handler_node);
+}
+
+bool server_core_put_metrics_handler(ServerDriver *server, const char *path)
 {
+    return server_core_put_handler(server, path, GET, ANY_ANY, server_core_handle_metrics);
+}
+
+bool server_core_put_trace_handler(ServerDriver *server, const char *path)
+{
+    return server_core_put_handler(server, path, GET, ANY_ANY, server_core_handle_trace);
+}
+
+bool server_core_dump_trace(const ServerDriver *server, const char *path)
+{
+    return trace_board_dump_file(&server->trace, path);
+}
+
+bool server_core_setup_thrd_states(ServerDriver *server)
+{
+    bool workers_ok = true;
+
+    // apply accept tuning to listeners, however they were added
+    for (int i = 0; i < server->listener_count; i++)
+    {
+        serversocket_set_options(&server->entry_sockets[i], &server->listen_opts);
+
+        if (server->listen_backlog > 0)
+            server->entry_sockets[i].backlog = server->listen_backlog;
+    }
+
     // setup producer and workers' state
-    lstworker_init(&server->producer_obj, &server->entry_socket, &server->task_queue);
+    handlerctx_set_metrics(&server->ctx, &server->metrics);
+    handlerctx_set_trace(&server->ctx, &server->trace);
+    lstworker_init(&server->producer_obj, server->entry_sockets, server->listener_count, &server->task_queue, &server->parking, &server->thread_metrics[0], &server->trace_rings[0]);
     
     for (int i = 0; i < H1C_WORKER_COUNT; i++)
     {
-        srvworker_init(&server->workers[i], i + 1, &server->router, &server->ctx, &server->task_queue, H1C_VERSION_STRING);
+        workers_ok = srvworker_init(&server->workers[i], i + 1, &server->router, &server->ctx, &server->task_queue, &server->buffer_pool, &server->parking, &server->thread_metrics[i + 1], &server->trace_rings[i + 1], &server->conn_policy, H1C_VERSION_STRING) && workers_ok;
+
+        if (server->access_log_on)
+            srvworker_set_access_log(&server->workers[i], accesslog_get_ring(&server->access_log, i));
+
+        if (server->capture_on)
+            srvworker_set_capture(&server->workers[i], &server->capture);
     }
+
+    if (server->capture_on)
+        connpark_set_capture(&server->parking, &server->capture);
+
+    return workers_ok;
+}
+
+bool server_core_start_stats(ServerDriver *server)
+{
+    char segment_name[STATSEG_NAME_SIZE];
+
+    snprintf(segment_name, STATSEG_NAME_SIZE, STATSEG_NAME_FMT, (int)getpid());
+
+    if (!statspub_init(&server->stats, segment_name, server_core_gather_stats, server))
+        return false;
+
+    if (!statspub_start(&server->stats))
+    {
+        statspub_dispose(&server->stats);
+        return false;
+    }
+
+    server->stats_on = true;
+
+    return true;
 }
 
 int server_core_run(ServerDriver *server)
 {
     // Initialize all producer & worker state...
     int started_worker_count = 0;
-    server_core_setup_thrd_states(server);
+
+    if (!server_core_setup_thrd_states(server))
+        return started_worker_count;
+
+    // Start the access log's flusher before anything it would have to catch up on.
+    if (server->access_log_on && !accesslog_start(&server->access_log))
+        return started_worker_count;
+
+    // Live stats are only for observing, so the server runs on without them.
+    if (!server_core_start_stats(server))
+        fprintf(stdout, "%s log: Stats segment unavailable, h1ctop will not see this server.\n", H1C_VERSION_STRING);
 
     // Try starting producer thread first since the workers require tasks before doing work...
     if (pthread_create(&server->thread_ids[0], NULL, lstworker_run, &server->producer_obj) != 0)
         return started_worker_count;
 
+    server->producer_started = true;
+
     // Try starting workers since tasks are possibly available or incoming...
     for (int pthrd_i = 1; pthrd_i < H1C_TOTAL_THREADS; pthrd_i++)
     {
@@ -88,21 +417,83 @@ void server_core_join(ServerDriver *server, int wthrd_count)
     }
 }
 
+void server_core_merge_latency(const ServerDriver *server, ServerWorkerStage stage, LatencyHistogram *dst)
+{
+    histogram_init(dst);
+
+    for (int worker_i = 0; worker_i < H1C_WORKER_COUNT; worker_i++)
+        srvworker_merge_latency(&server->workers[worker_i], stage, dst);
+}
+
+void server_core_report_latency(const ServerDriver *server, FILE *out)
+{
+    LatencyHistogram merged;
+    double ticks_per_us = timing_ticks_per_ns() * 1000.0;
+
+    fprintf(out, "%s latency (us):\n%-8s %10s %10s %10s %10s %10s %10s %10s\n", H1C_VERSION_STRING,
+        "stage", "count", "mean", "p50", "p90", "p99", "p99.9", "max");
+
+    for (int stage = 0; stage < SWORKER_STAGE_COUNT; stage++)
+    {
+        server_core_merge_latency(server, stage, &merged);
+
+        fprintf(out, "%-8s %10lu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", srvworker_stage_name(stage),
+            (unsigned long)histogram_count(&merged), histogram_mean(&merged) / ticks_per_us,
+            histogram_percentile(&merged, 50.0) / ticks_per_us, histogram_percentile(&merged, 90.0) / ticks_per_us,
+            histogram_percentile(&merged, 99.0) / ticks_per_us, histogram_percentile(&merged, 99.9) / ticks_per_us,
+            histogram_max(&merged) / ticks_per_us);
+    }
+}
+
+void server_core_stop(ServerDriver *server, int wthrd_count)
+{
+    // Stop accepting first, so no new tasks arrive for workers that are leaving.
+    lstworker_stop(&server->producer_obj);
+
+    if (server->producer_started)
+        pthread_join(server->thread_ids[0], NULL);
+
+    server->producer_started = false;
+
+    // Wake up workers... they will stop on realization that they must abort.
+    fprintf(stdout, "%s log: Signaling workers to quit.\n", H1C_VERSION_STRING);
+
+    for (int worker_i = 0; worker_i < wthrd_count; worker_i++)
+        srvworker_stop(&server->workers[worker_i]);
+
+    server_core_join(server, wthrd_count);
+}
+
 void server_core_cleanup(ServerDriver *server, int wthrd_count)
 {
-    // Stop and dispose producer and workers...
+    // Stop publishing first, since gathering stats locks the task queue and parking set.
+    if (server->stats_on)
+        statspub_dispose(&server->stats);
+
+    server->stats_on = false;
+
+    // Flush what workers logged and captured last. They are joined by now, so nothing writes to either anymore.
+    if (server->access_log_on)
+        accesslog_dispose(&server->access_log);
+
+    server->access_log_on = false;
+
+    if (server->capture_on)
+        capture_dispose(&server->capture);
+
+    server->capture_on = false;
+
+    // Dispose producer and workers...
     lstworker_end(&server->producer_obj);
 
     for (int worker_i = 0; worker_i < wthrd_count; worker_i++)
         srvworker_dispose(&server->workers[worker_i]);
 
-    // Wake up workers... they will stop on realization that they must abort.
-    fprintf(stdout, "%s log: Signaling workers to quit.\n", H1C_VERSION_STRING);
-    pthread_cond_broadcast(&server->task_queue.signaler);
-
     // Dispose other memory / resources...
     fprintf(stdout, "%s log: Disposing routes and handlers.\n", H1C_VERSION_STRING);
     bqueue_destroy(&server->task_queue);
+    connpark_dispose(&server->parking);
     rtemap_dispose(&server->router);
     handlerctx_dispose(&server->ctx);
+    slabpool_dispose(&server->buffer_pool);
 }
@@ -10,12 +10,185 @@
 
 #include "h1c/h1scanner.h"
 
-void h1scanner_init(HttpScanner *scanner, ClientSocket *cli_sock)
+/* Static Helpers */
+
+/**
+ * @brief Sends the interim reply an "Expect: 100-continue" client waits for, just before its body is first read.
+ */
+static bool h1scanner_send_continue(HttpScanner *scanner)
+{
+    struct iovec continue_iov;
+
+    if (!scanner->continue_pending)
+        return true;
+
+    scanner->continue_pending = false;
+    continue_iov.iov_base = HTTP_INTERIM_CONTINUE;
+    continue_iov.iov_len = strlen(HTTP_INTERIM_CONTINUE);
+
+    return clientsocket_write_iov(scanner->cli_sock_ref, &continue_iov, 1);
+}
+
+/**
+ * @brief Reads the line after a chunk's data, which must be empty.
+ */
+static bool h1scanner_eat_chunk_crlf(HttpScanner *scanner)
+{
+    buffer_clear(&scanner->header_buf);
+
+    if (!clientsocket_read_line(scanner->cli_sock_ref, HTTP_1X_LF, &scanner->header_buf))
+        return false;
+
+    scanner->chunk_crlf_pending = false;
+
+    return scanner->header_buf.data[0] == '\0';
+}
+
+/**
+ * @brief Reads trailer lines up to the blank line ending a chunked body. The header buffer bounds each line and H1SCANNER_MAX_TRAILERS bounds their count.
+ */
+static bool h1scanner_eat_trailers(HttpScanner *scanner)
+{
+    while (true)
+    {
+        buffer_clear(&scanner->header_buf);
+
+        if (!clientsocket_read_line(scanner->cli_sock_ref, HTTP_1X_LF, &scanner->header_buf))
+            return false;
+
+        if (scanner->header_buf.data[0] == '\0')
+            return true;
+
+        if (scanner->trailer_count >= H1SCANNER_MAX_TRAILERS)
+            return false;
+
+        char *tname_str = buffer_read_delim(&scanner->header_buf, HTTP_1X_COLON, scanner->arena_ref);
+        char *tvalue_str = buffer_read_delim(&scanner->header_buf, '\0', scanner->arena_ref);
+
+        if (!tname_str || !tvalue_str || tname_str[0] == '\0')
+            return false;
+
+        while (*tvalue_str == ' ' || *tvalue_str == '\t')
+            tvalue_str++;
+
+        scanner->trailers[scanner->trailer_count].name = tname_str;
+        scanner->trailers[scanner->trailer_count].value = tvalue_str;
+        scanner->trailer_count++;
+    }
+}
+
+/**
+ * @brief Starts the next chunk once the current one is read. The zero-sized last chunk ends the body after its trailers.
+ * @returns false on malformed chunk framing.
+ */
+static bool h1scanner_next_chunk(HttpScanner *scanner)
+{
+    size_t chunk_size = 0;
+
+    if (scanner->chunk_crlf_pending && !h1scanner_eat_chunk_crlf(scanner))
+        return false;
+
+    buffer_clear(&scanner->header_buf);
+
+    if (!clientsocket_read_line(scanner->cli_sock_ref, HTTP_1X_LF, &scanner->header_buf))
+        return false;
+
+    if (!chunk_size_parse(scanner->header_buf.data, &chunk_size))
+        return false;
+
+    buffer_clear(&scanner->header_buf);
+
+    if (chunk_size == 0)
+    {
+        if (!h1scanner_eat_trailers(scanner))
+            return false;
+
+        scanner->state = STOP;
+        return true;
+    }
+
+    scanner->body_left = chunk_size;
+    scanner->chunk_crlf_pending = true;
+
+    return true;
+}
+
+/**
+ * @brief Buffers a chunked body of unknown length by doubling an arena block. The outgrown blocks are dropped with the arena's reset.
+ */
+static HttpScannerState h1scanner_eat_chunked_blob(HttpScanner *scanner, BaseRequest *req_ref)
+{
+    size_t blob_capacity = MIN_BUFFER_SIZE;
+    size_t blob_len = 0;
+    char *blob = arena_alloc(scanner->arena_ref, blob_capacity + 1);
+    const char *chunk = NULL;
+    ssize_t chunk_len = 0;
+
+    if (!blob)
+        return ERROR;
+
+    while ((chunk_len = h1scanner_read_body(scanner, &chunk)) > 0)
+    {
+        if (blob_len + chunk_len > H1SCANNER_MAX_BUFFERED_BODY)
+        {
+            scanner->body_too_large = true;
+            return ERROR;
+        }
+
+        if (blob_len + chunk_len > blob_capacity)
+        {
+            while (blob_capacity < blob_len + chunk_len)
+                blob_capacity *= 2;
+
+            char *grown_blob = arena_alloc(scanner->arena_ref, blob_capacity + 1);
+
+            if (!grown_blob)
+                return ERROR;
+
+            memcpy(grown_blob, blob, blob_len);
+            blob = grown_blob;
+        }
+
+        memcpy(blob + blob_len, chunk, chunk_len);
+        blob_len += chunk_len;
+    }
+
+    if (chunk_len < 0)
+        return ERROR;
+
+    blob[blob_len] = '\0';
+    req_ref->body_blob = blob;
+    req_ref->content_len = blob_len;
+
+    return STOP;
+}
+
+/* HttpScanner Funcs. */
+
+void h1scanner_init(HttpScanner *scanner, ClientSocket *cli_sock, int worker_id, Arena *arena, char *buffer_mem)
 {
     scanner->state = START;
     scanner->cli_sock_ref = cli_sock;
-    buffer_init(&scanner->header_buf, MIN_BUFFER_SIZE);
-    buffer_init(&scanner->body_buf, MIN_BUFFER_SIZE);
+    scanner->worker_id = worker_id;
+    scanner->arena_ref = arena;
+    scanner->framing = BODY_NONE;
+    scanner->body_left = 0;
+    scanner->chunk_crlf_pending = false;
+    scanner->continue_pending = false;
+    scanner->body_too_large = false;
+    scanner->trailer_count = 0;
+
+    if (buffer_mem != NULL)
+    {
+        buffer_init_borrowed(&scanner->header_buf, buffer_mem, MIN_BUFFER_SIZE);
+        buffer_init_borrowed(&scanner->body_buf, buffer_mem + MIN_BUFFER_SIZE, MIN_BUFFER_SIZE);
+    }
+    else
+    {
+        buffer_init(&scanner->header_buf, MIN_BUFFER_SIZE);
+        buffer_init(&scanner->body_buf, MIN_BUFFER_SIZE);
+    }
+
     scanner->buffers_ok = scanner->header_buf.capacity > 0 && scanner->body_buf.capacity > 0;
 }
 
@@ -23,6 +196,7 @@ void h1scanner_dispose(HttpScanner *scanner)
 {
     scanner->state = STOP;
     scanner->cli_sock_ref = NULL; // NOTE: Unbind the client socket reference so that accidental usage post-close is impossible.
+    scanner->arena_ref = NULL;
     buffer_destroy(&scanner->header_buf);
     buffer_destroy(&scanner->body_buf);
     scanner->buffers_ok = false;
@@ -31,6 +205,12 @@ void h1scanner_dispose(HttpScanner *scanner)
 void h1scanner_reset(HttpScanner *scanner)
 {
     scanner->state = START;
+    scanner->framing = BODY_NONE;
+    scanner->body_left = 0;
+    scanner->chunk_crlf_pending = false;
+    scanner->continue_pending = false;
+    scanner->body_too_large = false;
+    scanner->trailer_count = 0;
     buffer_clear(&scanner->header_buf);
     buffer_clear(&scanner->body_buf);
     scanner->buffers_ok = true;
@@ -69,7 +249,7 @@ HttpScannerState h1scanner_url(HttpScanner *scanner, BaseRequest *req_ref)
     if (!clientsocket_read_line(scanner->cli_sock_ref, HTTP_1X_SP, &scanner->header_buf))
         return ERROR;
     
-    char *url_str = buffer_read_delim(&scanner->header_buf, '\0');
+    char *url_str = buffer_read_delim(&scanner->header_buf, '\0', scanner->arena_ref);
     req_ref->path_str = url_str;
     buffer_clear(&scanner->header_buf);
     
@@ -90,6 +270,9 @@ HttpScannerState h1scanner_schema(HttpScanner *scanner, BaseRequest *req_ref)
     else
         req_ref->schema_id = HTTP_SCHEMA_UNKNOWN;
 
+    // Persistence defaults by schema until a Connection header says otherwise.
+    req_ref->keep_connection = req_ref->schema_id == HTTP_SCHEMA_1_1;
+
     buffer_clear(&scanner->header_buf);
 
     return EAT_HEADER;
@@ -102,17 +285,24 @@ HttpScannerState h1scanner_header(HttpScanner *scanner, BaseRequest *req_ref)
         return ERROR;
 
     // 2. Check for empty line in case of transition to reading body...
-    int line_len = strlen(scanner->header_buf.data);
+    size_t line_len = strlen(scanner->header_buf.data);
 
-    if (line_len == 0 && req_ref->content_len > 0)
+    if (line_len == 0 && scanner->framing == BODY_CHUNKED)
         return EAT_BLOB;
-    
-    if (line_len == 0 && req_ref->content_len <= 0)
-        return STOP;
+
+    if (line_len == 0)
+    {
+        scanner->body_left = req_ref->content_len;
+        return (req_ref->content_len > 0) ? EAT_BLOB : STOP;
+    }
 
     // 3. Otherwise, process header line if recognized.
-    char *hname_str = buffer_read_delim(&scanner->header_buf, HTTP_1X_SP);
-    char *hvalue_str = buffer_read_delim(&scanner->header_buf, '\0');
+    char *hname_str = buffer_read_delim(&scanner->header_buf, HTTP_1X_SP, scanner->arena_ref);
+    char *hvalue_str = buffer_read_delim(&scanner->header_buf, '\0', scanner->arena_ref);
+
+    if (!hname_str || !hvalue_str)
+        return ERROR;
+
     // printf("hdr %s = %s\n", hname_str, hvalue_str); // debug!
 
     if (strcmp(hname_str, HTTP_HEADER_HOST) == 0)
@@ -121,7 +311,11 @@ HttpScannerState h1scanner_header(HttpScanner *scanner, BaseRequest *req_ref)
     }
     else if (strcmp(hname_str, HTTP_HEADER_CONNECTION) == 0)
     {
-        req_ref->keep_connection = strcmp(hvalue_str, HTTP_HVALUE_CONN_ALIVE) == 0;
+        // HTTP/1.1 persists unless the client says close, but HTTP/1.0 persists only if it opts in.
+        if (header_list_has_token(hvalue_str, HTTP_HVALUE_CONN_CLOSE))
+            req_ref->keep_connection = false;
+        else if (header_list_has_token(hvalue_str, HTTP_HVALUE_CONN_ALIVE))
+            req_ref->keep_connection = req_ref->schema_id != HTTP_SCHEMA_UNKNOWN;
     }
     else if (strcmp(hname_str, HTTP_HEADER_CTYPE) == 0)
     {
@@ -129,14 +323,47 @@ HttpScannerState h1scanner_header(HttpScanner *scanner, BaseRequest *req_ref)
     }
     else if (strcmp(hname_str, HTTP_HEADER_CLEN) == 0)
     {
-        req_ref->content_len = atoi(hvalue_str);
+        // A body framed both ways is a request smuggling risk, so it is refused.
+        if (scanner->framing == BODY_CHUNKED || !content_length_parse(hvalue_str, &req_ref->content_len))
+            return ERROR;
+
+        scanner->framing = BODY_LENGTH;
     }
-    else
+    else if (strcmp(hname_str, HTTP_HEADER_TRANSFER_ENCODING) == 0)
     {
-        free(hvalue_str); // NOTE: dispose ignored headers to avoid leaks!
+        // Only plain chunked framing is decoded, as other transfer codings would need decompression.
+        if (scanner->framing == BODY_LENGTH || strcasecmp(hvalue_str, HTTP_HVALUE_CHUNKED) != 0)
+            return ERROR;
+
+        scanner->framing = BODY_CHUNKED;
+        req_ref->content_len = 0;
+    }
+    else if (strcmp(hname_str, HTTP_HEADER_EXPECT) == 0)
+    {
+        scanner->continue_pending = req_ref->schema_id == HTTP_SCHEMA_1_1 && strcasecmp(hvalue_str, HTTP_HVALUE_EXPECT_CONTINUE) == 0;
+    }
+    else if (strcmp(hname_str, HTTP_HEADER_ACCEPT_ENCODING) == 0)
+    {
+        req_ref->accept_encodings = accept_encoding_to_flags(hvalue_str);
+    }
+    else if (strcmp(hname_str, HTTP_HEADER_IF_NONE_MATCH) == 0)
+    {
+        req_ref->if_none_match_hstr = hvalue_str; // NOTE: a repeated header replaces the older value.
+    }
+    else if (strcmp(hname_str, HTTP_HEADER_RANGE) == 0)
+    {
+        req_ref->range_hstr = hvalue_str;
+    }
+    else if (strcmp(hname_str, HTTP_HEADER_IF_RANGE) == 0)
+    {
+        req_ref->if_range_hstr = hvalue_str;
+    }
+    else if (strcmp(hname_str, HTTP_HEADER_IF_MODIFIED_SINCE) == 0)
+    {
+        req_ref->if_modified_since = http_date_to_time(hvalue_str);
     }
 
-    free(hname_str);
+    /// @note Ignored header strings need no free since the worker resets its arena after each request.
     buffer_clear(&scanner->header_buf);
 
     return EAT_HEADER;
@@ -144,31 +371,123 @@ HttpScannerState h1scanner_header(HttpScanner *scanner, BaseRequest *req_ref)
 
 HttpScannerState h1scanner_eat_blob(HttpScanner *scanner, BaseRequest *req_ref)
 {
-    bool buffer_ok = true;
-    int blob_size = req_ref->content_len;
+    if (scanner->framing == BODY_CHUNKED)
+        return h1scanner_eat_chunked_blob(scanner, req_ref);
 
-    if (blob_size > scanner->body_buf.capacity)
+    if (scanner->body_left > H1SCANNER_MAX_BUFFERED_BODY)
     {
-        buffer_ok = buffer_grow(&scanner->body_buf, blob_size + 1);
-        buffer_clear(&scanner->body_buf);
+        scanner->body_too_large = true;
+        return ERROR;
     }
 
-    if (!buffer_ok)
-        return ERROR;
+    size_t blob_size = scanner->body_left;
+    char *blob = arena_alloc(scanner->arena_ref, blob_size + 1);
+    char *blob_cursor = blob;
+    ssize_t temp_rc = 0;
 
-    if (!clientsocket_read_blob(scanner->cli_sock_ref, blob_size, &scanner->body_buf))
+    if (!blob || !h1scanner_send_continue(scanner))
         return ERROR;
 
-    req_ref->body_blob = buffer_get_span(&scanner->body_buf, blob_size);
+    // Receive straight into the arena block since the body buffer is only one chunk long.
+    while (scanner->body_left > 0)
+    {
+        temp_rc = clientsocket_read_some(scanner->cli_sock_ref, blob_cursor, scanner->body_left);
 
-    buffer_clear(&scanner->body_buf);
+        if (temp_rc <= 0)
+            return ERROR;
+
+        blob_cursor += temp_rc;
+        scanner->body_left -= temp_rc;
+    }
+
+    blob[blob_size] = '\0';
+    req_ref->body_blob = blob;
 
     return STOP;
 }
 
+bool h1scanner_has_body(const HttpScanner *scanner)
+{
+    return scanner->state == EAT_BLOB;
+}
+
+ssize_t h1scanner_read_body(HttpScanner *scanner, const char **chunk_ref)
+{
+    if (scanner->state != EAT_BLOB)
+        return (scanner->state == ERROR) ? -1 : 0;
+
+    if (!h1scanner_send_continue(scanner))
+    {
+        scanner->state = ERROR;
+        return -1;
+    }
+
+    if (scanner->framing == BODY_CHUNKED && scanner->body_left == 0 && !h1scanner_next_chunk(scanner))
+    {
+        scanner->state = ERROR;
+        return -1;
+    }
+
+    if (scanner->body_left == 0)
+    {
+        scanner->state = STOP;
+        return 0;
+    }
+
+    Buffer *chunk_buf = &scanner->body_buf;
+    size_t chunk_size = (scanner->body_left < chunk_buf->capacity) ? scanner->body_left : chunk_buf->capacity;
+    ssize_t temp_rc = clientsocket_read_some(scanner->cli_sock_ref, chunk_buf->data, chunk_size);
+
+    if (temp_rc <= 0)
+    {
+        scanner->state = ERROR;
+        return -1;
+    }
+
+    scanner->body_left -= temp_rc;
+    *chunk_ref = chunk_buf->data;
+
+    return temp_rc;
+}
+
+const char *h1scanner_get_trailer(const HttpScanner *scanner, const char *name)
+{
+    for (int i = 0; i < scanner->trailer_count; i++)
+    {
+        if (strcasecmp(scanner->trailers[i].name, name) == 0)
+            return scanner->trailers[i].value;
+    }
+
+    return NULL;
+}
+
+bool h1scanner_skip_body(HttpScanner *scanner)
+{
+    const char *ignored_chunk = NULL;
+    ssize_t temp_rc = 0;
+    size_t skipped_len = 0;
+
+    if (scanner->state == ERROR)
+        return false;
+
+    // A client still waiting for "100 Continue" has not sent the body, so closing beats inviting an unwanted upload.
+    if (scanner->continue_pending || scanner->body_left > H1SCANNER_MAX_SKIP_SIZE)
+        return false;
+
+    // Chunked bodies have no known length, so the limit is checked while skipping too.
+    do
+    {
+        temp_rc = h1scanner_read_body(scanner, &ignored_chunk);
+        skipped_len += (temp_rc > 0) ? temp_rc : 0;
+    } while (temp_rc > 0 && skipped_len <= H1SCANNER_MAX_SKIP_SIZE);
+
+    return temp_rc == 0;
+}
+
 bool h1scanner_read_reqinfo(HttpScanner *scanner, BaseRequest *base_req_ref)
 {
-    while (scanner->state != STOP && scanner->state != ERROR)
+    // The loop stops before the body, so the worker can pick buffering or streaming once it knows the handler.
+    while (scanner->state != STOP && scanner->state != ERROR && scanner->state != EAT_BLOB)
     {
         HttpScannerState state_view = scanner->state; 
         if (state_view == START) scanner->state = EAT_METHOD;
@@ -176,9 +495,10 @@ bool h1scanner_read_reqinfo(HttpScanner *scanner, BaseRequest *base_req_ref)
         else if (state_view == EAT_URL) scanner->state = h1scanner_url(scanner, base_req_ref);
         else if (state_view == EAT_SCHEMA) scanner->state = h1scanner_schema(scanner, base_req_ref);
         else if (state_view == EAT_HEADER) scanner->state = h1scanner_header(scanner, base_req_ref);
-        else if (state_view == EAT_BLOB) scanner->state = h1scanner_eat_blob(scanner, base_req_ref);
         else; // Ignore invalid states or STOP to prevent bad flow control.
     }
 
+    H1C_PROBE5(request__parsed, scanner->worker_id, scanner->cli_sock_ref->transport.fd, base_req_ref->method_id, scanner->cli_sock_ref->bytes_in, scanner->state != ERROR);
+
     return scanner->state != ERROR;
 }
@@ -10,10 +10,107 @@
 
 #include "h1c/h1writer.h"
 
-void h1writer_init(ReplyWriter *writer, ClientSocket *cli_sock_ref)
+/* Helper Funcs. */
+
+#define MULTIPART_CLOSE_FMT "\r\n--%s--\r\n"
+#define CHUNK_SIZE_LINE_FMT "%zx\r\n"
+#define CHUNK_DATA_END "\r\n"
+#define CHUNK_LAST "0\r\n\r\n"
+
+static const char *h1writer_mime_str(MimeType mime_type)
+{
+    if (mime_type == TXT_HTML)
+        return MIME_TXT_HTML;
+    else if (mime_type == TXT_CSS)
+        return MIME_TXT_CSS;
+    else if (mime_type == TXT_JS)
+        return MIME_TXT_JS;
+    else if (mime_type == APP_OCTET)
+        return MIME_APP_OCTET;
+
+    return MIME_TXT_PLAIN;
+}
+
+static int h1writer_format_part_header(char *dst, size_t dst_size, const ResponseObj *resinfo, const ByteRange *range)
+{
+    return snprintf(dst, dst_size, "\r\n--%s\r\n%s %s\r\n%s %s %i-%i/%i\r\n\r\n",
+        MIME_BYTERANGES_BOUNDARY,
+        HTTP_HEADER_CTYPE, h1writer_mime_str(resinfo->mime_type),
+        HTTP_HEADER_CONTENT_RANGE, HTTP_HVALUE_RANGES_BYTES, range->first, range->last, resinfo->content_len);
+}
+
+/**
+ * @brief Sums the segment lengths of a reply.
+ */
+static size_t h1writer_iov_bytes(const struct iovec *iov, int iov_count)
+{
+    size_t total = 0;
+
+    for (int i = 0; i < iov_count; i++)
+        total += iov[i].iov_len;
+
+    return total;
+}
+
+/**
+ * @brief Sends every segment of a whole reply, then fires its response__written probe.
+ */
+static bool h1writer_send_reply_iov(ReplyWriter *writer, const ResponseObj *resinfo, struct iovec *reply_iov, int iov_count, uint32_t shared_mask)
+{
+    size_t reply_bytes = h1writer_iov_bytes(reply_iov, iov_count); // counted first, since sending may advance the segments
+    bool write_ok = clientsocket_write_iov_shared(writer->cli_sock_ref, reply_iov, iov_count, shared_mask);
+
+    H1C_PROBE5(response__written, writer->worker_id, writer->cli_sock_ref->transport.fd, resinfo->status_code, reply_bytes, write_ok);
+
+    return write_ok;
+}
+
+/**
+ * @brief Gets the real count of payload bytes to send, which differs from the full length for 206 and 416 replies.
+ */
+static int h1writer_payload_length(const ResponseObj *resinfo)
+{
+    int payload_len = 0;
+
+    if (resinfo->range_unsatisfied)
+        return payload_len;
+
+    if (resinfo->range_count == 0)
+        return resinfo->content_len;
+
+    if (resinfo->range_count == 1)
+        return resinfo->ranges[0].last - resinfo->ranges[0].first + 1;
+
+    // Size each multipart part header with a dry-run format since none are written yet.
+    for (int i = 0; i < resinfo->range_count; i++)
+    {
+        const ByteRange *range_ref = &resinfo->ranges[i];
+
+        payload_len += h1writer_format_part_header(NULL, 0, resinfo, range_ref);
+        payload_len += range_ref->last - range_ref->first + 1;
+    }
+
+    payload_len += snprintf(NULL, 0, MULTIPART_CLOSE_FMT, MIME_BYTERANGES_BOUNDARY);
+
+    return payload_len;
+}
+
+/* ReplyWriter Funcs */
+
+void h1writer_init(ReplyWriter *writer, ClientSocket *cli_sock_ref, int worker_id, char *buffer_mem)
 {
     writer->cli_sock_ref = cli_sock_ref;
-    buffer_init(&writer->reply_buf, DEFAULT_REPLY_BUFSIZE);
+    writer->worker_id = worker_id;
+    writer->streaming = false;
+    writer->stream_chunked = false;
+    writer->stream_discard = false;
+    writer->stream_status = 0;
+    writer->stream_bytes = 0;
+
+    if (buffer_mem != NULL)
+        buffer_init_borrowed(&writer->reply_buf, buffer_mem, DEFAULT_REPLY_BUFSIZE);
+    else
+        buffer_init(&writer->reply_buf, DEFAULT_REPLY_BUFSIZE);
 }
 
 void h1writer_dispose(ReplyWriter *writer)
@@ -25,6 +122,11 @@ void h1writer_dispose(ReplyWriter *writer)
 void h1writer_reset(ReplyWriter *writer)
 {
     buffer_clear(&writer->reply_buf);
+    writer->streaming = false;
+    writer->stream_chunked = false;
+    writer->stream_discard = false;
+    writer->stream_status = 0;
+    writer->stream_bytes = 0;
 }
 
 bool h1writer_put_status_line(ReplyWriter *writer, const ResponseObj *resinfo)
@@ -38,7 +140,7 @@ bool h1writer_put_header_server(ReplyWriter *writer, const ResponseObj *resinfo)
 {
     bool put_ok = true;
     int offset_step = 0;
-    int cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
     char *write_cursor = writer->reply_buf.data + cursor_offset;
 
     offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_SERVER, resinfo->server_name_ref);
@@ -54,7 +156,7 @@ bool h1writer_put_header_server(ReplyWriter *writer, const ResponseObj *resinfo)
 bool h1writer_put_header_date(ReplyWriter *writer, const ResponseObj *resinfo)
 {
     Buffer *buf_ref = &writer->reply_buf;
-    int total_offset = buffer_get_wpos(buf_ref);
+    size_t total_offset = buffer_get_wpos(buf_ref);
     int offset_step = total_offset;
     int buf_margin = buf_ref->capacity - offset_step;
     char *write_cursor = buf_ref->data + offset_step;
@@ -101,7 +203,7 @@ bool h1writer_put_header_keepconn(ReplyWriter *writer, const ResponseObj *resinf
 {
     bool put_ok = true;
     int offset_step = 0;
-    int cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
     char *write_cursor = writer->reply_buf.data + cursor_offset;
 
     if (resinfo->keep_connection)
@@ -117,23 +219,38 @@ bool h1writer_put_header_keepconn(ReplyWriter *writer, const ResponseObj *resinf
     return put_ok;
 }
 
+bool h1writer_put_header_keepalive(ReplyWriter *writer, const ResponseObj *resinfo)
+{
+    bool put_ok = true;
+    int offset_step = 0;
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    char *write_cursor = writer->reply_buf.data + cursor_offset;
+
+    if (!resinfo->keep_connection || resinfo->keepalive_timeout <= 0)
+        return put_ok;
+
+    offset_step = sprintf(write_cursor, "%s timeout=%i, max=%i\r\n", HTTP_HEADER_KEEP_ALIVE, resinfo->keepalive_timeout, resinfo->keepalive_max);
+
+    put_ok = offset_step > 0;
+
+    if (put_ok)
+        buffer_set_wpos(&writer->reply_buf, cursor_offset + offset_step);
+
+    return put_ok;
+}
+
 bool h1writer_put_header_contype(ReplyWriter *writer, const ResponseObj *resinfo)
 {
     bool put_ok = true;
     int offset_step = 0;
-    int cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
     char *write_cursor = writer->reply_buf.data + cursor_offset;
 
-    if (resinfo->mime_type == TXT_PLAIN)
-        offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_CTYPE, MIME_TXT_PLAIN);
-    else if (resinfo->mime_type == TXT_HTML)
-        offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_CTYPE, MIME_TXT_HTML);
-    else if (resinfo->mime_type == TXT_CSS)
-        offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_CTYPE, MIME_TXT_CSS);
-    else if (resinfo->mime_type == TXT_JS)
-        offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_CTYPE, MIME_TXT_JS);
+    // Multiple ranges are sent as parts, and each part then carries the real payload type.
+    if (resinfo->range_count > 1)
+        offset_step = sprintf(write_cursor, "%s %s; boundary=%s\r\n", HTTP_HEADER_CTYPE, MIME_MULTI_BYTERANGES, MIME_BYTERANGES_BOUNDARY);
     else
-        offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_CTYPE, MIME_TXT_PLAIN);
+        offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_CTYPE, h1writer_mime_str(resinfo->mime_type));
 
     put_ok = offset_step > 0;
 
@@ -147,10 +264,163 @@ bool h1writer_put_header_contlen(ReplyWriter *writer, const ResponseObj *resinfo
 {
     bool put_ok = true;
     int offset_step = 0;
-    int cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    char *write_cursor = writer->reply_buf.data + cursor_offset;
+
+    offset_step = sprintf(write_cursor, "%s %i\r\n", HTTP_HEADER_CLEN, h1writer_payload_length(resinfo));
+
+    put_ok = offset_step > 0;
+
+    if (put_ok)
+        buffer_set_wpos(&writer->reply_buf, cursor_offset + offset_step);
+
+    return put_ok;
+}
+
+bool h1writer_put_header_encoding(ReplyWriter *writer, const ResponseObj *resinfo)
+{
+    bool put_ok = true;
+    int offset_step = 0;
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    char *write_cursor = writer->reply_buf.data + cursor_offset;
+
+    // Identity payloads need no Content-Encoding header at all.
+    if (resinfo->encoding == ENCODING_GZIP)
+        offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_CENCODING, ENCODING_TOKEN_GZIP);
+    else if (resinfo->encoding == ENCODING_BR)
+        offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_CENCODING, ENCODING_TOKEN_BR);
+    else
+        return put_ok;
+
+    put_ok = offset_step > 0;
+
+    if (put_ok)
+        buffer_set_wpos(&writer->reply_buf, cursor_offset + offset_step);
+
+    return put_ok;
+}
+
+bool h1writer_put_header_vary(ReplyWriter *writer, const ResponseObj *resinfo)
+{
+    bool put_ok = true;
+    int offset_step = 0;
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    char *write_cursor = writer->reply_buf.data + cursor_offset;
+
+    // Caches must key negotiated payloads by Accept-Encoding, even when the identity variant was sent.
+    if (!resinfo->vary_encoding)
+        return put_ok;
+
+    offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_VARY, HTTP_HVALUE_VARY_ENCODING);
+
+    put_ok = offset_step > 0;
+
+    if (put_ok)
+        buffer_set_wpos(&writer->reply_buf, cursor_offset + offset_step);
+
+    return put_ok;
+}
+
+bool h1writer_put_header_etag(ReplyWriter *writer, const ResponseObj *resinfo)
+{
+    bool put_ok = true;
+    int offset_step = 0;
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    char *write_cursor = writer->reply_buf.data + cursor_offset;
+
+    if (!resinfo->etag_ref || resinfo->etag_ref[0] == '\0')
+        return put_ok;
+
+    offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_ETAG, resinfo->etag_ref);
+
+    put_ok = offset_step > 0;
+
+    if (put_ok)
+        buffer_set_wpos(&writer->reply_buf, cursor_offset + offset_step);
+
+    return put_ok;
+}
+
+bool h1writer_put_header_lastmod(ReplyWriter *writer, const ResponseObj *resinfo)
+{
+    Buffer *buf_ref = &writer->reply_buf;
+    size_t total_offset = buffer_get_wpos(buf_ref);
+    int buf_margin = buf_ref->capacity - total_offset;
+    char *write_cursor = buf_ref->data + total_offset;
+    struct tm gmt_date;
+    char date_str[STATUS_LINE_BUFSIZE];
+
+    if (resinfo->last_modified == 0)
+        return true;
+
+    if (!gmtime_r(&resinfo->last_modified, &gmt_date))
+        return false;
+
+    if (strftime(date_str, STATUS_LINE_BUFSIZE, HTTP_GMT_FMT, &gmt_date) == 0)
+        return false;
+
+    int offset_step = snprintf(write_cursor, buf_margin, "%s %s\r\n", HTTP_HEADER_LAST_MODIFIED, date_str);
+
+    if (offset_step < 0 || offset_step >= buf_margin)
+        return false;
+
+    return buffer_set_wpos(buf_ref, total_offset + offset_step);
+}
+
+bool h1writer_put_header_acceptranges(ReplyWriter *writer, const ResponseObj *resinfo)
+{
+    bool put_ok = true;
+    int offset_step = 0;
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    char *write_cursor = writer->reply_buf.data + cursor_offset;
+
+    if (!resinfo->accept_ranges)
+        return put_ok;
+
+    offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_ACCEPT_RANGES, HTTP_HVALUE_RANGES_BYTES);
+
+    put_ok = offset_step > 0;
+
+    if (put_ok)
+        buffer_set_wpos(&writer->reply_buf, cursor_offset + offset_step);
+
+    return put_ok;
+}
+
+bool h1writer_put_header_conrange(ReplyWriter *writer, const ResponseObj *resinfo)
+{
+    bool put_ok = true;
+    int offset_step = 0;
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    char *write_cursor = writer->reply_buf.data + cursor_offset;
+
+    // Multipart replies put Content-Range into each part instead.
+    if (resinfo->range_unsatisfied)
+        offset_step = sprintf(write_cursor, "%s %s */%i\r\n", HTTP_HEADER_CONTENT_RANGE, HTTP_HVALUE_RANGES_BYTES, resinfo->content_len);
+    else if (resinfo->range_count == 1)
+        offset_step = sprintf(write_cursor, "%s %s %i-%i/%i\r\n", HTTP_HEADER_CONTENT_RANGE, HTTP_HVALUE_RANGES_BYTES, resinfo->ranges[0].first, resinfo->ranges[0].last, resinfo->content_len);
+    else
+        return put_ok;
+
+    put_ok = offset_step > 0;
+
+    if (put_ok)
+        buffer_set_wpos(&writer->reply_buf, cursor_offset + offset_step);
+
+    return put_ok;
+}
+
+bool h1writer_put_header_transenc(ReplyWriter *writer, const ResponseObj *resinfo)
+{
+    bool put_ok = true;
+    int offset_step = 0;
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
     char *write_cursor = writer->reply_buf.data + cursor_offset;
 
-    offset_step = sprintf(write_cursor, "%s %i\r\n", HTTP_HEADER_CLEN, resinfo->content_len);
+    if (!resinfo->chunked)
+        return put_ok;
+
+    offset_step = sprintf(write_cursor, "%s %s\r\n", HTTP_HEADER_TRANSFER_ENCODING, HTTP_HVALUE_CHUNKED);
 
     put_ok = offset_step > 0;
 
@@ -164,7 +434,7 @@ bool h1writer_put_header_blank(ReplyWriter *writer)
 {
     bool put_ok = true;
     int offset_step = 0;
-    int cursor_offset = buffer_get_wpos(&writer->reply_buf);
+    size_t cursor_offset = buffer_get_wpos(&writer->reply_buf);
     char *write_cursor = writer->reply_buf.data + cursor_offset;
 
     offset_step = sprintf(write_cursor, "\r\n");
@@ -188,16 +458,85 @@ bool h1writer_write_body_blob(ReplyWriter *writer, const ResponseObj *resinfo)
 bool h1writer_write_out(ReplyWriter *writer)
 {
     const Buffer *res_buf_view = &writer->reply_buf;
-    int blob_size = writer->reply_buf.write_pos;
+    size_t blob_size = writer->reply_buf.write_pos;
 
     return clientsocket_write_blob(writer->cli_sock_ref, blob_size, res_buf_view);
 }
 
-bool h1writer_put_reply(ReplyWriter *writer, const ResponseObj *resinfo)
+bool h1writer_write_reply_iov(ReplyWriter *writer, const ResponseObj *resinfo)
 {
-    bool body_load_ok = true;
-    bool write_ok = true;
+    struct iovec reply_iov[H1WRITER_IOV_COUNT];
+    int iov_count = 0;
+    Buffer *buf_ref = &writer->reply_buf;
+    char *payload = resinfo->body_blob;
+    uint32_t shared_mask = 0;  // payload slices of static resources are queued by reference for slow clients
+
+    reply_iov[iov_count].iov_base = buf_ref->data;
+    reply_iov[iov_count].iov_len = buffer_get_wpos(buf_ref);
+    iov_count++;
+
+    if (!payload || resinfo->header_only || resinfo->range_unsatisfied)
+        return h1writer_send_reply_iov(writer, resinfo, reply_iov, iov_count, shared_mask);
+
+    if (resinfo->range_count == 0)
+    {
+        reply_iov[iov_count].iov_base = payload;
+        reply_iov[iov_count].iov_len = resinfo->content_len;
+        shared_mask |= (resinfo->body_shared) ? ((uint32_t)1 << iov_count) : 0;
+        iov_count++;
+
+        return h1writer_send_reply_iov(writer, resinfo, reply_iov, iov_count, shared_mask);
+    }
+
+    if (resinfo->range_count == 1)
+    {
+        reply_iov[iov_count].iov_base = payload + resinfo->ranges[0].first;
+        reply_iov[iov_count].iov_len = resinfo->ranges[0].last - resinfo->ranges[0].first + 1;
+        shared_mask |= (resinfo->body_shared) ? ((uint32_t)1 << iov_count) : 0;
+        iov_count++;
+
+        return h1writer_send_reply_iov(writer, resinfo, reply_iov, iov_count, shared_mask);
+    }
+
+    // Multipart part headers go after the reply headers in the same buffer, but the payload slices are sent straight from the resource.
+    for (int i = 0; i < resinfo->range_count; i++)
+    {
+        const ByteRange *range_ref = &resinfo->ranges[i];
+        size_t part_offset = buffer_get_wpos(buf_ref);
+        int buf_margin = buf_ref->capacity - part_offset;
+        int part_len = h1writer_format_part_header(buf_ref->data + part_offset, buf_margin, resinfo, range_ref);
+
+        if (part_len < 0 || part_len >= buf_margin)
+            return false;
+
+        buffer_set_wpos(buf_ref, part_offset + part_len);
+
+        reply_iov[iov_count].iov_base = buf_ref->data + part_offset;
+        reply_iov[iov_count].iov_len = part_len;
+        iov_count++;
+
+        reply_iov[iov_count].iov_base = payload + range_ref->first;
+        reply_iov[iov_count].iov_len = range_ref->last - range_ref->first + 1;
+        shared_mask |= (resinfo->body_shared) ? ((uint32_t)1 << iov_count) : 0;
+        iov_count++;
+    }
+
+    size_t close_offset = buffer_get_wpos(buf_ref);
+    int close_margin = buf_ref->capacity - close_offset;
+    int close_len = snprintf(buf_ref->data + close_offset, close_margin, MULTIPART_CLOSE_FMT, MIME_BYTERANGES_BOUNDARY);
+
+    if (close_len < 0 || close_len >= close_margin)
+        return false;
+
+    reply_iov[iov_count].iov_base = buf_ref->data + close_offset;
+    reply_iov[iov_count].iov_len = close_len;
+    iov_count++;
+
+    return h1writer_send_reply_iov(writer, resinfo, reply_iov, iov_count, shared_mask);
+}
 
+bool h1writer_put_reply_head(ReplyWriter *writer, const ResponseObj *resinfo)
+{
     if (!h1writer_put_status_line(writer, resinfo))
         return false;
 
@@ -209,22 +548,154 @@ bool h1writer_put_reply(ReplyWriter *writer, const ResponseObj *resinfo)
 
     if (!h1writer_put_header_keepconn(writer, resinfo))
         return false;
+
+    if (!h1writer_put_header_keepalive(writer, resinfo))
+        return false;
     
-    if (!h1writer_put_header_contype(writer, resinfo))
+    // Header-only replies such as 304 carry no payload, so its type and length are left out.
+    if (!resinfo->header_only && !h1writer_put_header_contype(writer, resinfo))
+        return false;
+
+    // Streamed replies have no length up front, so chunked framing or the connection close marks their end.
+    if (!resinfo->header_only && !resinfo->streamed && !h1writer_put_header_contlen(writer, resinfo))
+        return false;
+
+    if (!h1writer_put_header_transenc(writer, resinfo))
         return false;
 
-    if (!h1writer_put_header_contlen(writer, resinfo))
+    if (!h1writer_put_header_encoding(writer, resinfo))
         return false;
 
-    if (!h1writer_put_header_blank(writer))
+    if (!h1writer_put_header_vary(writer, resinfo))
         return false;
 
-    if (resinfo->body_blob != NULL)
-        body_load_ok = buffer_put_span(&writer->reply_buf, resinfo->content_len, resinfo->body_blob);
+    if (!h1writer_put_header_etag(writer, resinfo))
+        return false;
+
+    if (!h1writer_put_header_lastmod(writer, resinfo))
+        return false;
+
+    if (!h1writer_put_header_acceptranges(writer, resinfo))
+        return false;
+
+    if (!h1writer_put_header_conrange(writer, resinfo))
+        return false;
+
+    return h1writer_put_header_blank(writer);
+}
+
+bool h1writer_put_reply(ReplyWriter *writer, const ResponseObj *resinfo)
+{
+    bool write_ok = true;
+
+    if (!h1writer_put_reply_head(writer, resinfo))
+        return false;
 
-    write_ok = h1writer_write_out(writer);
+    write_ok = h1writer_write_reply_iov(writer, resinfo);
 
     buffer_clear(&writer->reply_buf); // clear buffer of sent status line
 
-    return write_ok && body_load_ok;
+    return write_ok;
+}
+
+/* ReplyWriter Streaming Funcs */
+
+bool h1writer_stream_open(ReplyWriter *writer, ResponseObj *resinfo, bool discard_body)
+{
+    bool is_chunked = strncmp(resinfo->status_line, HTTP_1_1, strlen(HTTP_1_1)) == 0;
+
+    // Streamed bodies cannot be ranged since their length is unknown until the end.
+    resinfo_set_streamed(resinfo, is_chunked);
+    resinfo_set_accept_ranges(resinfo, false);
+
+    buffer_clear(&writer->reply_buf);
+
+    if (!h1writer_put_reply_head(writer, resinfo))
+        return false;
+
+    writer->streaming = true;
+    writer->stream_chunked = is_chunked;
+    writer->stream_discard = discard_body;
+    writer->stream_status = resinfo->status_code;
+    writer->stream_bytes = 0;
+
+    return true;
+}
+
+bool h1writer_stream_write(ReplyWriter *writer, const char *data, size_t len)
+{
+    struct iovec chunk_iov[3];
+    int iov_count = 0;
+    Buffer *buf_ref = &writer->reply_buf;
+
+    if (!writer->streaming)
+        return false;
+
+    if (writer->stream_discard || len == 0)
+        return true;
+
+    // The chunk-size line goes after any held back head, so both leave in one send with the data.
+    if (writer->stream_chunked)
+    {
+        size_t line_offset = buffer_get_wpos(buf_ref);
+        int line_len = snprintf(buf_ref->data + line_offset, buf_ref->capacity - line_offset, CHUNK_SIZE_LINE_FMT, len);
+
+        if (line_len < 0 || (size_t)line_len >= buf_ref->capacity - line_offset)
+            return false;
+
+        buffer_set_wpos(buf_ref, line_offset + line_len);
+    }
+
+    if (buffer_get_wpos(buf_ref) > 0)
+    {
+        chunk_iov[iov_count].iov_base = buf_ref->data;
+        chunk_iov[iov_count].iov_len = buffer_get_wpos(buf_ref);
+        iov_count++;
+    }
+
+    chunk_iov[iov_count].iov_base = (char *)data;
+    chunk_iov[iov_count].iov_len = len;
+    iov_count++;
+
+    if (writer->stream_chunked)
+    {
+        chunk_iov[iov_count].iov_base = CHUNK_DATA_END;
+        chunk_iov[iov_count].iov_len = strlen(CHUNK_DATA_END);
+        iov_count++;
+    }
+
+    buffer_clear(buf_ref);
+    writer->stream_bytes += h1writer_iov_bytes(chunk_iov, iov_count);
+
+    return clientsocket_write_iov(writer->cli_sock_ref, chunk_iov, iov_count);
+}
+
+bool h1writer_stream_finish(ReplyWriter *writer)
+{
+    struct iovec finish_iov;
+    Buffer *buf_ref = &writer->reply_buf;
+
+    if (!writer->streaming)
+        return false;
+
+    writer->streaming = false;
+
+    if (writer->stream_chunked && !writer->stream_discard && !buffer_put_span(buf_ref, strlen(CHUNK_LAST), CHUNK_LAST))
+        return false;
+
+    bool write_ok = true;
+
+    if (buffer_get_wpos(buf_ref) > 0)
+    {
+        finish_iov.iov_base = buf_ref->data;
+        finish_iov.iov_len = buffer_get_wpos(buf_ref);
+        writer->stream_bytes += finish_iov.iov_len;
+
+        buffer_clear(buf_ref);
+        write_ok = clientsocket_write_iov(writer->cli_sock_ref, &finish_iov, 1);
+    }
+
+    H1C_PROBE5(response__written, writer->worker_id, writer->cli_sock_ref->transport.fd, writer->stream_status, writer->stream_bytes, write_ok);
+
+    return write_ok;
 }
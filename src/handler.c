@@ -14,9 +14,15 @@ void h1chandler_init(H1CHandler *handler, HttpMethod method, MimeType mime, Hand
 {
     handler->method = method;
     handler->content_type = mime;
+    handler->streams_body = false;
     handler->callback = callback;
 }
 
+void h1chandler_set_streams_body(H1CHandler *handler, bool streams_body)
+{
+    handler->streams_body = streams_body;
+}
+
 HandlerStatus h1chandler_check_req(const H1CHandler *handler, const BaseRequest *req)
 {
     if (req->method_id != handler->method)
@@ -37,3 +43,23 @@ HandlerStatus h1chandler_handle(const H1CHandler *handler, const HandlerContext
 
     return check_code;
 }
+
+HandlerStatus h1chandler_serve_static(const HandlerContext *ctx, const char *fname, const BaseRequest *req, ResponseObj *res)
+{
+    const StaticResource *resrc_ref = handlerctx_get_resrc(ctx, fname);
+    ContentEncoding encoding = ENCODING_IDENTITY;
+
+    if (!resrc_ref)
+        return HANDLE_GENERAL_ERR;
+
+    const StaticVariant *variant_ref = statsrc_pick_variant(resrc_ref, req->accept_encodings, &encoding);
+
+    resinfo_set_mime_type(res, statsrc_get_type(resrc_ref));
+    resinfo_set_encoding(res, encoding, statsrc_has_encodings(resrc_ref));
+    resinfo_set_validators(res, variant_ref->etag, resrc_ref->mtime);
+    resinfo_set_accept_ranges(res, true);
+    resinfo_set_content_length(res, variant_ref->clen);
+    resinfo_set_shared_payload(res, variant_ref->data);
+
+    return HANDLE_OK;
+}
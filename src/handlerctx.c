@@ -17,6 +17,12 @@ bool handlerctx_init(HandlerContext *handlerctx, uint16_t fcount, const char *fn
     bool table_ok = restable_init(&handlerctx->resources, fcount);
     bool put_ok = true;
 
+    handlerctx->arena_ref = NULL;
+    handlerctx->scanner_ref = NULL;
+    handlerctx->writer_ref = NULL;
+    handlerctx->metrics_ref = NULL;
+    handlerctx->trace_ref = NULL;
+
     StaticResource *temp_resrc_ref = NULL;
 
     for (uint16_t i = 0; i < fcount && put_ok; i++)
@@ -51,6 +57,75 @@ void handlerctx_dispose(HandlerContext *handlerctx)
     handlerctx->ready = false;
 }
 
+void handlerctx_set_metrics(HandlerContext *handlerctx, const MetricsBoard *metrics)
+{
+    handlerctx->metrics_ref = metrics;
+}
+
+void handlerctx_set_trace(HandlerContext *handlerctx, const TraceBoard *trace)
+{
+    handlerctx->trace_ref = trace;
+}
+
+void handlerctx_init_view(HandlerContext *view, const HandlerContext *shared, Arena *arena, HttpScanner *scanner, ReplyWriter *writer)
+{
+    view->ready = shared->ready;
+    view->resources = shared->resources;
+    view->arena_ref = arena;
+    view->scanner_ref = scanner;
+    view->writer_ref = writer;
+    view->metrics_ref = shared->metrics_ref;
+    view->trace_ref = shared->trace_ref;
+}
+
+void *handlerctx_alloc(const HandlerContext *handlerctx, size_t size)
+{
+    if (!handlerctx->arena_ref)
+        return NULL;
+
+    return arena_alloc(handlerctx->arena_ref, size);
+}
+
+ssize_t handlerctx_read_body(const HandlerContext *handlerctx, const char **chunk_ref)
+{
+    if (!handlerctx->scanner_ref)
+        return -1;
+
+    return h1scanner_read_body(handlerctx->scanner_ref, chunk_ref);
+}
+
+const char *handlerctx_get_trailer(const HandlerContext *handlerctx, const char *name)
+{
+    if (!handlerctx->scanner_ref)
+        return NULL;
+
+    return h1scanner_get_trailer(handlerctx->scanner_ref, name);
+}
+
+bool handlerctx_stream_open(const HandlerContext *handlerctx, const BaseRequest *req, ResponseObj *res)
+{
+    if (!handlerctx->writer_ref)
+        return false;
+
+    return h1writer_stream_open(handlerctx->writer_ref, res, req->method_id == HEAD);
+}
+
+bool handlerctx_stream_write(const HandlerContext *handlerctx, const char *data, size_t len)
+{
+    if (!handlerctx->writer_ref)
+        return false;
+
+    return h1writer_stream_write(handlerctx->writer_ref, data, len);
+}
+
+bool handlerctx_stream_finish(const HandlerContext *handlerctx)
+{
+    if (!handlerctx->writer_ref)
+        return false;
+
+    return h1writer_stream_finish(handlerctx->writer_ref);
+}
+
 inline bool handlerctx_ready(const HandlerContext *handlerctx)
 {
     return handlerctx->ready;
@@ -0,0 +1,136 @@
+/**
+ * @file histogram.c
+ * @author Derek Tan
+ * @brief Implements log-linear latency histograms with a single lock-free writer.
+ * @date 2023-12-22
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "utils/histogram.h"
+
+/* Helper Funcs. */
+
+static int histogram_bucket_of(uint64_t value)
+{
+    if (value < HISTOGRAM_SUB_COUNT)
+        return (int)value;
+
+    // The top bit picks the power of two, and the next HISTOGRAM_SUB_BITS bits pick the sub-bucket within it.
+    int top_bit = 63 - __builtin_clzll(value);
+    int sub_index = (int)(value >> (top_bit - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_COUNT - 1);
+
+    return (top_bit - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT + sub_index;
+}
+
+static uint64_t histogram_bucket_low(int bucket)
+{
+    if (bucket < HISTOGRAM_SUB_COUNT)
+        return (uint64_t)bucket;
+
+    int top_bit = bucket / HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_BITS - 1;
+    uint64_t sub_index = (uint64_t)(bucket % HISTOGRAM_SUB_COUNT);
+
+    return (HISTOGRAM_SUB_COUNT + sub_index) << (top_bit - HISTOGRAM_SUB_BITS);
+}
+
+static uint64_t histogram_bucket_high(int bucket)
+{
+    return (bucket + 1 < HISTOGRAM_BUCKET_COUNT) ? histogram_bucket_low(bucket + 1) - 1 : UINT64_MAX;
+}
+
+/**
+ * @brief Adds to a counter only its owner writes, which needs no locked instruction.
+ */
+static void histogram_bump(_Atomic uint64_t *counter, uint64_t delta)
+{
+    uint64_t old_value = atomic_load_explicit(counter, memory_order_relaxed);
+
+    atomic_store_explicit(counter, old_value + delta, memory_order_relaxed);
+}
+
+/* LatencyHistogram Funcs. */
+
+void histogram_init(LatencyHistogram *hist)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++)
+        atomic_init(&hist->counts[i], 0);
+
+    atomic_init(&hist->sum, 0);
+    atomic_init(&hist->max, 0);
+}
+
+void histogram_record(LatencyHistogram *hist, uint64_t value)
+{
+    histogram_bump(&hist->counts[histogram_bucket_of(value)], 1);
+    histogram_bump(&hist->sum, value);
+
+    if (value > atomic_load_explicit(&hist->max, memory_order_relaxed))
+        atomic_store_explicit(&hist->max, value, memory_order_relaxed);
+}
+
+void histogram_merge(LatencyHistogram *dst, const LatencyHistogram *src)
+{
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++)
+        histogram_bump(&dst->counts[i], atomic_load_explicit(&src->counts[i], memory_order_relaxed));
+
+    histogram_bump(&dst->sum, atomic_load_explicit(&src->sum, memory_order_relaxed));
+
+    uint64_t src_max = atomic_load_explicit(&src->max, memory_order_relaxed);
+
+    if (src_max > atomic_load_explicit(&dst->max, memory_order_relaxed))
+        atomic_store_explicit(&dst->max, src_max, memory_order_relaxed);
+}
+
+uint64_t histogram_count(const LatencyHistogram *hist)
+{
+    uint64_t total = 0;
+
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++)
+        total += atomic_load_explicit(&hist->counts[i], memory_order_relaxed);
+
+    return total;
+}
+
+double histogram_mean(const LatencyHistogram *hist)
+{
+    uint64_t total = histogram_count(hist);
+
+    return (total > 0) ? (double)atomic_load_explicit(&hist->sum, memory_order_relaxed) / (double)total : 0.0;
+}
+
+uint64_t histogram_percentile(const LatencyHistogram *hist, double percent)
+{
+    uint64_t total = histogram_count(hist);
+    uint64_t seen = 0;
+
+    if (total == 0)
+        return 0;
+
+    // Rank of the value sought, counting from 1, so that 0% still means the first value.
+    uint64_t rank = (uint64_t)((percent / 100.0) * (double)total + 0.5);
+
+    rank = (rank < 1) ? 1 : (rank > total) ? total : rank;
+
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; i++)
+    {
+        seen += atomic_load_explicit(&hist->counts[i], memory_order_relaxed);
+
+        if (seen >= rank)
+        {
+            uint64_t bucket_high = histogram_bucket_high(i);
+            uint64_t hist_max = histogram_max(hist);
+
+            // The top bucket is often wide, so the true max is a tighter bound.
+            return (hist_max > 0 && hist_max < bucket_high) ? hist_max : bucket_high;
+        }
+    }
+
+    return histogram_max(hist);
+}
+
+uint64_t histogram_max(const LatencyHistogram *hist)
+{
+    return atomic_load_explicit(&hist->max, memory_order_relaxed);
+}
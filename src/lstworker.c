@@ -10,40 +10,108 @@
 
 #include "server/lstworker.h"
 
-void lstworker_init(ListenWorker *lstworker, ServerSocket *srvsock_ref, BlockedQueue *bqueue_ref)
+/* Helper Funcs. */
+
+/**
+ * @brief Logs a failure that may repeat once per connection at most every LSTWORKER_LOG_INTERVAL_MS, so a storm of them cannot flood the output or slow accepting.
+ */
+static void lstworker_log_failure(ListenWorker *lstworker, const char *what)
 {
-    lstworker->is_listening = true;
-    lstworker->srvsock_ref = srvsock_ref;
-    lstworker->bqueue_ref = bqueue_ref;
+    uint64_t now_ms = timing_now_ms();
+
+    lstworker->failure_count++;
+
+    if (now_ms - lstworker->last_log_ms < LSTWORKER_LOG_INTERVAL_MS)
+        return;
+
+    fprintf(stdout, "worker %i log: %s (%i times since the last report).\n", 0, what, lstworker->failure_count);
+    lstworker->last_log_ms = now_ms;
+    lstworker->failure_count = 0;
 }
 
-void lstworker_end(ListenWorker *lstworker)
+/**
+ * @brief Checks for accept errors that only concern one connection, such as a client resetting before it was accepted.
+ */
+static bool lstworker_is_transient(int error)
 {
-    lstworker->is_listening = false;
-    serversocket_close(lstworker->srvsock_ref);
-    /// @note Call bqueue_destroy on end of run!
+    switch (error)
+    {
+    case EINTR:
+    case ECONNABORTED:
+    case EPROTO:
+    case EPERM:
+    case ENETDOWN:
+    case ENETUNREACH:
+    case EHOSTDOWN:
+    case EHOSTUNREACH:
+    case ENONET:
+    case ENOPROTOOPT:
+    case EOPNOTSUPP:
+        return true;
+    default:
+        return false;
+    }
 }
 
-void lstworker_work(ListenWorker *lstworker)
+/**
+ * @brief Stops polling every listener for a short while, since none can accept until fds or memory free up.
+ */
+static void lstworker_pause(ListenWorker *lstworker)
 {
-    int temp_fd = -1;
-    QueueNode *temp_task = NULL;
+    for (int i = 0; i < lstworker->srvsock_count; i++)
+        connpark_pause_listener(lstworker->park_ref, &lstworker->srvsocks_ref[i], true);
 
-    if (!serversocket_open(lstworker->srvsock_ref))
+    lstworker->resume_ms = timing_now_ms() + LSTWORKER_ACCEPT_BACKOFF_MS;
+}
+
+static void lstworker_resume(ListenWorker *lstworker)
+{
+    if (lstworker->resume_ms == 0 || timing_now_ms() < lstworker->resume_ms)
         return;
 
+    for (int i = 0; i < lstworker->srvsock_count; i++)
+        connpark_pause_listener(lstworker->park_ref, &lstworker->srvsocks_ref[i], false);
+
+    lstworker->resume_ms = 0;
+}
+
+/**
+ * @brief Accepts every pending connection of a listener into the task queue, so a burst costs one wakeup instead of one per connection.
+ * 
+ * @returns false if the listener must stop.
+ */
+static bool lstworker_accept(ListenWorker *lstworker, ServerSocket *srvsock_ref)
+{
+    int temp_fd = -1;
+    QueueNode *temp_task = NULL;
+
     while (lstworker->is_listening)
     {
         // 1. Accept client connection to possibly handle...
-        temp_fd = serversocket_accept(lstworker->srvsock_ref);
+        temp_fd = serversocket_accept(srvsock_ref);
 
         if (temp_fd == -1)
         {
-            // Handle listening error... try again in case another connection is pending!
-            fprintf(stdout, "worker %i log: Invalid connection fd.\n", 0);
-            continue;
+            // The backlog is empty, or a client gave up before its turn.
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return true;
+
+            if (lstworker_is_transient(errno))
+                continue;
+
+            // Out of fds or memory: leave the rest queued in the kernel until some connections close.
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM)
+            {
+                lstworker_log_failure(lstworker, "Out of fds or memory to accept");
+                lstworker_pause(lstworker);
+            }
+
+            return true;
         }
 
+        metrics_add(&lstworker->metrics_ref->accepts, 1);
+        tracering_record(lstworker->trace_ref, TRACE_ACCEPT, temp_fd, 0, 0);
+
         // 2. Check blocking queue for placing any connection as task / reject it...
         temp_task = qnode_create(temp_fd);
 
@@ -51,20 +119,100 @@ void lstworker_work(ListenWorker *lstworker)
         {
             // Allocation failures may mean a memory overload... Stop ASAP!
             close(temp_fd);
-            lstworker_end(lstworker);
-            continue;
+            metrics_add(&lstworker->metrics_ref->closes, 1);
+            tracering_record(lstworker->trace_ref, TRACE_CLOSE, temp_fd, 0, 0);
+            H1C_PROBE3(connection__closed, 0, temp_fd, 0);
+            return false;
         }
 
         if (!bqueue_enqueue(lstworker->bqueue_ref, temp_task))
         {
-            fprintf(stdout, "worker %i log: Failed to put task.", 0);
+            lstworker_log_failure(lstworker, "Task queue full");
             close(temp_task->data);
+            free(temp_task);
+            metrics_add(&lstworker->metrics_ref->queue_full, 1);
+            metrics_add(&lstworker->metrics_ref->closes, 1);
+            tracering_record(lstworker->trace_ref, TRACE_CLOSE, temp_fd, 0, 0);
+            H1C_PROBE3(connection__closed, 0, temp_fd, 0);
             continue;
         }
 
         pthread_cond_signal(&lstworker->bqueue_ref->signaler);
     }
 
+    return true;
+}
+
+/* ListenWorker Funcs. */
+
+void lstworker_init(ListenWorker *lstworker, ServerSocket *srvsocks_ref, int srvsock_count, BlockedQueue *bqueue_ref, ConnParking *park_ref, ThreadMetrics *metrics_ref, TraceRing *trace_ref)
+{
+    lstworker->is_listening = true;
+    lstworker->srvsocks_ref = srvsocks_ref;
+    lstworker->srvsock_count = srvsock_count;
+    lstworker->bqueue_ref = bqueue_ref;
+    lstworker->park_ref = park_ref;
+    lstworker->metrics_ref = metrics_ref;
+    lstworker->trace_ref = trace_ref;
+    lstworker->resume_ms = 0;
+    lstworker->last_log_ms = 0;
+    lstworker->failure_count = 0;
+}
+
+void lstworker_end(ListenWorker *lstworker)
+{
+    lstworker->is_listening = false;
+
+    for (int i = 0; i < lstworker->srvsock_count; i++)
+        serversocket_close(&lstworker->srvsocks_ref[i]);
+
+    /// @note Call bqueue_destroy on end of run!
+}
+
+void lstworker_stop(ListenWorker *lstworker)
+{
+    lstworker->is_listening = false;
+
+    for (int i = 0; i < lstworker->srvsock_count; i++)
+        serversocket_shutdown(&lstworker->srvsocks_ref[i]);
+}
+
+void lstworker_work(ListenWorker *lstworker)
+{
+    ServerSocket *ready_listeners[CONNPARK_MAX_LISTENERS];
+    int ready_count = 0;
+
+    // Every listener must work, since a silently missing one would be hard to notice.
+    for (int i = 0; i < lstworker->srvsock_count; i++)
+    {
+        if (!serversocket_open(&lstworker->srvsocks_ref[i]) || !connpark_watch_listener(lstworker->park_ref, &lstworker->srvsocks_ref[i]))
+        {
+            fprintf(stdout, "worker %i log: Failed to open listener %i.\n", 0, i);
+            return;
+        }
+    }
+
+    while (lstworker->is_listening)
+    {
+        int wait_ms = (lstworker->resume_ms != 0) ? LSTWORKER_ACCEPT_BACKOFF_MS : LSTWORKER_POLL_TIMEOUT_MS;
+
+        // 0. Serve parked connections until new ones arrive on any listener, so slow clients drain without holding a worker...
+        if (connpark_poll(lstworker->park_ref, wait_ms, ready_listeners, &ready_count) < 0)
+        {
+            fprintf(stdout, "worker %i log: Failed to poll connections.\n", 0);
+            lstworker_end(lstworker);
+            continue;
+        }
+
+        for (int i = 0; i < ready_count && lstworker->is_listening; i++)
+        {
+            if (!lstworker_accept(lstworker, ready_listeners[i]))
+                lstworker_end(lstworker);
+        }
+
+        lstworker_resume(lstworker);
+    }
+
     /// @note The main server state will handle disposes of the blocking queue, web resources, etc. The listener only shares ownership of the queue, but does NOT own it.
 }
 
@@ -15,9 +15,13 @@
 /* Constants and Helper Macros */
 
 #define WWW_FILE_COUNT 2
+#define UPLOAD_REPLY_BUFSIZE 64
+#define NUMBERS_LINE_BUFSIZE 32
+#define NUMBERS_COUNT 10000
+#define TRACE_DUMP_DEFAULT_PATH "./h1c.trace"
 
 static ServerDriver server;
-static int server_wthrd_count = 0;
+static const char *trace_dump_path = TRACE_DUMP_DEFAULT_PATH;
 static const char *www_dir_files[WWW_FILE_COUNT] = {
     "./www/hello.html",
     "./www/index.css"
@@ -27,45 +31,88 @@ static const char *www_dir_files[WWW_FILE_COUNT] = {
 
 HandlerStatus handle_root(const HandlerContext *ctx, const BaseRequest *req, ResponseObj *res)
 {
-    const ResourceTable *restable_ref = &ctx->resources;
-    const StaticResource *resrc_ref = restable_get(restable_ref, "./www/hello.html");
+    return h1chandler_serve_static(ctx, "./www/hello.html", req, res);
+}
+
+HandlerStatus handle_index_css(const HandlerContext *ctx, const BaseRequest *req, ResponseObj *res)
+{
+    return h1chandler_serve_static(ctx, "./www/index.css", req, res);
+}
+
+HandlerStatus handle_upload(const HandlerContext *ctx, const BaseRequest *req, ResponseObj *res)
+{
+    const char *chunk = NULL;
+    ssize_t chunk_len = 0;
+    size_t total_len = 0;
+
+    // Count the upload as it streams in, so its size never matters to memory use.
+    while ((chunk_len = handlerctx_read_body(ctx, &chunk)) > 0)
+        total_len += chunk_len;
+
+    if (chunk_len < 0)
+        return HANDLE_GENERAL_ERR;
+
+    char *reply_text = handlerctx_alloc(ctx, UPLOAD_REPLY_BUFSIZE);
 
-    if (!resrc_ref)
+    if (!reply_text)
         return HANDLE_GENERAL_ERR;
 
-    resinfo_set_mime_type(res, TXT_HTML);
-    resinfo_set_content_length(res, statsrc_get_length(resrc_ref));
-    resinfo_set_body_payload(res, resrc_ref->data);
+    int reply_len = snprintf(reply_text, UPLOAD_REPLY_BUFSIZE, "Received %zu bytes.\n", total_len);
+
+    resinfo_set_mime_type(res, TXT_PLAIN);
+    resinfo_set_content_length(res, reply_len);
+    resinfo_set_body_payload(res, reply_text);
 
     return HANDLE_OK;
 }
 
-HandlerStatus handle_index_css(const HandlerContext *ctx, const BaseRequest *req, ResponseObj *res)
+HandlerStatus handle_numbers(const HandlerContext *ctx, const BaseRequest *req, ResponseObj *res)
 {
-    const ResourceTable *restable_ref = &ctx->resources;
-    const StaticResource *resrc_ref = restable_get(restable_ref, "./www/index.css");
+    char line[NUMBERS_LINE_BUFSIZE];
+
+    resinfo_set_mime_type(res, TXT_PLAIN);
 
-    if (!resrc_ref)
+    if (!handlerctx_stream_open(ctx, req, res))
         return HANDLE_GENERAL_ERR;
 
-    resinfo_set_mime_type(res, TXT_CSS);
-    resinfo_set_content_length(res, statsrc_get_length(resrc_ref));
-    resinfo_set_body_payload(res, resrc_ref->data);
+    // Each line goes out as it is made, so the reply size never matters to memory use.
+    for (int i = 1; i <= NUMBERS_COUNT; i++)
+    {
+        int line_len = snprintf(line, NUMBERS_LINE_BUFSIZE, "%i\n", i);
+
+        if (!handlerctx_stream_write(ctx, line, line_len))
+            return HANDLE_GENERAL_ERR;
+    }
 
-    return HANDLE_OK;
+    return handlerctx_stream_finish(ctx) ? HANDLE_OK : HANDLE_GENERAL_ERR;
 }
 
-void handle_signal_stops()
+/* Signal Funcs. */
+
+/**
+ * @brief Takes the signals every thread blocks on the main thread with sigwait, so none of this runs in a signal handler. Returns on SIGINT or SIGTERM.
+ */
+void wait_for_stop_signal(const sigset_t *signals)
 {
-    // On SIGINT, etc, close server and cleanup its state.
+    int signal_num = 0;
+
+    while (sigwait(signals, &signal_num) == 0)
+    {
+        if (signal_num == SIGHUP)
+            server_core_reopen_logs(&server); // as sent by logrotate, reopen log files.
+        else if (signal_num == SIGUSR1)
+            server_core_dump_trace(&server, trace_dump_path); // dump recent connection events for tools/h1ctrace.
+        else
+            break;
+    }
+
     fprintf(stdout, "%s: recieved interrupt.\n", H1C_VERSION_STRING);
-    server_core_cleanup(&server, server_wthrd_count);
 }
 
 int main(int argc, char *argv[])
 {
     /// 1a. Setup server state.
-    struct sigaction sa;
+    sigset_t signals;
     bool ctx_ok = true;      // if resources in context loaded 
     bool handlers_ok = true; // if handlers loaded
 
@@ -74,38 +121,91 @@ int main(int argc, char *argv[])
         // Use default host port if none is given in ARGV for user friendliness.
         server_core_init(&server, H1C_DEFAULT_HOSTNAME, H1C_DEFAULT_PORT, H1C_DEFAULT_BACKLOG);
     }
-    else if (argc == 2 && atoi(argv[1]) > 1024)
+    else if (argc >= 2 && atoi(argv[1]) > 1024)
     {
         // Use non-reserved port (1025+) to host server to prevent any extra socket errors.
         server_core_init(&server, H1C_DEFAULT_HOSTNAME, argv[1], H1C_DEFAULT_BACKLOG);
     }
     else
     {
-        fprintf(stderr, "usage: %s <port?>", argv[0]);
+        fprintf(stderr, "usage: %s <port?> <listen address>...\n", argv[0]);
+        return 1;
+    }
+
+    // Extra listeners such as "unix:@h1c" or "[::1]:8080" serve alongside the main port.
+    for (int arg_i = 2; arg_i < argc; arg_i++)
+    {
+        if (!server_core_add_listener(&server, argv[arg_i], H1C_DEFAULT_BACKLOG))
+        {
+            fprintf(stderr, "%s: Could not listen on %s.\n", H1C_VERSION_STRING, argv[arg_i]);
+            return 1;
+        }
+    }
+
+    // Access logging is opt-in, since it writes a line per request.
+    const char *access_log_path = getenv("H1C_ACCESS_LOG");
+
+    if (access_log_path != NULL && !server_core_set_access_log(&server, access_log_path))
+    {
+        fprintf(stderr, "%s: Could not open access log %s.\n", H1C_VERSION_STRING, access_log_path);
         return 1;
     }
 
+    // Capturing is opt-in too, since it copies every received byte and writes a record per reply and close through one shared lock.
+    const char *capture_path = getenv("H1C_CAPTURE_FILE");
+
+    if (capture_path != NULL && !server_core_set_capture(&server, capture_path))
+    {
+        fprintf(stderr, "%s: Could not open capture file %s.\n", H1C_VERSION_STRING, capture_path);
+        return 1;
+    }
+
+    if (getenv("H1C_TRACE_FILE") != NULL)
+        trace_dump_path = getenv("H1C_TRACE_FILE");
+
     /// 1b. Load resources to server.
     ctx_ok = server_core_setup_hdctx(&server, www_dir_files, WWW_FILE_COUNT);
 
     /// 1c. Load handlers to server.
-    handlers_ok = server_core_put_handler(&server, "/home", GET, ANY_ANY, handle_root) && server_core_put_handler(&server, "/index.css", GET, ANY_ANY, handle_index_css);
-
-    /// 1d. Put exit on interrupt handler for graceful cleanup.
-    sa.sa_handler = handle_signal_stops;
-    sigaction(SIGINT, &sa, NULL);
-
-    /// 2. Run server... Automatically cleans up resources after service in server_run(...).
+    handlers_ok = server_core_put_handler(&server, "/home", GET, ANY_ANY, handle_root) && server_core_put_handler(&server, "/index.css", GET, ANY_ANY, handle_index_css)
+        && server_core_put_streaming_handler(&server, "/upload", POST, ANY_ANY, handle_upload)
+        && server_core_put_handler(&server, "/numbers", GET, ANY_ANY, handle_numbers)
+        && server_core_put_metrics_handler(&server, "/metrics")
+        && server_core_put_trace_handler(&server, "/debug/trace");
+
+    /// 1d. Block the signals handled below before any thread starts, since threads inherit the mask. Each then waits for sigwait on this thread instead of interrupting whichever thread it lands on, which may hold a lock.
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    /// 2. Run server until interrupted... Every thread is stopped and joined before the state they share is disposed.
     if (ctx_ok && handlers_ok)
     {
         int server_wthrd_count = server_core_run(&server);
-        server_core_join(&server, server_wthrd_count);
+
+        if (!server_wthrd_count)
+        {
+            fprintf(stderr, "%s: Could not start workers, please check terminal output.\n", H1C_VERSION_STRING);
+            server_core_stop(&server, server_wthrd_count);
+            server_core_cleanup(&server, server_wthrd_count);
+            return 1;
+        }
+
         fprintf(stdout, "%s: Launched server!\n", H1C_VERSION_STRING);
+        wait_for_stop_signal(&signals);
+        server_core_stop(&server, server_wthrd_count);
+
+        // Reported once the workers are joined, since formatting and timer calibration are not safe in a signal handler.
+        server_core_report_latency(&server, stdout);
+        server_core_cleanup(&server, server_wthrd_count);
     }
     else
     {
         fprintf(stderr, "%s: Could not start, please check terminal output.\n", H1C_VERSION_STRING);
-        server_core_cleanup(&server, server_wthrd_count);
+        server_core_cleanup(&server, 0);
     }
 
     return 0;
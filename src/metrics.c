@@ -0,0 +1,163 @@
+/**
+ * @file metrics.c
+ * @author Derek Tan
+ * @brief Implements per-thread server counters and their Prometheus text rendering.
+ * @date 2023-12-22
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdarg.h>
+#include "utils/metrics.h"
+
+/* Helper Structs */
+
+typedef struct metrics_text_t
+{
+    char *data;
+    size_t capacity;
+    size_t length;
+    bool overflowed;
+} MetricsText;
+
+/* Helper Funcs. */
+
+static void metrics_text_printf(MetricsText *text, const char *format, ...)
+{
+    va_list args;
+
+    if (text->overflowed)
+        return;
+
+    va_start(args, format);
+    int put_len = vsnprintf(text->data + text->length, text->capacity - text->length, format, args);
+    va_end(args);
+
+    if (put_len < 0 || (size_t)put_len >= text->capacity - text->length)
+    {
+        text->overflowed = true;
+        return;
+    }
+
+    text->length += put_len;
+}
+
+static void metrics_text_counter(MetricsText *text, const char *name, const char *help, uint64_t value)
+{
+    metrics_text_printf(text, "# HELP %s %s\n# TYPE %s counter\n%s %lu\n", name, help, name, name, (unsigned long)value);
+}
+
+/* ThreadMetrics Funcs. */
+
+void metrics_init(ThreadMetrics *metrics)
+{
+    for (int i = 0; i < METRICS_METHOD_COUNT; i++)
+        atomic_init(&metrics->requests[i], 0);
+
+    for (int i = 0; i < METRICS_STATUS_COUNT; i++)
+        atomic_init(&metrics->responses[i], 0);
+
+    atomic_init(&metrics->bytes_in, 0);
+    atomic_init(&metrics->bytes_out, 0);
+    atomic_init(&metrics->accepts, 0);
+    atomic_init(&metrics->queue_full, 0);
+    atomic_init(&metrics->parse_errors, 0);
+    atomic_init(&metrics->closes, 0);
+    atomic_init(&metrics->slab_acquires, 0);
+    atomic_init(&metrics->slab_misses, 0);
+    atomic_init(&metrics->conditional_requests, 0);
+}
+
+void metrics_count_request(ThreadMetrics *metrics, HttpMethod method)
+{
+    int slot = (method >= ANYTHING && method <= UNKNOWN) ? (int)method : UNKNOWN;
+
+    metrics_add(&metrics->requests[slot], 1);
+}
+
+void metrics_count_response(ThreadMetrics *metrics, int status_code)
+{
+    if (status_code < METRICS_STATUS_MIN || status_code >= METRICS_STATUS_MIN + METRICS_STATUS_COUNT)
+        return;
+
+    metrics_add(&metrics->responses[status_code - METRICS_STATUS_MIN], 1);
+}
+
+/* MetricsBoard Funcs. */
+
+void metrics_board_init(MetricsBoard *board, ThreadMetrics *threads, int thread_count)
+{
+    board->threads = threads;
+    board->thread_count = thread_count;
+
+    for (int i = 0; i < thread_count; i++)
+        metrics_init(&threads[i]);
+}
+
+void metrics_board_sum(const MetricsBoard *board, ThreadMetrics *dst)
+{
+    metrics_init(dst);
+
+    for (int thread_i = 0; thread_i < board->thread_count; thread_i++)
+    {
+        const ThreadMetrics *src = &board->threads[thread_i];
+
+        for (int i = 0; i < METRICS_METHOD_COUNT; i++)
+            metrics_add(&dst->requests[i], metrics_load(&src->requests[i]));
+
+        for (int i = 0; i < METRICS_STATUS_COUNT; i++)
+            metrics_add(&dst->responses[i], metrics_load(&src->responses[i]));
+
+        metrics_add(&dst->bytes_in, metrics_load(&src->bytes_in));
+        metrics_add(&dst->bytes_out, metrics_load(&src->bytes_out));
+        metrics_add(&dst->accepts, metrics_load(&src->accepts));
+        metrics_add(&dst->queue_full, metrics_load(&src->queue_full));
+        metrics_add(&dst->parse_errors, metrics_load(&src->parse_errors));
+        metrics_add(&dst->closes, metrics_load(&src->closes));
+        metrics_add(&dst->slab_acquires, metrics_load(&src->slab_acquires));
+        metrics_add(&dst->slab_misses, metrics_load(&src->slab_misses));
+        metrics_add(&dst->conditional_requests, metrics_load(&src->conditional_requests));
+    }
+}
+
+int metrics_board_render(const MetricsBoard *board, char *dst, size_t capacity)
+{
+    ThreadMetrics total;
+    MetricsText text = {.data = dst, .capacity = capacity, .length = 0, .overflowed = false};
+
+    metrics_board_sum(board, &total);
+
+    metrics_text_printf(&text, "# HELP h1c_requests_total Requests read, by method.\n# TYPE h1c_requests_total counter\n");
+
+    for (int i = 0; i < METRICS_METHOD_COUNT; i++)
+        metrics_text_printf(&text, "h1c_requests_total{method=\"%s\"} %lu\n", method_code_to_name((HttpMethod)i), (unsigned long)metrics_load(&total.requests[i]));
+
+    metrics_text_printf(&text, "# HELP h1c_responses_total Replies sent, by status code.\n# TYPE h1c_responses_total counter\n");
+
+    for (int i = 0; i < METRICS_STATUS_COUNT; i++)
+    {
+        uint64_t count = metrics_load(&total.responses[i]);
+
+        if (count > 0)
+            metrics_text_printf(&text, "h1c_responses_total{code=\"%i\"} %lu\n", METRICS_STATUS_MIN + i, (unsigned long)count);
+    }
+
+    metrics_text_counter(&text, "h1c_received_bytes_total", "Bytes read from clients.", metrics_load(&total.bytes_in));
+    metrics_text_counter(&text, "h1c_sent_bytes_total", "Bytes sent to clients.", metrics_load(&total.bytes_out));
+    metrics_text_counter(&text, "h1c_accepted_connections_total", "Connections accepted.", metrics_load(&total.accepts));
+    metrics_text_counter(&text, "h1c_queue_full_rejections_total", "Connections closed on accept since the task queue was full.", metrics_load(&total.queue_full));
+    metrics_text_counter(&text, "h1c_parse_errors_total", "Requests with a malformed request line or headers.", metrics_load(&total.parse_errors));
+    metrics_text_counter(&text, "h1c_slab_acquires_total", "Connection buffers taken from the pool.", metrics_load(&total.slab_acquires));
+    metrics_text_counter(&text, "h1c_slab_misses_total", "Connection buffers allocated since the pool ran dry.", metrics_load(&total.slab_misses));
+    metrics_text_counter(&text, "h1c_conditional_requests_total", "GET and HEAD requests with cache validators.", metrics_load(&total.conditional_requests));
+
+    // Closes are counted by other threads than accepts, so a reader between the two may see a few more closes.
+    uint64_t accepts = metrics_load(&total.accepts);
+    uint64_t closes = metrics_load(&total.closes);
+
+    metrics_text_printf(&text, "# HELP h1c_active_connections Connections open now.\n# TYPE h1c_active_connections gauge\nh1c_active_connections %lu\n",
+        (unsigned long)((accepts > closes) ? accepts - closes : 0));
+
+    return text.overflowed ? -1 : (int)text.length;
+}
@@ -27,3 +27,20 @@ size_t hash_cstr(const char *str)
 
     return hash;
 }
+
+uint64_t hash_bytes_fnv1a(const char *bytes, size_t count)
+{
+    uint64_t hash = FNV1A_64_OFFSET;
+
+    if (!bytes)
+        return hash;
+
+    // FNV-1a covers every byte, unlike hash_cstr which only samples a short key prefix.
+    for (size_t i = 0; i < count; i++)
+    {
+        hash ^= (uint8_t)bytes[i];
+        hash *= FNV1A_64_PRIME;
+    }
+
+    return hash;
+}
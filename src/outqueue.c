@@ -0,0 +1,303 @@
+/**
+ * @file outqueue.c
+ * @author Derek Tan
+ * @brief Implements the pending output queue of non-blocking client sockets.
+ * @date 2023-12-18
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "basicio/outqueue.h"
+
+/* Helper Funcs. */
+
+/**
+ * @brief Drops sent bytes from the front of the queue, freeing every finished segment.
+ */
+static void outqueue_consume(OutQueue *outq, size_t count)
+{
+    outq->pending -= count;
+
+    while (count > 0 && outq->head != NULL)
+    {
+        OutSegment *segment = outq->head;
+        size_t segment_left = segment->len - segment->sent;
+
+        if (count < segment_left)
+        {
+            segment->sent += count;
+
+            if (segment->owned)
+                outq->buffered -= count;
+
+            return;
+        }
+
+        if (segment->owned)
+            outq->buffered -= segment_left;
+
+        count -= segment_left;
+        outq->head = segment->next;
+        free(segment);
+    }
+
+    if (outq->head == NULL)
+        outq->tail = NULL;
+}
+
+static void outqueue_link(OutQueue *outq, OutSegment *segment)
+{
+    if (outq->tail != NULL)
+        outq->tail->next = segment;
+    else
+        outq->head = segment;
+
+    outq->tail = segment;
+    outq->pending += segment->len;
+
+    if (segment->owned)
+        outq->buffered += segment->len;
+}
+
+/**
+ * @brief Checks whether the head segment should go out alone with MSG_ZEROCOPY, turning on SO_ZEROCOPY the first time.
+ */
+static bool outqueue_head_zerocopy(OutQueue *outq, int fd)
+{
+#if OUTQUEUE_HAS_ZEROCOPY
+    const OutSegment *segment = outq->head;
+    int flag_on = 1;
+
+    if (outq->zerocopy_min == 0 || segment->owned || segment->len - segment->sent < outq->zerocopy_min)
+        return false;
+
+    if (!outq->zerocopy_on && setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &flag_on, sizeof(flag_on)) != 0)
+    {
+        outq->zerocopy_min = 0;
+        return false;
+    }
+
+    outq->zerocopy_on = true;
+
+    return true;
+#else
+    (void)outq;
+    (void)fd;
+    return false;
+#endif
+}
+
+/**
+ * @brief Checks whether a segment may share a sendmsg call with the ones before it. Zero-copy segments never do, since copied ones next to them would be pinned too.
+ */
+static bool outqueue_is_batchable(const OutQueue *outq, const OutSegment *segment)
+{
+    return outq->zerocopy_min == 0 || segment->owned || segment->len - segment->sent < outq->zerocopy_min;
+}
+
+/* OutQueue Funcs. */
+
+void outqueue_init(OutQueue *outq)
+{
+    outq->head = NULL;
+    outq->tail = NULL;
+    outq->pending = 0;
+    outq->buffered = 0;
+    outq->zerocopy_min = 0;
+    outq->zerocopy_inflight = 0;
+    outq->zerocopy_on = false;
+}
+
+void outqueue_clear(OutQueue *outq)
+{
+    OutSegment *segment = outq->head;
+
+    while (segment != NULL)
+    {
+        OutSegment *next_segment = segment->next;
+
+        free(segment);
+        segment = next_segment;
+    }
+
+    outqueue_init(outq);
+}
+
+void outqueue_move(OutQueue *dst, OutQueue *src)
+{
+    *dst = *src;
+    outqueue_init(src);
+}
+
+bool outqueue_is_empty(const OutQueue *outq)
+{
+    return outq->pending == 0;
+}
+
+bool outqueue_put(OutQueue *outq, const char *data, size_t len)
+{
+    if (len == 0)
+        return true;
+
+    OutSegment *segment = malloc(sizeof(OutSegment) + len);
+
+    if (!segment)
+        return false;
+
+    segment->next = NULL;
+    segment->base = segment->data;
+    segment->len = len;
+    segment->sent = 0;
+    segment->owned = true;
+    memcpy(segment->data, data, len);
+    outqueue_link(outq, segment);
+
+    return true;
+}
+
+bool outqueue_put_shared(OutQueue *outq, const char *data, size_t len)
+{
+    if (len == 0)
+        return true;
+
+    OutSegment *segment = malloc(sizeof(OutSegment));
+
+    if (!segment)
+        return false;
+
+    segment->next = NULL;
+    segment->base = data;
+    segment->len = len;
+    segment->sent = 0;
+    segment->owned = false;
+    outqueue_link(outq, segment);
+
+    return true;
+}
+
+ssize_t outqueue_flush(OutQueue *outq, Transport *transport)
+{
+    struct iovec flush_iov[OUTQUEUE_IOV_COUNT];
+    struct msghdr msg;
+    ssize_t total_wc = 0;
+    int fd = transport->fd;
+
+    if (outq->zerocopy_inflight > 0 && outqueue_reap_zerocopy(outq, fd) < 0)
+        return -1;
+
+    while (outq->head != NULL)
+    {
+        int iov_count = 0;
+        int send_flags = MSG_DONTWAIT | MSG_NOSIGNAL;
+        bool zerocopy = transport_is_socket(transport) && outqueue_head_zerocopy(outq, fd);
+
+        for (OutSegment *segment = outq->head; segment != NULL && iov_count < OUTQUEUE_IOV_COUNT; segment = segment->next)
+        {
+            if (iov_count > 0 && (zerocopy || !outqueue_is_batchable(outq, segment)))
+                break;
+
+            flush_iov[iov_count].iov_base = (char *)segment->base + segment->sent;
+            flush_iov[iov_count].iov_len = segment->len - segment->sent;
+            iov_count++;
+        }
+
+#if OUTQUEUE_HAS_ZEROCOPY
+        if (zerocopy)
+            send_flags |= MSG_ZEROCOPY;
+#endif
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = flush_iov;
+        msg.msg_iovlen = iov_count;
+
+        ssize_t temp_wc = transport_sendmsg(transport, &msg, send_flags);
+
+        if (temp_wc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            // Out of room to pin more pages: reap what finished and copy this time.
+            if (zerocopy && errno == ENOBUFS)
+            {
+                if (outqueue_reap_zerocopy(outq, fd) < 0)
+                    return -1;
+
+                outq->zerocopy_min = 0;
+                continue;
+            }
+
+            return -1;
+        }
+
+        if (zerocopy)
+            outq->zerocopy_inflight++;
+
+        outqueue_consume(outq, temp_wc);
+        total_wc += temp_wc;
+    }
+
+    return total_wc;
+}
+
+void outqueue_set_zerocopy(OutQueue *outq, size_t min_len)
+{
+    outq->zerocopy_min = OUTQUEUE_HAS_ZEROCOPY ? min_len : 0;
+}
+
+int outqueue_reap_zerocopy(OutQueue *outq, int fd)
+{
+    int completed = 0;
+
+#if OUTQUEUE_HAS_ZEROCOPY
+    union
+    {
+        char buf[CMSG_SPACE(sizeof(struct sock_extended_err))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr msg;
+
+    while (true)
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            break; // NOTE: EAGAIN means the error queue is empty.
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+        {
+            bool is_recverr = (cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR)
+                || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR);
+            const struct sock_extended_err *err_info = (const struct sock_extended_err *)CMSG_DATA(cmsg);
+
+            if (!is_recverr || err_info->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err_info->ee_errno != 0)
+                return -1;
+
+            // Each notice covers an inclusive range of send numbers.
+            uint32_t range_count = err_info->ee_data - err_info->ee_info + 1;
+
+            outq->zerocopy_inflight -= (range_count < outq->zerocopy_inflight) ? range_count : outq->zerocopy_inflight;
+            completed += (int)range_count;
+
+            if (err_info->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+                outq->zerocopy_min = 0;
+        }
+    }
+#else
+    (void)outq;
+    (void)fd;
+#endif
+
+    return completed;
+}
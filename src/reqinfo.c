@@ -8,6 +8,8 @@
  * 
  */
 
+#include <stdint.h>
+#include <strings.h>
 #include "h1c/reqinfo.h"
 
 MimeType mime_id_to_code(const char *mime_str)
@@ -22,20 +24,350 @@ MimeType mime_id_to_code(const char *mime_str)
         return TXT_CSS;
     else if (strcmp(mime_str, MIME_TXT_JS) == 0)
         return TXT_JS;
+    else if (strcmp(mime_str, MIME_APP_OCTET) == 0)
+        return APP_OCTET;
 
     return MIME_UNKNOWN;
 }
 
+const char *method_code_to_name(HttpMethod method)
+{
+    switch (method)
+    {
+    case ANYTHING:
+        return HTTP_METHOD_ANY;
+    case HEAD:
+        return HTTP_METHOD_HEAD;
+    case GET:
+        return HTTP_METHOD_GET;
+    case POST:
+        return HTTP_METHOD_POST;
+    default:
+        return "OTHER";
+    }
+}
+
+static bool encoding_token_is_refused(const char *params_str, int params_len)
+{
+    // Only "q=0", "q=0.0", etc. refuse a coding, so any other digit after the point keeps it acceptable.
+    const char *q_cursor = NULL;
+
+    for (int i = 0; i + 1 < params_len; i++)
+    {
+        if (params_str[i] == 'q' && params_str[i + 1] == '=')
+        {
+            q_cursor = params_str + i + 2;
+            break;
+        }
+    }
+
+    if (!q_cursor || *q_cursor != '0')
+        return false;
+
+    q_cursor++;
+
+    if (*q_cursor == '.')
+        q_cursor++;
+
+    while (*q_cursor == '0')
+        q_cursor++;
+
+    return *q_cursor < '1' || *q_cursor > '9';
+}
+
+int accept_encoding_to_flags(const char *hvalue_str)
+{
+    int flags = ENCODING_FLAG(ENCODING_IDENTITY);
+    int named_flags = 0;       // codings listed by name, whether accepted or refused
+    bool any_accepted = false; // "*" stands for the codings not named elsewhere
+    const char *cursor = hvalue_str;
+
+    while (cursor != NULL && *cursor != '\0')
+    {
+        // 1. Skip list separators and whitespace before the next coding token.
+        while (*cursor == ',' || *cursor == HTTP_1X_SP || *cursor == '\t')
+            cursor++;
+
+        const char *token_start = cursor;
+        int token_len = 0;
+        int params_len = 0;
+
+        while (cursor[token_len] != '\0' && cursor[token_len] != ',' && cursor[token_len] != ';' && cursor[token_len] != HTTP_1X_SP)
+            token_len++;
+
+        cursor += token_len;
+
+        // 2. Find optional parameters such as "q=0.5" up to the end of this list item.
+        const char *params_str = cursor;
+
+        while (params_str[params_len] != '\0' && params_str[params_len] != ',')
+            params_len++;
+
+        cursor += params_len;
+
+        if (token_len == 0)
+            continue;
+
+        // 3. Match recognized codings, which are case-insensitive... Unknown ones like deflate are ignored since no variant exists for them.
+        int token_flag = 0;
+
+        if (token_len == 4 && strncasecmp(token_start, ENCODING_TOKEN_GZIP, 4) == 0)
+            token_flag = ENCODING_FLAG(ENCODING_GZIP);
+        else if (token_len == 2 && strncasecmp(token_start, ENCODING_TOKEN_BR, 2) == 0)
+            token_flag = ENCODING_FLAG(ENCODING_BR);
+        else if (token_len == 1 && strncmp(token_start, ENCODING_TOKEN_ANY, 1) == 0)
+        {
+            any_accepted = !encoding_token_is_refused(params_str, params_len);
+            continue;
+        }
+
+        named_flags |= token_flag;
+
+        if (!encoding_token_is_refused(params_str, params_len))
+            flags |= token_flag;
+    }
+
+    if (any_accepted)
+        flags |= (ENCODING_FLAG(ENCODING_GZIP) | ENCODING_FLAG(ENCODING_BR)) & ~named_flags;
+
+    return flags;
+}
+
+bool header_list_has_token(const char *hvalue_str, const char *token)
+{
+    size_t token_len = strlen(token);
+    const char *cursor = hvalue_str;
+
+    while (*cursor != '\0')
+    {
+        while (*cursor == ' ' || *cursor == '\t' || *cursor == ',')
+            cursor++;
+
+        const char *item_begin = cursor;
+
+        while (*cursor != '\0' && *cursor != ',')
+            cursor++;
+
+        // Trim the item's trailing spaces before comparing it whole.
+        const char *item_end = cursor;
+
+        while (item_end > item_begin && (item_end[-1] == ' ' || item_end[-1] == '\t'))
+            item_end--;
+
+        if ((size_t)(item_end - item_begin) == token_len && strncasecmp(item_begin, token, token_len) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+bool content_length_parse(const char *hvalue_str, size_t *len_ref)
+{
+    size_t length = 0;
+    const char *cursor = hvalue_str;
+
+    if (*cursor == '\0')
+        return false;
+
+    // Parse by hand since strtoull accepts signs and whitespace that Content-Length forbids.
+    for (; *cursor != '\0'; cursor++)
+    {
+        if (*cursor < '0' || *cursor > '9')
+            return false;
+
+        size_t digit = *cursor - '0';
+
+        if (length > (SIZE_MAX - digit) / 10)
+            return false;
+
+        length = length * 10 + digit;
+    }
+
+    *len_ref = length;
+
+    return true;
+}
+
+bool chunk_size_parse(const char *line_str, size_t *size_ref)
+{
+    size_t size = 0;
+    size_t digit = 0;
+    const char *cursor = line_str;
+
+    for (; *cursor != '\0' && *cursor != ';' && *cursor != ' ' && *cursor != '\t'; cursor++)
+    {
+        if (*cursor >= '0' && *cursor <= '9')
+            digit = *cursor - '0';
+        else if (*cursor >= 'a' && *cursor <= 'f')
+            digit = *cursor - 'a' + 10;
+        else if (*cursor >= 'A' && *cursor <= 'F')
+            digit = *cursor - 'A' + 10;
+        else
+            return false;
+
+        if (size > (SIZE_MAX - digit) / 16)
+            return false;
+
+        size = size * 16 + digit;
+    }
+
+    // The size needs at least one digit, so a bare extension is malformed.
+    if (cursor == line_str)
+        return false;
+
+    *size_ref = size;
+
+    return true;
+}
+
+time_t http_date_to_time(const char *date_str)
+{
+    struct tm gmt_date;
+
+    memset(&gmt_date, 0, sizeof(gmt_date));
+
+    if (!date_str || !strptime(date_str, HTTP_GMT_FMT, &gmt_date))
+        return 0;
+
+    return timegm(&gmt_date);
+}
+
+bool etag_list_has_match(const char *etag_list_str, const char *etag)
+{
+    int etag_len = strlen(etag);
+    const char *cursor = etag_list_str;
+
+    if (!cursor || etag_len == 0)
+        return false;
+
+    while (*cursor != '\0')
+    {
+        while (*cursor == ',' || *cursor == HTTP_1X_SP || *cursor == '\t')
+            cursor++;
+
+        if (*cursor == '*')
+            return true;
+
+        if (strncmp(cursor, "W/", 2) == 0)
+            cursor += 2;
+
+        int tag_len = 0;
+
+        while (cursor[tag_len] != '\0' && cursor[tag_len] != ',' && cursor[tag_len] != HTTP_1X_SP)
+            tag_len++;
+
+        if (tag_len == etag_len && strncmp(cursor, etag, etag_len) == 0)
+            return true;
+
+        cursor += tag_len;
+    }
+
+    return false;
+}
+
+static const char *byte_range_parse_num(const char *cursor, int *num_ref)
+{
+    long long num = 0;
+    const char *start = cursor;
+
+    while (*cursor >= '0' && *cursor <= '9')
+    {
+        num = num * 10 + (*cursor - '0');
+
+        // Positions past INT_MAX cannot be in any payload, so just saturate them.
+        if (num > INT32_MAX)
+            num = INT32_MAX;
+
+        cursor++;
+    }
+
+    *num_ref = (cursor != start) ? (int)num : -1;
+
+    return cursor;
+}
+
+int byte_ranges_parse(const char *range_str, int full_len, ByteRange *ranges, int max_count)
+{
+    int unit_len = strlen(HTTP_RANGE_UNIT_PREFIX);
+    int range_count = 0;
+    const char *cursor = range_str;
+
+    if (!cursor || strncmp(cursor, HTTP_RANGE_UNIT_PREFIX, unit_len) != 0)
+        return BYTE_RANGES_INVALID;
+
+    cursor += unit_len;
+
+    while (*cursor != '\0')
+    {
+        int first = -1;
+        int last = -1;
+
+        while (*cursor == HTTP_1X_SP || *cursor == '\t')
+            cursor++;
+
+        // 1. Read "first-last", "first-", or the suffix form "-count".
+        cursor = byte_range_parse_num(cursor, &first);
+
+        if (*cursor != '-')
+            return BYTE_RANGES_INVALID;
+
+        cursor = byte_range_parse_num(cursor + 1, &last);
+
+        if ((first == -1 && last == -1) || (first != -1 && last != -1 && last < first))
+            return BYTE_RANGES_INVALID;
+
+        while (*cursor == HTTP_1X_SP || *cursor == '\t')
+            cursor++;
+
+        if (*cursor == ',')
+            cursor++;
+        else if (*cursor != '\0')
+            return BYTE_RANGES_INVALID;
+
+        // 2. Clamp the range to the payload, or skip it when it lies past the end.
+        if (first == -1)
+        {
+            if (last == 0 || full_len == 0)
+                continue;
+
+            first = (last >= full_len) ? 0 : full_len - last;
+            last = full_len - 1;
+        }
+        else
+        {
+            if (first >= full_len)
+                continue;
+
+            if (last == -1 || last >= full_len)
+                last = full_len - 1;
+        }
+
+        if (range_count >= max_count)
+            return BYTE_RANGES_INVALID;
+
+        ranges[range_count].first = first;
+        ranges[range_count].last = last;
+        range_count++;
+    }
+
+    return range_count;
+}
+
 void basic_reqinfo_init(BaseRequest *base_req)
 {
     base_req->schema_id = HTTP_SCHEMA_1_0;
     base_req->method_id = UNKNOWN;
     base_req->path_str = NULL;
     base_req->host_hstr = NULL;
+    base_req->if_none_match_hstr = NULL;
+    base_req->range_hstr = NULL;
+    base_req->if_range_hstr = NULL;
     base_req->body_blob = NULL;
     base_req->keep_connection = false;
     base_req->mime_type = ANY_ANY;
     base_req->content_len = 0;
+    base_req->accept_encodings = ENCODING_FLAG(ENCODING_IDENTITY);
+    base_req->if_modified_since = 0;
 }
 
 void basic_reqinfo_clear(BaseRequest *base_req)
@@ -43,21 +375,17 @@ void basic_reqinfo_clear(BaseRequest *base_req)
     base_req->schema_id = HTTP_SCHEMA_1_0;
     base_req->method_id = HEAD;
 
-    if (base_req->path_str != NULL)
-    {
-        free(base_req->path_str);
-        base_req->path_str = NULL;
-    }
-
-    if (base_req->host_hstr != NULL)
-    {
-        free(base_req->host_hstr);
-        base_req->host_hstr = NULL;
-    }
-
-    base_req->body_blob = NULL;  // NOTE: Unbind blob managed by StaticResource objects instead.
+    // NOTE: Scanned strings are owned by the worker's request arena, so just unbind them before its bulk reset.
+    base_req->path_str = NULL;
+    base_req->host_hstr = NULL;
+    base_req->if_none_match_hstr = NULL;
+    base_req->range_hstr = NULL;
+    base_req->if_range_hstr = NULL;
+    base_req->body_blob = NULL;
 
     base_req->keep_connection = false;
     base_req->mime_type = ANY_ANY;
     base_req->content_len = 0;
+    base_req->accept_encodings = ENCODING_FLAG(ENCODING_IDENTITY);
+    base_req->if_modified_since = 0;
 }
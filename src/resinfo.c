@@ -12,44 +12,86 @@
 
 void resinfo_init(ResponseObj *response, const char *server_name)
 {
+    response->status_code = 0;
     response->status_line_len = 0;
     memset(response->status_line, '\0', STATUS_LINE_BUFSIZE);
     response->server_name_ref = server_name;
     response->date = time(NULL);
     response->keep_connection = false;
+    response->keepalive_timeout = 0;
+    response->keepalive_max = 0;
     response->mime_type = MIME_UNKNOWN;
     response->content_len = 0;
+    response->encoding = ENCODING_IDENTITY;
+    response->vary_encoding = false;
+    response->header_only = false;
+    response->etag_ref = NULL;
+    response->last_modified = 0;
+    response->accept_ranges = false;
+    response->range_unsatisfied = false;
+    response->range_count = 0;
+    response->streamed = false;
+    response->chunked = false;
     response->body_blob = NULL;
+    response->body_shared = false;
 }
 
 void resinfo_reset(ResponseObj *response, ResponseRstMode mode)
 {
     if (mode == RES_RST_ALL)
     {
+        response->status_code = 0;
         response->status_line_len = 0;
         memset(response->status_line, '\0', STATUS_LINE_BUFSIZE);
         response->date = time(NULL);
         response->keep_connection = false;
+        response->keepalive_timeout = 0;
+        response->keepalive_max = 0;
         response->mime_type = MIME_UNKNOWN;
         response->content_len = 0;
+        response->encoding = ENCODING_IDENTITY;
+        response->vary_encoding = false;
+        response->header_only = false;
+        response->etag_ref = NULL;
+        response->last_modified = 0;
+        response->accept_ranges = false;
+        response->range_unsatisfied = false;
+        response->range_count = 0;
+        response->streamed = false;
+        response->chunked = false;
         response->body_blob = NULL;
+        response->body_shared = false;
         return;
     }
     else if (mode == RES_RST_HEADERS)
     {
         response->date = time(NULL);
         response->keep_connection = false;
+        response->keepalive_timeout = 0;
+        response->keepalive_max = 0;
         response->mime_type = MIME_UNKNOWN;
+        response->encoding = ENCODING_IDENTITY;
+        response->vary_encoding = false;
+        response->header_only = false;
+        response->etag_ref = NULL;
+        response->last_modified = 0;
+        response->accept_ranges = false;
     }
     else if (mode == RES_RST_PAYLOAD)
     {
         response->content_len = 0;
+        response->range_unsatisfied = false;
+        response->range_count = 0;
+        response->streamed = false;
+        response->chunked = false;
         response->body_blob = NULL;
+        response->body_shared = false;
     }
 }
 
 void resinfo_fill_status_line(ResponseObj *response, const char *schema, const char *code, const char *msg)
 {
+    response->status_code = atoi(code);
     response->status_line_len = sprintf(response->status_line, "%s %s %s\r\n", schema, code, msg);
 }
 
@@ -58,6 +100,12 @@ void resinfo_set_keep_connection(ResponseObj *response, bool is_persistent)
     response->keep_connection = is_persistent;
 }
 
+void resinfo_set_keep_alive(ResponseObj *response, int timeout, int max_requests)
+{
+    response->keepalive_timeout = timeout;
+    response->keepalive_max = max_requests;
+}
+
 void resinfo_set_mime_type(ResponseObj *response, MimeType mime_type)
 {
     response->mime_type = mime_type;
@@ -68,7 +116,60 @@ void resinfo_set_content_length(ResponseObj *response, int content_length)
     response->content_len = content_length;
 }
 
+void resinfo_set_encoding(ResponseObj *response, ContentEncoding encoding, bool is_negotiated)
+{
+    response->encoding = encoding;
+    response->vary_encoding = is_negotiated;
+}
+
+void resinfo_set_validators(ResponseObj *response, const char *etag, time_t last_modified)
+{
+    response->etag_ref = etag;
+    response->last_modified = last_modified;
+}
+
+void resinfo_set_header_only(ResponseObj *response, bool is_header_only)
+{
+    response->header_only = is_header_only;
+}
+
+void resinfo_set_accept_ranges(ResponseObj *response, bool is_range_capable)
+{
+    response->accept_ranges = is_range_capable;
+}
+
+void resinfo_set_ranges(ResponseObj *response, const ByteRange *ranges, int range_count)
+{
+    int safe_count = (range_count > 0 && range_count <= BYTE_RANGES_MAX_COUNT) ? range_count : 0;
+
+    memcpy(response->ranges, ranges, safe_count * sizeof(ByteRange));
+    response->range_count = safe_count;
+    response->range_unsatisfied = false;
+}
+
+void resinfo_set_range_unsatisfied(ResponseObj *response)
+{
+    response->range_count = 0;
+    response->range_unsatisfied = true;
+}
+
+void resinfo_set_streamed(ResponseObj *response, bool is_chunked)
+{
+    response->streamed = true;
+    response->chunked = is_chunked;
+
+    if (!is_chunked)
+        response->keep_connection = false;
+}
+
 void resinfo_set_body_payload(ResponseObj *response, char *blob)
 {
     response->body_blob = blob;
+    response->body_shared = false;
+}
+
+void resinfo_set_shared_payload(ResponseObj *response, char *blob)
+{
+    response->body_blob = blob;
+    response->body_shared = true;
 }
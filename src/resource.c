@@ -8,28 +8,29 @@
  * 
  */
 
+#include <inttypes.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <zlib.h>
 #include "utils/resource.h"
 
+/* Magic Macros */
+
+#define SIDECAR_NAME_BUFSIZE 256
+#define GZIP_WINDOW_BITS (15 + 16)
+#define GZIP_MEM_LEVEL 9
+
 /* Helper Funcs. */
 
 MimeType filename_get_mime(const char *fname)
 {
-    const char *cursor = fname;
-    char temp = *cursor;
+    // Use the last dot since relative paths like "./www/a.css" have leading dots too.
+    const char *cursor = strrchr(fname, '.');
 
-    if (temp == '.' || temp == '\0')
+    if (!cursor || strchr(cursor, '/') != NULL)
         return ANY_ANY;
 
-    // skip separating dot if any
-    while (temp != '\0')
-    {
-        if (temp == '.')
-            break;
-
-        cursor++;
-        temp = *cursor;
-    }
-
     if (strncmp(cursor, FILE_EXT_TXT, 4) == 0)
         return TXT_PLAIN;
 
@@ -81,39 +82,191 @@ char *file_read_all(const char *fname, size_t *read_count_ref)
     return data;
 }
 
-/* StaticResource Funcs. */
+char *file_map_all(const char *fname, size_t *map_count_ref)
+{
+    struct stat file_info;
+    void *mapping = MAP_FAILED;
+    int fd = open(fname, O_RDONLY);
 
-bool statsrc_init(StaticResource *statsrc, const char *fname)
+    *map_count_ref = 0;
+
+    if (fd == -1)
+        return NULL;
+
+    // Empty files cannot be mapped, so their callers should fall back to file_read_all.
+    if (fstat(fd, &file_info) == 0 && file_info.st_size > 0)
+        mapping = mmap(NULL, file_info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+        return NULL;
+
+    *map_count_ref = file_info.st_size;
+
+    return mapping;
+}
+
+char *data_gzip_all(const char *data, size_t data_len, size_t *gzip_count_ref)
 {
-    statsrc->fname = fname;
-    statsrc->type = filename_get_mime(fname);
+    z_stream stream;
+    char *gzip_data = NULL;
+    size_t gzip_capacity = 0;
+
+    *gzip_count_ref = 0;
+    memset(&stream, 0, sizeof(stream));
+
+    // Use the +16 window bits for a gzip wrapper instead of a raw zlib stream.
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, GZIP_WINDOW_BITS, GZIP_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+
+    gzip_capacity = deflateBound(&stream, data_len);
+    gzip_data = malloc(gzip_capacity);
+
+    if (!gzip_data)
+    {
+        deflateEnd(&stream);
+        return NULL;
+    }
+
+    stream.next_in = (Bytef *)data;
+    stream.avail_in = data_len;
+    stream.next_out = (Bytef *)gzip_data;
+    stream.avail_out = gzip_capacity;
+
+    // The output bound fits the whole stream, so one finishing pass is enough.
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END)
+    {
+        free(gzip_data);
+        deflateEnd(&stream);
+        return NULL;
+    }
+
+    *gzip_count_ref = stream.total_out;
+    deflateEnd(&stream);
+
+    return gzip_data;
+}
+
+static bool statsrc_load_variant(StaticResource *statsrc, ContentEncoding encoding, const char *fname)
+{
+    StaticVariant *variant_ref = &statsrc->variants[encoding];
+
+    variant_ref->data = file_map_all(fname, &variant_ref->clen);
+    variant_ref->mapped = variant_ref->data != NULL;
+
+    if (!variant_ref->mapped)
+        variant_ref->data = file_read_all(fname, &variant_ref->clen);
 
+    return variant_ref->data != NULL;
+}
+
+static void statsrc_load_sidecar(StaticResource *statsrc, ContentEncoding encoding, const char *ext)
+{
+    char sidecar_name[SIDECAR_NAME_BUFSIZE];
+    int name_len = snprintf(sidecar_name, SIDECAR_NAME_BUFSIZE, "%s%s", statsrc->fname, ext);
+
+    if (name_len < 0 || name_len >= SIDECAR_NAME_BUFSIZE)
+        return;
+
+    // A missing sidecar file is normal, and it just leaves the variant empty.
+    statsrc_load_variant(statsrc, encoding, sidecar_name);
+}
+
+static void statsrc_load_gzip(StaticResource *statsrc)
+{
+    const StaticVariant *identity_ref = &statsrc->variants[ENCODING_IDENTITY];
+    StaticVariant *gzip_ref = &statsrc->variants[ENCODING_GZIP];
     size_t temp_clen = 0;
-    char *raw_data = file_read_all(fname, &temp_clen);
-    bool alloc_ok = raw_data != NULL;
 
-    if (alloc_ok)
+    if (gzip_ref->data != NULL || identity_ref->clen < STATSRC_GZIP_MIN_SIZE)
+        return;
+
+    if (statsrc->type == ANY_ANY || statsrc->type == MIME_UNKNOWN)
+        return;
+
+    char *gzip_data = data_gzip_all(identity_ref->data, identity_ref->clen, &temp_clen);
+
+    if (!gzip_data)
+        return;
+
+    // Keep the gzip variant only if it is really smaller than the original.
+    if (temp_clen >= identity_ref->clen)
+    {
+        free(gzip_data);
+        return;
+    }
+
+    gzip_ref->data = gzip_data;
+    gzip_ref->clen = temp_clen;
+}
+
+static void statsrc_load_validators(StaticResource *statsrc)
+{
+    struct stat file_info;
+
+    statsrc->mtime = (stat(statsrc->fname, &file_info) == 0) ? file_info.st_mtime : 0;
+
+    // Hash each variant separately since a strong ETag must change with the coding too.
+    for (int i = 0; i < ENCODING_COUNT; i++)
     {
-        statsrc->data = raw_data;
-        statsrc->clen = temp_clen;
+        StaticVariant *variant_ref = &statsrc->variants[i];
+
+        if (!variant_ref->data)
+            continue;
+
+        uint64_t content_hash = hash_bytes_fnv1a(variant_ref->data, variant_ref->clen);
+
+        snprintf(variant_ref->etag, STATSRC_ETAG_BUFSIZE, "\"%016" PRIx64 "\"", content_hash);
     }
-    else
+}
+
+/* StaticResource Funcs. */
+
+bool statsrc_init(StaticResource *statsrc, const char *fname)
+{
+    statsrc->fname = fname;
+    statsrc->type = filename_get_mime(fname);
+    statsrc->mtime = 0;
+
+    for (int i = 0; i < ENCODING_COUNT; i++)
     {
-        statsrc->data = NULL;
-        statsrc->clen = 0;
+        statsrc->variants[i].data = NULL;
+        statsrc->variants[i].clen = 0;
+        statsrc->variants[i].mapped = false;
+        statsrc->variants[i].etag[0] = '\0';
     }
 
+    bool alloc_ok = statsrc_load_variant(statsrc, ENCODING_IDENTITY, fname);
+
+    if (!alloc_ok)
+        return alloc_ok;
+
+    // Prefer precompressed files on disk, then compress any missing gzip variant just once here instead of per request.
+    statsrc_load_sidecar(statsrc, ENCODING_GZIP, FILE_EXT_GZIP);
+    statsrc_load_sidecar(statsrc, ENCODING_BR, FILE_EXT_BR);
+    statsrc_load_gzip(statsrc);
+    statsrc_load_validators(statsrc);
+
     return alloc_ok;
 }
 
 void statsrc_dispose(StaticResource *statsrc)
 {
-    if (!statsrc->data)
-        return;
+    for (int i = 0; i < ENCODING_COUNT; i++)
+    {
+        if (!statsrc->variants[i].data)
+            continue;
 
-    free(statsrc->data);
-    statsrc->data = NULL;
-    statsrc->clen = 0;
+        if (statsrc->variants[i].mapped)
+            munmap(statsrc->variants[i].data, statsrc->variants[i].clen);
+        else
+            free(statsrc->variants[i].data);
+
+        statsrc->variants[i].data = NULL;
+        statsrc->variants[i].clen = 0;
+        statsrc->variants[i].mapped = false;
+    }
 }
 
 MimeType statsrc_get_type(const StaticResource *statsrc)
@@ -123,10 +276,45 @@ MimeType statsrc_get_type(const StaticResource *statsrc)
 
 int statsrc_get_length(const StaticResource *statsrc)
 {
-    return statsrc->clen;
+    return statsrc->variants[ENCODING_IDENTITY].clen;
 }
 
 const char *statsrc_view_data(const StaticResource *statsrc)
 {
-    return statsrc->data;
+    return statsrc->variants[ENCODING_IDENTITY].data;
+}
+
+bool statsrc_has_encodings(const StaticResource *statsrc)
+{
+    for (int i = ENCODING_IDENTITY + 1; i < ENCODING_COUNT; i++)
+    {
+        if (statsrc->variants[i].data != NULL)
+            return true;
+    }
+
+    return false;
+}
+
+const StaticVariant *statsrc_pick_variant(const StaticResource *statsrc, int accept_flags, ContentEncoding *encoding_ref)
+{
+    ContentEncoding best_encoding = ENCODING_IDENTITY;
+    const StaticVariant *best_ref = &statsrc->variants[ENCODING_IDENTITY];
+
+    for (int i = ENCODING_IDENTITY + 1; i < ENCODING_COUNT; i++)
+    {
+        const StaticVariant *temp_ref = &statsrc->variants[i];
+
+        if (!temp_ref->data || !(accept_flags & ENCODING_FLAG(i)))
+            continue;
+
+        if (temp_ref->clen < best_ref->clen)
+        {
+            best_encoding = (ContentEncoding)i;
+            best_ref = temp_ref;
+        }
+    }
+
+    *encoding_ref = best_encoding;
+
+    return best_ref;
 }
@@ -54,13 +54,15 @@ void restable_dispose(ResourceTable *restable)
     {
         curr_ref = *statres_ref;
 
-        if (!curr_ref)
-            continue;
-
-        statsrc_dispose(curr_ref);
-        free(curr_ref);
+        // Advance past empty buckets too, or the loop never reaches the end of the table.
+        if (curr_ref)
+        {
+            statsrc_dispose(curr_ref);
+            free(curr_ref);
+        }
 
         statres_ref++;
+        bucket_pos++;
     }
     
     free(restable->resources);
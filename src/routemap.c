@@ -63,7 +63,6 @@ bool rtemap_put(RouteMap *rtemap, RoutedNode *new_node)
 
     if (!rtemap->root)
     {
-        puts("put root handler node"); // debug!!
         rtemap->root = new_node;
         rtemap->count++;
         return true;
@@ -94,13 +93,11 @@ bool rtemap_put(RouteMap *rtemap, RoutedNode *new_node)
         return false;
     else if (key_compare < 0)
     {
-        printf("adding L key %i\n", key_compare); // debug!!
         parent_ptr->left = new_node;
         rtemap->count++;
     }
     else
     {
-        printf("adding R key %i\n", key_compare); // debug!!
         parent_ptr->right = new_node;
         rtemap->count++;
     }
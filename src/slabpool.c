@@ -0,0 +1,98 @@
+/**
+ * @file slabpool.c
+ * @author Derek Tan
+ * @brief Implements a lock-free pool of fixed-size buffer slabs.
+ * @date 2023-12-12
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include "collections/slabpool.h"
+
+/* Helper Funcs. */
+
+static uint64_t slabpool_pack_head(uint64_t tag, uint32_t slab_id)
+{
+    return (tag << 32) | slab_id;
+}
+
+/* SlabPool Funcs. */
+
+bool slabpool_init(SlabPool *pool, uint32_t slab_count, size_t slab_size)
+{
+    uint32_t safe_count = (slab_count >= SLABPOOL_MIN_COUNT && slab_count <= SLABPOOL_MAX_COUNT)
+        ? slab_count
+        : SLABPOOL_MIN_COUNT;
+
+    pool->slab_size = slab_size;
+    pool->slab_count = 0;
+    pool->slabs = malloc(safe_count * slab_size);
+    pool->next_ids = malloc(safe_count * sizeof(_Atomic uint32_t));
+    atomic_init(&pool->head, slabpool_pack_head(0, SLABPOOL_NIL_ID));
+
+    if (!pool->slabs || !pool->next_ids)
+    {
+        slabpool_dispose(pool);
+        return false;
+    }
+
+    // Chain every slab in address order: id i links to id i + 1, and the last one ends the list.
+    for (uint32_t i = 0; i < safe_count; i++)
+        atomic_init(&pool->next_ids[i], (i + 1 < safe_count) ? i + 2 : SLABPOOL_NIL_ID);
+
+    pool->slab_count = safe_count;
+    atomic_store(&pool->head, slabpool_pack_head(0, 1));
+
+    return true;
+}
+
+void slabpool_dispose(SlabPool *pool)
+{
+    free(pool->slabs);
+    free((void *)pool->next_ids);
+    pool->slabs = NULL;
+    pool->next_ids = NULL;
+    pool->slab_count = 0;
+    atomic_store(&pool->head, slabpool_pack_head(0, SLABPOOL_NIL_ID));
+}
+
+char *slabpool_acquire(SlabPool *pool)
+{
+    uint64_t old_head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    uint64_t new_head = 0;
+    uint32_t slab_id = SLABPOOL_NIL_ID;
+
+    do
+    {
+        slab_id = (uint32_t)old_head;
+
+        if (slab_id == SLABPOOL_NIL_ID)
+            return NULL;
+
+        uint32_t next_id = atomic_load_explicit(&pool->next_ids[slab_id - 1], memory_order_relaxed);
+        new_head = slabpool_pack_head((old_head >> 32) + 1, next_id);
+    }
+    while (!atomic_compare_exchange_weak_explicit(&pool->head, &old_head, new_head, memory_order_acq_rel, memory_order_acquire));
+
+    return pool->slabs + (size_t)(slab_id - 1) * pool->slab_size;
+}
+
+void slabpool_release(SlabPool *pool, char *slab)
+{
+    char *pool_end = pool->slabs + (size_t)pool->slab_count * pool->slab_size;
+
+    if (!slab || slab < pool->slabs || slab >= pool_end)
+        return;
+
+    uint32_t slab_id = (uint32_t)((slab - pool->slabs) / pool->slab_size) + 1;
+    uint64_t old_head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    uint64_t new_head = 0;
+
+    do
+    {
+        atomic_store_explicit(&pool->next_ids[slab_id - 1], (uint32_t)old_head, memory_order_relaxed);
+        new_head = slabpool_pack_head((old_head >> 32) + 1, slab_id);
+    }
+    while (!atomic_compare_exchange_weak_explicit(&pool->head, &old_head, new_head, memory_order_release, memory_order_relaxed));
+}
@@ -1,7 +1,7 @@
 /**
  * @file sockets.c
  * @author Derek Tan
- * @brief Implements synchronous I/O wrappers for TCP sockets. 
+ * @brief Implements I/O wrappers for TCP sockets with read deadlines and queued non-blocking sends.
  * @date 2023-09-01
  * 
  * @copyright Copyright (c) 2023
@@ -10,6 +10,76 @@
 
 #include "basicio/sockets.h"
 
+/** ServerSocket Helpers */
+
+static void serversocket_fail(ServerSocket *svr_sock)
+{
+    if (svr_sock->fd != -1)
+        close(svr_sock->fd);
+
+    svr_sock->fd = -1;
+    svr_sock->ready = false;
+    svr_sock->closed = true;
+}
+
+/**
+ * @brief Finishes setup shared by every kind of listener once its socket is bound.
+ */
+static void serversocket_setup_bound(ServerSocket *svr_sock)
+{
+    // The listener is polled, so accepting must never block on a connection another wakeup already took.
+    int fd_flags = fcntl(svr_sock->fd, F_GETFL, 0);
+
+    if (fd_flags != -1)
+        fcntl(svr_sock->fd, F_SETFL, fd_flags | O_NONBLOCK);
+
+    fcntl(svr_sock->fd, F_SETFD, FD_CLOEXEC);
+    memset(&svr_sock->opts, 0, sizeof(svr_sock->opts));
+
+    svr_sock->ready = true;
+    svr_sock->closed = false;
+}
+
+/**
+ * @brief Checks whether nothing listens on a Unix socket path anymore, as when its server died without unlinking it.
+ */
+static bool serversocket_unix_is_stale(const struct sockaddr_un *addr, socklen_t addr_len)
+{
+    int probe_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (probe_fd == -1)
+        return false;
+
+    bool is_stale = connect(probe_fd, (const struct sockaddr *)addr, addr_len) == -1 && errno == ECONNREFUSED;
+
+    close(probe_fd);
+
+    return is_stale;
+}
+
+/**
+ * @brief Applies the TCP options that must be set before listening.
+ */
+static void serversocket_apply_options(ServerSocket *svr_sock)
+{
+    const ServerSocketOpts *opts = &svr_sock->opts;
+    int flag_on = 1;
+
+    if (svr_sock->family == AF_UNIX)
+        return;
+
+    if (opts->defer_accept_secs > 0)
+        setsockopt(svr_sock->fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &opts->defer_accept_secs, sizeof(opts->defer_accept_secs));
+
+#ifdef TCP_FASTOPEN
+    if (opts->fastopen_qlen > 0)
+        setsockopt(svr_sock->fd, IPPROTO_TCP, TCP_FASTOPEN, &opts->fastopen_qlen, sizeof(opts->fastopen_qlen));
+#endif
+
+    if (opts->nodelay)
+        setsockopt(svr_sock->fd, IPPROTO_TCP, TCP_NODELAY, &flag_on, sizeof(flag_on));
+}
+
 /** ServerSocket */
 
 void serversocket_init(ServerSocket *svr_sock, const char *host, const char *port, int backlog)
@@ -17,11 +87,13 @@ void serversocket_init(ServerSocket *svr_sock, const char *host, const char *por
     bool ready_flag;
     int temp_fd;
     struct addrinfo config, *option_ptr;
+    svr_sock->fd = -1;
     svr_sock->backlog = backlog;
+    svr_sock->unix_path[0] = '\0';
 
-    // Setup socket configuration of TCP/IPv4 with local address.
+    // Setup socket configuration of TCP over IPv4 or IPv6, whichever the host is.
     memset(&config, 0, sizeof(config));
-    config.ai_family = AF_INET;
+    config.ai_family = AF_UNSPEC;
     config.ai_socktype = SOCK_STREAM;
     config.ai_flags = AI_PASSIVE;
 
@@ -29,9 +101,7 @@ void serversocket_init(ServerSocket *svr_sock, const char *host, const char *por
 
     if (!ready_flag)
     {
-        svr_sock->fd = -1;
-        svr_sock->ready = false;
-        svr_sock->closed = true;
+        serversocket_fail(svr_sock);
         return;
     }
 
@@ -40,13 +110,21 @@ void serversocket_init(ServerSocket *svr_sock, const char *host, const char *por
 
     if (temp_fd == -1)
     {
-        svr_sock->fd = -1;
-        svr_sock->ready = false;
-        svr_sock->closed = true;
+        freeaddrinfo(option_ptr);
+        serversocket_fail(svr_sock);
         return;
     }
 
     svr_sock->fd = temp_fd;
+    svr_sock->family = option_ptr->ai_family;
+
+    // Dual-stack: an IPv6 listener takes IPv4 clients too, unless the system forbids it.
+    if (svr_sock->family == AF_INET6)
+    {
+        int v6_only = 0;
+        setsockopt(svr_sock->fd, IPPROTO_IPV6, IPV6_V6ONLY, &v6_only, sizeof(v6_only));
+    }
+
     ready_flag = bind(svr_sock->fd, option_ptr->ai_addr, option_ptr->ai_addrlen) != -1;
 
     // Dispose intrusive list of socket config options...
@@ -54,21 +132,113 @@ void serversocket_init(ServerSocket *svr_sock, const char *host, const char *por
 
     if (!ready_flag)
     {
-        close(svr_sock->fd);
-        svr_sock->fd = -1;
-        svr_sock->ready = false;
-        svr_sock->closed = true;
+        serversocket_fail(svr_sock);
+        return;
     }
 
-    // Set connection timeout of 2.5s to reduce worker stalling.
-    struct timeval timeout;
-    timeout.tv_sec = 0;
-    timeout.tv_usec = 2500;
+    serversocket_setup_bound(svr_sock);
+}
 
-    setsockopt(svr_sock->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+void serversocket_init_unix(ServerSocket *svr_sock, const char *path, int backlog)
+{
+    struct sockaddr_un addr;
+    struct stat path_stat;
+    size_t path_len = strlen(path);
+    bool is_abstract = path[0] == SERVERSOCKET_ABSTRACT_MARK;
+    svr_sock->fd = -1;
+    svr_sock->backlog = backlog;
+    svr_sock->family = AF_UNIX;
+    svr_sock->unix_path[0] = '\0';
 
-    svr_sock->ready = ready_flag;
-    svr_sock->closed = false;
+    // Names must fit sun_path, and filesystem paths also need their NUL.
+    if (path_len == 0 || path_len >= sizeof(addr.sun_path) || (is_abstract && path_len == 1))
+    {
+        serversocket_fail(svr_sock);
+        return;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path, path_len);
+
+    // Abstract names start with a NUL byte instead of the mark, and their length comes from the address size.
+    socklen_t addr_len = offsetof(struct sockaddr_un, sun_path) + path_len + 1;
+
+    if (is_abstract)
+    {
+        addr.sun_path[0] = '\0';
+        addr_len = offsetof(struct sockaddr_un, sun_path) + path_len;
+    }
+    else if (lstat(path, &path_stat) == 0 && S_ISSOCK(path_stat.st_mode))
+    {
+        // NOTE: only stale sockets are replaced, never other files or one a running server still accepts on.
+        if (!serversocket_unix_is_stale(&addr, addr_len))
+        {
+            serversocket_fail(svr_sock);
+            return;
+        }
+
+        unlink(path);
+    }
+
+    svr_sock->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (svr_sock->fd == -1 || bind(svr_sock->fd, (struct sockaddr *)&addr, addr_len) == -1)
+    {
+        serversocket_fail(svr_sock);
+        return;
+    }
+
+    if (!is_abstract)
+        memcpy(svr_sock->unix_path, path, path_len + 1);
+
+    serversocket_setup_bound(svr_sock);
+}
+
+bool serversocket_init_address(ServerSocket *svr_sock, const char *address, int backlog)
+{
+    char host[SERVERSOCKET_HOST_SIZE];
+    size_t unix_prefix_len = strlen(SERVERSOCKET_UNIX_PREFIX);
+
+    if (strncmp(address, SERVERSOCKET_UNIX_PREFIX, unix_prefix_len) == 0)
+    {
+        serversocket_init_unix(svr_sock, address + unix_prefix_len, backlog);
+        return svr_sock->ready;
+    }
+
+    // The port follows the last colon, so bracketed IPv6 hosts may hold colons of their own.
+    const char *port = strrchr(address, ':');
+    const char *host_begin = address;
+    const char *host_end = port;
+
+    if (!port || port[1] == '\0')
+        return false;
+
+    if (address[0] == '[')
+    {
+        host_begin++;
+        host_end = strchr(address, ']');
+
+        if (!host_end || host_end + 1 != port)
+            return false;
+    }
+
+    size_t host_len = host_end - host_begin;
+
+    if (host_len == 0 || host_len >= sizeof(host))
+        return false;
+
+    memcpy(host, host_begin, host_len);
+    host[host_len] = '\0';
+
+    serversocket_init(svr_sock, host, port + 1, backlog);
+
+    return svr_sock->ready;
+}
+
+void serversocket_set_options(ServerSocket *svr_sock, const ServerSocketOpts *opts)
+{
+    svr_sock->opts = *opts;
 }
 
 bool serversocket_open(ServerSocket *svr_sock)
@@ -76,6 +246,8 @@ bool serversocket_open(ServerSocket *svr_sock)
     if (!svr_sock->ready || svr_sock->closed)
         return false;
 
+    serversocket_apply_options(svr_sock);
+
     return listen(svr_sock->fd, svr_sock->backlog) != -1;
 }
 
@@ -86,6 +258,17 @@ void serversocket_close(ServerSocket *svr_sock)
     
     close(svr_sock->fd);
     svr_sock->closed = true;
+
+    if (svr_sock->unix_path[0] != '\0')
+        unlink(svr_sock->unix_path);
+}
+
+void serversocket_shutdown(ServerSocket *svr_sock)
+{
+    if (!svr_sock->ready || svr_sock->closed)
+        return;
+
+    shutdown(svr_sock->fd, SHUT_RDWR);
 }
 
 int serversocket_accept(ServerSocket *svr_sock)
@@ -93,26 +276,175 @@ int serversocket_accept(ServerSocket *svr_sock)
     if (!svr_sock->ready || svr_sock->closed)
         return -1;
     
-    return accept(svr_sock->fd, NULL, NULL);
+    return accept4(svr_sock->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+}
+
+/** ClientSocket Helpers */
+
+/**
+ * @brief Polls for readability or writability until the deadline, so a silent client cannot block a worker forever.
+ * @returns false with errno as ETIMEDOUT and timed_out set once the deadline passes.
+ */
+static bool clientsocket_poll_deadline(ClientSocket *cli_sock, short events)
+{
+    int timeout_ms = -1;
+    int poll_rc = 0;
+
+    do
+    {
+        if (cli_sock->deadline_ms != CLIENTSOCKET_NO_DEADLINE)
+        {
+            uint64_t now_ms = timing_now_ms();
+
+            if (now_ms >= cli_sock->deadline_ms)
+            {
+                cli_sock->timed_out = true;
+                errno = ETIMEDOUT;
+                return false;
+            }
+
+            timeout_ms = (int)(cli_sock->deadline_ms - now_ms);
+        }
+
+        poll_rc = transport_poll(&cli_sock->transport, events, timeout_ms);
+
+        // Zero-copy completions poll as errors, so reap them and wait on.
+        if (poll_rc > 0 && (poll_rc & (events | POLLHUP)) == 0 && (poll_rc & POLLERR)
+            && outqueue_reap_zerocopy(&cli_sock->outq, cli_sock->transport.fd) > 0)
+            poll_rc = 0;
+    } while ((poll_rc == -1 && errno == EINTR) || poll_rc == 0);
+
+    return poll_rc > 0;
+}
+
+/**
+ * @brief Sends queued output without blocking, counting what goes out.
+ */
+static ssize_t clientsocket_flush(ClientSocket *cli_sock)
+{
+    ssize_t temp_wc = outqueue_is_empty(&cli_sock->outq) ? 0 : outqueue_flush(&cli_sock->outq, &cli_sock->transport);
+
+    if (temp_wc > 0)
+        cli_sock->bytes_out += temp_wc;
+
+    return temp_wc;
+}
+
+/**
+ * @brief Receives without blocking first, and only waits under the deadline when nothing is buffered yet.
+ */
+static ssize_t clientsocket_recv(ClientSocket *cli_sock, char *dst, size_t count)
+{
+    ssize_t temp_rc = 0;
+
+    while (true)
+    {
+        temp_rc = transport_recv(&cli_sock->transport, dst, count);
+
+        if (temp_rc > 0 && cli_sock->extend_ms != 0)
+            cli_sock->deadline_ms = timing_now_ms() + cli_sock->extend_ms;
+
+        if (temp_rc > 0)
+            cli_sock->bytes_in += temp_rc;
+        else if (temp_rc == 0)
+            cli_sock->read_failed = true;
+
+        if (temp_rc >= 0)
+            return temp_rc;
+
+        if (errno == EINTR)
+            continue;
+
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            break;
+
+        // Queued output may be what the client waits for before it sends more, as with "100 Continue".
+        if (clientsocket_flush(cli_sock) < 0)
+            break;
+
+        if (!clientsocket_poll_deadline(cli_sock, POLLIN))
+            break;
+    }
+
+    cli_sock->read_failed = true;
+
+    return -1;
+}
+
+/**
+ * @brief Sends queued output until no more than the limit of copied bytes is left, waiting for writability under the deadline.
+ */
+static bool clientsocket_drain_to(ClientSocket *cli_sock, size_t limit)
+{
+    while (cli_sock->outq.buffered > limit)
+    {
+        ssize_t temp_wc = clientsocket_flush(cli_sock);
+
+        if (temp_wc < 0)
+            return false;
+
+        if (temp_wc > 0 && cli_sock->extend_ms != 0)
+            cli_sock->deadline_ms = timing_now_ms() + cli_sock->extend_ms;
+
+        if (cli_sock->outq.buffered > limit && !clientsocket_poll_deadline(cli_sock, POLLOUT))
+            return false;
+    }
+
+    return true;
 }
 
 /** ClientSocket */
 
 void clientsocket_init(ClientSocket *cli_sock, int fd)
 {
-    cli_sock->fd = fd;
+    Transport socket_transport;
+
+    transport_init_socket(&socket_transport, fd);
+    clientsocket_init_transport(cli_sock, &socket_transport);
     cli_sock->closed = (fd == -1);
 }
 
+void clientsocket_init_transport(ClientSocket *cli_sock, const Transport *transport)
+{
+    cli_sock->transport = *transport;
+    cli_sock->closed = false;
+    cli_sock->deadline_ms = CLIENTSOCKET_NO_DEADLINE;
+    cli_sock->extend_ms = 0;
+    outqueue_init(&cli_sock->outq);
+    cli_sock->max_pending = CLIENTSOCKET_DEFAULT_MAX_PENDING;
+    cli_sock->bytes_in = 0;
+    cli_sock->bytes_out = 0;
+    cli_sock->read_failed = false;
+    cli_sock->timed_out = false;
+}
+
 void clientsocket_close(ClientSocket *cli_sock)
 {
     if (cli_sock->closed)
         return;
     
-    close(cli_sock->fd);
+    transport_close(&cli_sock->transport);
+    outqueue_clear(&cli_sock->outq);
     cli_sock->closed = true;
 }
 
+void clientsocket_set_deadline(ClientSocket *cli_sock, uint64_t deadline_ms, uint32_t extend_ms)
+{
+    cli_sock->deadline_ms = deadline_ms;
+    cli_sock->extend_ms = extend_ms;
+}
+
+void clientsocket_set_max_pending(ClientSocket *cli_sock, size_t max_pending)
+{
+    cli_sock->max_pending = max_pending;
+}
+
+void clientsocket_set_zerocopy(ClientSocket *cli_sock, size_t min_len)
+{
+    // Only real sockets have kernel pages to send from.
+    outqueue_set_zerocopy(&cli_sock->outq, transport_is_socket(&cli_sock->transport) ? min_len : 0);
+}
+
 bool clientsocket_read_line(ClientSocket *cli_sock, char delim, Buffer *dst_buf)
 {
     char byte;
@@ -121,7 +453,7 @@ bool clientsocket_read_line(ClientSocket *cli_sock, char delim, Buffer *dst_buf)
 
     do
     {
-        read_ok = recv(cli_sock->fd, &byte, 1, 0) != -1;
+        read_ok = clientsocket_recv(cli_sock, &byte, 1) > 0; // NOTE: 0 means the peer closed, which is common between persistent requests.
 
         if (!read_ok)
             break;
@@ -144,45 +476,151 @@ bool clientsocket_read_line(ClientSocket *cli_sock, char delim, Buffer *dst_buf)
     return read_ok && buffer_ok;
 }
 
-bool clientsocket_read_blob(ClientSocket *cli_sock, int count, Buffer *dst_buf)
+bool clientsocket_has_input(ClientSocket *cli_sock)
 {
-    int pending_rc = count;
-    char byte;
-    bool read_ok = true;
-    bool buffer_ok = true;
+    int revents = transport_poll(&cli_sock->transport, POLLIN, 0);
 
-    do
+    if (revents <= 0)
+        return false;
+
+    // Zero-copy completions are not input, and reaping them leaves a connection free to idle.
+    if ((revents & (POLLIN | POLLHUP)) == 0 && outqueue_reap_zerocopy(&cli_sock->outq, cli_sock->transport.fd) > 0)
     {
-        read_ok = recv(cli_sock->fd, &byte, 1, 0) != -1;
+        revents = transport_poll(&cli_sock->transport, POLLIN, 0);
 
-        if (!read_ok)
-            break;
-        
-        buffer_ok = buffer_put(dst_buf, byte);
-        pending_rc--;
+        return revents > 0 && (revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+    }
 
-        if (!buffer_ok)
-            break;
-    } while (pending_rc > 0);
-    
-    return read_ok && buffer_ok;
+    return true;
 }
 
-bool clientsocket_write_blob(ClientSocket *cli_sock, int count, const Buffer *src_buf)
+bool clientsocket_read_blob(ClientSocket *cli_sock, size_t count, Buffer *dst_buf)
 {
-    bool write_ok = true;
-    int pending_wc = count;
-    int temp_wc = 0;
-    const char *data_cursor = src_buf->data;
+    size_t pending_rc = count;
+    ssize_t temp_rc = 0;
 
-    do
+    if (count > dst_buf->capacity - dst_buf->write_pos)
+        return false;
+
+    // Bodies are read in bulk straight into the buffer instead of byte by byte like header lines.
+    while (pending_rc > 0)
     {
-        temp_wc = send(cli_sock->fd, data_cursor, pending_wc, 0);
+        temp_rc = clientsocket_read_some(cli_sock, dst_buf->data + dst_buf->write_pos, pending_rc);
+
+        if (temp_rc <= 0)
+            return false;
+
+        dst_buf->write_pos += temp_rc;
+        pending_rc -= temp_rc;
+    }
+
+    return true;
+}
+
+ssize_t clientsocket_read_some(ClientSocket *cli_sock, char *dst, size_t count)
+{
+    return clientsocket_recv(cli_sock, dst, count);
+}
+
+bool clientsocket_write_blob(ClientSocket *cli_sock, size_t count, const Buffer *src_buf)
+{
+    struct iovec blob_iov = {.iov_base = src_buf->data, .iov_len = count};
+
+    return clientsocket_write_iov(cli_sock, &blob_iov, 1);
+}
+
+bool clientsocket_write_iov(ClientSocket *cli_sock, struct iovec *iov, int iov_count)
+{
+    return clientsocket_write_iov_shared(cli_sock, iov, iov_count, 0);
+}
+
+bool clientsocket_write_iov_shared(ClientSocket *cli_sock, struct iovec *iov, int iov_count, uint32_t shared_mask)
+{
+    int iov_pos = 0;
+    ssize_t temp_wc = 0;
+    struct msghdr msg;
+    bool use_zerocopy = false;
+
+    // Large shared payloads go through the queue, which sends them zero-copy apart from the copied headers.
+    for (int i = 0; i < iov_count && cli_sock->outq.zerocopy_min > 0; i++)
+        use_zerocopy = use_zerocopy || ((shared_mask & ((uint32_t)1 << i)) && iov[i].iov_len >= cli_sock->outq.zerocopy_min);
+
+    // Bytes already queued go first, so only an empty queue lets new data skip it.
+    while (!use_zerocopy && iov_pos < iov_count && outqueue_is_empty(&cli_sock->outq))
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov + iov_pos;
+        msg.msg_iovlen = iov_count - iov_pos;
+
+        temp_wc = transport_sendmsg(&cli_sock->transport, &msg, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if (temp_wc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
 
-        write_ok = temp_wc > 0;
-        pending_wc -= temp_wc;
-        data_cursor += temp_wc;
-    } while (write_ok && pending_wc > 0);
+            return false;
+        }
+
+        if (temp_wc > 0 && cli_sock->extend_ms != 0)
+            cli_sock->deadline_ms = timing_now_ms() + cli_sock->extend_ms;
+
+        cli_sock->bytes_out += temp_wc;
+
+        // Skip every fully sent segment, then trim the partially sent one.
+        while (iov_pos < iov_count && (size_t)temp_wc >= iov[iov_pos].iov_len)
+        {
+            temp_wc -= iov[iov_pos].iov_len;
+            iov_pos++;
+        }
+
+        if (iov_pos < iov_count)
+        {
+            iov[iov_pos].iov_base = (char *)iov[iov_pos].iov_base + temp_wc;
+            iov[iov_pos].iov_len -= temp_wc;
+        }
+    }
+
+    // Queue the rest for a later flush, and only wait here if the client fell too far behind.
+    for (; iov_pos < iov_count; iov_pos++)
+    {
+        bool put_ok = (shared_mask & ((uint32_t)1 << iov_pos))
+            ? outqueue_put_shared(&cli_sock->outq, iov[iov_pos].iov_base, iov[iov_pos].iov_len)
+            : outqueue_put(&cli_sock->outq, iov[iov_pos].iov_base, iov[iov_pos].iov_len);
+
+        if (!put_ok)
+            return false;
+    }
+
+    if (use_zerocopy)
+    {
+        temp_wc = clientsocket_flush(cli_sock);
+
+        if (temp_wc < 0)
+            return false;
+
+        if (temp_wc > 0 && cli_sock->extend_ms != 0)
+            cli_sock->deadline_ms = timing_now_ms() + cli_sock->extend_ms;
+    }
+
+    return clientsocket_drain_to(cli_sock, cli_sock->max_pending);
+}
+
+size_t clientsocket_pending(const ClientSocket *cli_sock)
+{
+    return cli_sock->outq.pending;
+}
+
+int clientsocket_detach(ClientSocket *cli_sock, OutQueue *dst_outq)
+{
+    int detached_fd = cli_sock->transport.fd;
+
+    outqueue_move(dst_outq, &cli_sock->outq);
+    cli_sock->transport.fd = TRANSPORT_NO_FD;
+    cli_sock->closed = true;
 
-    return pending_wc == 0;
+    return detached_fd;
 }
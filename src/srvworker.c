@@ -10,21 +10,179 @@
 
 #include "server/srvworker.h"
 
+/* Helper Funcs. */
+
+static void srvworker_on_conn_expired(TimerNode *node)
+{
+    ServerWorker *srvworker = (ServerWorker *)node->owner_ref;
+
+    // The connection closes on reset, which also stops any blocked read at the socket's matching deadline.
+    srvworker->conn_timed_out = true;
+    srvworker->request.keep_connection = false;
+}
+
+static const char *const srvworker_state_names[SWORKER_END + 1] = {
+    "start",
+    "consume",
+    "recv",
+    "process",
+    "send",
+    "reset",
+    "end"
+};
+
+static const char *const srvworker_stage_names[SWORKER_STAGE_COUNT] = {
+    "consume",
+    "recv",
+    "process",
+    "route",
+    "handler",
+    "send",
+    "reset"
+};
+
+/**
+ * @brief Records the ticks since started_ticks under a stage.
+ */
+static void srvworker_time_stage(ServerWorker *srvworker, ServerWorkerStage stage, uint64_t started_ticks)
+{
+    histogram_record(&srvworker->latency[stage], timing_cycles() - started_ticks);
+}
+
+/**
+ * @brief Writes received bytes held back for the request capture as one record. The capture is read once, as the server may drop it while shutting down.
+ */
+static void srvworker_capture_flush(ServerWorker *srvworker, int fd)
+{
+    RequestCapture *capture = srvworker->capture_ref;
+
+    if (capture != NULL && srvworker->capture_held > 0)
+        capture_put(capture, CAPTURE_DATA, srvworker->wid, fd, srvworker->capture_data, srvworker->capture_held);
+
+    srvworker->capture_held = 0;
+}
+
+/**
+ * @brief Tap callback noting what the current connection received in the request capture.
+ */
+static void srvworker_capture_recv(void *srvworker_ref, int fd, const char *data, size_t len)
+{
+    ServerWorker *srvworker = (ServerWorker *)srvworker_ref;
+
+    if (srvworker->capture_held + len > SRVWORKER_CAPTURE_COALESCE)
+        srvworker_capture_flush(srvworker, fd);
+
+    if (len < SRVWORKER_CAPTURE_COALESCE)
+    {
+        memcpy(srvworker->capture_data + srvworker->capture_held, data, len);
+        srvworker->capture_held += (uint32_t)len;
+        return;
+    }
+
+    RequestCapture *capture = srvworker->capture_ref;
+
+    if (capture != NULL)
+        capture_put(capture, CAPTURE_DATA, srvworker->wid, fd, data, (uint32_t)len);
+}
+
+/**
+ * @brief Notes a connection event in the request capture, after any bytes held back from before it.
+ */
+static void srvworker_capture_note(ServerWorker *srvworker, CaptureRecordKind kind, int fd, uint32_t length)
+{
+    RequestCapture *capture = srvworker->capture_ref;
+
+    srvworker_capture_flush(srvworker, fd);
+
+    if (capture != NULL)
+        capture_put(capture, kind, srvworker->wid, fd, NULL, length);
+}
+
+/**
+ * @brief Hands the finished exchange to the access log, if it is on. Only called before the request and reply state is reset.
+ */
+static void srvworker_log_exchange(ServerWorker *srvworker)
+{
+    const BaseRequest *req_ref = &srvworker->request;
+
+    // Nothing was read on a connection that closed or idled out before its next request.
+    if (!srvworker->log_ring_ref || (srvworker->response.status_code == 0 && !srvworker->exchange_error))
+        return;
+
+    AccessRecord record = {
+        .worker_id = srvworker->wid,
+        .method = req_ref->method_id,
+        .path = req_ref->path_str,
+        .status_code = srvworker->response.status_code,
+        .bytes_in = srvworker->clisock.bytes_in,
+        .bytes_out = srvworker->clisock.bytes_out,
+        .duration_ns = timing_now_ns() - srvworker->exchange_started_ns,
+        .error = srvworker->exchange_error
+    };
+
+    logring_put_record(srvworker->log_ring_ref, &record);
+}
+
 /* ServerWorker Funcs. */
 
-void srvworker_init(ServerWorker *srvworker, int worker_id, RouteMap *router_ref, HandlerContext *ctx_ref, BlockedQueue *bqueue_ref, const char *server_name)
+bool srvworker_init(ServerWorker *srvworker, int worker_id, RouteMap *router_ref, HandlerContext *ctx_ref, BlockedQueue *bqueue_ref, SlabPool *slabpool_ref, ConnParking *park_ref, ThreadMetrics *metrics_ref, TraceRing *trace_ref, const ConnectionPolicy *policy, const char *server_name)
 {
     srvworker->wid = worker_id;
     srvworker->state = SWORKER_START;
+    atomic_init(&srvworker->shown_state, SWORKER_START);
     srvworker->must_abort = false;
+    clientsocket_init(&srvworker->clisock, -1); // closed until the first connection, so disposing an idle worker is safe
     basic_reqinfo_init(&srvworker->request);
     resinfo_init(&srvworker->response, server_name);
+    bool arena_ok = arena_init(&srvworker->arena, SRVWORKER_ARENA_BLOCK_SIZE);
+    handlerctx_init_view(&srvworker->ctx_view, ctx_ref, &srvworker->arena, &srvworker->scanner, &srvworker->writer);
 
     /// @note ServerWorker I/O utilities are initialized in the consume function.
 
     srvworker->router_ref = router_ref;
     srvworker->ctx_ref = ctx_ref;
     srvworker->bqueue_ref = bqueue_ref;
+    srvworker->slabpool_ref = slabpool_ref;
+    srvworker->park_ref = park_ref;
+    srvworker->metrics_ref = metrics_ref;
+    srvworker->trace_ref = trace_ref;
+    srvworker->slab_ref = NULL;
+    srvworker->policy = *policy;
+    srvworker->conn_requests = 0;
+    timerwheel_init(&srvworker->timers, timing_now_ms(), SRVWORKER_TIMER_TICK_MS);
+    timernode_init(&srvworker->conn_timer, srvworker_on_conn_expired, srvworker);
+    srvworker->conn_timer_kind = CONN_TIMER_HEADER;
+    srvworker->conn_timed_out = false;
+
+    for (int i = 0; i < SWORKER_STAGE_COUNT; i++)
+        histogram_init(&srvworker->latency[i]);
+
+    srvworker->log_ring_ref = NULL;
+    srvworker->exchange_started_ns = 0;
+    srvworker->exchange_error = NULL;
+    srvworker->capture_ref = NULL;
+    srvworker->capture_held = 0;
+
+    return arena_ok;
+}
+
+void srvworker_set_access_log(ServerWorker *srvworker, LogRing *log_ring_ref)
+{
+    srvworker->log_ring_ref = log_ring_ref;
+}
+
+void srvworker_set_capture(ServerWorker *srvworker, RequestCapture *capture_ref)
+{
+    srvworker->capture_ref = capture_ref;
+}
+
+void srvworker_stop(ServerWorker *srvworker)
+{
+    // Set under the queue lock, so a worker about to wait for a task cannot miss the wakeup.
+    pthread_mutex_lock(&srvworker->bqueue_ref->lock);
+    srvworker->must_abort = true;
+    pthread_cond_broadcast(&srvworker->bqueue_ref->signaler);
+    pthread_mutex_unlock(&srvworker->bqueue_ref->lock);
 }
 
 void srvworker_dispose(ServerWorker *srvworker)
@@ -34,45 +192,152 @@ void srvworker_dispose(ServerWorker *srvworker)
 
     h1scanner_dispose(&srvworker->scanner);
     h1writer_dispose(&srvworker->writer);
+    timerwheel_cancel(&srvworker->timers, &srvworker->conn_timer);
+    arena_dispose(&srvworker->arena);
+    slabpool_release(srvworker->slabpool_ref, srvworker->slab_ref);
+    srvworker->slab_ref = NULL;
 
     srvworker->router_ref = NULL;
     srvworker->ctx_ref = NULL;
     srvworker->bqueue_ref = NULL;
+    srvworker->slabpool_ref = NULL;
+    srvworker->park_ref = NULL;
 
     fprintf(stdout, "Disposed worker %i\n", srvworker->wid);
 }
 
+void srvworker_arm_timer(ServerWorker *srvworker, ConnTimerKind kind)
+{
+    int timeout_secs = srvworker->policy.header_timeout;
+
+    if (kind == CONN_TIMER_BODY)
+        timeout_secs = srvworker->policy.body_timeout;
+    else if (kind == CONN_TIMER_SEND)
+        timeout_secs = srvworker->policy.send_timeout;
+
+    uint32_t timeout_ms = (uint32_t)timeout_secs * 1000;
+    uint64_t deadline_ms = timing_now_ms() + timeout_ms;
+    bool is_inactivity = kind == CONN_TIMER_BODY || kind == CONN_TIMER_SEND;
+
+    srvworker->conn_timer_kind = kind;
+    timerwheel_schedule(&srvworker->timers, &srvworker->conn_timer, deadline_ms);
+    clientsocket_set_deadline(&srvworker->clisock, deadline_ms, is_inactivity ? timeout_ms : 0);
+}
+
+int srvworker_check_timers(ServerWorker *srvworker)
+{
+    // Body and send deadlines move with each transfer, so the timer catches up with the socket before the wheel judges it.
+    if (srvworker->clisock.extend_ms != 0 && timernode_is_scheduled(&srvworker->conn_timer))
+        timerwheel_schedule(&srvworker->timers, &srvworker->conn_timer, srvworker->clisock.deadline_ms);
+
+    return timerwheel_advance(&srvworker->timers, timing_now_ms());
+}
+
+const char *srvworker_state_name(ServerWorkerState state)
+{
+    return (state >= SWORKER_START && state <= SWORKER_END) ? srvworker_state_names[state] : "unknown";
+}
+
+ServerWorkerState srvworker_get_shown_state(const ServerWorker *srvworker)
+{
+    return (ServerWorkerState)atomic_load_explicit(&srvworker->shown_state, memory_order_relaxed);
+}
+
+const char *srvworker_stage_name(ServerWorkerStage stage)
+{
+    return (stage >= 0 && stage < SWORKER_STAGE_COUNT) ? srvworker_stage_names[stage] : "unknown";
+}
+
+void srvworker_merge_latency(const ServerWorker *srvworker, ServerWorkerStage stage, LatencyHistogram *dst)
+{
+    histogram_merge(dst, &srvworker->latency[stage]);
+}
+
 ServerWorkerState srvworker_consume(ServerWorker *srvworker)
 {
     pthread_mutex_lock(&srvworker->bqueue_ref->lock);
 
-    while (bqueue_is_empty(srvworker->bqueue_ref))
+    while (bqueue_is_empty(srvworker->bqueue_ref) && !srvworker->must_abort)
     {
         pthread_cond_wait(&srvworker->bqueue_ref->signaler, &srvworker->bqueue_ref->lock);
     }
 
+    // Connections still queued are closed with the queue.
+    if (srvworker->must_abort)
+    {
+        pthread_mutex_unlock(&srvworker->bqueue_ref->lock);
+        return SWORKER_END;
+    }
+
     // The queue has something, so getting a connection task from queue is ok.
     QueueNode *popped_task = bqueue_dequeue(srvworker->bqueue_ref);
 
-    clientsocket_init(&srvworker->clisock, popped_task->data);
-    h1scanner_init(&srvworker->scanner, &srvworker->clisock);
-    h1writer_init(&srvworker->writer, &srvworker->clisock);
+    int popped_fd = popped_task->data;
+    int popped_served = popped_task->served;
 
     free(popped_task);
 
     pthread_mutex_unlock(&srvworker->bqueue_ref->lock);
 
+    // Borrow one pooled slab for all of this connection's I/O buffers. A NULL slab makes the scanner and writer allocate their own.
+    char *slab = slabpool_acquire(srvworker->slabpool_ref);
+    srvworker->slab_ref = slab;
+    metrics_add(&srvworker->metrics_ref->slab_acquires, 1);
+
+    if (!slab)
+        metrics_add(&srvworker->metrics_ref->slab_misses, 1);
+
+    clientsocket_init(&srvworker->clisock, popped_fd);
+
+    if (srvworker->capture_ref != NULL)
+    {
+        srvworker->capture_tap.inner = srvworker->clisock.transport;
+        srvworker->capture_tap.on_recv = srvworker_capture_recv;
+        srvworker->capture_tap.tap_ref = srvworker;
+        srvworker->capture_held = 0;
+        transport_init_tap(&srvworker->clisock.transport, &srvworker->capture_tap);
+    }
+
+    clientsocket_set_max_pending(&srvworker->clisock, srvworker->policy.max_pending);
+    clientsocket_set_zerocopy(&srvworker->clisock, srvworker->policy.zerocopy_min);
+    srvworker->conn_requests = popped_served;
+    srvworker->conn_timed_out = false;
+    srvworker_arm_timer(srvworker, CONN_TIMER_HEADER);
+    h1scanner_init(&srvworker->scanner, &srvworker->clisock, srvworker->wid, &srvworker->arena, slab);
+    h1writer_init(&srvworker->writer, &srvworker->clisock, srvworker->wid, (slab != NULL) ? slab + H1SCANNER_BUFFER_MEM_SIZE : NULL);
+
     return SWORKER_RECV;
 }
 
 ServerWorkerState srvworker_recv(ServerWorker *srvworker)
 {
+    if (srvworker->log_ring_ref != NULL)
+        srvworker->exchange_started_ns = timing_now_ns();
+
+    tracering_record(srvworker->trace_ref, TRACE_PARSE_START, srvworker->clisock.transport.fd, 0, 0);
+
     if (!h1scanner_read_reqinfo(&srvworker->scanner, &srvworker->request))
     {
-        fprintf(stderr, "Error at %s:%i: \"%s\"", __FILE__, __LINE__, "Read of request failed.");
+        // Slow clients and persistent connections closed by their peer between requests are routine, so only rejected requests get an access log record.
+        bool timed_out = srvworker_check_timers(srvworker) > 0 || srvworker->clisock.timed_out;
+
+        // Anything but a hang up, an I/O error or a timeout means the scanner rejected what it read.
+        if (!timed_out && !srvworker->clisock.read_failed)
+        {
+            metrics_add(&srvworker->metrics_ref->parse_errors, 1);
+            srvworker->exchange_error = "parse_error";
+        }
+
+        srvworker->request.keep_connection = false;
         return SWORKER_RESET;
     }
 
+    // Body reads get their own deadline, which moves forward as long as data keeps arriving. Likewise, replies get one that moves as the client takes data.
+    if (h1scanner_has_body(&srvworker->scanner))
+        srvworker_arm_timer(srvworker, CONN_TIMER_BODY);
+    else
+        srvworker_arm_timer(srvworker, CONN_TIMER_SEND);
+
     return SWORKER_PROCESS;
 }
 
@@ -86,8 +351,13 @@ ServerWorkerState srvworker_process_ok(ServerWorker *srvworker, const BaseReques
 
     // Get mutable response referencing ptr. 
     ResponseObj *res_ref = &srvworker->response;
+    uint64_t route_started_ticks = timing_cycles();
     const RoutedNode *handler_item = rtemap_get(srvworker->router_ref, req_url); /// @note This is a simple fetching (read) operation on the route map, so no synchronization is needed here!
 
+    srvworker_time_stage(srvworker, SWORKER_STAGE_ROUTE, route_started_ticks);
+    tracering_record(srvworker->trace_ref, TRACE_ROUTE, srvworker->clisock.transport.fd, handler_item != NULL, 0);
+    H1C_PROBE5(route__matched, srvworker->wid, srvworker->clisock.transport.fd, req_method, handler_item != NULL, req_url);
+
     // Check for handler with resource... 404 if none exist.
     if (!handler_item)
         return srvworker_process_bad(srvworker, HTTP_STATUS_UNFOUND, HTTP_MSG_UNFOUND, req_ref);
@@ -113,16 +383,54 @@ ServerWorkerState srvworker_process_ok(ServerWorker *srvworker, const BaseReques
     // Extract handler object from the fetched routing tree node... I also see its status checks for more specific error handling.
     const H1CHandler *handler_ref = rtdnode_get_handler(handler_item);
 
+    // Streaming handlers pull the body themselves, but other handlers get it buffered whole if it is small enough.
+    if (!handler_ref->streams_body && h1scanner_has_body(&srvworker->scanner))
+    {
+        srvworker->scanner.state = h1scanner_eat_blob(&srvworker->scanner, &srvworker->request);
+
+        if (srvworker->scanner.state == ERROR && srvworker->scanner.body_too_large)
+        {
+            // The rest of the body is unread, so the connection cannot carry another request.
+            srvworker_process_bad(srvworker, HTTP_STATUS_TOO_LARGE, HTTP_MSG_TOO_LARGE, req_ref);
+            resinfo_set_keep_connection(res_ref, false);
+            return SWORKER_SEND;
+        }
+
+        if (srvworker->scanner.state == ERROR)
+        {
+            srvworker_process_bad(srvworker, HTTP_STATUS_BAD_REQUEST, HTTP_MSG_BAD_REQUEST, req_ref);
+            resinfo_set_keep_connection(res_ref, false);
+            return SWORKER_SEND;
+        }
+    }
+
+    uint64_t handler_started_ticks = timing_cycles();
     HandlerStatus main_handler_status = (handler_ref->method == req_method)
-        ? h1chandler_handle(handler_ref, srvworker->ctx_ref, req_ref, res_ref)
+        ? h1chandler_handle(handler_ref, &srvworker->ctx_view, req_ref, res_ref)
         : HANDLE_BAD_METHOD; // BIG ERROR: unexpected 500 from here because of temp_method != GET...
 
+    srvworker_time_stage(srvworker, SWORKER_STAGE_HANDLER, handler_started_ticks);
+    tracering_record(srvworker->trace_ref, TRACE_HANDLER_DONE, srvworker->clisock.transport.fd, (uint32_t)main_handler_status, 0);
+    H1C_PROBE4(handler__returned, srvworker->wid, srvworker->clisock.transport.fd, main_handler_status, res_ref->status_code);
+
+    // A streamed reply already went out, so it can only be ended here.
+    if (res_ref->streamed)
+        return srvworker_end_stream(srvworker, main_handler_status);
+
     // Exit before the error replying code to avoid clobbering the server message. Otherwise, replace the response with an errorneous one.
     if (main_handler_status == HANDLE_OK)
-        return SWORKER_SEND;
+        return srvworker_process_conditional(srvworker, req_ref);
 
     resinfo_reset(res_ref, RES_RST_ALL);
 
+    // A streaming handler that failed on a malformed body gets the client blamed, and the connection is out of sync.
+    if (srvworker->scanner.state == ERROR)
+    {
+        srvworker_process_bad(srvworker, HTTP_STATUS_BAD_REQUEST, HTTP_MSG_BAD_REQUEST, req_ref);
+        resinfo_set_keep_connection(res_ref, false);
+        return SWORKER_SEND;
+    }
+
     if (main_handler_status == HANDLE_BAD_METHOD)
         return srvworker_process_bad(srvworker, HTTP_STATUS_NO_IMPL, HTTP_MSG_NO_IMPL, req_ref);
 
@@ -134,6 +442,101 @@ ServerWorkerState srvworker_process_ok(ServerWorker *srvworker, const BaseReques
     return SWORKER_SEND;
 }
 
+ServerWorkerState srvworker_process_conditional(ServerWorker *srvworker, const BaseRequest *req_ref)
+{
+    ResponseObj *res_ref = &srvworker->response;
+    bool not_modified = false;
+
+    // Only safe reads on a supported schema may be answered from the client's cache.
+    if (req_ref->method_id != GET && req_ref->method_id != HEAD)
+        return SWORKER_SEND;
+
+    if (req_ref->schema_id == HTTP_SCHEMA_UNKNOWN)
+        return SWORKER_SEND;
+
+    if (req_ref->if_none_match_hstr != NULL || req_ref->if_modified_since != 0)
+        metrics_add(&srvworker->metrics_ref->conditional_requests, 1);
+
+    // If-None-Match takes precedence, so If-Modified-Since is only checked without it.
+    if (req_ref->if_none_match_hstr != NULL)
+        not_modified = res_ref->etag_ref != NULL && etag_list_has_match(req_ref->if_none_match_hstr, res_ref->etag_ref);
+    else if (req_ref->if_modified_since != 0)
+        not_modified = res_ref->last_modified != 0 && res_ref->last_modified <= req_ref->if_modified_since;
+
+    if (!not_modified)
+        return srvworker_process_range(srvworker, req_ref);
+
+    if (req_ref->schema_id == HTTP_SCHEMA_1_1)
+        resinfo_fill_status_line(res_ref, HTTP_1_1, HTTP_STATUS_NOT_MODIFIED, HTTP_MSG_NOT_MODIFIED);
+    else
+        resinfo_fill_status_line(res_ref, HTTP_1_0, HTTP_STATUS_NOT_MODIFIED, HTTP_MSG_NOT_MODIFIED);
+
+    resinfo_set_header_only(res_ref, true);
+    resinfo_set_body_payload(res_ref, NULL);
+
+    return SWORKER_SEND;
+}
+
+ServerWorkerState srvworker_process_range(ServerWorker *srvworker, const BaseRequest *req_ref)
+{
+    ResponseObj *res_ref = &srvworker->response;
+    const char *if_range_str = req_ref->if_range_hstr;
+    ByteRange ranges[BYTE_RANGES_MAX_COUNT];
+
+    if (req_ref->method_id != GET || !req_ref->range_hstr || !res_ref->accept_ranges || !res_ref->body_blob)
+        return SWORKER_SEND;
+
+    // If-Range needs a strong ETag match or the exact Last-Modified date, otherwise the client gets the new full payload.
+    if (if_range_str != NULL && if_range_str[0] == '"')
+    {
+        if (!res_ref->etag_ref || strcmp(if_range_str, res_ref->etag_ref) != 0)
+            return SWORKER_SEND;
+    }
+    else if (if_range_str != NULL)
+    {
+        time_t if_range_date = http_date_to_time(if_range_str);
+
+        if (if_range_date == 0 || if_range_date != res_ref->last_modified)
+            return SWORKER_SEND;
+    }
+
+    int range_count = byte_ranges_parse(req_ref->range_hstr, res_ref->content_len, ranges, BYTE_RANGES_MAX_COUNT);
+
+    if (range_count == BYTE_RANGES_INVALID)
+        return SWORKER_SEND;
+
+    const char *schema_str = (req_ref->schema_id == HTTP_SCHEMA_1_1) ? HTTP_1_1 : HTTP_1_0;
+
+    if (range_count == BYTE_RANGES_UNSATISFIABLE)
+    {
+        resinfo_fill_status_line(res_ref, schema_str, HTTP_STATUS_BAD_RANGE, HTTP_MSG_BAD_RANGE);
+        resinfo_set_range_unsatisfied(res_ref);
+        return SWORKER_SEND;
+    }
+
+    resinfo_fill_status_line(res_ref, schema_str, HTTP_STATUS_PARTIAL, HTTP_MSG_PARTIAL);
+    resinfo_set_ranges(res_ref, ranges, range_count);
+
+    return SWORKER_SEND;
+}
+
+ServerWorkerState srvworker_end_stream(ServerWorker *srvworker, HandlerStatus handler_status)
+{
+    ReplyWriter *writer_ref = &srvworker->writer;
+    bool stream_ok = handler_status == HANDLE_OK;
+
+    // Finish for handlers that return without doing so. A failed handler's reply is cut short instead, which the client sees as an error.
+    if (stream_ok && writer_ref->streaming)
+        stream_ok = h1writer_stream_finish(writer_ref);
+
+    if (!stream_ok || !srvworker->response.keep_connection)
+        srvworker->request.keep_connection = false;
+
+    tracering_record(srvworker->trace_ref, TRACE_SEND_DONE, srvworker->clisock.transport.fd, (uint32_t)srvworker->response.status_code, (uint32_t)srvworker->clisock.bytes_out);
+
+    return SWORKER_RESET;
+}
+
 ServerWorkerState srvworker_process_bad(ServerWorker *srvworker, const char *status_str, const char *msg_str, const BaseRequest *req_ref)
 {
     HttpSchema req_schema = req_ref->schema_id;
@@ -157,6 +560,16 @@ ServerWorkerState srvworker_process_all(ServerWorker *srvworker)
     // First check request for initial verification: does it have a Host header?
     const BaseRequest *req_view = &srvworker->request;
 
+    metrics_count_request(srvworker->metrics_ref, req_view->method_id);
+
+    // Apply the keep-alive policy before dispatch, since streaming handlers send their reply head early.
+    srvworker->conn_requests++;
+
+    if (srvworker->conn_requests >= srvworker->policy.keepalive_max)
+        srvworker->request.keep_connection = false;
+
+    resinfo_set_keep_alive(&srvworker->response, srvworker->policy.keepalive_timeout, srvworker->policy.keepalive_max - srvworker->conn_requests);
+
     bool has_host = req_view->host_hstr != NULL;
 
     if (has_host)
@@ -167,35 +580,89 @@ ServerWorkerState srvworker_process_all(ServerWorker *srvworker)
 
 ServerWorkerState srvworker_send(ServerWorker *srvworker)
 {
+    srvworker_arm_timer(srvworker, CONN_TIMER_SEND);
+
     if (!h1writer_put_reply(&srvworker->writer, &srvworker->response))
-    {
-        // Show error message for any debugging.
-        fprintf(stderr, "Error at %s:%i: \"%s\"", __FILE__, __LINE__, "Write of response failed.");
-    }
+        srvworker->exchange_error = "send_failed";
+
+    tracering_record(srvworker->trace_ref, TRACE_SEND_DONE, srvworker->clisock.transport.fd, (uint32_t)srvworker->response.status_code, (uint32_t)srvworker->clisock.bytes_out);
 
     return SWORKER_RESET;
 }
 
 ServerWorkerState srvworker_reset(ServerWorker *srvworker)
 {
-    bool conn_persists = srvworker->request.keep_connection;
+    // Drain any body the handler did not read, or close if it is too big to bother.
+    bool conn_persists = srvworker->request.keep_connection && srvworker->response.keep_connection && h1scanner_skip_body(&srvworker->scanner);
+
+    // Count and log the exchange before its state goes. Requests that failed to scan have no reply.
+    srvworker_log_exchange(srvworker);
+    srvworker->exchange_error = NULL;
+
+    // Replays wait for a reply of this size before sending what the client sent next, as the client did.
+    uint64_t reply_bytes = srvworker->clisock.bytes_out + clientsocket_pending(&srvworker->clisock);
+
+    if (srvworker->capture_ref != NULL && reply_bytes > 0)
+        srvworker_capture_note(srvworker, CAPTURE_REPLY, srvworker->clisock.transport.fd, (uint32_t)reply_bytes);
+
+    metrics_count_response(srvworker->metrics_ref, srvworker->response.status_code);
+    metrics_add(&srvworker->metrics_ref->bytes_in, srvworker->clisock.bytes_in);
+    metrics_add(&srvworker->metrics_ref->bytes_out, srvworker->clisock.bytes_out);
+    srvworker->clisock.bytes_in = 0;
+    srvworker->clisock.bytes_out = 0;
 
     // Reset HTTP I/O state to avoid request / response clobbering.
     h1scanner_reset(&srvworker->scanner);
     h1writer_reset(&srvworker->writer);
     basic_reqinfo_clear(&srvworker->request);
     resinfo_reset(&srvworker->response, RES_RST_ALL);
+    arena_reset(&srvworker->arena); // NOTE: drop every request string and handler allocation at once.
+
+    // A client still taking its reply finishes in the parking set, and so does an idle one until its next request arrives. Either way, this worker moves on. Pipelined requests are served right away.
+    bool has_pending = clientsocket_pending(&srvworker->clisock) > 0 && !srvworker->conn_timed_out;
+    bool has_input = conn_persists && !has_pending && clientsocket_has_input(&srvworker->clisock);
 
-    // After reset, there is a chance that the connection is going to end by "Connection: close". Close this stale connection and free any dynamic memory.
-    if (!conn_persists)
+    if (has_input)
     {
+        srvworker_arm_timer(srvworker, CONN_TIMER_HEADER);
+        return SWORKER_RECV;
+    }
+
+    // After reset, there is a chance that the connection is going to end by "Connection: close". Close this stale connection or park it, and free any dynamic memory.
+    uint32_t idle_timeout_ms = conn_persists ? (uint32_t)srvworker->policy.keepalive_timeout * 1000 : 0;
+
+    timerwheel_cancel(&srvworker->timers, &srvworker->conn_timer);
+
+    bool parked = false;
+    int conn_fd = srvworker->clisock.transport.fd; // parking takes the fd away from the socket
+
+    if (has_pending)
+        parked = connpark_put_draining(srvworker->park_ref, &srvworker->clisock, srvworker->conn_requests, (uint32_t)srvworker->policy.send_timeout * 1000, idle_timeout_ms);
+    else if (conn_persists)
+        parked = connpark_put_idle(srvworker->park_ref, &srvworker->clisock, srvworker->conn_requests, idle_timeout_ms);
+    else
+    {
+        // Noted while the fd is still this connection's, since the next accept may reuse it.
+        if (srvworker->capture_ref != NULL)
+            srvworker_capture_note(srvworker, CAPTURE_CLOSE, conn_fd, 0);
+
         clientsocket_close(&srvworker->clisock);
-        h1scanner_dispose(&srvworker->scanner);
-        h1writer_dispose(&srvworker->writer);
-        return SWORKER_CONSUME;
     }
 
-    return SWORKER_RECV;
+    // Closed here, or by a parking set that could not take it.
+    if (!parked)
+    {
+        metrics_add(&srvworker->metrics_ref->closes, 1);
+        tracering_record(srvworker->trace_ref, TRACE_CLOSE, conn_fd, 0, 0);
+        H1C_PROBE3(connection__closed, srvworker->wid, conn_fd, srvworker->conn_requests);
+    }
+
+    h1scanner_dispose(&srvworker->scanner);
+    h1writer_dispose(&srvworker->writer);
+    slabpool_release(srvworker->slabpool_ref, srvworker->slab_ref);
+    srvworker->slab_ref = NULL;
+
+    return SWORKER_CONSUME;
 }
 
 void *run_srvworker(void *srvworker_ref)
@@ -206,25 +673,35 @@ void *run_srvworker(void *srvworker_ref)
 
     while (srvworker->state != SWORKER_END && !srvworker->must_abort)
     {
+        // Each state's step is timed from its transition in to its transition out.
+        uint64_t started_ticks = timing_cycles();
+
+        atomic_store_explicit(&srvworker->shown_state, srvworker->state, memory_order_relaxed);
+
         if (srvworker->state == SWORKER_START || srvworker->state == SWORKER_CONSUME)
         {
             srvworker->state = srvworker_consume(srvworker);
+            srvworker_time_stage(srvworker, SWORKER_STAGE_CONSUME, started_ticks);
         }
         else if (srvworker->state == SWORKER_RECV)
         {
             srvworker->state = srvworker_recv(srvworker);
+            srvworker_time_stage(srvworker, SWORKER_STAGE_RECV, started_ticks);
         }
         else if (srvworker->state == SWORKER_PROCESS)
         {
             srvworker->state = srvworker_process_all(srvworker);
+            srvworker_time_stage(srvworker, SWORKER_STAGE_PROCESS, started_ticks);
         }
         else if (srvworker->state == SWORKER_SEND)
         {
             srvworker->state = srvworker_send(srvworker);
+            srvworker_time_stage(srvworker, SWORKER_STAGE_SEND, started_ticks);
         }
         else if (srvworker->state == SWORKER_RESET)
         {
             srvworker->state = srvworker_reset(srvworker);
+            srvworker_time_stage(srvworker, SWORKER_STAGE_RESET, started_ticks);
         }
         else
         {
@@ -0,0 +1,221 @@
+/**
+ * @file statseg.c
+ * @author Derek Tan
+ * @brief Implements the shared memory stats segment, its seqlock and its publisher thread.
+ * @date 2023-12-23
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "utils/statseg.h"
+
+/* Helper Funcs. */
+
+static uint64_t statseg_wall_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+static void statspub_publish(StatsPublisher *publisher)
+{
+    StatsSnapshot snapshot;
+    uint64_t now_ms = timing_now_ms();
+
+    memset(&snapshot, 0, sizeof(StatsSnapshot));
+    publisher->gather(publisher->source_ref, &snapshot);
+
+    snapshot.published_ms = statseg_wall_ms();
+    snapshot.uptime_ms = now_ms - publisher->started_ms;
+    snapshot.pid = (uint32_t)getpid();
+
+    if (now_ms > publisher->last_ms && snapshot.requests >= publisher->last_requests)
+        snapshot.rps = (double)(snapshot.requests - publisher->last_requests) * 1000.0 / (double)(now_ms - publisher->last_ms);
+
+    publisher->last_requests = snapshot.requests;
+    publisher->last_ms = now_ms;
+
+    statseg_write(publisher->segment, &snapshot);
+}
+
+static void *statspub_run(void *publisher_ref)
+{
+    StatsPublisher *publisher = (StatsPublisher *)publisher_ref;
+
+    pthread_mutex_lock(&publisher->lock);
+
+    while (publisher->running)
+    {
+        struct timespec until;
+
+        pthread_mutex_unlock(&publisher->lock);
+        statspub_publish(publisher);
+        pthread_mutex_lock(&publisher->lock);
+
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += (long)STATSEG_PUBLISH_MS * 1000000;
+        until.tv_sec += until.tv_nsec / 1000000000;
+        until.tv_nsec %= 1000000000;
+
+        if (publisher->running)
+            pthread_cond_timedwait(&publisher->wakeup, &publisher->lock, &until);
+    }
+
+    pthread_mutex_unlock(&publisher->lock);
+
+    return NULL;
+}
+
+/* StatsSegment Funcs. */
+
+void statseg_write(StatsSegment *segment, const StatsSnapshot *snapshot)
+{
+    uint32_t seq = atomic_load_explicit(&segment->seq, memory_order_relaxed);
+
+    atomic_store_explicit(&segment->seq, seq + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    memcpy(&segment->snapshot, snapshot, sizeof(StatsSnapshot));
+    atomic_store_explicit(&segment->seq, seq + 2, memory_order_release);
+}
+
+bool statseg_read(const StatsSegment *segment, StatsSnapshot *dst)
+{
+    for (int i = 0; i < STATSEG_READ_TRIES; i++)
+    {
+        uint32_t seq_before = atomic_load_explicit(&segment->seq, memory_order_acquire);
+
+        if (seq_before & 1)
+        {
+            sched_yield();
+            continue;
+        }
+
+        memcpy(dst, &segment->snapshot, sizeof(StatsSnapshot));
+        atomic_thread_fence(memory_order_acquire);
+
+        if (atomic_load_explicit(&segment->seq, memory_order_relaxed) == seq_before)
+            return true;
+    }
+
+    return false;
+}
+
+const StatsSegment *statseg_open(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+
+    if (fd == -1)
+        return NULL;
+
+    void *mapping = mmap(NULL, sizeof(StatsSegment), PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+        return NULL;
+
+    const StatsSegment *segment = (const StatsSegment *)mapping;
+
+    if (segment->magic != STATSEG_MAGIC || segment->version != STATSEG_VERSION || segment->size != sizeof(StatsSegment))
+    {
+        munmap(mapping, sizeof(StatsSegment));
+        return NULL;
+    }
+
+    return segment;
+}
+
+void statseg_close(const StatsSegment *segment)
+{
+    if (segment != NULL)
+        munmap((void *)segment, sizeof(StatsSegment));
+}
+
+/* StatsPublisher Funcs. */
+
+bool statspub_init(StatsPublisher *publisher, const char *name, StatsGatherFunc gather, void *source_ref)
+{
+    publisher->segment = NULL;
+    publisher->running = false;
+
+    if (strlen(name) >= STATSEG_NAME_SIZE)
+        return false;
+
+    strcpy(publisher->name, name);
+
+    // Readers only ever map the segment, so it may be world-readable but only the server writes.
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd == -1)
+        return false;
+
+    if (ftruncate(fd, sizeof(StatsSegment)) != 0)
+    {
+        close(fd);
+        shm_unlink(name);
+        return false;
+    }
+
+    void *mapping = mmap(NULL, sizeof(StatsSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (mapping == MAP_FAILED)
+    {
+        shm_unlink(name);
+        return false;
+    }
+
+    publisher->segment = (StatsSegment *)mapping;
+    publisher->segment->magic = STATSEG_MAGIC;
+    publisher->segment->version = STATSEG_VERSION;
+    publisher->segment->size = sizeof(StatsSegment);
+    atomic_init(&publisher->segment->seq, 0);
+
+    publisher->gather = gather;
+    publisher->source_ref = source_ref;
+    publisher->started_ms = timing_now_ms();
+    publisher->last_requests = 0;
+    publisher->last_ms = publisher->started_ms;
+    pthread_mutex_init(&publisher->lock, NULL);
+    pthread_cond_init(&publisher->wakeup, NULL);
+
+    return true;
+}
+
+bool statspub_start(StatsPublisher *publisher)
+{
+    publisher->running = true;
+
+    if (pthread_create(&publisher->thread, NULL, statspub_run, publisher) != 0)
+    {
+        publisher->running = false;
+        return false;
+    }
+
+    return true;
+}
+
+void statspub_dispose(StatsPublisher *publisher)
+{
+    if (publisher->running)
+    {
+        pthread_mutex_lock(&publisher->lock);
+        publisher->running = false;
+        pthread_cond_signal(&publisher->wakeup);
+        pthread_mutex_unlock(&publisher->lock);
+        pthread_join(publisher->thread, NULL);
+    }
+
+    if (publisher->segment != NULL)
+    {
+        munmap(publisher->segment, sizeof(StatsSegment));
+        shm_unlink(publisher->name);
+    }
+
+    publisher->segment = NULL;
+}
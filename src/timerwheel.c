@@ -0,0 +1,206 @@
+/**
+ * @file timerwheel.c
+ * @author Derek Tan
+ * @brief Implements a hierarchical hashed timer wheel for connection timeouts.
+ * @date 2023-12-16
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include "collections/timerwheel.h"
+
+/* Helper Funcs. */
+
+static void timerwheel_list_reset(TimerNode *sentinel)
+{
+    sentinel->prev = sentinel;
+    sentinel->next = sentinel;
+}
+
+static void timerwheel_list_unlink(TimerNode *node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+/**
+ * @brief Moves a slot's whole list to a local sentinel, so callbacks and cascades can touch the wheel while it is walked.
+ */
+static void timerwheel_list_take(TimerNode *slot, TimerNode *taken)
+{
+    if (slot->next == slot)
+    {
+        timerwheel_list_reset(taken);
+        return;
+    }
+
+    taken->next = slot->next;
+    taken->prev = slot->prev;
+    taken->next->prev = taken;
+    taken->prev->next = taken;
+    timerwheel_list_reset(slot);
+}
+
+/**
+ * @brief Links a timer into the slot of the coarsest level that still separates it from the current tick.
+ */
+static void timerwheel_place(TimerWheel *wheel, TimerNode *node, uint64_t min_tick)
+{
+    if (node->expiry_tick < min_tick)
+        node->expiry_tick = min_tick;
+
+    uint64_t delta = node->expiry_tick - wheel->current_tick;
+
+    if (delta >= TIMERWHEEL_MAX_TICKS)
+    {
+        delta = TIMERWHEEL_MAX_TICKS - 1;
+        node->expiry_tick = wheel->current_tick + delta;
+    }
+
+    int level = 0;
+
+    while (level < TIMERWHEEL_LEVELS - 1 && delta >= ((uint64_t)1 << (TIMERWHEEL_SLOT_BITS * (level + 1))))
+        level++;
+
+    TimerNode *slot = &wheel->slots[level][(node->expiry_tick >> (TIMERWHEEL_SLOT_BITS * level)) & TIMERWHEEL_SLOT_MASK];
+
+    node->next = slot;
+    node->prev = slot->prev;
+    slot->prev->next = node;
+    slot->prev = node;
+}
+
+/**
+ * @brief Processes one tick: coarser slots due now cascade down first, and then the tick's level 0 slot expires.
+ */
+static int timerwheel_step(TimerWheel *wheel)
+{
+    TimerNode taken;
+    int expired_count = 0;
+    uint64_t tick = ++wheel->current_tick;
+    int top_level = 0;
+
+    while (top_level < TIMERWHEEL_LEVELS - 1 && (tick & (((uint64_t)1 << (TIMERWHEEL_SLOT_BITS * (top_level + 1))) - 1)) == 0)
+        top_level++;
+
+    for (int level = top_level; level > 0; level--)
+    {
+        timerwheel_list_take(&wheel->slots[level][(tick >> (TIMERWHEEL_SLOT_BITS * level)) & TIMERWHEEL_SLOT_MASK], &taken);
+
+        while (taken.next != &taken)
+        {
+            TimerNode *node = taken.next;
+
+            timerwheel_list_unlink(node);
+            timerwheel_place(wheel, node, tick);
+        }
+    }
+
+    timerwheel_list_take(&wheel->slots[0][tick & TIMERWHEEL_SLOT_MASK], &taken);
+
+    while (taken.next != &taken)
+    {
+        TimerNode *node = taken.next;
+
+        timerwheel_list_unlink(node);
+        wheel->count--;
+        expired_count++;
+
+        if (node->on_expire != NULL)
+            node->on_expire(node);
+    }
+
+    return expired_count;
+}
+
+/* TimerNode Funcs. */
+
+void timernode_init(TimerNode *node, TimerFunc on_expire, void *owner)
+{
+    node->prev = NULL;
+    node->next = NULL;
+    node->expiry_tick = 0;
+    node->on_expire = on_expire;
+    node->owner_ref = owner;
+}
+
+bool timernode_is_scheduled(const TimerNode *node)
+{
+    return node->next != NULL;
+}
+
+/* TimerWheel Funcs. */
+
+void timerwheel_init(TimerWheel *wheel, uint64_t now_ms, uint32_t tick_ms)
+{
+    wheel->tick_ms = (tick_ms > 0) ? tick_ms : 1;
+    wheel->current_tick = now_ms / wheel->tick_ms;
+    wheel->count = 0;
+
+    for (int level = 0; level < TIMERWHEEL_LEVELS; level++)
+    {
+        for (int slot = 0; slot < TIMERWHEEL_SLOTS; slot++)
+            timerwheel_list_reset(&wheel->slots[level][slot]);
+    }
+}
+
+void timerwheel_schedule(TimerWheel *wheel, TimerNode *node, uint64_t expiry_ms)
+{
+    timerwheel_cancel(wheel, node);
+
+    // Round up so that a timer never fires before its time.
+    node->expiry_tick = (expiry_ms + wheel->tick_ms - 1) / wheel->tick_ms;
+    timerwheel_place(wheel, node, wheel->current_tick + 1);
+    wheel->count++;
+}
+
+void timerwheel_cancel(TimerWheel *wheel, TimerNode *node)
+{
+    if (!timernode_is_scheduled(node))
+        return;
+
+    timerwheel_list_unlink(node);
+    wheel->count--;
+}
+
+int timerwheel_advance(TimerWheel *wheel, uint64_t now_ms)
+{
+    uint64_t target_tick = now_ms / wheel->tick_ms;
+    int expired_count = 0;
+
+    while (wheel->current_tick < target_tick)
+    {
+        // Idle stretches are skipped in one jump since no slot has anything to process.
+        if (wheel->count == 0)
+        {
+            wheel->current_tick = target_tick;
+            break;
+        }
+
+        expired_count += timerwheel_step(wheel);
+    }
+
+    return expired_count;
+}
+
+uint64_t timerwheel_next_expiry(const TimerWheel *wheel)
+{
+    if (wheel->count == 0)
+        return TIMERWHEEL_NO_EXPIRY;
+
+    for (uint64_t tick = wheel->current_tick + 1; tick <= wheel->current_tick + TIMERWHEEL_SLOTS; tick++)
+    {
+        const TimerNode *slot = &wheel->slots[0][tick & TIMERWHEEL_SLOT_MASK];
+
+        if (slot->next != slot)
+            return tick * wheel->tick_ms;
+    }
+
+    // Only coarser levels have timers, so the next level 1 cascade is the earliest that something may change.
+    uint64_t cascade_tick = ((wheel->current_tick >> TIMERWHEEL_SLOT_BITS) + 1) << TIMERWHEEL_SLOT_BITS;
+
+    return cascade_tick * wheel->tick_ms;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file timing.c
+ * @author Derek Tan
+ * @brief Implements monotonic clock helpers for timeouts.
+ * @date 2023-12-16
+ * 
+ * @copyright Copyright (c) 2023
+ * 
+ */
+
+#include "utils/timing.h"
+
+/* Timing Funcs. */
+
+uint64_t timing_now_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+uint64_t timing_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + (uint64_t)now.tv_nsec;
+}
+
+double timing_ticks_per_ns(void)
+{
+    struct timespec pause = {.tv_sec = 0, .tv_nsec = TIMING_CALIBRATE_NS};
+    uint64_t started_ns = timing_now_ns();
+    uint64_t started_ticks = timing_cycles();
+
+    nanosleep(&pause, NULL);
+
+    uint64_t elapsed_ticks = timing_cycles() - started_ticks;
+    uint64_t elapsed_ns = timing_now_ns() - started_ns;
+
+    return (elapsed_ns > 0 && elapsed_ticks > 0) ? (double)elapsed_ticks / (double)elapsed_ns : 1.0;
+}
@@ -0,0 +1,173 @@
+/**
+ * @file tracering.c
+ * @author Derek Tan
+ * @brief Implements per-thread connection lifecycle trace rings and their binary dumps.
+ * @date 2023-12-23
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "utils/tracering.h"
+
+/* Helper Vars. */
+
+static const char *const trace_kind_names[TRACE_KIND_COUNT] = {
+    "accept",
+    "parse_start",
+    "route",
+    "handler_done",
+    "send_done",
+    "close"
+};
+
+// File dumps may come from a signal handler, which must not allocate, so they share one buffer.
+static TraceEvent trace_dump_events[TRACE_RING_CAPACITY];
+static atomic_flag trace_dump_busy = ATOMIC_FLAG_INIT;
+
+/* Helper Funcs. */
+
+static void trace_board_fill_header(const TraceBoard *board, TraceFileHeader *header)
+{
+    memset(header, 0, sizeof(TraceFileHeader));
+    memcpy(header->magic, TRACE_FILE_MAGIC, sizeof(header->magic));
+    header->version = TRACE_FILE_VERSION;
+    header->ring_count = (uint32_t)board->ring_count;
+    header->ticks_per_ns = board->ticks_per_ns;
+}
+
+static bool trace_write_all(int fd, const void *data, size_t len)
+{
+    const char *cursor = (const char *)data;
+
+    while (len > 0)
+    {
+        ssize_t temp_wc = write(fd, cursor, len);
+
+        if (temp_wc < 0 && errno == EINTR)
+            continue;
+
+        if (temp_wc <= 0)
+            return false;
+
+        cursor += temp_wc;
+        len -= temp_wc;
+    }
+
+    return true;
+}
+
+/* TraceRing Funcs. */
+
+void tracering_init(TraceRing *ring, uint16_t thread_id)
+{
+    atomic_init(&ring->head, 0);
+    ring->thread_id = thread_id;
+    memset(ring->events, 0, sizeof(ring->events));
+}
+
+uint32_t tracering_snapshot(const TraceRing *ring, TraceEvent *dst)
+{
+    uint64_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint64_t first = (head > TRACE_RING_CAPACITY) ? head - TRACE_RING_CAPACITY : 0;
+
+    for (uint64_t i = first; i < head; i++)
+        dst[i - first] = ring->events[i & (TRACE_RING_CAPACITY - 1)];
+
+    // The owner may have lapped the copy meanwhile, and may be rewriting the slot after its head right now, so those events are dropped.
+    atomic_thread_fence(memory_order_acquire);
+
+    uint64_t head_after = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint64_t first_whole = (head_after + 1 > TRACE_RING_CAPACITY) ? head_after + 1 - TRACE_RING_CAPACITY : 0;
+
+    if (first_whole <= first)
+        return (uint32_t)(head - first);
+
+    if (first_whole >= head)
+        return 0;
+
+    memmove(dst, dst + (first_whole - first), (head - first_whole) * sizeof(TraceEvent));
+
+    return (uint32_t)(head - first_whole);
+}
+
+const char *tracering_kind_name(TraceEventKind kind)
+{
+    return (kind >= 0 && kind < TRACE_KIND_COUNT) ? trace_kind_names[kind] : "unknown";
+}
+
+/* TraceBoard Funcs. */
+
+void trace_board_init(TraceBoard *board, TraceRing *rings, int ring_count)
+{
+    board->rings = rings;
+    board->ring_count = ring_count;
+    board->ticks_per_ns = timing_ticks_per_ns();
+
+    for (int i = 0; i < ring_count; i++)
+        tracering_init(&rings[i], (uint16_t)i);
+}
+
+size_t trace_board_dump_size(const TraceBoard *board)
+{
+    return sizeof(TraceFileHeader) + (size_t)board->ring_count * (sizeof(TraceRingHeader) + sizeof(TraceEvent) * TRACE_RING_CAPACITY);
+}
+
+long trace_board_dump(const TraceBoard *board, char *dst, size_t capacity)
+{
+    TraceFileHeader header;
+    size_t length = sizeof(TraceFileHeader);
+
+    if (capacity < trace_board_dump_size(board))
+        return -1;
+
+    trace_board_fill_header(board, &header);
+    memcpy(dst, &header, sizeof(TraceFileHeader));
+
+    // Events go straight into place after their ring's header, which is filled in once their count is known.
+    for (int i = 0; i < board->ring_count; i++)
+    {
+        TraceRingHeader ring_header = {.thread_id = board->rings[i].thread_id, .event_count = 0};
+        TraceEvent *events = (TraceEvent *)(dst + length + sizeof(TraceRingHeader));
+
+        ring_header.event_count = tracering_snapshot(&board->rings[i], events);
+        memcpy(dst + length, &ring_header, sizeof(TraceRingHeader));
+        length += sizeof(TraceRingHeader) + ring_header.event_count * sizeof(TraceEvent);
+    }
+
+    return (long)length;
+}
+
+bool trace_board_dump_file(const TraceBoard *board, const char *path)
+{
+    TraceFileHeader header;
+    bool write_ok = true;
+
+    if (atomic_flag_test_and_set(&trace_dump_busy))
+        return false;
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    if (fd == -1)
+    {
+        atomic_flag_clear(&trace_dump_busy);
+        return false;
+    }
+
+    trace_board_fill_header(board, &header);
+    write_ok = trace_write_all(fd, &header, sizeof(TraceFileHeader));
+
+    for (int i = 0; i < board->ring_count && write_ok; i++)
+    {
+        TraceRingHeader ring_header = {.thread_id = board->rings[i].thread_id, .event_count = 0};
+
+        ring_header.event_count = tracering_snapshot(&board->rings[i], trace_dump_events);
+        write_ok = trace_write_all(fd, &ring_header, sizeof(TraceRingHeader))
+            && trace_write_all(fd, trace_dump_events, ring_header.event_count * sizeof(TraceEvent));
+    }
+
+    close(fd);
+    atomic_flag_clear(&trace_dump_busy);
+
+    return write_ok;
+}
@@ -0,0 +1,388 @@
+/**
+ * @file transport.c
+ * @author Derek Tan
+ * @brief Implements the socket, in-memory, scripted and tap byte stream transports of client sockets.
+ * @date 2023-12-21
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include "basicio/transport.h"
+
+/* Socket Transport */
+
+static ssize_t transport_socket_recv(Transport *transport, char *dst, size_t count)
+{
+    return recv(transport->fd, dst, count, MSG_DONTWAIT);
+}
+
+static ssize_t transport_socket_sendmsg(Transport *transport, const struct msghdr *msg, int flags)
+{
+    return sendmsg(transport->fd, msg, flags | MSG_DONTWAIT);
+}
+
+static int transport_socket_poll(Transport *transport, short events, int timeout_ms)
+{
+    struct pollfd poll_item = {.fd = transport->fd, .events = events, .revents = 0};
+    int poll_rc = poll(&poll_item, 1, timeout_ms);
+
+    return (poll_rc > 0) ? poll_item.revents : poll_rc;
+}
+
+static void transport_socket_close(Transport *transport)
+{
+    close(transport->fd);
+    transport->fd = TRANSPORT_NO_FD;
+}
+
+static const TransportOps transport_socket_ops = {
+    .recv = transport_socket_recv,
+    .sendmsg = transport_socket_sendmsg,
+    .poll = transport_socket_poll,
+    .close = transport_socket_close
+};
+
+/* Memory Transport */
+
+static ssize_t transport_memory_recv(Transport *transport, char *dst, size_t count)
+{
+    MemPipe *in_pipe = ((MemTransport *)transport->ctx)->in_ref;
+
+    if (mempipe_available(in_pipe) == 0)
+    {
+        if (in_pipe->closed)
+            return 0;
+
+        errno = EAGAIN;
+        return -1;
+    }
+
+    return (ssize_t)mempipe_read(in_pipe, dst, count);
+}
+
+static ssize_t transport_memory_sendmsg(Transport *transport, const struct msghdr *msg, int flags)
+{
+    MemPipe *out_pipe = ((MemTransport *)transport->ctx)->out_ref;
+    ssize_t total_wc = 0;
+
+    (void)flags;
+
+    if (out_pipe->closed)
+    {
+        errno = EPIPE;
+        return -1;
+    }
+
+    for (size_t i = 0; i < msg->msg_iovlen; i++)
+    {
+        if (!mempipe_write(out_pipe, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len))
+        {
+            errno = ENOBUFS;
+            return -1;
+        }
+
+        total_wc += msg->msg_iov[i].iov_len;
+    }
+
+    return total_wc;
+}
+
+static int transport_memory_poll(Transport *transport, short events, int timeout_ms)
+{
+    MemPipe *in_pipe = ((MemTransport *)transport->ctx)->in_ref;
+    int revents = POLLOUT & events;
+
+    (void)timeout_ms;
+
+    if (mempipe_available(in_pipe) > 0 || in_pipe->closed)
+        revents |= POLLIN & events;
+
+    if (revents == 0)
+    {
+        errno = ETIMEDOUT;
+        return -1;
+    }
+
+    return revents;
+}
+
+static void transport_memory_close(Transport *transport)
+{
+    ((MemTransport *)transport->ctx)->out_ref->closed = true;
+}
+
+static const TransportOps transport_memory_ops = {
+    .recv = transport_memory_recv,
+    .sendmsg = transport_memory_sendmsg,
+    .poll = transport_memory_poll,
+    .close = transport_memory_close
+};
+
+/* Scripted Transport */
+
+/**
+ * @brief Gets the size limit of the next call from a script, cycling through it.
+ */
+static size_t transport_script_next(const size_t *sizes, int count, int *step)
+{
+    size_t limit = sizes[*step];
+
+    *step = (*step + 1) % count;
+
+    return limit;
+}
+
+static ssize_t transport_scripted_recv(Transport *transport, char *dst, size_t count)
+{
+    ScriptedTransport *scripted = (ScriptedTransport *)transport->ctx;
+
+    if (scripted->read_sizes != NULL && scripted->read_count > 0)
+    {
+        size_t limit = transport_script_next(scripted->read_sizes, scripted->read_count, &scripted->read_step);
+
+        if (limit == 0)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+
+        count = (count < limit) ? count : limit;
+    }
+
+    return transport_recv(scripted->inner_ref, dst, count);
+}
+
+static ssize_t transport_scripted_sendmsg(Transport *transport, const struct msghdr *msg, int flags)
+{
+    ScriptedTransport *scripted = (ScriptedTransport *)transport->ctx;
+    struct iovec short_iov[msg->msg_iovlen > 0 ? msg->msg_iovlen : 1];
+    struct msghdr short_msg = *msg;
+    size_t limit;
+
+    if (scripted->write_sizes == NULL || scripted->write_count <= 0)
+        return transport_sendmsg(scripted->inner_ref, msg, flags);
+
+    limit = transport_script_next(scripted->write_sizes, scripted->write_count, &scripted->write_step);
+
+    if (limit == 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    // Cut the segments off after limit bytes, as a full socket buffer would.
+    short_msg.msg_iov = short_iov;
+    short_msg.msg_iovlen = 0;
+
+    for (size_t i = 0; i < msg->msg_iovlen && limit > 0; i++)
+    {
+        short_iov[i] = msg->msg_iov[i];
+
+        if (short_iov[i].iov_len > limit)
+            short_iov[i].iov_len = limit;
+
+        limit -= short_iov[i].iov_len;
+        short_msg.msg_iovlen++;
+    }
+
+    return transport_sendmsg(scripted->inner_ref, &short_msg, flags);
+}
+
+static int transport_scripted_poll(Transport *transport, short events, int timeout_ms)
+{
+    return transport_poll(((ScriptedTransport *)transport->ctx)->inner_ref, events, timeout_ms);
+}
+
+static void transport_scripted_close(Transport *transport)
+{
+    transport_close(((ScriptedTransport *)transport->ctx)->inner_ref);
+}
+
+static const TransportOps transport_scripted_ops = {
+    .recv = transport_scripted_recv,
+    .sendmsg = transport_scripted_sendmsg,
+    .poll = transport_scripted_poll,
+    .close = transport_scripted_close
+};
+
+/* Tap Transport */
+
+static ssize_t transport_tap_recv(Transport *transport, char *dst, size_t count)
+{
+    TapTransport *tap = (TapTransport *)transport->ctx;
+    ssize_t temp_rc = transport_recv(&tap->inner, dst, count);
+
+    if (temp_rc > 0)
+        tap->on_recv(tap->tap_ref, tap->inner.fd, dst, (size_t)temp_rc);
+
+    return temp_rc;
+}
+
+static ssize_t transport_tap_sendmsg(Transport *transport, const struct msghdr *msg, int flags)
+{
+    return transport_sendmsg(&((TapTransport *)transport->ctx)->inner, msg, flags);
+}
+
+static int transport_tap_poll(Transport *transport, short events, int timeout_ms)
+{
+    return transport_poll(&((TapTransport *)transport->ctx)->inner, events, timeout_ms);
+}
+
+static void transport_tap_close(Transport *transport)
+{
+    transport_close(&((TapTransport *)transport->ctx)->inner);
+    transport->fd = TRANSPORT_NO_FD;
+}
+
+static const TransportOps transport_tap_ops = {
+    .recv = transport_tap_recv,
+    .sendmsg = transport_tap_sendmsg,
+    .poll = transport_tap_poll,
+    .close = transport_tap_close
+};
+
+/* Transport Funcs. */
+
+void transport_init_socket(Transport *transport, int fd)
+{
+    transport->ops = &transport_socket_ops;
+    transport->ctx = NULL;
+    transport->fd = fd;
+}
+
+void transport_init_memory(Transport *transport, MemTransport *mem)
+{
+    transport->ops = &transport_memory_ops;
+    transport->ctx = mem;
+    transport->fd = TRANSPORT_NO_FD;
+}
+
+void transport_init_scripted(Transport *transport, ScriptedTransport *scripted)
+{
+    scripted->read_step = 0;
+    scripted->write_step = 0;
+
+    transport->ops = &transport_scripted_ops;
+    transport->ctx = scripted;
+    transport->fd = TRANSPORT_NO_FD;
+}
+
+void transport_init_tap(Transport *transport, TapTransport *tap)
+{
+    transport->ops = &transport_tap_ops;
+    transport->ctx = tap;
+    transport->fd = tap->inner.fd;
+}
+
+bool transport_is_socket(const Transport *transport)
+{
+    // Taps pass sends and their flags on unchanged, so socket-only features such as MSG_ZEROCOPY work through them.
+    while (transport->ops == &transport_tap_ops)
+        transport = &((const TapTransport *)transport->ctx)->inner;
+
+    return transport->ops == &transport_socket_ops;
+}
+
+ssize_t transport_recv(Transport *transport, char *dst, size_t count)
+{
+    return transport->ops->recv(transport, dst, count);
+}
+
+ssize_t transport_sendmsg(Transport *transport, const struct msghdr *msg, int flags)
+{
+    return transport->ops->sendmsg(transport, msg, flags);
+}
+
+int transport_poll(Transport *transport, short events, int timeout_ms)
+{
+    return transport->ops->poll(transport, events, timeout_ms);
+}
+
+void transport_close(Transport *transport)
+{
+    transport->ops->close(transport);
+}
+
+/* MemPipe Funcs. */
+
+bool mempipe_init(MemPipe *pipe, size_t capacity)
+{
+    pipe->data = malloc(capacity);
+    pipe->capacity = (pipe->data != NULL) ? capacity : 0;
+    pipe->read_pos = 0;
+    pipe->write_pos = 0;
+    pipe->closed = false;
+
+    return pipe->data != NULL;
+}
+
+void mempipe_dispose(MemPipe *pipe)
+{
+    free(pipe->data);
+    pipe->data = NULL;
+    pipe->capacity = 0;
+    pipe->read_pos = 0;
+    pipe->write_pos = 0;
+}
+
+bool mempipe_write(MemPipe *pipe, const char *data, size_t len)
+{
+    // Reuse the space of bytes already read before growing.
+    if (pipe->read_pos > 0 && pipe->write_pos + len > pipe->capacity)
+    {
+        memmove(pipe->data, pipe->data + pipe->read_pos, pipe->write_pos - pipe->read_pos);
+        pipe->write_pos -= pipe->read_pos;
+        pipe->read_pos = 0;
+    }
+
+    if (pipe->write_pos + len > pipe->capacity)
+    {
+        size_t next_capacity = (pipe->capacity > 0) ? pipe->capacity : MEMPIPE_DEFAULT_CAPACITY;
+
+        while (next_capacity < pipe->write_pos + len)
+            next_capacity *= 2;
+
+        char *next_data = realloc(pipe->data, next_capacity);
+
+        if (!next_data)
+            return false;
+
+        pipe->data = next_data;
+        pipe->capacity = next_capacity;
+    }
+
+    memcpy(pipe->data + pipe->write_pos, data, len);
+    pipe->write_pos += len;
+
+    return true;
+}
+
+size_t mempipe_read(MemPipe *pipe, char *dst, size_t count)
+{
+    size_t available = pipe->write_pos - pipe->read_pos;
+    size_t taken = (count < available) ? count : available;
+
+    memcpy(dst, pipe->data + pipe->read_pos, taken);
+    pipe->read_pos += taken;
+
+    if (pipe->read_pos == pipe->write_pos)
+    {
+        pipe->read_pos = 0;
+        pipe->write_pos = 0;
+    }
+
+    return taken;
+}
+
+size_t mempipe_available(const MemPipe *pipe)
+{
+    return pipe->write_pos - pipe->read_pos;
+}
+
+void mempipe_clear(MemPipe *pipe)
+{
+    pipe->read_pos = 0;
+    pipe->write_pos = 0;
+    pipe->closed = false;
+}
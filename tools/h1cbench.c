@@ -0,0 +1,831 @@
+/**
+ * @file h1cbench.c
+ * @author Derek Tan
+ * @brief HTTP/1.1 load generator for measuring H1C: epoll client threads in keep-alive, pipelining or connection-storm mode, with JSON results to compare runs.
+ * @date 2023-12-20
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+#include "utils/timing.h"
+
+/* Macros */
+
+#define BENCH_MAX_THREADS 64
+#define BENCH_MAX_DEPTH 64        // most pipelined requests in flight per connection
+#define BENCH_RECV_SIZE 65536
+#define BENCH_REQUEST_SIZE 1024
+#define BENCH_MAX_EVENTS 256
+#define BENCH_POLL_MS 50          // longest wait before rechecking the stop flag
+#define BENCH_LAUNCH_WAIT_MS 5000 // longest wait for a launched server to accept
+
+/* Enums */
+
+typedef enum bench_mode_e
+{
+    BENCH_KEEPALIVE, // one request in flight per persistent connection
+    BENCH_PIPELINE,  // a window of requests in flight per persistent connection
+    BENCH_STORM      // a new connection per request
+} BenchMode;
+
+typedef enum conn_state_e
+{
+    CONN_CONNECTING,
+    CONN_OPEN
+} ConnState;
+
+/* Structs */
+
+typedef struct bench_config_t
+{
+    const char *host;
+    const char *port;
+    const char *path;
+    const char *server_exe;  // server to launch on the port first, or NULL for one already running
+    const char *json_path;   // where to write results, or NULL for stdout
+    BenchMode mode;
+    int threads;
+    int connections;
+    int depth;
+    int duration_secs;
+    int warmup_secs;
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    char request[BENCH_REQUEST_SIZE];
+    size_t request_len;
+} BenchConfig;
+
+typedef struct bench_errors_t
+{
+    uint64_t connect;
+    uint64_t read;
+    uint64_t write;
+    uint64_t parse;
+    uint64_t status;  // replies other than 2xx or 3xx
+} BenchErrors;
+
+/**
+ * @brief Latencies of one thread's replies in nanoseconds, merged and sorted at the end for exact percentiles.
+ */
+typedef struct latency_log_t
+{
+    uint64_t *items;
+    size_t count;
+    size_t capacity;
+} LatencyLog;
+
+typedef struct bench_conn_t
+{
+    int fd;
+    ConnState state;
+    bool want_out;                       // EPOLLOUT is armed
+    bool closing;                        // the server announced it closes after the current reply
+    int to_send;                         // queued requests not fully written yet
+    size_t out_off;                      // bytes of the first queued request already written
+    uint64_t sent_ns[BENCH_MAX_DEPTH];   // ring of request start times, oldest reply first
+    int sent_head;
+    int inflight;
+    size_t body_left;                    // body bytes of the current reply still to skip
+    bool in_body;
+    int status;
+    size_t recv_len;
+    char recv_buf[BENCH_RECV_SIZE];
+} BenchConn;
+
+typedef struct bench_thread_t
+{
+    pthread_t id;
+    int epoll_fd;
+    int conn_count;
+    BenchConn *conns;
+    const BenchConfig *config;
+    uint64_t requests;
+    uint64_t bytes_read;
+    uint64_t connects;
+    BenchErrors errors;
+    LatencyLog latencies;
+} BenchThread;
+
+/* Globals */
+
+static atomic_bool bench_stop = false;
+static atomic_uint_fast64_t bench_measure_from_ns = 0;  // replies before this are warmup
+
+/* Helper Funcs. */
+
+static bool latency_log_put(LatencyLog *log, uint64_t value)
+{
+    if (log->count == log->capacity)
+    {
+        size_t next_capacity = (log->capacity == 0) ? 4096 : log->capacity * 2;
+        uint64_t *next_items = realloc(log->items, next_capacity * sizeof(uint64_t));
+
+        if (!next_items)
+            return false;
+
+        log->items = next_items;
+        log->capacity = next_capacity;
+    }
+
+    log->items[log->count++] = value;
+
+    return true;
+}
+
+static int compare_u64(const void *lhs, const void *rhs)
+{
+    uint64_t a = *(const uint64_t *)lhs;
+    uint64_t b = *(const uint64_t *)rhs;
+
+    return (a > b) - (a < b);
+}
+
+static double percentile_us(const LatencyLog *log, double fraction)
+{
+    if (log->count == 0)
+        return 0.0;
+
+    size_t rank = (size_t)(fraction * (double)(log->count - 1) + 0.5);
+
+    return (double)log->items[rank] / 1000.0;
+}
+
+static bool conn_arm(BenchThread *thread, BenchConn *conn, int op)
+{
+    struct epoll_event conn_event = {.events = EPOLLIN | EPOLLRDHUP, .data.ptr = conn};
+
+    conn->want_out = conn->state == CONN_CONNECTING || conn->to_send > 0;
+
+    if (conn->want_out)
+        conn_event.events |= EPOLLOUT;
+
+    return epoll_ctl(thread->epoll_fd, op, conn->fd, &conn_event) == 0;
+}
+
+static void conn_queue_request(BenchConn *conn)
+{
+    int slot = (conn->sent_head + conn->inflight) % BENCH_MAX_DEPTH;
+
+    conn->sent_ns[slot] = timing_now_ns();
+    conn->inflight++;
+    conn->to_send++;
+}
+
+/**
+ * @brief Starts a non-blocking connect, so storms measure the server's accept path rather than the client's.
+ */
+static bool conn_open(BenchThread *thread, BenchConn *conn)
+{
+    const BenchConfig *config = thread->config;
+    int window = (config->mode == BENCH_PIPELINE) ? config->depth : 1;
+
+    conn->fd = socket(config->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    conn->state = CONN_CONNECTING;
+    conn->closing = false;
+    conn->to_send = 0;
+    conn->out_off = 0;
+    conn->sent_head = 0;
+    conn->inflight = 0;
+    conn->body_left = 0;
+    conn->in_body = false;
+    conn->recv_len = 0;
+
+    if (conn->fd == -1)
+        return false;
+
+    if (config->addr.ss_family != AF_UNIX)
+    {
+        int flag_on = 1;
+        setsockopt(conn->fd, IPPROTO_TCP, TCP_NODELAY, &flag_on, sizeof(flag_on));
+    }
+
+    if (connect(conn->fd, (const struct sockaddr *)&config->addr, config->addr_len) == -1 && errno != EINPROGRESS)
+    {
+        close(conn->fd);
+        conn->fd = -1;
+        return false;
+    }
+
+    for (int i = 0; i < window; i++)
+        conn_queue_request(conn);
+
+    return conn_arm(thread, conn, EPOLL_CTL_ADD);
+}
+
+/**
+ * @brief Closes a connection and opens its replacement. Requests the server dropped after announcing a close are not errors.
+ */
+static void conn_reopen(BenchThread *thread, BenchConn *conn, bool failed)
+{
+    if (failed && conn->inflight > 0)
+        thread->errors.read++;
+
+    if (conn->fd != -1)
+        close(conn->fd);
+
+    conn->fd = -1;
+
+    // Back off a little if the client runs out of ports or fds, instead of spinning.
+    while (!atomic_load(&bench_stop) && !conn_open(thread, conn))
+    {
+        thread->errors.connect++;
+        usleep(1000);
+    }
+}
+
+static bool conn_flush(BenchThread *thread, BenchConn *conn)
+{
+    const BenchConfig *config = thread->config;
+    struct iovec out_iov[BENCH_MAX_DEPTH];
+
+    while (conn->to_send > 0)
+    {
+        int iov_count = (conn->to_send < BENCH_MAX_DEPTH) ? conn->to_send : BENCH_MAX_DEPTH;
+        struct msghdr msg;
+
+        for (int i = 0; i < iov_count; i++)
+        {
+            out_iov[i].iov_base = (char *)config->request;
+            out_iov[i].iov_len = config->request_len;
+        }
+
+        out_iov[0].iov_base = (char *)config->request + conn->out_off;
+        out_iov[0].iov_len -= conn->out_off;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = out_iov;
+        msg.msg_iovlen = iov_count;
+
+        ssize_t temp_wc = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+
+        if (temp_wc < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            thread->errors.write++;
+            return false;
+        }
+
+        size_t sent = (size_t)temp_wc + conn->out_off;
+
+        conn->to_send -= (int)(sent / config->request_len);
+        conn->out_off = sent % config->request_len;
+    }
+
+    // Only toggle EPOLLOUT when it changes, since every epoll_ctl is a system call.
+    if (conn->want_out != (conn->to_send > 0))
+        return conn_arm(thread, conn, EPOLL_CTL_MOD);
+
+    return true;
+}
+
+/**
+ * @brief Parses the status line and headers of a reply, which must have a Content-Length since bodies are skipped by count.
+ */
+static bool conn_parse_head(BenchConn *conn, const char *head, size_t head_len)
+{
+    const char *head_end = head + head_len;
+    const char *line = memchr(head, '\n', head_len);
+    bool has_length = false;
+
+    if (sscanf(head, "HTTP/1.%*d %d", &conn->status) != 1)
+        return false;
+
+    conn->body_left = 0;
+
+    while (line != NULL && ++line < head_end)
+    {
+        if (strncasecmp(line, "Content-Length:", 15) == 0)
+        {
+            conn->body_left = strtoull(line + 15, NULL, 10);
+            has_length = true;
+        }
+        else if (strncasecmp(line, "Connection:", 11) == 0 && strncasecmp(line + 11 + strspn(line + 11, " "), "close", 5) == 0)
+        {
+            conn->closing = true;
+        }
+
+        line = memchr(line, '\n', head_end - line);
+    }
+
+    return has_length;
+}
+
+static void conn_on_reply(BenchThread *thread, BenchConn *conn)
+{
+    uint64_t now_ns = timing_now_ns();
+    uint64_t started_ns = conn->sent_ns[conn->sent_head];
+
+    conn->sent_head = (conn->sent_head + 1) % BENCH_MAX_DEPTH;
+    conn->inflight--;
+
+    if (started_ns >= atomic_load(&bench_measure_from_ns))
+    {
+        thread->requests++;
+
+        if (conn->status < 200 || conn->status >= 400)
+            thread->errors.status++;
+
+        latency_log_put(&thread->latencies, now_ns - started_ns);
+    }
+
+    // Keep the window full on persistent connections, but send nothing more once the server said it closes.
+    if (thread->config->mode != BENCH_STORM && !conn->closing && !atomic_load(&bench_stop))
+        conn_queue_request(conn);
+}
+
+/**
+ * @brief Consumes whole replies from the receive buffer and keeps any partial one for the next read.
+ * @returns false if a reply was malformed.
+ */
+static bool conn_consume(BenchThread *thread, BenchConn *conn)
+{
+    size_t pos = 0;
+
+    while (pos < conn->recv_len)
+    {
+        if (conn->in_body)
+        {
+            size_t avail = conn->recv_len - pos;
+            size_t take = (conn->body_left < avail) ? conn->body_left : avail;
+
+            conn->body_left -= take;
+            pos += take;
+
+            if (conn->body_left > 0)
+                break;
+
+            conn->in_body = false;
+            conn_on_reply(thread, conn);
+            continue;
+        }
+
+        const char *head = conn->recv_buf + pos;
+        const char *head_end = memmem(head, conn->recv_len - pos, "\r\n\r\n", 4);
+
+        if (!head_end)
+        {
+            // Headers longer than the whole buffer would never complete.
+            if (pos == 0 && conn->recv_len == BENCH_RECV_SIZE)
+                return false;
+
+            break;
+        }
+
+        if (!conn_parse_head(conn, head, head_end - head + 2))
+            return false;
+
+        pos += (head_end - head) + 4;
+        conn->in_body = true;
+
+        if (conn->body_left == 0)
+        {
+            conn->in_body = false;
+            conn_on_reply(thread, conn);
+        }
+    }
+
+    memmove(conn->recv_buf, conn->recv_buf + pos, conn->recv_len - pos);
+    conn->recv_len -= pos;
+
+    return true;
+}
+
+static void conn_on_event(BenchThread *thread, BenchConn *conn, uint32_t events)
+{
+    if (conn->state == CONN_CONNECTING)
+    {
+        int sock_error = 0;
+        socklen_t error_len = sizeof(sock_error);
+
+        if (!(events & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+            return;
+
+        getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &sock_error, &error_len);
+
+        if (sock_error != 0)
+        {
+            thread->errors.connect++;
+            conn->inflight = 0;
+            conn_reopen(thread, conn, false);
+            return;
+        }
+
+        conn->state = CONN_OPEN;
+        thread->connects++;
+    }
+
+    if ((events & EPOLLOUT) && !conn_flush(thread, conn))
+    {
+        conn->inflight = 0;
+        conn_reopen(thread, conn, false);
+        return;
+    }
+
+    if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)))
+        return;
+
+    while (true)
+    {
+        ssize_t temp_rc = recv(conn->fd, conn->recv_buf + conn->recv_len, BENCH_RECV_SIZE - conn->recv_len, 0);
+
+        if (temp_rc > 0)
+        {
+            thread->bytes_read += temp_rc;
+            conn->recv_len += temp_rc;
+
+            if (!conn_consume(thread, conn))
+            {
+                thread->errors.parse++;
+                conn->inflight = 0;
+                conn_reopen(thread, conn, false);
+                return;
+            }
+
+            continue;
+        }
+
+        if (temp_rc < 0 && errno == EINTR)
+            continue;
+
+        if (temp_rc < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+
+        // The server closed: expected in storms and after a keep-alive limit, a failure otherwise.
+        conn_reopen(thread, conn, !conn->closing && thread->config->mode != BENCH_STORM);
+        return;
+    }
+
+    // A storm connection is done after its one reply.
+    if (thread->config->mode == BENCH_STORM && conn->inflight == 0)
+    {
+        conn_reopen(thread, conn, false);
+        return;
+    }
+
+    // Replies may have queued more requests.
+    if (conn->to_send > 0 && !conn_flush(thread, conn))
+    {
+        conn->inflight = 0;
+        conn_reopen(thread, conn, false);
+    }
+}
+
+static void *bench_thread_run(void *thread_ref)
+{
+    BenchThread *thread = (BenchThread *)thread_ref;
+    struct epoll_event events[BENCH_MAX_EVENTS];
+
+    for (int i = 0; i < thread->conn_count; i++)
+    {
+        thread->conns[i].fd = -1;
+
+        if (!conn_open(thread, &thread->conns[i]))
+            thread->errors.connect++;
+    }
+
+    while (!atomic_load(&bench_stop))
+    {
+        int event_count = epoll_wait(thread->epoll_fd, events, BENCH_MAX_EVENTS, BENCH_POLL_MS);
+
+        for (int i = 0; i < event_count; i++)
+            conn_on_event(thread, (BenchConn *)events[i].data.ptr, events[i].events);
+    }
+
+    for (int i = 0; i < thread->conn_count; i++)
+    {
+        if (thread->conns[i].fd != -1)
+            close(thread->conns[i].fd);
+    }
+
+    return NULL;
+}
+
+static bool bench_resolve(BenchConfig *config)
+{
+    struct addrinfo hints, *result;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(config->host, config->port, &hints, &result) != 0)
+        return false;
+
+    memcpy(&config->addr, result->ai_addr, result->ai_addrlen);
+    config->addr_len = result->ai_addrlen;
+    freeaddrinfo(result);
+
+    return true;
+}
+
+/**
+ * @brief Starts the server under test on the benchmark port and waits until it accepts.
+ * @returns The server's pid, or -1 if it did not come up.
+ */
+static pid_t bench_launch(const BenchConfig *config)
+{
+    pid_t server_pid = fork();
+
+    if (server_pid == 0)
+    {
+        int null_fd = open("/dev/null", O_WRONLY);
+
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        execl(config->server_exe, config->server_exe, config->port, (char *)NULL);
+        _exit(127);
+    }
+
+    if (server_pid < 0)
+        return -1;
+
+    uint64_t give_up_ms = timing_now_ms() + BENCH_LAUNCH_WAIT_MS;
+
+    while (timing_now_ms() < give_up_ms)
+    {
+        int probe_fd = socket(config->addr.ss_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        bool is_up = connect(probe_fd, (const struct sockaddr *)&config->addr, config->addr_len) == 0;
+
+        close(probe_fd);
+
+        if (is_up)
+            return server_pid;
+
+        if (waitpid(server_pid, NULL, WNOHANG) == server_pid)
+            return -1;
+
+        usleep(20000);
+    }
+
+    kill(server_pid, SIGKILL);
+    waitpid(server_pid, NULL, 0);
+
+    return -1;
+}
+
+static const char *bench_mode_name(BenchMode mode)
+{
+    switch (mode)
+    {
+    case BENCH_PIPELINE:
+        return "pipeline";
+    case BENCH_STORM:
+        return "storm";
+    default:
+        return "keepalive";
+    }
+}
+
+static bool bench_parse_mode(const char *name, BenchMode *mode)
+{
+    if (strcmp(name, "keepalive") == 0)
+        *mode = BENCH_KEEPALIVE;
+    else if (strcmp(name, "pipeline") == 0)
+        *mode = BENCH_PIPELINE;
+    else if (strcmp(name, "storm") == 0)
+        *mode = BENCH_STORM;
+    else
+        return false;
+
+    return true;
+}
+
+static void bench_usage(const char *exe)
+{
+    fprintf(stderr,
+        "usage: %s [-m keepalive|pipeline|storm] [-t threads] [-c connections] [-d seconds] [-w warmup seconds]\n"
+        "          [-P pipeline depth] [-H host] [-p port] [-u path] [-s server to launch] [-o results.json]\n", exe);
+}
+
+static bool bench_parse_args(BenchConfig *config, int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:t:c:d:w:P:H:p:u:s:o:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            if (!bench_parse_mode(optarg, &config->mode))
+                return false;
+            break;
+        case 't':
+            config->threads = atoi(optarg);
+            break;
+        case 'c':
+            config->connections = atoi(optarg);
+            break;
+        case 'd':
+            config->duration_secs = atoi(optarg);
+            break;
+        case 'w':
+            config->warmup_secs = atoi(optarg);
+            break;
+        case 'P':
+            config->depth = atoi(optarg);
+            break;
+        case 'H':
+            config->host = optarg;
+            break;
+        case 'p':
+            config->port = optarg;
+            break;
+        case 'u':
+            config->path = optarg;
+            break;
+        case 's':
+            config->server_exe = optarg;
+            break;
+        case 'o':
+            config->json_path = optarg;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return config->threads > 0 && config->threads <= BENCH_MAX_THREADS && config->connections >= config->threads
+        && config->duration_secs > 0 && config->warmup_secs >= 0 && config->depth > 0 && config->depth <= BENCH_MAX_DEPTH;
+}
+
+static void bench_write_json(FILE *out, const BenchConfig *config, const BenchThread *threads, const LatencyLog *merged, double elapsed_secs)
+{
+    uint64_t requests = 0, bytes_read = 0, connects = 0;
+    BenchErrors errors = {0};
+    double latency_sum_us = 0.0;
+
+    for (int i = 0; i < config->threads; i++)
+    {
+        requests += threads[i].requests;
+        bytes_read += threads[i].bytes_read;
+        connects += threads[i].connects;
+        errors.connect += threads[i].errors.connect;
+        errors.read += threads[i].errors.read;
+        errors.write += threads[i].errors.write;
+        errors.parse += threads[i].errors.parse;
+        errors.status += threads[i].errors.status;
+    }
+
+    for (size_t i = 0; i < merged->count; i++)
+        latency_sum_us += (double)merged->items[i] / 1000.0;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"tool\": \"h1cbench\",\n");
+    fprintf(out, "  \"mode\": \"%s\",\n", bench_mode_name(config->mode));
+    fprintf(out, "  \"target\": \"%s:%s%s\",\n", config->host, config->port, config->path);
+    fprintf(out, "  \"threads\": %d,\n", config->threads);
+    fprintf(out, "  \"connections\": %d,\n", config->connections);
+    fprintf(out, "  \"pipeline_depth\": %d,\n", (config->mode == BENCH_PIPELINE) ? config->depth : 1);
+    fprintf(out, "  \"duration_s\": %.3f,\n", elapsed_secs);
+    fprintf(out, "  \"requests\": %lu,\n", (unsigned long)requests);
+    fprintf(out, "  \"rps\": %.1f,\n", (elapsed_secs > 0.0) ? (double)requests / elapsed_secs : 0.0);
+    fprintf(out, "  \"bytes_read\": %lu,\n", (unsigned long)bytes_read);
+    fprintf(out, "  \"connects\": %lu,\n", (unsigned long)connects);
+    fprintf(out, "  \"latency_us\": {\"mean\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p999\": %.1f, \"max\": %.1f},\n",
+        (merged->count > 0) ? latency_sum_us / (double)merged->count : 0.0,
+        percentile_us(merged, 0.50), percentile_us(merged, 0.90), percentile_us(merged, 0.99), percentile_us(merged, 0.999),
+        percentile_us(merged, 1.0));
+    fprintf(out, "  \"errors\": {\"connect\": %lu, \"read\": %lu, \"write\": %lu, \"parse\": %lu, \"status\": %lu}\n",
+        (unsigned long)errors.connect, (unsigned long)errors.read, (unsigned long)errors.write, (unsigned long)errors.parse,
+        (unsigned long)errors.status);
+    fprintf(out, "}\n");
+}
+
+int main(int argc, char *argv[])
+{
+    static BenchThread threads[BENCH_MAX_THREADS];
+    BenchConfig config = {
+        .host = "127.0.0.1", .port = "8000", .path = "/home", .server_exe = NULL, .json_path = NULL,
+        .mode = BENCH_KEEPALIVE, .threads = 2, .connections = 64, .depth = 8, .duration_secs = 5, .warmup_secs = 1
+    };
+    LatencyLog merged = {NULL, 0, 0};
+    pid_t server_pid = -1;
+    int exit_code = 0;
+
+    if (!bench_parse_args(&config, argc, argv))
+    {
+        bench_usage(argv[0]);
+        return 1;
+    }
+
+    if (!bench_resolve(&config))
+    {
+        fprintf(stderr, "h1cbench: cannot resolve %s:%s\n", config.host, config.port);
+        return 1;
+    }
+
+    config.request_len = snprintf(config.request, sizeof(config.request), "GET %s HTTP/1.1\r\nHost: %s:%s\r\nUser-Agent: h1cbench\r\n%s\r\n",
+        config.path, config.host, config.port, (config.mode == BENCH_STORM) ? "Connection: close\r\n" : "");
+
+    if (config.request_len >= sizeof(config.request))
+    {
+        fprintf(stderr, "h1cbench: request path is too long\n");
+        return 1;
+    }
+
+    if (config.server_exe != NULL && (server_pid = bench_launch(&config)) == -1)
+    {
+        fprintf(stderr, "h1cbench: %s did not start on port %s\n", config.server_exe, config.port);
+        return 1;
+    }
+
+    // Spread connections evenly, each thread owning its own epoll set.
+    uint64_t started_ns = timing_now_ns();
+
+    atomic_store(&bench_measure_from_ns, started_ns + (uint64_t)config.warmup_secs * 1000000000);
+
+    for (int i = 0; i < config.threads; i++)
+    {
+        threads[i].config = &config;
+        threads[i].conn_count = config.connections / config.threads + ((i < config.connections % config.threads) ? 1 : 0);
+        threads[i].conns = calloc(threads[i].conn_count, sizeof(BenchConn));
+        threads[i].epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+
+        if (!threads[i].conns || threads[i].epoll_fd == -1 || pthread_create(&threads[i].id, NULL, bench_thread_run, &threads[i]) != 0)
+        {
+            fprintf(stderr, "h1cbench: cannot start thread %d\n", i);
+            atomic_store(&bench_stop, true);
+            config.threads = i;
+            exit_code = 1;
+            break;
+        }
+    }
+
+    if (exit_code == 0)
+        sleep((unsigned)(config.warmup_secs + config.duration_secs));
+
+    atomic_store(&bench_stop, true);
+    uint64_t stopped_ns = timing_now_ns();
+
+    for (int i = 0; i < config.threads; i++)
+    {
+        pthread_join(threads[i].id, NULL);
+
+        for (size_t j = 0; j < threads[i].latencies.count; j++)
+            latency_log_put(&merged, threads[i].latencies.items[j]);
+    }
+
+    if (server_pid != -1)
+    {
+        kill(server_pid, SIGKILL);
+        waitpid(server_pid, NULL, 0);
+    }
+
+    if (exit_code == 0)
+    {
+        uint64_t measured_ns = stopped_ns - atomic_load(&bench_measure_from_ns);
+        FILE *out = (config.json_path != NULL) ? fopen(config.json_path, "w") : stdout;
+
+        qsort(merged.items, merged.count, sizeof(uint64_t), compare_u64);
+
+        if (out != NULL)
+        {
+            bench_write_json(out, &config, threads, &merged, (double)measured_ns / 1e9);
+
+            if (out != stdout)
+                fclose(out);
+        }
+        else
+        {
+            fprintf(stderr, "h1cbench: cannot write %s\n", config.json_path);
+            exit_code = 1;
+        }
+    }
+
+    for (int i = 0; i < config.threads; i++)
+    {
+        free(threads[i].conns);
+        free(threads[i].latencies.items);
+        close(threads[i].epoll_fd);
+    }
+
+    free(merged.items);
+
+    return exit_code;
+}
@@ -0,0 +1,273 @@
+/**
+ * @file h1ccheck.c
+ * @author Derek Tan
+ * @brief Deterministic checks of the request scanner over scripted memory transports, so fragmented and stalled reads are covered without sockets or timing luck.
+ * @date 2023-12-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "basicio/sockets.h"
+#include "h1c/h1scanner.h"
+#include "utils/arena.h"
+#include "utils/timing.h"
+#include "server/srvworker.h"
+
+/* Macros */
+
+#define CHECK_BODY_SIZE 256
+
+// Failed checks return at once, leaving their connection to the process exit.
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) \
+        { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            return false; \
+        } \
+    } while (0)
+
+#define CHECK_STR(actual, expected) CHECK((actual) != NULL && strcmp((actual), (expected)) == 0)
+
+#define CHECK_SIZES(sizes) (sizes), (int)(sizeof(sizes) / sizeof((sizes)[0]))
+
+/* Structs */
+
+/**
+ * @brief A scanner reading, through a script of read sizes, whatever was written into its memory pipe.
+ */
+typedef struct check_conn_t
+{
+    MemPipe in_pipe;
+    MemPipe out_pipe;
+    MemTransport mem;
+    ScriptedTransport scripted;
+    Transport mem_transport;
+    Transport cli_transport;
+    ClientSocket cli_sock;
+    Arena arena;
+    char *slab;
+    HttpScanner scanner;
+    BaseRequest request;
+} CheckConn;
+
+/* Helper Funcs. */
+
+static bool check_conn_open(CheckConn *conn, const char *raw, const size_t *read_sizes, int read_count)
+{
+    memset(conn, 0, sizeof(CheckConn));
+
+    if (!mempipe_init(&conn->in_pipe, MEMPIPE_DEFAULT_CAPACITY) || !mempipe_init(&conn->out_pipe, MEMPIPE_DEFAULT_CAPACITY))
+        return false;
+
+    conn->slab = malloc(SRVWORKER_SLAB_SIZE);
+
+    if (!conn->slab || !arena_init(&conn->arena, SRVWORKER_ARENA_BLOCK_SIZE))
+        return false;
+
+    conn->mem.in_ref = &conn->in_pipe;
+    conn->mem.out_ref = &conn->out_pipe;
+    transport_init_memory(&conn->mem_transport, &conn->mem);
+
+    conn->scripted.inner_ref = &conn->mem_transport;
+    conn->scripted.read_sizes = read_sizes;
+    conn->scripted.read_count = read_count;
+    transport_init_scripted(&conn->cli_transport, &conn->scripted);
+
+    clientsocket_init_transport(&conn->cli_sock, &conn->cli_transport);
+    h1scanner_init(&conn->scanner, &conn->cli_sock, 0, &conn->arena, conn->slab);
+    basic_reqinfo_init(&conn->request);
+
+    return mempipe_write(&conn->in_pipe, raw, strlen(raw));
+}
+
+static void check_conn_next(CheckConn *conn)
+{
+    h1scanner_reset(&conn->scanner);
+    basic_reqinfo_clear(&conn->request);
+    arena_reset(&conn->arena);
+}
+
+static void check_conn_close(CheckConn *conn)
+{
+    h1scanner_dispose(&conn->scanner);
+    arena_dispose(&conn->arena);
+    free(conn->slab);
+    mempipe_dispose(&conn->in_pipe);
+    mempipe_dispose(&conn->out_pipe);
+}
+
+/**
+ * @brief Reads the whole body of the scanned request into dst as a NUL terminated string.
+ */
+static bool check_read_body(CheckConn *conn, char *dst, size_t capacity)
+{
+    const char *chunk = NULL;
+    ssize_t chunk_len = 0;
+    size_t total_len = 0;
+
+    while ((chunk_len = h1scanner_read_body(&conn->scanner, &chunk)) > 0)
+    {
+        if (total_len + (size_t)chunk_len >= capacity)
+            return false;
+
+        memcpy(dst + total_len, chunk, (size_t)chunk_len);
+        total_len += (size_t)chunk_len;
+    }
+
+    dst[total_len] = '\0';
+
+    return chunk_len == 0;
+}
+
+/* Checks */
+
+/**
+ * @brief A browser's revalidation, handed over one byte per read.
+ */
+static bool check_one_byte_reads(void)
+{
+    static const size_t read_sizes[] = {1};
+    const char *raw = "GET /index.css HTTP/1.1\r\nHost: localhost:8080\r\nConnection: keep-alive\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\nIf-None-Match: \"5d8c72a5edda8d6a\"\r\n\r\n";
+    CheckConn conn;
+    const BaseRequest *req = &conn.request;
+
+    CHECK(check_conn_open(&conn, raw, CHECK_SIZES(read_sizes)));
+    CHECK(h1scanner_read_reqinfo(&conn.scanner, &conn.request));
+    CHECK(req->method_id == GET);
+    CHECK(req->schema_id == HTTP_SCHEMA_1_1);
+    CHECK_STR(req->path_str, "/index.css");
+    CHECK_STR(req->host_hstr, "localhost:8080");
+    CHECK_STR(req->if_none_match_hstr, "\"5d8c72a5edda8d6a\"");
+    CHECK(req->keep_connection);
+    CHECK(req->accept_encodings == (ENCODING_FLAG(ENCODING_IDENTITY) | ENCODING_FLAG(ENCODING_GZIP) | ENCODING_FLAG(ENCODING_BR)));
+    CHECK(!h1scanner_has_body(&conn.scanner));
+    CHECK(mempipe_available(&conn.in_pipe) == 0);
+
+    check_conn_close(&conn);
+
+    return true;
+}
+
+/**
+ * @brief An upload pipelined with the next request, one byte per read, so the body must end exactly where the next request starts.
+ */
+static bool check_one_byte_body(void)
+{
+    static const size_t read_sizes[] = {1};
+    const char *raw = "POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Length: 27\r\n\r\nhello from the h1c check!\n\n"
+        "GET /home HTTP/1.0\r\nHost: localhost\r\n\r\n";
+    char body[CHECK_BODY_SIZE];
+    CheckConn conn;
+
+    CHECK(check_conn_open(&conn, raw, CHECK_SIZES(read_sizes)));
+    CHECK(h1scanner_read_reqinfo(&conn.scanner, &conn.request));
+    CHECK(conn.request.method_id == POST);
+    CHECK_STR(conn.request.path_str, "/upload");
+    CHECK(conn.request.content_len == 27);
+    CHECK(h1scanner_has_body(&conn.scanner));
+    CHECK(check_read_body(&conn, body, CHECK_BODY_SIZE));
+    CHECK_STR(body, "hello from the h1c check!\n\n");
+
+    check_conn_next(&conn);
+
+    CHECK(h1scanner_read_reqinfo(&conn.scanner, &conn.request));
+    CHECK(conn.request.method_id == GET);
+    CHECK(conn.request.schema_id == HTTP_SCHEMA_1_0);
+    CHECK_STR(conn.request.path_str, "/home");
+    CHECK(!conn.request.keep_connection);
+
+    check_conn_close(&conn);
+
+    return true;
+}
+
+/**
+ * @brief A chunked upload in odd reads with stalls between them, as from a client behind a slow, lossy link.
+ */
+static bool check_stalled_chunked_body(void)
+{
+    static const size_t read_sizes[] = {1, 0, 7, 3, 0, 0, 64, 2, 512, 5};
+    const char *raw = "POST /upload HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\n\r\n";
+    char body[CHECK_BODY_SIZE];
+    CheckConn conn;
+
+    CHECK(check_conn_open(&conn, raw, CHECK_SIZES(read_sizes)));
+    CHECK(h1scanner_read_reqinfo(&conn.scanner, &conn.request));
+    CHECK(conn.request.method_id == POST);
+    CHECK(h1scanner_has_body(&conn.scanner));
+    CHECK(check_read_body(&conn, body, CHECK_BODY_SIZE));
+    CHECK_STR(body, "hello world");
+    CHECK(mempipe_available(&conn.in_pipe) == 0);
+
+    check_conn_close(&conn);
+
+    return true;
+}
+
+/**
+ * @brief A rejected request is told apart from a timeout by the socket's flag, never by a stale errno, and a read stalled past its deadline sets that flag.
+ */
+static bool check_timeout_flag(void)
+{
+    static const size_t read_sizes[] = {64};
+    CheckConn conn;
+
+    CHECK(check_conn_open(&conn, "POST /upload HTTP/1.1\r\nContent-Length: twelve\r\n\r\n", CHECK_SIZES(read_sizes)));
+    errno = ETIMEDOUT;
+    CHECK(!h1scanner_read_reqinfo(&conn.scanner, &conn.request));
+    CHECK(!conn.cli_sock.timed_out);
+    CHECK(!conn.cli_sock.read_failed);
+
+    check_conn_close(&conn);
+
+    CHECK(check_conn_open(&conn, "GET /home HTTP/1.1\r\nHost:", CHECK_SIZES(read_sizes)));
+    clientsocket_set_deadline(&conn.cli_sock, timing_now_ms(), 0);
+    CHECK(!h1scanner_read_reqinfo(&conn.scanner, &conn.request));
+    CHECK(conn.cli_sock.timed_out);
+
+    check_conn_close(&conn);
+
+    return true;
+}
+
+/* Main */
+
+typedef struct check_entry_t
+{
+    const char *name;
+    bool (*run)(void);
+} CheckEntry;
+
+static const CheckEntry check_entries[] = {
+    {"request line and headers in 1-byte reads", check_one_byte_reads},
+    {"body and pipelined request in 1-byte reads", check_one_byte_body},
+    {"chunked body in stalled, odd-sized reads", check_stalled_chunked_body},
+    {"timeouts flagged apart from rejected requests", check_timeout_flag}
+};
+
+int main(void)
+{
+    int failed_count = 0;
+    int check_count = (int)(sizeof(check_entries) / sizeof(check_entries[0]));
+
+    for (int i = 0; i < check_count; i++)
+    {
+        bool check_ok = check_entries[i].run();
+
+        fprintf(stdout, "%-48s %s\n", check_entries[i].name, check_ok ? "ok" : "FAILED");
+        failed_count += !check_ok;
+    }
+
+    fprintf(stdout, "%d of %d checks passed\n", check_count - failed_count, check_count);
+
+    return (failed_count == 0) ? 0 : 1;
+}
@@ -0,0 +1,536 @@
+/**
+ * @file h1creplay.c
+ * @author Derek Tan
+ * @brief Plays a request capture back against a running server, at the recorded pace or as fast as possible. Every replay sends the same bytes on the same connections in the same order, and each connection waits for its replies before sending on, as the captured client did.
+ * @date 2023-12-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "server/capture.h"
+#include "utils/timing.h"
+
+/* Macros */
+
+#define REPLAY_READ_CHUNK 65536
+#define REPLAY_SCRATCH_SIZE 65536
+#define REPLAY_POLL_SLICE_MS 100       // longest single wait, so pacing stays on time
+#define REPLAY_DEFAULT_WAIT_MS 5000    // longest wait for a reply before moving on without it
+
+/* Structs */
+
+typedef struct replay_config_t
+{
+    const char *host;
+    const char *port;
+    bool as_fast;       // ignore the recorded pace
+    double speed;       // pace multiplier, such as 2 for twice the recorded rate
+    int wait_ms;
+    int loops;
+    const char *capture_path;
+} ReplayConfig;
+
+/**
+ * @brief The replay's stand-in for one captured connection, found by the fd the server knew it by.
+ */
+typedef struct replay_conn_t
+{
+    int sock;           // or -1 if not open
+    uint64_t expected;  // reply bytes the capture saw on it so far
+    uint64_t received;
+    bool peer_closed;
+} ReplayConn;
+
+typedef struct replay_stats_t
+{
+    uint64_t records;
+    uint64_t connections;
+    uint64_t replies;
+    uint64_t bytes_sent;
+    uint64_t bytes_expected;
+    uint64_t bytes_received;
+    uint64_t short_replies;   // waits that timed out or ended early, as when the server replied differently
+    uint64_t connect_errors;
+    uint64_t write_errors;
+} ReplayStats;
+
+typedef struct replay_state_t
+{
+    const ReplayConfig *config;
+    struct addrinfo *target;
+    ReplayConn *conns;        // by recorded fd
+    int conn_capacity;
+    struct pollfd *poll_items;
+    int *poll_owners;         // recorded fd of each poll item
+    char scratch[REPLAY_SCRATCH_SIZE];
+    ReplayStats stats;
+} ReplayState;
+
+/* Helper Funcs. */
+
+static void replay_usage(const char *exe)
+{
+    fprintf(stderr, "usage: %s [-H host] [-p port] [-f] [-s speed] [-w reply wait ms] [-n loops] capture file\n", exe);
+}
+
+static char *replay_read_all(const char *path, size_t *length_ref)
+{
+    FILE *in = fopen(path, "rb");
+    size_t capacity = REPLAY_READ_CHUNK;
+    size_t length = 0;
+    char *data = (in != NULL) ? malloc(capacity) : NULL;
+
+    while (data != NULL)
+    {
+        size_t read_count = fread(data + length, 1, capacity - length, in);
+
+        length += read_count;
+
+        if (read_count == 0)
+            break;
+
+        if (length == capacity)
+        {
+            char *grown = realloc(data, capacity * 2);
+
+            if (!grown)
+            {
+                free(data);
+                data = NULL;
+                break;
+            }
+
+            data = grown;
+            capacity *= 2;
+        }
+    }
+
+    if (in != NULL)
+        fclose(in);
+
+    *length_ref = length;
+
+    return data;
+}
+
+/**
+ * @brief Checks the capture's layout before any of it is trusted, and finds the largest fd it names.
+ * @note A record cut short, as by a server killed mid-write, is dropped with the rest of the file shortened to fit.
+ */
+static bool replay_validate(const char *data, size_t *length_ref, int *max_fd_ref)
+{
+    const CaptureFileHeader *header = (const CaptureFileHeader *)data;
+    size_t length = *length_ref;
+    size_t offset = sizeof(CaptureFileHeader);
+    int max_fd = 0;
+
+    if (length < sizeof(CaptureFileHeader) || memcmp(header->magic, CAPTURE_FILE_MAGIC, sizeof(header->magic)) != 0)
+        return false;
+
+    if (header->version != CAPTURE_FILE_VERSION)
+        return false;
+
+    while (offset < length)
+    {
+        CaptureRecord record;
+        size_t record_start = offset;
+
+        if (length - offset < sizeof(CaptureRecord))
+        {
+            length = record_start;
+            break;
+        }
+
+        memcpy(&record, data + offset, sizeof(CaptureRecord));
+        offset += sizeof(CaptureRecord);
+
+        if (record.fd < 0 || record.kind > CAPTURE_CLOSE)
+            return false;
+
+        if (record.kind == CAPTURE_DATA)
+        {
+            if (length - offset < record.length)
+            {
+                length = record_start;
+                break;
+            }
+
+            offset += record.length;
+        }
+
+        max_fd = (record.fd > max_fd) ? record.fd : max_fd;
+    }
+
+    if (length < *length_ref)
+        fprintf(stderr, "h1creplay: ignoring a truncated record at the end of the capture\n");
+
+    *length_ref = length;
+    *max_fd_ref = max_fd;
+
+    return true;
+}
+
+static void replay_close_conn(ReplayConn *conn)
+{
+    if (conn->sock != -1)
+        close(conn->sock);
+
+    conn->sock = -1;
+    conn->expected = 0;
+    conn->received = 0;
+    conn->peer_closed = false;
+}
+
+static bool replay_open_conn(ReplayState *state, ReplayConn *conn)
+{
+    const struct addrinfo *target = state->target;
+    int nodelay = 1;
+    int sock = socket(target->ai_family, target->ai_socktype, target->ai_protocol);
+
+    if (sock == -1 || connect(sock, target->ai_addr, target->ai_addrlen) != 0)
+    {
+        if (sock != -1)
+            close(sock);
+
+        state->stats.connect_errors++;
+        return false;
+    }
+
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK);
+
+    replay_close_conn(conn);
+    conn->sock = sock;
+    state->stats.connections++;
+
+    return true;
+}
+
+/**
+ * @brief Waits up to timeout_ms for replies on every open connection and takes what arrived. Also waits for write_fd to take more, if not -1.
+ *
+ * @returns true if write_fd became writable.
+ */
+static bool replay_pump(ReplayState *state, int timeout_ms, int write_fd)
+{
+    int poll_count = 0;
+    bool writable = false;
+
+    for (int fd = 0; fd < state->conn_capacity; fd++)
+    {
+        ReplayConn *conn = &state->conns[fd];
+
+        if (conn->sock == -1 || conn->peer_closed)
+            continue;
+
+        state->poll_items[poll_count].fd = conn->sock;
+        state->poll_items[poll_count].events = POLLIN | ((fd == write_fd) ? POLLOUT : 0);
+        state->poll_items[poll_count].revents = 0;
+        state->poll_owners[poll_count] = fd;
+        poll_count++;
+    }
+
+    if (poll(state->poll_items, poll_count, timeout_ms) <= 0)
+        return false;
+
+    for (int i = 0; i < poll_count; i++)
+    {
+        ReplayConn *conn = &state->conns[state->poll_owners[i]];
+        short revents = state->poll_items[i].revents;
+
+        if (revents & POLLOUT)
+            writable = true;
+
+        if ((revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+            continue;
+
+        while (true)
+        {
+            ssize_t temp_rc = recv(conn->sock, state->scratch, REPLAY_SCRATCH_SIZE, 0);
+
+            if (temp_rc > 0)
+            {
+                conn->received += temp_rc;
+                state->stats.bytes_received += temp_rc;
+                continue;
+            }
+
+            if (temp_rc == 0 || (errno != EAGAIN && errno != EINTR))
+                conn->peer_closed = true;
+
+            break;
+        }
+    }
+
+    return writable;
+}
+
+/**
+ * @brief Waits until a connection got every reply the capture saw on it, as its client did before sending on.
+ */
+static void replay_await_replies(ReplayState *state, ReplayConn *conn)
+{
+    uint64_t give_up_ms = timing_now_ms() + (uint64_t)state->config->wait_ms;
+
+    while (conn->received < conn->expected && !conn->peer_closed)
+    {
+        uint64_t now_ms = timing_now_ms();
+
+        if (now_ms >= give_up_ms)
+            break;
+
+        replay_pump(state, (int)((give_up_ms - now_ms < REPLAY_POLL_SLICE_MS) ? give_up_ms - now_ms : REPLAY_POLL_SLICE_MS), -1);
+    }
+
+    // Later waits only count replies still to come, so one mismatch does not hold up the rest.
+    if (conn->received < conn->expected)
+    {
+        state->stats.short_replies++;
+        conn->expected = conn->received;
+    }
+}
+
+static void replay_send(ReplayState *state, ReplayConn *conn, int fd, const char *data, size_t len)
+{
+    while (len > 0 && conn->sock != -1)
+    {
+        ssize_t temp_wc = send(conn->sock, data, len, MSG_NOSIGNAL);
+
+        if (temp_wc > 0)
+        {
+            data += temp_wc;
+            len -= temp_wc;
+            state->stats.bytes_sent += temp_wc;
+            continue;
+        }
+
+        if (temp_wc < 0 && (errno == EAGAIN || errno == EINTR))
+        {
+            replay_pump(state, REPLAY_POLL_SLICE_MS, fd);
+            continue;
+        }
+
+        state->stats.write_errors++;
+        conn->peer_closed = true;
+        break;
+    }
+}
+
+/**
+ * @brief Waits for a record's turn at the recorded pace, taking replies meanwhile.
+ */
+static void replay_pace(ReplayState *state, uint64_t started_ns, uint64_t offset_ns)
+{
+    uint64_t due_ns = started_ns + (uint64_t)((double)offset_ns / state->config->speed);
+
+    while (true)
+    {
+        uint64_t now_ns = timing_now_ns();
+
+        if (now_ns >= due_ns)
+            break;
+
+        uint64_t left_ms = (due_ns - now_ns + 999999) / 1000000;
+
+        replay_pump(state, (int)((left_ms < REPLAY_POLL_SLICE_MS) ? left_ms : REPLAY_POLL_SLICE_MS), -1);
+    }
+}
+
+static void replay_run_once(ReplayState *state, const char *data, size_t length)
+{
+    uint64_t started_ns = timing_now_ns();
+    size_t offset = sizeof(CaptureFileHeader);
+
+    while (offset < length)
+    {
+        CaptureRecord record;
+
+        memcpy(&record, data + offset, sizeof(CaptureRecord));
+        offset += sizeof(CaptureRecord);
+        state->stats.records++;
+
+        ReplayConn *conn = &state->conns[record.fd];
+
+        if (!state->config->as_fast)
+            replay_pace(state, started_ns, record.offset_ns);
+
+        switch (record.kind)
+        {
+        case CAPTURE_DATA:
+            // A connection the server closed without a close record, as at the end of a capture, gets a fresh one.
+            replay_await_replies(state, conn);
+
+            if ((conn->sock == -1 || conn->peer_closed) && !replay_open_conn(state, conn))
+                break;
+
+            replay_send(state, conn, record.fd, data + offset, record.length);
+            break;
+        case CAPTURE_REPLY:
+            conn->expected += record.length;
+            state->stats.replies++;
+            state->stats.bytes_expected += record.length;
+            break;
+        case CAPTURE_CLOSE:
+            replay_await_replies(state, conn);
+            replay_close_conn(conn);
+            break;
+        default:
+            break;
+        }
+
+        if (record.kind == CAPTURE_DATA)
+            offset += record.length;
+    }
+
+    for (int fd = 0; fd < state->conn_capacity; fd++)
+    {
+        if (state->conns[fd].sock == -1)
+            continue;
+
+        replay_await_replies(state, &state->conns[fd]);
+        replay_close_conn(&state->conns[fd]);
+    }
+}
+
+static bool replay_parse_args(ReplayConfig *config, int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "H:p:fs:w:n:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'H':
+            config->host = optarg;
+            break;
+        case 'p':
+            config->port = optarg;
+            break;
+        case 'f':
+            config->as_fast = true;
+            break;
+        case 's':
+            config->speed = atof(optarg);
+            break;
+        case 'w':
+            config->wait_ms = atoi(optarg);
+            break;
+        case 'n':
+            config->loops = atoi(optarg);
+            break;
+        default:
+            return false;
+        }
+    }
+
+    if (argc - optind != 1)
+        return false;
+
+    config->capture_path = argv[optind];
+
+    return config->speed > 0.0 && config->wait_ms > 0 && config->loops > 0;
+}
+
+static void replay_report(const ReplayConfig *config, const ReplayStats *stats, double elapsed_secs)
+{
+    printf("h1creplay: %s x%d against %s:%s, ", config->capture_path, config->loops, config->host, config->port);
+
+    if (config->as_fast)
+        printf("as fast as possible\n");
+    else
+        printf("at %.2fx the recorded pace\n", config->speed);
+
+    printf("%-16s %lu\n", "records", (unsigned long)stats->records);
+    printf("%-16s %lu\n", "connections", (unsigned long)stats->connections);
+    printf("%-16s %lu\n", "replies", (unsigned long)stats->replies);
+    printf("%-16s %lu\n", "bytes sent", (unsigned long)stats->bytes_sent);
+    printf("%-16s %lu of %lu expected\n", "bytes received", (unsigned long)stats->bytes_received, (unsigned long)stats->bytes_expected);
+    printf("%-16s %lu\n", "short replies", (unsigned long)stats->short_replies);
+    printf("%-16s %lu connect, %lu write\n", "errors", (unsigned long)stats->connect_errors, (unsigned long)stats->write_errors);
+    printf("%-16s %.3f s\n", "elapsed", elapsed_secs);
+    printf("%-16s %.1f\n", "replies/s", (elapsed_secs > 0.0) ? (double)stats->replies / elapsed_secs : 0.0);
+}
+
+/* Main */
+
+int main(int argc, char *argv[])
+{
+    ReplayConfig config = {.host = "127.0.0.1", .port = "8000", .as_fast = false, .speed = 1.0, .wait_ms = REPLAY_DEFAULT_WAIT_MS, .loops = 1, .capture_path = NULL};
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    size_t length = 0;
+    int max_fd = 0;
+
+    if (!replay_parse_args(&config, argc, argv))
+    {
+        replay_usage(argv[0]);
+        return 1;
+    }
+
+    char *data = replay_read_all(config.capture_path, &length);
+
+    if (!data || !replay_validate(data, &length, &max_fd))
+    {
+        fprintf(stderr, "h1creplay: %s is not a request capture of version %d\n", config.capture_path, CAPTURE_FILE_VERSION);
+        free(data);
+        return 1;
+    }
+
+    ReplayState *state = calloc(1, sizeof(ReplayState));
+
+    if (!state || getaddrinfo(config.host, config.port, &hints, &state->target) != 0)
+    {
+        fprintf(stderr, "h1creplay: cannot resolve %s:%s\n", config.host, config.port);
+        free(state);
+        free(data);
+        return 1;
+    }
+
+    state->config = &config;
+    state->conn_capacity = max_fd + 1;
+    state->conns = calloc(state->conn_capacity, sizeof(ReplayConn));
+    state->poll_items = calloc(state->conn_capacity, sizeof(struct pollfd));
+    state->poll_owners = calloc(state->conn_capacity, sizeof(int));
+
+    if (!state->conns || !state->poll_items || !state->poll_owners)
+    {
+        fprintf(stderr, "h1creplay: out of memory\n");
+        return 1;
+    }
+
+    for (int fd = 0; fd < state->conn_capacity; fd++)
+        state->conns[fd].sock = -1;
+
+    uint64_t started_ns = timing_now_ns();
+
+    for (int loop = 0; loop < config.loops; loop++)
+        replay_run_once(state, data, length);
+
+    replay_report(&config, &state->stats, (double)(timing_now_ns() - started_ns) / 1e9);
+
+    bool replay_ok = state->stats.connect_errors == 0 && state->stats.write_errors == 0;
+
+    freeaddrinfo(state->target);
+    free(state->conns);
+    free(state->poll_items);
+    free(state->poll_owners);
+    free(state);
+    free(data);
+
+    return replay_ok ? 0 : 1;
+}
@@ -0,0 +1,230 @@
+/**
+ * @file h1ctop.c
+ * @author Derek Tan
+ * @brief Shows a running server's live counters, read from its shared memory stats segment, so watching it sends no HTTP traffic and never slows its workers.
+ * @date 2023-12-24
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils/statseg.h"
+
+/* Macros */
+
+#define TOP_SHM_DIR "/dev/shm"
+#define TOP_SHM_PREFIX "h1c."
+#define TOP_DEFAULT_INTERVAL_MS 1000
+#define TOP_STALE_MS (STATSEG_PUBLISH_MS * 4)  // a segment this old likely belongs to a stopped server
+
+/* Structs */
+
+typedef struct top_config_t
+{
+    int interval_ms;
+    int iterations;  // screens to show, or 0 to keep going
+    bool batch;      // append screens instead of redrawing, as for logs and pipes
+    char segment_name[STATSEG_NAME_SIZE];
+} TopConfig;
+
+/* Helper Funcs. */
+
+static void top_usage(const char *exe)
+{
+    fprintf(stderr, "usage: %s [-i interval ms] [-n iterations] [-b] [server pid or segment name, such as /h1c.1234]\n", exe);
+}
+
+static uint64_t top_wall_ms(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    return (uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000;
+}
+
+static void top_sleep_ms(int ms)
+{
+    struct timespec delay = {.tv_sec = ms / 1000, .tv_nsec = (long)(ms % 1000) * 1000000};
+
+    nanosleep(&delay, NULL);
+}
+
+/**
+ * @brief Takes a pid, a segment name, or nothing, in which case the only server segment present is used.
+ */
+static bool top_resolve_name(const char *arg, char *dst)
+{
+    if (arg != NULL)
+    {
+        char *end = NULL;
+        long pid = strtol(arg, &end, 10);
+
+        if (*arg != '\0' && *end == '\0')
+            return pid > 0 && snprintf(dst, STATSEG_NAME_SIZE, STATSEG_NAME_FMT, (int)pid) < STATSEG_NAME_SIZE;
+
+        return snprintf(dst, STATSEG_NAME_SIZE, "%s%s", (arg[0] == '/') ? "" : "/", arg) < STATSEG_NAME_SIZE;
+    }
+
+    DIR *shm_dir = opendir(TOP_SHM_DIR);
+    struct dirent *entry = NULL;
+    int found_count = 0;
+
+    if (!shm_dir)
+        return false;
+
+    while ((entry = readdir(shm_dir)) != NULL)
+    {
+        if (strncmp(entry->d_name, TOP_SHM_PREFIX, strlen(TOP_SHM_PREFIX)) != 0)
+            continue;
+
+        if (snprintf(dst, STATSEG_NAME_SIZE, "/%s", entry->d_name) < STATSEG_NAME_SIZE)
+            found_count++;
+    }
+
+    closedir(shm_dir);
+
+    if (found_count > 1)
+        fprintf(stderr, "h1ctop: several servers are running, so pass the pid of one\n");
+
+    return found_count == 1;
+}
+
+static double top_percent(uint64_t part, uint64_t whole)
+{
+    return (whole > 0) ? (double)part * 100.0 / (double)whole : 0.0;
+}
+
+static void top_print_bytes(const char *label, uint64_t bytes)
+{
+    static const char *const units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    double value = (double)bytes;
+    int unit_i = 0;
+
+    while (value >= 1024.0 && unit_i < 4)
+    {
+        value /= 1024.0;
+        unit_i++;
+    }
+
+    printf("%s %.1f %s", label, value, units[unit_i]);
+}
+
+static void top_show(const TopConfig *config, const StatsSnapshot *snapshot)
+{
+    uint64_t now_ms = top_wall_ms();
+    uint64_t age_ms = (now_ms > snapshot->published_ms) ? now_ms - snapshot->published_ms : 0;
+    uint64_t uptime_s = snapshot->uptime_ms / 1000;
+
+    if (!config->batch)
+        fputs("\033[H\033[2J", stdout);
+
+    printf("h1ctop - %s  pid %u  up %luh %02lum %02lus  updated %lums ago%s\n", config->segment_name, snapshot->pid,
+        (unsigned long)(uptime_s / 3600), (unsigned long)(uptime_s / 60 % 60), (unsigned long)(uptime_s % 60),
+        (unsigned long)age_ms, (age_ms > TOP_STALE_MS) ? " (stale)" : "");
+    printf("requests  %12lu  rps %10.1f  parse errors %lu\n", (unsigned long)snapshot->requests, snapshot->rps,
+        (unsigned long)snapshot->parse_errors);
+    printf("responses 1xx %lu  2xx %lu  3xx %lu  4xx %lu  5xx %lu\n", (unsigned long)snapshot->responses[0],
+        (unsigned long)snapshot->responses[1], (unsigned long)snapshot->responses[2], (unsigned long)snapshot->responses[3],
+        (unsigned long)snapshot->responses[4]);
+    printf("conns     active %lu  parked %lu  accepted %lu\n", (unsigned long)snapshot->active_connections,
+        (unsigned long)snapshot->parked_connections, (unsigned long)snapshot->accepts);
+    printf("queue     depth %lu / %lu  shed when full %lu\n", (unsigned long)snapshot->queue_depth,
+        (unsigned long)snapshot->queue_capacity, (unsigned long)snapshot->queue_full);
+    top_print_bytes("traffic  ", snapshot->bytes_in);
+    top_print_bytes(" in,", snapshot->bytes_out);
+    puts(" out");
+    printf("slab pool hit %.1f%% of %lu  revalidated %.1f%% of %lu conditional\n",
+        100.0 - top_percent(snapshot->slab_misses, snapshot->slab_acquires), (unsigned long)snapshot->slab_acquires,
+        top_percent(snapshot->not_modified, snapshot->conditional_requests), (unsigned long)snapshot->conditional_requests);
+
+    printf("\n%-6s %-10s %12s %14s\n", "worker", "state", "requests", "bytes out");
+
+    for (uint32_t i = 0; i < snapshot->worker_count && i < STATSEG_MAX_WORKERS; i++)
+    {
+        const StatsWorker *worker = &snapshot->workers[i];
+
+        printf("%-6u %-10.*s %12lu %14lu\n", worker->worker_id, STATSEG_STATE_SIZE, worker->state,
+            (unsigned long)worker->requests, (unsigned long)worker->bytes_out);
+    }
+
+    if (config->batch)
+        putchar('\n');
+
+    fflush(stdout);
+}
+
+static bool top_parse_args(TopConfig *config, int argc, char *argv[])
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:n:b")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            config->interval_ms = atoi(optarg);
+            break;
+        case 'n':
+            config->iterations = atoi(optarg);
+            break;
+        case 'b':
+            config->batch = true;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    if (argc - optind > 1 || config->interval_ms <= 0 || config->iterations < 0)
+        return false;
+
+    return top_resolve_name((optind < argc) ? argv[optind] : NULL, config->segment_name);
+}
+
+/* Main */
+
+int main(int argc, char *argv[])
+{
+    TopConfig config = {.interval_ms = TOP_DEFAULT_INTERVAL_MS, .iterations = 0, .batch = !isatty(STDOUT_FILENO)};
+
+    if (!top_parse_args(&config, argc, argv))
+    {
+        top_usage(argv[0]);
+        return 1;
+    }
+
+    const StatsSegment *segment = statseg_open(config.segment_name);
+
+    if (!segment)
+    {
+        fprintf(stderr, "h1ctop: no stats segment of version %d at %s\n", STATSEG_VERSION, config.segment_name);
+        return 1;
+    }
+
+    for (int shown = 0; config.iterations == 0 || shown < config.iterations; shown++)
+    {
+        StatsSnapshot snapshot;
+
+        if (shown > 0)
+            top_sleep_ms(config.interval_ms);
+
+        if (!statseg_read(segment, &snapshot))
+            continue;
+
+        top_show(&config, &snapshot);
+    }
+
+    statseg_close(segment);
+
+    return 0;
+}
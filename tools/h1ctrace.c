@@ -0,0 +1,273 @@
+/**
+ * @file h1ctrace.c
+ * @author Derek Tan
+ * @brief Decodes H1C trace ring dumps into Chrome trace JSON, as chrome://tracing and Perfetto load, with each thread's events and its request and handler spans.
+ * @date 2023-12-23
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/tracering.h"
+
+/* Macros */
+
+#define TRACE_READ_CHUNK 65536
+#define TRACE_PID 1
+
+/* Structs */
+
+/**
+ * @brief The request a thread is serving, pieced together from its events. A worker serves one request at a time, so one per thread is enough.
+ */
+typedef struct trace_span_state_t
+{
+    int fd;               // of the request being read, or -1 if none
+    uint64_t started_ticks;
+    uint64_t routed_ticks;
+} TraceSpanState;
+
+/**
+ * @brief Writes trace events, minding the commas between them.
+ */
+typedef struct trace_json_out_t
+{
+    FILE *out;
+    uint64_t origin_ticks;
+    double ticks_per_us;
+    bool has_events;
+} TraceJsonOut;
+
+/* Helper Funcs. */
+
+static void trace_usage(const char *exe)
+{
+    fprintf(stderr, "usage: %s [dump file, or - for stdin] > trace.json\n", exe);
+}
+
+/**
+ * @brief Reads a whole dump, as from a file, SIGUSR1 or curl of the trace route.
+ */
+static char *trace_read_all(FILE *in, size_t *length_ref)
+{
+    size_t capacity = TRACE_READ_CHUNK;
+    size_t length = 0;
+    char *data = malloc(capacity);
+
+    while (data != NULL)
+    {
+        size_t read_count = fread(data + length, 1, capacity - length, in);
+
+        length += read_count;
+
+        if (read_count == 0)
+            break;
+
+        if (length == capacity)
+        {
+            char *grown = realloc(data, capacity * 2);
+
+            if (!grown)
+            {
+                free(data);
+                return NULL;
+            }
+
+            data = grown;
+            capacity *= 2;
+        }
+    }
+
+    *length_ref = length;
+
+    return data;
+}
+
+static double trace_ts_us(const TraceJsonOut *json, uint64_t ticks)
+{
+    return (double)(ticks - json->origin_ticks) / json->ticks_per_us;
+}
+
+static void trace_json_begin_event(TraceJsonOut *json)
+{
+    fputs(json->has_events ? ",\n" : "\n", json->out);
+    json->has_events = true;
+}
+
+static void trace_put_thread_name(TraceJsonOut *json, uint32_t thread_id)
+{
+    trace_json_begin_event(json);
+
+    if (thread_id == 0)
+        fprintf(json->out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":0,\"args\":{\"name\":\"listener\"}}", TRACE_PID);
+    else
+        fprintf(json->out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"worker %u\"}}", TRACE_PID, thread_id, thread_id);
+}
+
+static void trace_put_instant(TraceJsonOut *json, const TraceEvent *event)
+{
+    trace_json_begin_event(json);
+    fprintf(json->out, "{\"name\":\"%s\",\"cat\":\"conn\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{\"fd\":%d",
+        tracering_kind_name((TraceEventKind)event->kind), trace_ts_us(json, event->ticks), TRACE_PID, event->thread_id, event->fd);
+
+    if (event->kind == TRACE_ROUTE)
+        fprintf(json->out, ",\"matched\":%s", event->code ? "true" : "false");
+    else if (event->kind == TRACE_HANDLER_DONE)
+        fprintf(json->out, ",\"handler_status\":%u", event->code);
+    else if (event->kind == TRACE_SEND_DONE)
+        fprintf(json->out, ",\"status\":%u,\"bytes\":%u", event->code, event->bytes);
+
+    fputs("}}", json->out);
+}
+
+static void trace_put_span(TraceJsonOut *json, const char *name, uint64_t started_ticks, const TraceEvent *end_event)
+{
+    trace_json_begin_event(json);
+    fprintf(json->out, "{\"name\":\"%s\",\"cat\":\"request\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{\"fd\":%d,\"code\":%u}}",
+        name, trace_ts_us(json, started_ticks), (double)(end_event->ticks - started_ticks) / json->ticks_per_us,
+        TRACE_PID, end_event->thread_id, end_event->fd, end_event->code);
+}
+
+/**
+ * @brief Pairs a thread's events into request spans, from parse start to send done, and handler spans, from route to handler done.
+ */
+static void trace_track_span(TraceJsonOut *json, TraceSpanState *span, const TraceEvent *event)
+{
+    switch (event->kind)
+    {
+    case TRACE_PARSE_START:
+        span->fd = event->fd;
+        span->started_ticks = event->ticks;
+        span->routed_ticks = 0;
+        break;
+    case TRACE_ROUTE:
+        if (span->fd == event->fd)
+            span->routed_ticks = event->ticks;
+        break;
+    case TRACE_HANDLER_DONE:
+        if (span->fd == event->fd && span->routed_ticks != 0)
+            trace_put_span(json, "handler", span->routed_ticks, event);
+        break;
+    case TRACE_SEND_DONE:
+        if (span->fd == event->fd)
+            trace_put_span(json, "request", span->started_ticks, event);
+
+        span->fd = -1;
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Checks the dump's layout before any of it is trusted.
+ */
+static bool trace_validate(const char *data, size_t length, uint64_t *origin_ref)
+{
+    const TraceFileHeader *header = (const TraceFileHeader *)data;
+    size_t offset = sizeof(TraceFileHeader);
+    uint64_t origin = UINT64_MAX;
+
+    if (length < sizeof(TraceFileHeader) || memcmp(header->magic, TRACE_FILE_MAGIC, sizeof(header->magic)) != 0)
+        return false;
+
+    if (header->version != TRACE_FILE_VERSION || header->ticks_per_ns <= 0.0)
+        return false;
+
+    for (uint32_t i = 0; i < header->ring_count; i++)
+    {
+        TraceRingHeader ring_header;
+
+        if (length - offset < sizeof(TraceRingHeader))
+            return false;
+
+        memcpy(&ring_header, data + offset, sizeof(TraceRingHeader));
+        offset += sizeof(TraceRingHeader);
+
+        if (ring_header.event_count > TRACE_RING_CAPACITY || (length - offset) / sizeof(TraceEvent) < ring_header.event_count)
+            return false;
+
+        // Rings hold oldest events first, so only each ring's first event can be the earliest.
+        if (ring_header.event_count > 0)
+        {
+            TraceEvent first_event;
+
+            memcpy(&first_event, data + offset, sizeof(TraceEvent));
+            origin = (first_event.ticks < origin) ? first_event.ticks : origin;
+        }
+
+        offset += ring_header.event_count * sizeof(TraceEvent);
+    }
+
+    *origin_ref = (origin == UINT64_MAX) ? 0 : origin;
+
+    return true;
+}
+
+/* Main */
+
+int main(int argc, char *argv[])
+{
+    const char *in_path = (argc > 1) ? argv[1] : "-";
+    FILE *in = (strcmp(in_path, "-") == 0) ? stdin : fopen(in_path, "rb");
+    size_t length = 0;
+    uint64_t origin_ticks = 0;
+
+    if (argc > 2 || !in)
+    {
+        trace_usage(argv[0]);
+        return 1;
+    }
+
+    char *data = trace_read_all(in, &length);
+
+    if (in != stdin)
+        fclose(in);
+
+    if (!data || !trace_validate(data, length, &origin_ticks))
+    {
+        fprintf(stderr, "h1ctrace: %s is not a trace dump of version %d\n", in_path, TRACE_FILE_VERSION);
+        free(data);
+        return 1;
+    }
+
+    TraceFileHeader header;
+    TraceJsonOut json = {.out = stdout, .origin_ticks = origin_ticks, .has_events = false};
+    size_t offset = sizeof(TraceFileHeader);
+
+    memcpy(&header, data, sizeof(TraceFileHeader));
+    json.ticks_per_us = header.ticks_per_ns * 1000.0;
+
+    fprintf(stdout, "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"tool\":\"h1ctrace\",\"ticks_per_ns\":%.6f},\"traceEvents\":[", header.ticks_per_ns);
+
+    for (uint32_t i = 0; i < header.ring_count; i++)
+    {
+        TraceRingHeader ring_header;
+        TraceSpanState span = {.fd = -1, .started_ticks = 0, .routed_ticks = 0};
+
+        memcpy(&ring_header, data + offset, sizeof(TraceRingHeader));
+        offset += sizeof(TraceRingHeader);
+        trace_put_thread_name(&json, ring_header.thread_id);
+
+        for (uint32_t j = 0; j < ring_header.event_count; j++)
+        {
+            TraceEvent event;
+
+            memcpy(&event, data + offset, sizeof(TraceEvent));
+            offset += sizeof(TraceEvent);
+            trace_put_instant(&json, &event);
+            trace_track_span(&json, &span, &event);
+        }
+    }
+
+    fputs("\n]}\n", stdout);
+    free(data);
+
+    return 0;
+}
@@ -0,0 +1,667 @@
+/**
+ * @file microbench.c
+ * @author Derek Tan
+ * @brief In-process microbenchmarks of the request scanner over sockets and memory, reply writer, route map, resource table, task queue, access log and trace ring, reporting ns/op, timestamp ticks/op and allocations/op.
+ * @date 2023-12-21
+ *
+ * @copyright Copyright (c) 2023
+ *
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+
+#include "utils/timing.h"
+#include "basicio/sockets.h"
+#include "collections/bqueue.h"
+#include "h1c/h1scanner.h"
+#include "h1c/h1writer.h"
+#include "utils/arena.h"
+#include "utils/resrctable.h"
+#include "utils/routemap.h"
+#include "utils/tracering.h"
+#include "server/accesslog.h"
+#include "server/srvworker.h"
+
+/* Macros */
+
+#define MBENCH_SOCKBUF_SIZE (1024 * 1024)
+#define MBENCH_SCANNER_ROUNDS 4000
+#define MBENCH_SCANNER_BATCH 32        // requests queued in the socket pair per timed pass
+#define MBENCH_WRITER_ROUNDS 8000
+#define MBENCH_WRITER_BATCH 16         // replies written per timed pass, well under the socket buffer
+#define MBENCH_BODY_SIZE 4096
+#define MBENCH_ROUTE_COUNT 4096
+#define MBENCH_RESOURCE_COUNT 4096
+#define MBENCH_KEY_SIZE 48
+#define MBENCH_LOOKUPS (4 * 1000 * 1000)
+#define MBENCH_QUEUE_OPS 400000        // tasks passed through the queue per run
+#define MBENCH_QUEUE_THREADS 2         // producers, and as many consumers
+#define MBENCH_LOG_ROUNDS 64
+#define MBENCH_LOG_BATCH 4096          // records per timed pass, well under a ring's worth
+#define MBENCH_TRACE_EVENTS (4 * 1000 * 1000)
+
+/* Structs */
+
+/**
+ * @brief Totals of one benchmark's timed sections. Setup between sections is left out by pausing.
+ */
+typedef struct micro_bench_t
+{
+    const char *name;
+    uint64_t ops;
+    uint64_t elapsed_ns;
+    uint64_t elapsed_cycles;
+    uint64_t allocs;
+    uint64_t started_ns;
+    uint64_t started_cycles;
+    uint64_t started_allocs;
+} MicroBench;
+
+typedef struct queue_bench_args_t
+{
+    BlockedQueue *bqueue;
+    int count;
+} QueueBenchArgs;
+
+/* Allocation Counting */
+
+// Linked with --wrap, so every allocation by the server's objects and this file lands here first.
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static atomic_uint_fast64_t mbench_alloc_count = 0;
+
+void *__wrap_malloc(size_t size)
+{
+    atomic_fetch_add_explicit(&mbench_alloc_count, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    atomic_fetch_add_explicit(&mbench_alloc_count, 1, memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    atomic_fetch_add_explicit(&mbench_alloc_count, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+/* Corpus */
+
+/**
+ * @brief Requests as captured from common clients: curl, a browser revalidating a stylesheet, an HTTP/1.0 probe, a range request and a small upload.
+ */
+static const char *const mbench_corpus[] = {
+    "GET /home HTTP/1.1\r\nHost: localhost:8080\r\nUser-Agent: curl/8.4.0\r\nAccept: */*\r\n\r\n",
+    "GET /index.css HTTP/1.1\r\nHost: localhost:8080\r\nConnection: keep-alive\r\n"
+    "sec-ch-ua: \"Not_A Brand\";v=\"8\", \"Chromium\";v=\"120\"\r\nsec-ch-ua-mobile: ?0\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0.0.0 Safari/537.36\r\n"
+    "sec-ch-ua-platform: \"Linux\"\r\nAccept: text/css,*/*;q=0.1\r\nSec-Fetch-Site: same-origin\r\nSec-Fetch-Mode: no-cors\r\n"
+    "Sec-Fetch-Dest: style\r\nReferer: http://localhost:8080/home\r\nAccept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\nIf-None-Match: \"5d8c72a5edda8d6a\"\r\nIf-Modified-Since: Sun, 03 Dec 2023 10:00:00 GMT\r\n\r\n",
+    "GET /home HTTP/1.0\r\nHost: localhost\r\n\r\n",
+    "GET /home HTTP/1.1\r\nHost: localhost:8080\r\nRange: bytes=0-99,200-299\r\nAccept: */*\r\nIf-Range: \"5d8c72a5edda8d6a\"\r\n\r\n",
+    "POST /upload HTTP/1.1\r\nHost: localhost:8080\r\nUser-Agent: curl/8.4.0\r\nContent-Type: text/plain\r\nContent-Length: 27\r\n\r\n"
+    "hello from the microbench!\n"
+};
+
+#define MBENCH_CORPUS_COUNT (int)(sizeof(mbench_corpus) / sizeof(mbench_corpus[0]))
+
+/* Helper Funcs. */
+
+static void mbench_resume(MicroBench *bench)
+{
+    bench->started_allocs = atomic_load(&mbench_alloc_count);
+    bench->started_ns = timing_now_ns();
+    bench->started_cycles = timing_cycles();
+}
+
+static void mbench_pause(MicroBench *bench, uint64_t ops)
+{
+    uint64_t stopped_cycles = timing_cycles();
+    uint64_t stopped_ns = timing_now_ns();
+
+    bench->elapsed_cycles += stopped_cycles - bench->started_cycles;
+    bench->elapsed_ns += stopped_ns - bench->started_ns;
+    bench->allocs += atomic_load(&mbench_alloc_count) - bench->started_allocs;
+    bench->ops += ops;
+}
+
+static void mbench_report(const MicroBench *bench)
+{
+    double ops = (bench->ops > 0) ? (double)bench->ops : 1.0;
+
+    fprintf(stdout, "%-36s %10lu %10.1f %12.1f %10.3f\n", bench->name, (unsigned long)bench->ops,
+        (double)bench->elapsed_ns / ops, (double)bench->elapsed_cycles / ops, (double)bench->allocs / ops);
+}
+
+static uint32_t mbench_next_random(uint32_t *state)
+{
+    // xorshift32: cheap and deterministic, so runs compare
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+
+    return *state;
+}
+
+static bool mbench_socketpair(int fds[2])
+{
+    int buf_size = MBENCH_SOCKBUF_SIZE;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+        return false;
+
+    setsockopt(fds[0], SOL_SOCKET, SO_SNDBUF, &buf_size, sizeof(buf_size));
+    setsockopt(fds[1], SOL_SOCKET, SO_RCVBUF, &buf_size, sizeof(buf_size));
+
+    return true;
+}
+
+static bool mbench_write_all(int fd, const char *data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t temp_wc = write(fd, data, len);
+
+        if (temp_wc <= 0)
+            return false;
+
+        data += temp_wc;
+        len -= temp_wc;
+    }
+
+    return true;
+}
+
+static void mbench_drain(int fd, size_t len)
+{
+    char sink[16384];
+
+    while (len > 0)
+    {
+        ssize_t temp_rc = read(fd, sink, (len < sizeof(sink)) ? len : sizeof(sink));
+
+        if (temp_rc <= 0)
+            return;
+
+        len -= temp_rc;
+    }
+}
+
+static HandlerStatus mbench_handler(const HandlerContext *ctx, const BaseRequest *req, ResponseObj *res)
+{
+    (void)ctx;
+    (void)req;
+    (void)res;
+
+    return HANDLE_OK;
+}
+
+/* Benchmarks */
+
+/**
+ * @brief Scans requests from the corpus as a worker would, written into feed_fd or feed_pipe before each timed pass.
+ */
+static bool mbench_scan_corpus(MicroBench *bench, ClientSocket *cli_sock, int feed_fd, MemPipe *feed_pipe)
+{
+    HttpScanner scanner;
+    BaseRequest request;
+    Arena arena;
+    char *slab = malloc(SRVWORKER_SLAB_SIZE);
+    bool scan_ok = slab != NULL && arena_init(&arena, SRVWORKER_ARENA_BLOCK_SIZE);
+
+    if (!scan_ok)
+    {
+        free(slab);
+        return false;
+    }
+
+    h1scanner_init(&scanner, cli_sock, 0, &arena, slab);
+    basic_reqinfo_init(&request);
+
+    for (int round = 0; round < MBENCH_SCANNER_ROUNDS && scan_ok; round++)
+    {
+        for (int i = 0; i < MBENCH_SCANNER_BATCH && scan_ok; i++)
+        {
+            const char *raw = mbench_corpus[(round + i) % MBENCH_CORPUS_COUNT];
+
+            scan_ok = (feed_pipe != NULL) ? mempipe_write(feed_pipe, raw, strlen(raw)) : mbench_write_all(feed_fd, raw, strlen(raw));
+        }
+
+        mbench_resume(bench);
+
+        for (int i = 0; i < MBENCH_SCANNER_BATCH && scan_ok; i++)
+        {
+            scan_ok = h1scanner_read_reqinfo(&scanner, &request);
+
+            if (scan_ok && h1scanner_has_body(&scanner))
+                scan_ok = h1scanner_skip_body(&scanner);
+
+            h1scanner_reset(&scanner);
+            basic_reqinfo_clear(&request);
+            arena_reset(&arena);
+        }
+
+        mbench_pause(bench, MBENCH_SCANNER_BATCH);
+    }
+
+    h1scanner_dispose(&scanner);
+    arena_dispose(&arena);
+    free(slab);
+
+    return scan_ok;
+}
+
+/**
+ * @brief Scans through a socket pair, so the real socket reads are included.
+ */
+static bool mbench_scanner(MicroBench *bench)
+{
+    int fds[2];
+    ClientSocket cli_sock;
+
+    if (!mbench_socketpair(fds))
+        return false;
+
+    clientsocket_init(&cli_sock, fds[1]);
+
+    bool scan_ok = mbench_scan_corpus(bench, &cli_sock, fds[0], NULL);
+
+    close(fds[0]);
+    close(fds[1]);
+
+    return scan_ok;
+}
+
+/**
+ * @brief Scans through memory pipes, optionally cut into the given read sizes, leaving the scanner's own cost.
+ */
+static bool mbench_scanner_memory(MicroBench *bench, const size_t *read_sizes, int read_count)
+{
+    MemPipe in_pipe;
+    MemPipe out_pipe;
+    MemTransport mem = {.in_ref = &in_pipe, .out_ref = &out_pipe};
+    ScriptedTransport scripted = {.read_sizes = read_sizes, .read_count = read_count};
+    Transport mem_transport;
+    Transport cli_transport;
+    ClientSocket cli_sock;
+    bool scan_ok = mempipe_init(&in_pipe, MEMPIPE_DEFAULT_CAPACITY) && mempipe_init(&out_pipe, MEMPIPE_DEFAULT_CAPACITY);
+
+    transport_init_memory(&mem_transport, &mem);
+    cli_transport = mem_transport;
+
+    if (read_sizes != NULL)
+    {
+        scripted.inner_ref = &mem_transport;
+        transport_init_scripted(&cli_transport, &scripted);
+    }
+
+    clientsocket_init_transport(&cli_sock, &cli_transport);
+
+    scan_ok = scan_ok && mbench_scan_corpus(bench, &cli_sock, -1, &in_pipe);
+
+    mempipe_dispose(&in_pipe);
+    mempipe_dispose(&out_pipe);
+
+    return scan_ok;
+}
+
+static bool mbench_scanner_unfragmented(MicroBench *bench)
+{
+    return mbench_scanner_memory(bench, NULL, 0);
+}
+
+static bool mbench_scanner_fragmented(MicroBench *bench)
+{
+    // Odd sizes and stalls, as from a client behind a slow, lossy link.
+    static const size_t read_sizes[] = {1, 0, 7, 3, 0, 0, 64, 2, 512, 5};
+
+    return mbench_scanner_memory(bench, read_sizes, (int)(sizeof(read_sizes) / sizeof(read_sizes[0])));
+}
+
+/**
+ * @brief Writes a keep-alive 200 reply with a shared 4 KB body, the common case of a static file.
+ */
+static bool mbench_writer(MicroBench *bench)
+{
+    static char body[MBENCH_BODY_SIZE];
+    int fds[2];
+    ClientSocket cli_sock;
+    ReplyWriter writer;
+    ResponseObj response;
+    char *slab = malloc(SRVWORKER_SLAB_SIZE);
+    bool write_ok = slab != NULL && mbench_socketpair(fds);
+
+    if (!write_ok)
+        return false;
+
+    memset(body, 'x', sizeof(body));
+    clientsocket_init(&cli_sock, fds[0]);
+    h1writer_init(&writer, &cli_sock, 0, slab + H1SCANNER_BUFFER_MEM_SIZE);
+    resinfo_init(&response, "H1C/microbench");
+    resinfo_fill_status_line(&response, HTTP_1_1, HTTP_STATUS_OK, HTTP_MSG_OK);
+    resinfo_set_keep_connection(&response, true);
+    resinfo_set_keep_alive(&response, 5, 100);
+    resinfo_set_mime_type(&response, TXT_HTML);
+    resinfo_set_validators(&response, "\"5d8c72a5edda8d6a\"", 1701597600);
+    resinfo_set_accept_ranges(&response, true);
+    resinfo_set_content_length(&response, MBENCH_BODY_SIZE);
+    resinfo_set_shared_payload(&response, body);
+
+    for (int round = 0; round < MBENCH_WRITER_ROUNDS && write_ok; round++)
+    {
+        mbench_resume(bench);
+
+        for (int i = 0; i < MBENCH_WRITER_BATCH && write_ok; i++)
+        {
+            write_ok = h1writer_put_reply(&writer, &response);
+            h1writer_reset(&writer);
+        }
+
+        mbench_pause(bench, MBENCH_WRITER_BATCH);
+
+        // Drain what the pass wrote, untimed, so the next pass never finds the socket full.
+        int pending_count = 0;
+
+        if (ioctl(fds[1], FIONREAD, &pending_count) == 0)
+            mbench_drain(fds[1], (size_t)pending_count);
+    }
+
+    h1writer_dispose(&writer);
+    close(fds[0]);
+    close(fds[1]);
+    free(slab);
+
+    return write_ok;
+}
+
+/**
+ * @brief Looks up routes in a map of thousands, inserted in random order as an app would register them. One lookup in eight misses.
+ */
+static bool mbench_rtemap(MicroBench *bench)
+{
+    static char paths[MBENCH_ROUTE_COUNT][MBENCH_KEY_SIZE];
+    static char missing[MBENCH_ROUTE_COUNT / 8][MBENCH_KEY_SIZE];
+    static int order[MBENCH_ROUTE_COUNT];
+    RouteMap router;
+    uint32_t random_state = 2463534242u;
+    int found_count = 0;
+
+    rtemap_init(&router);
+
+    for (int i = 0; i < MBENCH_ROUTE_COUNT; i++)
+    {
+        snprintf(paths[i], MBENCH_KEY_SIZE, "/api/v1/items/%05d/detail", i);
+        order[i] = i;
+    }
+
+    for (int i = 0; i < MBENCH_ROUTE_COUNT / 8; i++)
+        snprintf(missing[i], MBENCH_KEY_SIZE, "/api/v1/items/%05d/missing", i);
+
+    for (int i = MBENCH_ROUTE_COUNT - 1; i > 0; i--)
+    {
+        int j = (int)(mbench_next_random(&random_state) % (uint32_t)(i + 1));
+        int temp = order[i];
+
+        order[i] = order[j];
+        order[j] = temp;
+    }
+
+    for (int i = 0; i < MBENCH_ROUTE_COUNT; i++)
+        rtemap_put(&router, rtdnode_create(paths[order[i]], GET, TXT_HTML, mbench_handler));
+
+    mbench_resume(bench);
+
+    for (int i = 0; i < MBENCH_LOOKUPS; i++)
+    {
+        uint32_t pick = mbench_next_random(&random_state);
+        const char *path = ((pick & 7) == 0) ? missing[(pick >> 3) % (MBENCH_ROUTE_COUNT / 8)] : paths[(pick >> 3) % MBENCH_ROUTE_COUNT];
+
+        found_count += rtemap_get(&router, path) != NULL;
+    }
+
+    mbench_pause(bench, MBENCH_LOOKUPS);
+    rtemap_dispose(&router);
+
+    return found_count > 0;
+}
+
+/**
+ * @brief Looks up keys in a resource table of thousands of entries.
+ */
+static bool mbench_restable(MicroBench *bench)
+{
+    static char keys[MBENCH_RESOURCE_COUNT][MBENCH_KEY_SIZE];
+    static StaticResource placeholder;  // only its address is stored, so it needs no loading
+    ResourceTable table;
+    uint32_t random_state = 88172645u;
+    int found_count = 0;
+
+    if (!restable_init(&table, MBENCH_RESOURCE_COUNT))
+        return false;
+
+    for (int i = 0; i < MBENCH_RESOURCE_COUNT; i++)
+    {
+        snprintf(keys[i], MBENCH_KEY_SIZE, "./www/assets/file%04d.css", i);
+        restable_put(&table, keys[i], &placeholder);
+    }
+
+    mbench_resume(bench);
+
+    for (int i = 0; i < MBENCH_LOOKUPS; i++)
+        found_count += restable_get(&table, keys[mbench_next_random(&random_state) % MBENCH_RESOURCE_COUNT]) != NULL;
+
+    mbench_pause(bench, MBENCH_LOOKUPS);
+
+    // NOTE: restable_dispose would dispose the placeholder, so only the buckets are freed.
+    free(table.resources);
+
+    return found_count > 0;
+}
+
+static void *mbench_queue_producer(void *args_ref)
+{
+    QueueBenchArgs *args = (QueueBenchArgs *)args_ref;
+
+    for (int i = 0; i < args->count; i++)
+    {
+        QueueNode *task = qnode_create(i);
+
+        // A full queue is retried, as a listener would rather wait than drop in a benchmark.
+        while (!bqueue_enqueue(args->bqueue, task))
+            sched_yield();
+
+        pthread_cond_signal(&args->bqueue->signaler);
+    }
+
+    return NULL;
+}
+
+static void *mbench_queue_consumer(void *args_ref)
+{
+    QueueBenchArgs *args = (QueueBenchArgs *)args_ref;
+
+    for (int i = 0; i < args->count; i++)
+    {
+        // Same pattern as srvworker_consume.
+        pthread_mutex_lock(&args->bqueue->lock);
+
+        while (bqueue_is_empty(args->bqueue))
+            pthread_cond_wait(&args->bqueue->signaler, &args->bqueue->lock);
+
+        QueueNode *task = bqueue_dequeue(args->bqueue);
+
+        pthread_mutex_unlock(&args->bqueue->lock);
+        free(task);
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Passes tasks from producers to consumers through the task queue, as the listener and workers do.
+ */
+static bool mbench_bqueue(MicroBench *bench, int thread_pairs)
+{
+    BlockedQueue bqueue;
+    pthread_t producers[MBENCH_QUEUE_THREADS];
+    pthread_t consumers[MBENCH_QUEUE_THREADS];
+    QueueBenchArgs args;
+
+    if (!bqueue_init(&bqueue, BQUEUE_MAX_SIZE))
+        return false;
+
+    args.bqueue = &bqueue;
+    args.count = MBENCH_QUEUE_OPS / thread_pairs;
+
+    mbench_resume(bench);
+
+    for (int i = 0; i < thread_pairs; i++)
+    {
+        pthread_create(&consumers[i], NULL, mbench_queue_consumer, &args);
+        pthread_create(&producers[i], NULL, mbench_queue_producer, &args);
+    }
+
+    for (int i = 0; i < thread_pairs; i++)
+    {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+
+    mbench_pause(bench, (uint64_t)args.count * thread_pairs);
+
+    pthread_cond_destroy(&bqueue.signaler);
+    pthread_mutex_destroy(&bqueue.lock);
+
+    return true;
+}
+
+static bool mbench_bqueue_single(MicroBench *bench)
+{
+    return mbench_bqueue(bench, 1);
+}
+
+static bool mbench_bqueue_contended(MicroBench *bench)
+{
+    return mbench_bqueue(bench, MBENCH_QUEUE_THREADS);
+}
+
+/**
+ * @brief Puts access log records into a worker's ring while the flusher writes them to /dev/null. Each pass waits for the ring to drain untimed, so no record is dropped.
+ */
+static bool mbench_accesslog(MicroBench *bench)
+{
+    AccessLog log;
+    AccessRecord record = {
+        .worker_id = 1,
+        .method = GET,
+        .path = "/api/v1/items/00042/detail",
+        .status_code = 200,
+        .bytes_in = 83,
+        .bytes_out = 685,
+        .duration_ns = 92400,
+        .error = NULL
+    };
+    bool put_ok = true;
+
+    if (!accesslog_init(&log, "/dev/null", 1) || !accesslog_start(&log))
+        return false;
+
+    LogRing *ring = accesslog_get_ring(&log, 0);
+
+    for (int round = 0; round < MBENCH_LOG_ROUNDS && put_ok; round++)
+    {
+        mbench_resume(bench);
+
+        for (int i = 0; i < MBENCH_LOG_BATCH; i++)
+            put_ok = logring_put_record(ring, &record) && put_ok;
+
+        mbench_pause(bench, MBENCH_LOG_BATCH);
+
+        while (atomic_load(&ring->read_pos) != atomic_load(&ring->write_pos))
+            usleep(1000);
+    }
+
+    accesslog_dispose(&log);
+
+    return put_ok;
+}
+
+/**
+ * @brief Records lifecycle events into a trace ring, as workers do several times per request.
+ */
+static bool mbench_tracering(MicroBench *bench)
+{
+    static TraceRing ring;
+
+    tracering_init(&ring, 1);
+    mbench_resume(bench);
+
+    for (int i = 0; i < MBENCH_TRACE_EVENTS; i++)
+        tracering_record(&ring, (TraceEventKind)(i % TRACE_KIND_COUNT), i & 1023, 200, (uint32_t)i);
+
+    mbench_pause(bench, MBENCH_TRACE_EVENTS);
+
+    return atomic_load(&ring.head) == MBENCH_TRACE_EVENTS;
+}
+
+/* Main */
+
+typedef struct micro_bench_entry_t
+{
+    const char *name;
+    bool (*run)(MicroBench *bench);
+} MicroBenchEntry;
+
+static const MicroBenchEntry mbench_entries[] = {
+    {"h1scanner_read_reqinfo", mbench_scanner},
+    {"h1scanner_read_reqinfo (memory)", mbench_scanner_unfragmented},
+    {"h1scanner_read_reqinfo (fragmented)", mbench_scanner_fragmented},
+    {"h1writer_put_reply", mbench_writer},
+    {"rtemap_get (4096 routes)", mbench_rtemap},
+    {"restable_get (4096 keys)", mbench_restable},
+    {"bqueue_enqueue/dequeue (1p/1c)", mbench_bqueue_single},
+    {"bqueue_enqueue/dequeue (2p/2c)", mbench_bqueue_contended},
+    {"logring_put_record", mbench_accesslog},
+    {"tracering_record", mbench_tracering}
+};
+
+int main(int argc, char *argv[])
+{
+    const char *filter = (argc > 1) ? argv[1] : NULL;
+    int exit_code = 0;
+
+    fprintf(stdout, "%-36s %10s %10s %12s %10s\n", "benchmark", "ops", "ns/op", "ticks/op", "allocs/op");
+
+    for (size_t i = 0; i < sizeof(mbench_entries) / sizeof(mbench_entries[0]); i++)
+    {
+        MicroBench bench = {.name = mbench_entries[i].name};
+
+        if (filter != NULL && strstr(mbench_entries[i].name, filter) == NULL)
+            continue;
+
+        if (!mbench_entries[i].run(&bench))
+        {
+            fprintf(stderr, "%s: failed\n", bench.name);
+            exit_code = 1;
+            continue;
+        }
+
+        mbench_report(&bench);
+    }
+
+    return exit_code;
+}